@@ -175,6 +175,11 @@ comma-separated list of all input values
 .TP
 .B countunique
 number of unique/distinct values
+
+.TP
+.B acountunique[:PRECISION]
+estimated number of unique/distinct values, from a HyperLogLog sketch of
+2^\fBPRECISION\fR registers (defaults to 12, with an error of about 1.6%).
 .PP
 
 
@@ -231,6 +236,16 @@ inter-quartile range
 .B perc[:PERCENTILE]
 percentile value \fBPERCENTILE\fR (defaults to 95).
 
+.TP
+.B amedian[:COMPRESSION]
+estimated median value, from a t-digest of about 2.5 times
+\fBCOMPRESSION\fR centroids (defaults to 100).
+
+.TP
+.B aperc[:PERCENTILE[:COMPRESSION]]
+estimated percentile value \fBPERCENTILE\fR (defaults to 95),
+from a t-digest like \fBamedian\fR.
+
 .TP
 .B mode
 mode value (most common value)
@@ -26,90 +26,59 @@
 #include <string.h>
 #include <assert.h>
 
-#include "hash.h"
-#include "hashcode-string2.h"
 #include "xalloc.h"
 
 #include "system.h"
 #include "crosstab.h"
+#include "key-intern.h"
 #include "utils.h"
 #include "text-options.h"
+#include "text-output.h"
 
-
-static bool _GL_ATTRIBUTE_PURE
-str_comparator (const void* a, const void* b)
+/* A row or column name, as sorted by crosstab_print () */
+struct crosstab_name
 {
-  assert (a!=NULL && b!=NULL);                   /* LCOV_EXCL_LINE */
-  if (a==b)
-    return true;
-  return (STREQ ((const char*)a, (const char*)b));
-}
+  const char *name;
+  size_t len;
+  size_t id;
+};
 
-static size_t _GL_ATTRIBUTE_PURE
-hash_crosstab_data_cell (void const *x, size_t tablesize)
+static int _GL_ATTRIBUTE_PURE
+crosstab_name_compare (const void *p1, const void *p2)
 {
-  struct crosstab_datacell *dc = (struct crosstab_datacell*)x;
-
-  const char *s;
-  size_t h = 0;
-#define SIZE_BITS (sizeof (size_t) * CHAR_BIT)
-
-  for (s = dc->row_name; *s; s++)
-    h = *s + ((h << 9) | (h >> (SIZE_BITS - 9)));
-  for (s = dc->col_name; *s; s++)
-    h = *s + ((h << 9) | (h >> (SIZE_BITS - 9)));
-
-  return h % tablesize;
+  const struct crosstab_name *n1 = p1;
+  const struct crosstab_name *n2 = p2;
+  const int diff = memcmp (n1->name, n2->name, MIN (n1->len, n2->len));
+  if (diff)
+    return diff;
+  return (n1->len > n2->len) - (n1->len < n2->len);
 }
 
-static bool _GL_ATTRIBUTE_PURE
-crosstab_datacell_comparator (const void* a, const void* b)
+/* Returns the sorted names of KI (to be freed by the caller) */
+static struct crosstab_name*
+crosstab_sorted_names (const struct key_intern *ki)
 {
-  assert (a!=NULL && b!=NULL);                   /* LCOV_EXCL_LINE */
-  if (a==b)
-    return true;
-  const struct crosstab_datacell *da = (struct crosstab_datacell*)a;
-  const struct crosstab_datacell *db = (struct crosstab_datacell*)b;
-  return (STREQ (da->row_name, db->row_name)
-          && STREQ (da->col_name, db->col_name));
-}
-
-
-static struct crosstab_datacell*
-new_datacell (const char* row, const char* col, const char* data)
-{
-  struct crosstab_datacell *dc = xmalloc (sizeof (struct crosstab_datacell));
-  dc->row_name = row;
-  dc->col_name = col;
-  dc->data = xstrdup (data);
-  return dc;
-}
-
-static void
-crosstab_datacell_free (void *a)
-{
-  struct crosstab_datacell *dc = (struct crosstab_datacell*)a;
-  dc->row_name = NULL;
-  dc->col_name = NULL;
-  /* syntax-check doesn't like casting the argument to free; free
-     doesn't like const values passed to it. */
-  void *data = (void*)dc->data;
-  free (data);
-  dc->data = NULL;
-  free (dc);
+  const size_t n = key_intern_count (ki);
+  struct crosstab_name *names = XNMALLOC (n, struct crosstab_name);
+  for (size_t i = 0; i < n; ++i)
+    {
+      names[i].name = key_intern_key (ki, i, &names[i].len);
+      names[i].id = i;
+    }
+  qsort (names, n, sizeof *names, crosstab_name_compare);
+  return names;
 }
 
 /* Setup needed variables for the cross-tabulation */
 struct crosstab*
 crosstab_init ()
 {
-  struct crosstab *ct = XMALLOC (struct crosstab);
+  struct crosstab *ct = XZALLOC (struct crosstab);
 
-  ct->rows    = hash_initialize (1000,NULL,hash_pjw,str_comparator,free);
-  ct->columns = hash_initialize (1000,NULL,hash_pjw,str_comparator,free);
-  ct->data    = hash_initialize (1000,NULL,hash_crosstab_data_cell,
-                                crosstab_datacell_comparator,
-                                crosstab_datacell_free);
+  ct->rows    = key_intern_init ();
+  ct->columns = key_intern_init ();
+  ct->cells   = key_intern_init ();
+  ct->values  = key_intern_init ();
   return ct;
 }
 
@@ -117,33 +86,33 @@ void
 crosstab_free (struct crosstab* ct)
 {
   assert (ct!=NULL);                             /* LCOV_EXCL_LINE */
-  hash_free (ct->rows);
-  ct->rows = NULL;
-  hash_free (ct->columns);
-  ct->columns = NULL;
-  hash_free (ct->data);
-  ct->data = NULL;
+  key_intern_free (ct->rows);
+  key_intern_free (ct->columns);
+  key_intern_free (ct->cells);
+  key_intern_free (ct->values);
+  free (ct->cell_values);
   free (ct);
 }
 
-/* Add new cross-tabulation result */
+/* Add new cross-tabulation result.
+   If the cell already has a result, the first one is kept. */
 void
 crosstab_add_result (struct crosstab* ct,
-                      const char* row, const char* col, const char* data)
+                     const char* row, size_t row_len,
+                     const char* col, size_t col_len, const char* data)
 {
-  const char* r = hash_lookup (ct->rows, row);
-  if (r==NULL)
-    r = hash_insert (ct->rows, xstrdup (row));
-
-  const char* c = hash_lookup (ct->columns, col);
-  if (c==NULL)
-    c = hash_insert (ct->columns, xstrdup (col));
-
-  struct crosstab_datacell *ctdc = new_datacell (r,c,data);
-  struct crosstab_datacell *existing_ctdc = hash_insert (ct->data, ctdc);
-  if (ctdc != existing_ctdc) {
-    crosstab_datacell_free (ctdc);
-  }
+  const size_t cell[2] = { key_intern_id (ct->rows, row, row_len),
+                           key_intern_id (ct->columns, col, col_len) };
+  const char *key = (const char *) cell;
+  const size_t hash = key_intern_hash (key, sizeof cell);
+  if (key_intern_find (ct->cells, key, sizeof cell, hash) != KEY_INTERN_NONE)
+    return;
+
+  const size_t id = key_intern_add (ct->cells, key, sizeof cell, hash);
+  if (id == ct->alloc_cell_values)
+    ct->cell_values = x2nrealloc (ct->cell_values, &ct->alloc_cell_values,
+                                  sizeof *ct->cell_values);
+  ct->cell_values[id] = key_intern_id (ct->values, data, strlen (data));
 }
 
 
@@ -151,38 +120,42 @@ crosstab_add_result (struct crosstab* ct,
 void
 crosstab_print (const struct crosstab* ct)
 {
-  const size_t n_rows = hash_get_n_entries (ct->rows);
-  char** rows_list = XNMALLOC (n_rows,char*);
-  hash_get_entries (ct->rows, (void**)rows_list, n_rows);
-  qsort (rows_list, n_rows, sizeof (char*), cmpstringp);
+  const size_t n_rows = key_intern_count (ct->rows);
+  struct crosstab_name *rows_list = crosstab_sorted_names (ct->rows);
 
-  const size_t n_cols = hash_get_n_entries (ct->columns);
-  char** cols_list = XNMALLOC (n_cols,char*);
-  hash_get_entries (ct->columns, (void**)cols_list, n_cols);
-  qsort (cols_list, n_cols, sizeof (char*), cmpstringp);
+  const size_t n_cols = key_intern_count (ct->columns);
+  struct crosstab_name *cols_list = crosstab_sorted_names (ct->columns);
 
   /* Print columns */
   for (size_t c = 0; c < n_cols; ++c)
     {
       print_field_separator ();
-      fputs (cols_list[c], stdout);
+      output_field (cols_list[c].name, cols_list[c].len);
     }
   print_line_separator ();
 
   /* Print rows */
   for (size_t r = 0; r < n_rows; ++r)
     {
-      fputs (rows_list[r], stdout);
+      output_field (rows_list[r].name, rows_list[r].len);
 
       for (size_t c = 0; c < n_cols; ++c)
         {
-          struct crosstab_datacell curr;
-          curr.row_name = rows_list[r];
-          curr.col_name = cols_list[c];
-
-          const struct crosstab_datacell *dc = hash_lookup (ct->data, &curr);
+          const size_t cell[2] = { rows_list[r].id, cols_list[c].id };
+          const char *key = (const char *) cell;
+          const size_t id = key_intern_find (ct->cells, key, sizeof cell,
+                                             key_intern_hash (key,
+                                                              sizeof cell));
           print_field_separator ();
-          fputs ((dc==NULL)?missing_field_filler:dc->data, stdout);
+          if (id == KEY_INTERN_NONE)
+            output_str (missing_field_filler);
+          else
+            {
+              size_t len;
+              const char *data = key_intern_key (ct->values,
+                                                 ct->cell_values[id], &len);
+              output_field (data, len);
+            }
         }
 
       print_line_separator ();
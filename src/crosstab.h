@@ -22,29 +22,25 @@
 #ifndef __CROSSTAB_H__
 #define __CROSSTAB_H__
 
+/* Results of the cross-tabulation, keyed by the IDs of their
+   row and column names */
 struct crosstab
 {
-  Hash_table *rows;
-  Hash_table *columns;
-  Hash_table *data;
+  struct key_intern *rows;
+  struct key_intern *columns;
+  struct key_intern *cells;     /* (row ID, column ID) pairs */
+  struct key_intern *values;    /* the distinct results */
+  size_t *cell_values;          /* the value ID of each cell ID */
+  size_t alloc_cell_values;
 };
 
-struct crosstab_datacell
-{
-  const char* row_name;
-  const char* col_name;
-  const char* data;
-};
-
-struct crosstab_data_cell*
-crosstab_new_datacell (const char* row, const char* col, const char* data);
-
 struct crosstab*
 crosstab_init ();
 
 void
 crosstab_add_result (struct crosstab* ct,
-                      const char* row, const char* col, const char* data);
+                     const char* row, size_t row_len,
+                     const char* col, size_t col_len, const char* data);
 
 void
 crosstab_print (const struct crosstab* ct);
@@ -28,19 +28,22 @@
 #include <getopt.h>
 #include <locale.h>
 #include <math.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <inttypes.h>
 #include <strings.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 #include "system.h"
 
 #include "die.h"
 #include "fpucw.h"
 #include "closeout.h"
-#include "hash.h"
-#include "hashcode-string2.h"
+#include "hard-locale.h"
 #include "lib/intprops.h"
 #include "quote.h"
 #include "ignore-value.h"
@@ -50,16 +53,29 @@
 #include "version-etc.h"
 #include "xalloc.h"
 #include "sh-quote.h"
+#include "readtokens0.h"
+#include "xstrtol.h"
 
 #include "text-options.h"
+#include "text-output.h"
 #include "text-lines.h"
+#include "text-scan.h"
+#include "text-numbers.h"
+#include "text-sort.h"
 #include "column-headers.h"
 #include "op-defs.h"
 #include "op-parser.h"
 #include "utils.h"
 #include "randutils.h"
 #include "field-ops.h"
+#include "tdigest.h"
+#include "hyperloglog.h"
 #include "crosstab.h"
+#include "key-intern.h"
+#include "decompress.h"
+#include "workers.h"
+#include "state-file.h"
+#include "hash-group.h"
 
 /* The official name of this program (e.g., no 'g' prefix).  */
 #define PROGRAM_NAME "datamash"
@@ -71,8 +87,9 @@
 const char version_etc_copyright[]
   = "Copyright %s %d Assaf Gordon and Tim Rice" ;
 
-/* Line number in the input file */
-static size_t line_number = 0 ;
+/* Line number in the input file
+   (in a --threads worker, the number of the line being grouped) */
+static _Thread_local size_t line_number = 0 ;
 
 /* Lines in the current group */
 static size_t lines_in_group = 0 ;
@@ -96,16 +113,107 @@ static bool crosstab_mode = false; /* if TRUE, do cross-tabulation */
 static struct crosstab* crosstab = NULL;
 
 static bool pipe_through_sort = false;
+
+/* With --hash-group, groups are collected in a hash table
+   (the input need not be sorted). With -s, only the results are sorted. */
+static bool hash_groups = false;
+static bool sort_hash_groups = false;
+/* Memory budget of --hash-group (--hash-buffer-size) */
+static size_t hash_buffer_size = 1024 * 1024 * 1024;
+
+/* The groups collected with --hash-group */
+static struct hash_group_config hash_config;
+static struct hash_grouper *hash_grouper = NULL;
+
+/* Number of threads (--threads). 0 if not given: grouping uses one
+   thread, and the built-in sort one thread per processor. */
+static size_t num_threads = 0;
+
 static FILE* input_stream = NULL;
+static struct line_input input_lines;
+
+/* Input files (NULL = read from stdin) */
+static char **input_files = NULL;
+static size_t num_input_files = 0;
+
+/* Errors about an input line name its file (if there are several
+   input files), and give its line number in that file */
+static bool name_input_files = false;
+
+/* Process which writes the input files to 'sort' (-1 = none) */
+static pid_t input_feeder = -1;
+
+/* Maximum number of input files processed at the same time */
+static size_t parallel_jobs = 1;
+
+/* In a worker process: partial results, to be combined with the results
+   of the other input files by the main process (NULL = not a worker) */
+static FILE *worker_state = NULL;
+
+/* Number of groups completed by a group-by worker */
+static size_t worker_groups = 0;
+
+/* In the main process: the last group of the previous input files,
+   which might continue in the next file (see merge_group_state ()) */
+static struct line_record_t pending_group_line;
+static bool pending_group = false;
+static struct line_record_t merge_group_line;
+
+/* With --emit-state, the states of the operations of each group are
+   written instead of their results, to be combined by 'merge-state' */
+static bool emit_state = false;
+
+/* With --top, only the 'top_groups' groups with the largest result of
+   the operation number 'top_by' (--by, 1 = the first operation) are
+   printed, after all the groups were collected. 'top_op' is the index
+   of this operation in dm->ops. */
+static size_t top_groups = 0;
+static size_t top_by = 0;
+static size_t top_op = 0;
+
+/* A group kept by --top, with its printed results */
+struct top_group
+{
+  long double value;    /* the result of the --by operation */
+  size_t order;         /* the group's position in the output */
+  char *out;
+  size_t out_len;
+  size_t out_alloc;
+};
 
-/* Use large buffer for normal operation (will be reduced for testing) */
-static size_t rmdup_initial_size = (1024*1024);
+/* The groups kept by --top: a min-heap, whose root is the group
+   which would be dropped first */
+static struct top_group *top_heap = NULL;
+static size_t top_heap_size = 0;
+static size_t top_heap_alloc = 0;
+static size_t top_order = 0;
+
+/* The operations, as given on the command line (or read from the state
+   files by 'merge-state'): written at the beginning of the states */
+static const char *state_group_spec = NULL;
+static const char **state_op_args = NULL;
+static size_t state_num_op_args = 0;
+
+/* Use the vector text-scanning kernels, if supported by the CPU
+   (disabled for testing) */
+static bool use_simd = true;
 
 /* Explicit output delimiter with --output-delimiter */
 static int explicit_output_delimiter = -1;
 
-/* Path to default sort program */
-static const char *sort_cmd = SORT_PATH;
+/* True if -t was used (--csv defaults to a comma) */
+static bool explicit_field_separator = false;
+
+/* External sort program (--sort-cmd).
+   If NULL, the input is sorted in-process (see text-sort.h). */
+static const char *sort_cmd = NULL;
+
+/* Memory budget of the in-process sort (--sort-buffer-size) */
+static size_t sort_buffer_size = SORT_BUFFER_DEFAULT;
+
+/* In-process sort of the input (created when the first line is read) */
+static bool sort_input = false;
+static struct line_sorter *input_sorter = NULL;
 
 enum
 {
@@ -116,14 +224,28 @@ enum
   OUTPUT_DELIMITER_OPTION,
   CUSTOM_FORMAT_OPTION,
   SORT_PROGRAM_OPTION,
+  SORT_BUFFER_SIZE_OPTION,
+  HASH_BUFFER_SIZE_OPTION,
   VNLOG_OPTION,
   UNDOC_PRINT_INF_OPTION,
   UNDOC_PRINT_NAN_OPTION,
   UNDOC_PRINT_PROGNAME_OPTION,
-  UNDOC_RMDUP_TEST
+  FILES0_FROM_OPTION,
+  PARALLEL_OPTION,
+  DECOMPRESS_OPTION,
+  CSV_OPTION,
+  HASH_GROUP_OPTION,
+  THREADS_OPTION,
+  EMIT_STATE_OPTION,
+  TOP_OPTION,
+  BY_OPTION,
+  UNDOC_RMDUP_TEST,
+  UNDOC_NO_SIMD_OPTION
 };
 
-static char const short_options[] = "sS:fF:izg:t:HWR:Cc:hV";
+/* The leading '-' returns the operations (non-option arguments) in order,
+   to tell them apart from the file operands following '--' */
+static char const short_options[] = "-sS:fF:izg:t:HWR:Cc:hV";
 
 static struct option const long_options[] =
 {
@@ -143,11 +265,22 @@ static struct option const long_options[] =
   {"output-delimiter", required_argument, NULL, OUTPUT_DELIMITER_OPTION},
   {"collapse-delimiter", required_argument, NULL,'c'},
   {"sort", no_argument, NULL, 's'},
+  {"hash-group", no_argument, NULL, HASH_GROUP_OPTION},
+  {"hash-buffer-size", required_argument, NULL, HASH_BUFFER_SIZE_OPTION},
   {"seed", no_argument, NULL, 'S'},
   {"no-strict", no_argument, NULL, NO_STRICT_OPTION},
   {"narm", no_argument, NULL, REMOVE_NA_VALUES_OPTION},
   {"round", required_argument, NULL, 'R'},
   {"sort-cmd", required_argument, NULL, SORT_PROGRAM_OPTION},
+  {"sort-buffer-size", required_argument, NULL, SORT_BUFFER_SIZE_OPTION},
+  {"files0-from", required_argument, NULL, FILES0_FROM_OPTION},
+  {"parallel", required_argument, NULL, PARALLEL_OPTION},
+  {"threads", required_argument, NULL, THREADS_OPTION},
+  {"emit-state", no_argument, NULL, EMIT_STATE_OPTION},
+  {"top", required_argument, NULL, TOP_OPTION},
+  {"by", required_argument, NULL, BY_OPTION},
+  {"decompress", required_argument, NULL, DECOMPRESS_OPTION},
+  {"csv", no_argument, NULL, CSV_OPTION},
   {GETOPT_HELP_OPTION_DECL},
   {GETOPT_VERSION_OPTION_DECL},
   /* Undocumented options */
@@ -155,6 +288,7 @@ static struct option const long_options[] =
   {"-print-nan", no_argument, NULL, UNDOC_PRINT_NAN_OPTION},
   {"-print-progname", no_argument, NULL, UNDOC_PRINT_PROGNAME_OPTION},
   {"-rmdup-test", no_argument, NULL, UNDOC_RMDUP_TEST},
+  {"-no-simd", no_argument, NULL, UNDOC_NO_SIMD_OPTION},
   {NULL, 0, NULL, 0},
 };
 
@@ -184,10 +318,11 @@ usage (int status)
     emit_try_help ();
   else
     {
-      printf (_("Usage: %s [OPTION] op [fld] [op fld ...]\n"),
+      printf (_("Usage: %s [OPTION] op [fld] [op fld ...] [-- FILE...]\n"),
           program_name);
       fputs ("\n", stdout);
-      fputs (_("Performs numeric/string operations on input from stdin."),
+      fputs (_("Performs numeric/string operations on input from stdin,\n\
+or from the FILEs listed after '--' (read one after the other)."),
           stdout);
       fputs ("\n\n", stdout);
       fputs (_("\
@@ -202,7 +337,8 @@ fields can be listed with a dash (e.g. 2-8).  Use colons for operations\n\
 which require a pair of fields (e.g. 'pcov 2:6').\n"), stdout);
       fputs ("\n\n", stdout);
       fputs (_("Primary operations:\n"),stdout);
-      fputs ("  groupby, crosstab, transpose, reverse, check\n",stdout);
+      fputs ("  groupby, crosstab, transpose, reverse, check, merge-state\n",
+             stdout);
 
       fputs (_("Line-Filtering operations:\n"),stdout);
       fputs ("  rmdup\n",stdout);
@@ -218,14 +354,15 @@ which require a pair of fields (e.g. 'pcov 2:6').\n"), stdout);
       fputs ("  sum, min, max, absmin, absmax, range, dotprod\n",stdout);
 
       fputs (_("Textual/Numeric Grouping operations:\n"),stdout);
-      fputs ("  count, first, last, rand, unique, collapse, countunique\n",
+      fputs ("  count, first, last, rand, unique, collapse, countunique,\n",
              stdout);
+      fputs ("  acountunique\n", stdout);
 
       fputs (_("Statistical Grouping operations:\n"),stdout);
       fputs ("\
   mean, geomean, harmmean, trimmean, median, q1, q3, iqr, perc,\n\
-  mode, antimode, pstdev, sstdev, pvar, svar, ms, rms, mad, madraw,\n\
-  pskew, sskew, pkurt, skurt, dpo, jarque,\n\
+  amedian, aperc, mode, antimode, pstdev, sstdev, pvar, svar, ms, rms,\n\
+  mad, madraw, pskew, sskew, pkurt, skurt, dpo, jarque,\n\
   scov, pcov, spearson, ppearson\n\
 \n", stdout);
       fputs ("\n", stdout);
@@ -247,7 +384,9 @@ which require a pair of fields (e.g. 'pcov 2:6').\n"), stdout);
 "), stdout);
       fputs (_("\
   -g, --group=X[,Y,Z]       group via fields X,[Y,Z];\n\
-                              equivalent to primary operation 'groupby'\n\
+                              equivalent to primary operation 'groupby';\n\
+                              a field can be computed by a per-line\n\
+                              operation, e.g. 'bin:3600(2)'\n\
 "), stdout);
       fputs (_("\
       --header-in           first input line is column headers\n\
@@ -269,6 +408,27 @@ which require a pair of fields (e.g. 'pcov 2:6').\n"), stdout);
       fputs (_("\
   -s, --sort                sort the input before grouping; this removes the\n\
                               need to manually pipe the input through 'sort'\n\
+"), stdout);
+      fputs (_("\
+      --hash-group          group unsorted input: collect each group\n\
+                              separately, and print the groups in the order\n\
+                              of their first line (sorted with -s)\n\
+"), stdout);
+      fputs (_("\
+      --hash-buffer-size=SIZE  with --hash-group, use up to about SIZE\n\
+                              bytes of memory for the groups; lines of\n\
+                              other groups are grouped later, from\n\
+                              temporary files (default 1G, see\n\
+                              --sort-buffer-size for the units)\n\
+"), stdout);
+      fputs (_("\
+      --top=N               print only the N groups with the largest result\n\
+                              of the operation given with --by, largest\n\
+                              first (equal results in the usual order)\n\
+"), stdout);
+      fputs (_("\
+      --by=OPINDEX          with --top, rank the groups by the result of\n\
+                              operation number OPINDEX (default 1)\n\
 "), stdout);
       fputs (_("\
   -S, --seed                set a seed for operations that use randomization\n\
@@ -279,8 +439,33 @@ which require a pair of fields (e.g. 'pcov 2:6').\n"), stdout);
 "), stdout);
 
       fputs (_("File Operation Options:\n"),stdout);
+      fputs (_("\
+      --decompress=FORMAT   decompress the input: auto (the default) detects\n\
+                              gzip and zstd data, none reads it as is,\n\
+                              gzip or zstd force the format\n\
+"), stdout);
+      fputs (_("\
+      --emit-state          print the state of each group's operations\n\
+                              instead of their results; state files are\n\
+                              combined with 'merge-state -- FILE...'\n\
+"), stdout);
+      fputs (_("\
+      --files0-from=F       read input from the files specified by\n\
+                              NUL-terminated names in file F;\n\
+                              if F is - then read names from standard input\n\
+"), stdout);
       fputs (_("\
       --no-strict           allow lines with varying number of fields\n\
+"), stdout);
+      fputs (_("\
+      --parallel=N          process up to N input files at the same time\n\
+                              (per-line operations, check, and grouping\n\
+                              without --sort and --full)\n\
+"), stdout);
+      fputs (_("\
+      --threads=N           use N threads: with --hash-group, each thread\n\
+                              collects the groups of some of the keys;\n\
+                              with -s, the input is sorted with N threads\n\
 "), stdout);
       printf (_("\
   -F, --filler=X            fill missing values with X (default %s)\n\
@@ -290,6 +475,13 @@ which require a pair of fields (e.g. 'pcov 2:6').\n"), stdout);
       fputs (_("General Options:\n"),stdout);
       fputs (_("\
   -t, --field-separator=X   use X instead of TAB as field delimiter\n\
+"), stdout);
+      fputs (_("\
+      --csv                 read the input as CSV (RFC 4180): fields can be\n\
+                              enclosed in double-quotes, and contain the\n\
+                              delimiter, newlines and doubled quotes;\n\
+                              implies -t ',' unless -t is used.\n\
+                              Output fields are quoted as needed\n\
 "), stdout);
       fputs (_("\
       --format=FORMAT       print numeric values with printf style\n\
@@ -313,7 +505,14 @@ which require a pair of fields (e.g. 'pcov 2:6').\n"), stdout);
   -z, --zero-terminated     end lines with 0 byte, not newline\n\
 "), stdout);
       fputs (_("\
-      --sort-cmd=/path/to/sort   Alternative sort(1) to use.\n\
+      --sort-buffer-size=SIZE  with -s, use up to SIZE bytes of memory;\n\
+                              larger inputs are sorted in temporary files.\n\
+                              SIZE is in KiB, or followed by b (bytes),\n\
+                              K, M, G or T, as with sort -S (default 256M)\n\
+"), stdout);
+      fputs (_("\
+      --sort-cmd=/path/to/sort   with -s, sort with this sort(1) program\n\
+                              instead of the built-in sort\n\
 "), stdout);
 
       fputs (HELP_OPTION_DESCRIPTION, stdout);
@@ -351,13 +550,56 @@ which require a pair of fields (e.g. 'pcov 2:6').\n"), stdout);
   exit (status);
 }
 
+/* Returns the line number of the input line number NUMBER in its
+   input file, and sets *FILE to the name of that file (see
+   'name_input_files'; otherwise, returns NUMBER and sets *FILE to NULL).
+   With --sort, the lines are numbered in their sorted order. */
+static size_t
+input_file_line (size_t number, const char **file)
+{
+  size_t line = number;
+
+  *file = NULL;
+  if (name_input_files && !sort_input)
+    *file = line_input_file_line (&input_lines, number, &line);
+  return line;
+}
+
+/* Reports an error in the input line being processed, and exits.
+   The message starts with FILE, the name of the line's input file (if
+   not NULL, see input_file_line ()). It is not quoted, as quotef ()
+   is not thread-safe.
+   In a --threads worker, only the worker stops: the main thread
+   reports the error of the first invalid line, as if the lines had
+   been processed in order. */
+static noreturn void
+input_line_error (const char *file, const char *format, ...)
+{
+  va_list args, args2;
+  va_start (args, format);
+  va_copy (args2, args);
+  const int len = vsnprintf (NULL, 0, format, args);
+  const size_t prefix_len = file ? strlen (file) + 2 : 0;
+  char *msg = xmalloc (prefix_len + MAX (len, 0) + 1);
+  if (file)
+    sprintf (msg, "%s: ", file);
+  vsnprintf (msg + prefix_len, MAX (len, 0) + 1, format, args2);
+  va_end (args2);
+  va_end (args);
+
+  if (hash_grouper)
+    hash_grouper_error (hash_grouper, msg, line_number);
+  die (EXIT_FAILURE, 0, "%s", msg);
+}
+
 static inline noreturn void
 error_not_enough_fields (const size_t needed, const size_t found)
 {
-  error (0, 0, _("invalid input: field %"PRIuMAX" requested, " \
-        "line %"PRIuMAX" has only %"PRIuMAX" fields"),
-        (uintmax_t)needed, (uintmax_t)line_number, (uintmax_t)found);
-  exit (EXIT_FAILURE);
+  const char *file;
+  const size_t line = input_file_line (line_number, &file);
+  input_line_error (file, _("invalid input: field %"PRIuMAX" requested, " \
+                            "line %"PRIuMAX" has only %"PRIuMAX" fields"),
+                    (uintmax_t)needed, (uintmax_t)line, (uintmax_t)found);
 }
 
 
@@ -369,16 +611,99 @@ safe_line_record_get_field (const struct line_record_t *lr, const size_t n,
     error_not_enough_fields (n, line_record_num_fields (lr));
 }
 
+/* Size of a key computed from a column (e.g. 'bin(2)'),
+   see group_key_field () */
+enum { COMPUTED_KEY_SIZE = 21 };
+
+/* Returns the value of the computed group-by key G of LINE
+   (e.g. 'bin(2)'), whose column is STR */
+static long double
+computed_key_value (const struct group_column_t *g, const char *str,
+                    size_t len)
+{
+  long double value = 0;
+  const enum FIELD_OP_COLLECT_RESULT flocr = field_op_transform (g->op, str,
+                                                                 len, &value);
+  if (!field_op_ok (flocr))
+    {
+      char *tmp = xmalloc (len+1);
+      memcpy (tmp,str,len);
+      tmp[len] = 0 ;
+      const char *file;
+      const size_t line = input_file_line (line_number, &file);
+      input_line_error (file,
+                        _("%s in line %"PRIuMAX" field %"PRIuMAX": '%s'"),
+                        field_op_collect_result_name (flocr),
+                        (uintmax_t)line, (uintmax_t)g->num, tmp);
+    }
+  return value;
+}
+
+/* Stores VALUE in the COMPUTED_KEY_SIZE bytes of BUF, as hexadecimal
+   digits (class, exponent, mantissa) which compare like the values,
+   in either letter case */
+static void
+encode_computed_key (char *buf, long double value)
+{
+  static const char hex[] = "0123456789abcdef";
+  uint64_t mant = 0;
+  unsigned int exp = 0;
+  int e = 0;
+
+  if (isnan (value))
+    buf[0] = '5';
+  else if (is_zero (value))
+    buf[0] = '2';
+  else if (isinf (value))
+    buf[0] = value < 0 ? '0' : '4';
+  else
+    {
+      mant = ldexpl (frexpl (fabsl (value), &e), 64);
+      exp = e + 0x8000;
+      buf[0] = value < 0 ? '1' : '3';
+    }
+
+  /* Negative values are ordered by decreasing magnitude */
+  const unsigned int flip = buf[0] == '1' ? 0xf : 0;
+  for (int i = 0; i < 4; ++i)
+    buf[1 + i] = hex[((exp >> (12 - 4 * i)) & 0xf) ^ flip];
+  for (int i = 0; i < 16; ++i)
+    buf[5 + i] = hex[((mant >> (60 - 4 * i)) & 0xf) ^ flip];
+}
+
+/* Stores in STR and LEN the group-by key I of LINE: its column,
+   or the key computed from it (e.g. 'bin(2)') in BUF,
+   of COMPUTED_KEY_SIZE bytes */
 static inline void
-safe_line_record_get_fieldz (const struct line_record_t *lr, const size_t n,
-                             char * /* out */ buf, size_t len)
+group_key_field (const struct line_record_t *line, size_t i, char *buf,
+                 const char **str, size_t *len)
+{
+  const struct group_column_t *g = &dm->grps[i];
+  safe_line_record_get_field (line, g->num, str, len);
+  if (g->op)
+    {
+      encode_computed_key (buf, computed_key_value (g, *str, *len));
+      *str = buf;
+      *len = COMPUTED_KEY_SIZE;
+    }
+}
+
+/* Stores in STR and LEN the group-by key I of LINE as printed:
+   its column, or the key computed from it formatted in BUF,
+   of numeric_output_bufsize bytes */
+static void
+group_key_output (const struct line_record_t *line, size_t i, char *buf,
+                  const char **str, size_t *len)
 {
-  const char *p;
-  size_t l = 0;
-  safe_line_record_get_field (lr, n, &p, &l);
-  l = MIN (len-1,l);
-  memcpy (buf, p, l);
-  buf[l] = 0;
+  const struct group_column_t *g = &dm->grps[i];
+  safe_line_record_get_field (line, g->num, str, len);
+  if (g->op)
+    {
+      format_number (buf, numeric_output_bufsize,
+                     computed_key_value (g, *str, *len));
+      *str = buf;
+      *len = strlen (buf);
+    }
 }
 
 /* returns TRUE if the lines are different, false if identical.
@@ -389,11 +714,11 @@ different (const struct line_record_t* l1, const struct line_record_t* l2)
 {
   for (size_t i = 0; i < dm->num_grps; ++i)
     {
-      const size_t col_num = dm->grps[i].num;
+      char buf1[COMPUTED_KEY_SIZE], buf2[COMPUTED_KEY_SIZE];
       const char *str1=NULL,*str2=NULL;
       size_t len1=0,len2=0;
-      safe_line_record_get_field (l1, col_num, &str1, &len1);
-      safe_line_record_get_field (l2, col_num, &str2, &len2);
+      group_key_field (l1, i, buf1, &str1, &len1);
+      group_key_field (l2, i, buf2, &str2, &len2);
       if (len1 != len2)
         return true;
       if ((case_sensitive && !STREQ_LEN (str1,str2,len1))
@@ -404,9 +729,9 @@ different (const struct line_record_t* l1, const struct line_record_t* l2)
 }
 
 /* For a given line, extract all requested fields and process the associated
-   operations on them */
+   operations OPS (dm->ops, or the instances of a group) on them */
 static bool
-process_line (const struct line_record_t *line)
+process_line (const struct line_record_t *line, struct fieldop *ops)
 {
   const char *str = NULL;
   size_t len = 0;
@@ -415,7 +740,7 @@ process_line (const struct line_record_t *line)
 
   for (size_t i=0; i<dm->num_ops; ++i)
     {
-      struct fieldop *op = &dm->ops[i];
+      struct fieldop *op = &ops[i];
       safe_line_record_get_field (line, op->field, &str, &len);
       flocr = field_op_collect (op, str, len);
       if (!field_op_ok (flocr))
@@ -423,10 +748,12 @@ process_line (const struct line_record_t *line)
           char *tmp = xmalloc (len+1);
           memcpy (tmp,str,len);
           tmp[len] = 0 ;
-          die (EXIT_FAILURE, 0,
-              _("%s in line %"PRIuMAX" field %"PRIuMAX": '%s'"),
-              field_op_collect_result_name (flocr),
-              (uintmax_t)line_number, (uintmax_t)op->field, tmp);
+          const char *file;
+          const size_t line = input_file_line (line_number, &file);
+          input_line_error (file,
+                            _("%s in line %"PRIuMAX" field %"PRIuMAX": '%s'"),
+                            field_op_collect_result_name (flocr),
+                            (uintmax_t)line, (uintmax_t)op->field, tmp);
         }
       keep_line = keep_line || (flocr==FLOCR_OK_KEEP_LINE);
     }
@@ -447,45 +774,54 @@ print_input_line (const struct line_record_t* lb)
       for (size_t i = 1; i <= line_record_num_fields (lb); ++i)
         {
           safe_line_record_get_field (lb, i, &str, &len);
-          ignore_value (fwrite (str, sizeof (char), len, stdout));
+          output_field (str, len);
           print_field_separator ();
         }
     }
   else
     {
+      char buf[numeric_output_bufsize];
       for (size_t i = 0; i < dm->num_grps; ++i)
         {
-          const size_t col_num = dm->grps[i].num;
-          safe_line_record_get_field (lb, col_num, &str, &len);
-          ignore_value (fwrite (str,sizeof (char),len,stdout));
+          group_key_output (lb, i, buf, &str, &len);
+          output_field (str, len);
           print_field_separator ();
         }
     }
 }
 
-#define SWAP_LINES(A, B)          \
-  do                              \
-    {                             \
-      struct line_record_t *_tmp; \
-      _tmp = (A);                 \
-      (A) = (B);                  \
-      (B) = _tmp;                 \
-    }                             \
-  while (0)
+/* With --csv, a header field is captured between header_field_begin ()
+   and header_field_end (), and printed quoted as needed */
+static void
+header_field_begin ()
+{
+  if (csv_input)
+    output_capture_begin ();
+}
 
+static void
+header_field_end ()
+{
+  if (csv_input)
+    {
+      size_t len;
+      const char *field = output_capture_end (&len);
+      output_field (field, len);
+    }
+}
 
 static void
 print_column_headers ()
 {
   if ( vnlog )
-    printf ("# ");
+    output_str ("# ");
 
   if (print_full_line)
     {
       /* Print the headers of all the input fields */
       for (size_t n=1; n<=get_num_column_headers (); ++n)
         {
-          fputs (get_input_field_name (n), stdout);
+          output_field_str (get_input_field_name (n));
           print_field_separator ();
         }
     }
@@ -499,7 +835,14 @@ print_column_headers ()
           const size_t col_num = dm->grps[i].num;
           if (col_num > get_num_column_headers ())
             error_not_enough_fields (col_num, get_num_column_headers ());
-          printf ("GroupBy" "(%s)",get_input_field_name (col_num));
+          header_field_begin ();
+          if (dm->grps[i].op)
+            output_printf ("GroupBy" "(%s(%s))",
+                           get_field_operation_name (dm->grps[i].op->op),
+                           get_input_field_name (col_num));
+          else
+            output_printf ("GroupBy" "(%s)",get_input_field_name (col_num));
+          header_field_end ();
           print_field_separator ();
         }
     }
@@ -514,24 +857,29 @@ print_column_headers ()
       if (op->field > get_num_column_headers ())
         error_not_enough_fields (op->field, get_num_column_headers ());
 
-      printf ("%s", get_field_operation_name (op->op));
+      header_field_begin ();
+      output_str (get_field_operation_name (op->op));
 
       if (op->op == OP_PERCENTILE) {
-        printf (":%"PRIuMAX, (uintmax_t)op->params.percentile);
+        output_printf (":%"PRIuMAX, (uintmax_t)op->params.percentile);
+      }
+      if (op->op == OP_APPROX_PERCENTILE) {
+        output_printf (":%"PRIuMAX, (uintmax_t)op->params.approx.percentile);
       }
       if (op->op == OP_TRIMMED_MEAN) {
-        printf (":%Lg", op->params.trimmed_mean);
+        output_printf (":%Lg", op->params.trimmed_mean);
       }
 
-      printf ("(%s", get_input_field_name (op->field));
+      output_printf ("(%s", get_input_field_name (op->field));
       while (dm->ops[i].subordinate)
         {
           /* print subsequent arguments to the same operation,
              e.g. 'pcov (x,y)' */
           ++i;
-          printf (",%s", get_input_field_name (dm->ops[i].field));
+          output_printf (",%s", get_input_field_name (dm->ops[i].field));
         }
-      printf (")");
+      output_str (")");
+      header_field_end ();
 
       if (i != dm->num_ops-1)
         print_field_separator ();
@@ -558,17 +906,35 @@ field_op_find_named_columns ()
     }
 }
 
+/* Returns the highest column number used by the grouping columns
+   and the operations: fields beyond it need not be split.
+   Returns 0 if entire lines are needed (--full). */
+static size_t
+max_used_column ()
+{
+  size_t max_col = 0;
+
+  if (print_full_line)
+    return 0;
+
+  for (size_t i = 0; i < dm->num_grps; ++i)
+    max_col = MAX (max_col, dm->grps[i].num);
+  for (size_t i = 0; i < dm->num_ops; ++i)
+    max_col = MAX (max_col, dm->ops[i].field);
+  return max_col;
+}
+
 /*
     Process the input header line
 */
 static void
-process_input_header (FILE *stream)
+process_input_header (struct line_input *in)
 {
   struct line_record_t lr;
 
   line_record_init (&lr);
 
-  if (line_record_fread (&lr, stream, eolchar, skip_comments, vnlog))
+  if (line_record_fread (&lr, in, eolchar, skip_comments, vnlog))
     {
       build_input_line_headers (&lr, true);
       line_number++;
@@ -581,16 +947,16 @@ process_input_header (FILE *stream)
 }
 
 static void
-summarize_field_ops ()
+summarize_field_ops (struct fieldop *ops)
 {
   for (size_t i=0;i<dm->num_ops;++i)
     {
-      struct fieldop *p = &dm->ops[i];
+      struct fieldop *p = &ops[i];
       if (p->subordinate)
         continue;
 
       field_op_summarize (p);
-      fputs (p->out_buf, stdout);
+      output_field_str (p->out_buf);
 
       /* print field separator */
       if (i != dm->num_ops-1)
@@ -608,646 +974,1892 @@ reset_field_ops ()
     field_op_reset (&dm->ops[i]);
 }
 
-/* Process a completed group of data lines
-   (all with the same 'group by' keys). */
+/* Writes the content of LINE to a worker's state file */
 static void
-process_group (const struct line_record_t* line)
+save_line (const struct line_record_t *line, FILE *state)
 {
-  /* TODO: dynamically re-alloc if needed */
-  char col_name[512];
-  char row_name[512];
-
-  if (lines_in_group>0)
-    {
-      if (crosstab_mode)
-        {
-          /* cross-tabulation mode - save results in a matrix, print later */
-          const size_t row_field = dm->grps[0].num;
-          safe_line_record_get_fieldz (line, row_field,
-                                       row_name, sizeof row_name);
-
-          const size_t col_field = dm->grps[1].num;
-          safe_line_record_get_fieldz (line, col_field,
-                                       col_name, sizeof col_name);
+  const size_t len = line_record_length (line);
+  if (fwrite (&len, sizeof len, 1, state) != 1
+      || (len && fwrite (line_record_buffer (line), 1, len, state) != len))
+    die (EXIT_FAILURE, errno, _("write error"));
+}
 
-          field_op_summarize (&dm->ops[0]);
-          const char* data = dm->ops[0].out_buf;
+/* Reads a line written by save_line () into LINE.
+   Returns false at the end of STATE. */
+static bool
+load_line (struct line_record_t *line, FILE *state)
+{
+  size_t len;
+  if (fread (&len, sizeof len, 1, state) != 1)
+    return false;
 
-          crosstab_add_result (crosstab, row_name, col_name, data);
-        }
-      else
-        {
-          /* group-by/per-line mode - print results once available */
-          print_input_line (line);
-          summarize_field_ops ();
-        }
-    }
-  lines_in_group = 0;
-  reset_field_ops ();
+  char *buf = xmalloc (len + 1);
+  if (fread (buf, 1, len, state) != len)
+    die (EXIT_FAILURE, errno, _("read error"));
+  line_record_assign (line, buf, len);
+  free (buf);
+  return true;
 }
 
-/*
-    Process each line in the input.
-
-    If the key of the current line is different from the previous one,
-    summarize the previous group and start a new one.
- */
+/* In a worker, saves the length of the output header line(s) printed
+   so far (possibly none): the main process prints only the first file's
+   header. */
 static void
-process_file ()
+save_header_length ()
 {
-  struct line_record_t lb1, lb2;
-  struct line_record_t *thisline, *group_first_line;
+  static bool saved = false;
 
-  thisline = &lb1;
-  group_first_line = &lb2;
+  if (!worker_state || saved)
+    return;
 
-  line_record_init (thisline);
-  line_record_init (group_first_line);
+  output_flush ();
+  const off_t header_len = lseek (STDOUT_FILENO, 0, SEEK_CUR);
+  if (fwrite (&header_len, sizeof header_len, 1, worker_state) != 1)
+    die (EXIT_FAILURE, errno, _("write error"));
+  saved = true;
+}
 
-  /* If there is an input header line, and it wasn't read already
-     in 'open_input' - read it now */
-  if (input_header && line_number==0)
-    process_input_header (input_stream);
+/* In a group-by worker, the first and last groups of the input file are
+   not printed: their keys and operation states are saved, so that the
+   main process can combine them with groups from the neighbouring files
+   which have the same key. */
+static void
+save_group_state (const struct line_record_t *line)
+{
+  save_line (line, worker_state);
+  for (size_t i = 0; i < dm->num_ops; ++i)
+    field_op_save_state (&dm->ops[i], worker_state);
+}
 
-  if (print_full_line && !line_mode)
-    fputs (_("datamash: Using -f/--full with non-linewise operations \
-is deprecated and will be disabled in a future release.\n"), stderr);
+/* Prints the pending group (see merge_group_state ()) */
+static void
+flush_pending_group ()
+{
+  if (!pending_group)
+    return;
 
-  /* If there is an input header line, and the user requested an output
-     header line, and the input line was read successfully, print headers */
-  if (input_header && output_header && line_number==1)
-    print_column_headers ();
+  print_input_line (&pending_group_line);
+  summarize_field_ops (dm->ops);
+  reset_field_ops ();
+  pending_group = false;
+}
 
+/* Combines a group saved by a worker (with save_group_state ()),
+   whose key line was already read into LINE.
+   If it has the same key as the pending group (the last group of the
+   previous files), their states are combined (and LINE replaces the
+   pending group's line if the operations would have kept one of its
+   group's lines, e.g. with -i and 'max'). Otherwise, the pending group
+   is printed, and the group read becomes the pending group. */
+static void
+merge_group_state (struct line_record_t *line, FILE *state)
+{
+  bool keep_line = false;
 
-  while (line_record_fread (thisline, input_stream, eolchar,
-                            skip_comments, false))
+  if (pending_group && different (line, &pending_group_line))
+    flush_pending_group ();
+  if (!pending_group)
     {
-      bool new_group = false;
-
-      line_number++;
+      line_record_swap (line, &pending_group_line);
+      pending_group = true;
+    }
 
-      /* If there's no input header line, and the user requested an output
-         header line, then generate output header line based on the number
-         of fields in the first (data, non-header) input line */
-      if (line_number==1 && output_header && !input_header)
-        {
-          build_input_line_headers (thisline, false);
-          print_column_headers ();
-        }
+  for (size_t i = 0; i < dm->num_ops; ++i)
+    if (!field_op_merge_state (&dm->ops[i], state, &keep_line))
+      die (EXIT_FAILURE, 0, _("read error"));
+  if (keep_line)
+    line_record_swap (line, &pending_group_line);
+}
 
+/* Returns true if the group A ranks below the group B with --top:
+   with a smaller value (NaN being the smallest), or an equal value
+   and a later position in the output */
+static bool _GL_ATTRIBUTE_PURE
+top_group_below (const struct top_group *a, const struct top_group *b)
+{
+  if (isnan (a->value) || isnan (b->value))
+    {
+      if (!isnan (a->value) || !isnan (b->value))
+        return isnan (a->value);
+    }
+  else if (a->value < b->value || a->value > b->value)
+    return a->value < b->value;
+  return a->order > b->order;
+}
 
-      /* If no keys are given, the entire input is considered one group */
-      if (dm->num_grps || line_mode)
-        {
-          new_group = (group_first_line->lbuf.length == 0 || line_mode
-                       || different (thisline, group_first_line));
+static void
+top_heap_swap (size_t i, size_t j)
+{
+  struct top_group tmp = top_heap[i];
+  top_heap[i] = top_heap[j];
+  top_heap[j] = tmp;
+}
 
-          if (new_group)
-            {
-              process_group (group_first_line);
-              group_first_line->lbuf.length = 0;
-            }
-        }
-      else
-        {
-          /* The entire line is a "group", if it's the first line, keep it */
-          new_group = (group_first_line->lbuf.length==0);
-        }
+/* Returns true if the next group, whose --by result is VALUE, would be
+   kept by --top (it is then added with top_group_add ()) */
+static bool
+top_group_wanted (long double value)
+{
+  if (top_heap_size < top_groups)
+    return true;
+  const struct top_group g = { .value = value, .order = top_order };
+  return top_group_below (&top_heap[0], &g);
+}
 
-      lines_in_group++;
-      bool keep_line = process_line (thisline);
+/* Keeps the next group, whose --by result is VALUE and whose output is
+   the LEN bytes at OUT, in place of the lowest kept group if needed
+   (top_group_wanted () must have returned true) */
+static void
+top_group_add (long double value, const char *out, size_t len)
+{
+  size_t i;
 
-      if (new_group || keep_line)
-        {
-          SWAP_LINES (group_first_line, thisline);
-        }
+  if (top_heap_size < top_groups)
+    {
+      if (top_heap_size == top_heap_alloc)
+        top_heap = x2nrealloc (top_heap, &top_heap_alloc, sizeof *top_heap);
+      i = top_heap_size++;
+      top_heap[i].out = NULL;
+      top_heap[i].out_alloc = 0;
     }
+  else
+    i = 0;
 
-  /* summarize last group */
-  process_group (group_first_line);
+  struct top_group *g = &top_heap[i];
+  g->value = value;
+  g->order = top_order++;
+  if (g->out_alloc < len)
+    {
+      g->out_alloc = MAX (g->out_alloc * 2, len);
+      g->out = xrealloc (g->out, g->out_alloc);
+    }
+  if (len)
+    memcpy (g->out, out, len);
+  g->out_len = len;
+
+  /* Restore the heap order: a new group moves up, a replaced root
+     moves down */
+  if (i)
+    for (; i && top_group_below (&top_heap[i], &top_heap[(i - 1) / 2]);
+         i = (i - 1) / 2)
+      top_heap_swap (i, (i - 1) / 2);
+  else
+    for (;;)
+      {
+        size_t low = i;
+        const size_t left = 2 * i + 1, right = 2 * i + 2;
+        if (left < top_heap_size
+            && top_group_below (&top_heap[left], &top_heap[low]))
+          low = left;
+        if (right < top_heap_size
+            && top_group_below (&top_heap[right], &top_heap[low]))
+          low = right;
+        if (low == i)
+          break;
+        top_heap_swap (i, low);
+        i = low;
+      }
+}
 
-  line_record_free (&lb1);
-  line_record_free (&lb2);
+static int
+compare_top_groups (const void *p1, const void *p2)
+{
+  const struct top_group *g1 = p1;
+  const struct top_group *g2 = p2;
+  return top_group_below (g2, g1) ? -1 : top_group_below (g1, g2);
 }
 
-/*
-    Transpose rows and columns in input file
- */
+/* Prints the groups kept by --top, largest first */
 static void
-transpose_file ()
+print_top_groups ()
 {
-  size_t num_lines = 0;
-  size_t alloc_lines = 0;
-  struct line_record_t *lines = NULL;
-
-  size_t max_num_fields = 0 ;
-  size_t prev_num_fields = 0 ;
-
-  /* Read all input lines - but instead of reusing line_record_t,
-     keep all lines in memory. */
-  while (true)
+  qsort (top_heap, top_heap_size, sizeof *top_heap, compare_top_groups);
+  for (size_t i = 0; i < top_heap_size; ++i)
     {
-      if (num_lines+1 > alloc_lines)
-        {
-          alloc_lines += 1000;
-          lines = xnrealloc ( lines, alloc_lines,
-                              sizeof (struct line_record_t));
-        }
+      output_bytes (top_heap[i].out, top_heap[i].out_len);
+      free (top_heap[i].out);
+    }
+  free (top_heap);
+  top_heap = NULL;
+  top_heap_size = top_heap_alloc = 0;
+}
 
-      struct line_record_t *thisline = &lines[num_lines];
-      num_lines++;
-      line_record_init (thisline);
+/* Prints the results of the operations OPS of a completed group,
+   whose first line is LINE (or saves them in the crosstab matrix) */
+static void
+print_group_results (const struct line_record_t* line, struct fieldop *ops)
+{
+  if (crosstab_mode)
+    {
+      /* cross-tabulation mode - save results in a matrix, print later */
+      const char *row_name, *col_name;
+      size_t row_len, col_len;
+      char row_buf[numeric_output_bufsize], col_buf[numeric_output_bufsize];
+      group_key_output (line, 0, row_buf, &row_name, &row_len);
+      group_key_output (line, 1, col_buf, &col_name, &col_len);
+
+      field_op_summarize (&ops[0]);
+      const char* data = ops[0].out_buf;
+
+      crosstab_add_result (crosstab, row_name, row_len, col_name, col_len,
+                           data);
+    }
+  else if (emit_state)
+    emit_group_state (line, ops, dm->num_ops);
+  else
+    {
+      /* group-by/per-line mode - print results once available */
+      print_input_line (line);
+      summarize_field_ops (ops);
+    }
+}
 
-      if (!line_record_fread (thisline, input_stream, eolchar,
-                              skip_comments, false))
-        break;
-      line_number++;
+/* Prints the results of a completed group (see print_group_results ()),
+   or with --top, keeps them if the group is among the largest so far */
+static void
+print_group (const struct line_record_t* line, struct fieldop *ops)
+{
+  if (!top_groups)
+    {
+      print_group_results (line, ops);
+      return;
+    }
 
-      const size_t num_fields = line_record_num_fields (thisline);
+  field_op_summarize (&ops[top_op]);
+  const long double value = ops[top_op].result;
+  if (!top_group_wanted (value))
+    return;
 
-      if (strict && line_number>1 && num_fields != prev_num_fields)
-          die (EXIT_FAILURE, 0, _("transpose input error: line %"PRIuMAX" " \
-                    "has %"PRIuMAX" fields (previous lines had %"PRIuMAX");\n" \
-                    "see --help to disable strict mode"),
-                    (uintmax_t)line_number, (uintmax_t)num_fields,
-                    (uintmax_t)prev_num_fields);
+  size_t len;
+  output_capture_begin ();
+  print_group_results (line, ops);
+  const char *out = output_capture_end (&len);
+  top_group_add (value, out, len);
+}
 
-      prev_num_fields = num_fields;
-      max_num_fields = MAX (max_num_fields,num_fields);
+/* Reads the next batch of input lines. With --sort (and no --sort-cmd)
+   the lines are returned sorted by the group-by columns. */
+static size_t
+input_batch_fread (struct line_batch *batch)
+{
+  if (!sort_input)
+    return line_batch_fread (batch, &input_lines, eolchar, skip_comments);
 
+  /* Named group-by columns are known once the header line was read */
+  if (!input_sorter)
+    {
+      size_t *keys = XNMALLOC (dm->num_grps, size_t);
+      for (size_t i = 0; i < dm->num_grps; ++i)
+        keys[i] = dm->grps[i].num;
+      input_sorter = line_sorter_init (keys, dm->num_grps, !case_sensitive,
+                                       sort_buffer_size, num_threads);
+      free (keys);
     }
+  return line_sorter_fread (input_sorter, batch, &input_lines, eolchar,
+                            skip_comments);
+}
 
-  /* Output all fields */
-  for (size_t i = 1 ; i <= max_num_fields ; ++i)
+/* Process a completed group of data lines
+   (all with the same 'group by' keys).
+   LAST is true for the last group of the input. */
+static void
+process_group (const struct line_record_t* line, bool last)
+{
+  if (lines_in_group>0)
     {
-      for (size_t j = 0; j < line_number; ++j)
+      if (worker_state && !crosstab_mode && !line_mode
+          && (worker_groups++ == 0 || last))
         {
-          if (j>0)
-            print_field_separator ();
-
-          const struct line_record_t *line = &lines[j];
-          const char* str;
-          size_t len;
-          if (line_record_get_field (line, i, &str, &len))
-            fwrite (str, len, sizeof (char), stdout);
-          else
-            fputs (missing_field_filler, stdout);
+          /* group-by worker - these groups might continue in the
+             neighbouring input files */
+          save_group_state (line);
         }
-      print_line_separator ();
+      else
+        print_group (line, dm->ops);
     }
-
-  /* Free pointers */
-  for (size_t i = 0; i < num_lines; ++i)
-    line_record_free (&lines[i]);
-  free (lines);
+  lines_in_group = 0;
+  reset_field_ops ();
 }
 
-/*
-    Reverse the fields in each line of the input file
- */
-static void
-reverse_fields_in_file ()
+/* The key of the current group (in sorted input), to find the first line
+   of the next group: once a group has a second line, its group-by columns
+   are copied, instead of being extracted again from the group's line for
+   each line compared by different ().
+   The last 8 bytes of each column (folded to lower case with
+   --ignore-case) are compared first: the keys of consecutive groups often
+   differ only at their end. */
+struct group_key
 {
-  struct line_record_t lr;
-  struct line_record_t *thisline;
-  size_t prev_num_fields = 0;
-  thisline = &lr;
-  line_record_init (thisline);
+  char *buf;                    /* the columns, concatenated */
+  size_t len;
+  size_t alloc;
+  size_t *lens;                 /* the length of each column */
+  uint64_t *tails;              /* the last 8 bytes of each column */
+  bool mixed_case;              /* with -i, a line of the group had another
+                                   letter case */
+  bool valid;
+};
 
-  while (line_record_fread (thisline, input_stream, eolchar, skip_comments,
-                            vnlog && line_number==0))
-    {
-      line_number++;
+/* tolower () of each byte value, and whether it folds the ASCII
+   characters as in the C locale (8 bytes can then be folded at once) */
+static unsigned char fold_table[UCHAR_MAX + 1];
+static bool fold_ascii;
 
-      const size_t num_fields = line_record_num_fields (thisline);
+#define REPEAT_BYTE(b) (UINT64_C (0x0101010101010101) * (b))
 
-      if (strict && line_number>1 && num_fields != prev_num_fields)
-          die (EXIT_FAILURE, 0, _("reverse-field input error: line " \
-                       "%"PRIuMAX" has %"PRIuMAX" fields (previous lines had " \
-                       "%"PRIuMAX");\n" \
-                       "see --help to disable strict mode"),
-                        (uintmax_t)line_number, (uintmax_t)num_fields,
-                        (uintmax_t)prev_num_fields);
+/* Returns the 8 bytes in W folded to lower case */
+static inline uint64_t
+fold_word (uint64_t w)
+{
+  if (fold_ascii && (w & REPEAT_BYTE (0x80)) == 0)
+    {
+      /* The high bit of each byte is set for 'A'..'Z' */
+      const uint64_t upper = (w + REPEAT_BYTE (0x80 - 'A'))
+                             & ~(w + REPEAT_BYTE (0x80 - 'Z' - 1));
+      return w | ((upper & REPEAT_BYTE (0x80)) >> 2);
+    }
 
-      prev_num_fields = num_fields;
+  unsigned char b[sizeof w];
+  memcpy (b, &w, sizeof w);
+  for (size_t i = 0; i < sizeof w; ++i)
+    b[i] = fold_table[b[i]];
+  memcpy (&w, b, sizeof w);
+  return w;
+}
 
-      /* Special handling for header line */
-      if (line_number == 1)
+static void
+group_key_init (struct group_key *key)
+{
+  memset (key, 0, sizeof *key);
+  key->lens = XNMALLOC (dm->num_grps, size_t);
+  key->tails = XNMALLOC (dm->num_grps, uint64_t);
+
+  fold_ascii = true;
+  for (int c = 0; c <= UCHAR_MAX; ++c)
+    {
+      fold_table[c] = tolower (c);
+      if (c < 0x80 && fold_table[c] != (c >= 'A' && c <= 'Z' ? c + 32 : c))
+        fold_ascii = false;
+    }
+}
+
+static void
+group_key_free (struct group_key *key)
+{
+  free (key->buf);
+  free (key->lens);
+  free (key->tails);
+}
+
+/* Returns the last 8 bytes of the column STR (of at least 8 bytes),
+   in lower case with --ignore-case */
+static inline uint64_t
+key_column_tail (const char *str, size_t len)
+{
+  uint64_t w;
+  memcpy (&w, str + len - sizeof w, sizeof w);
+  return case_sensitive ? w : fold_word (w);
+}
+
+/* Sets KEY to the group-by columns of LINE (which must all exist) */
+static void
+group_key_set (struct group_key *key, const struct line_record_t *line)
+{
+  key->len = 0;
+  key->mixed_case = false;
+  key->valid = true;
+  for (size_t i = 0; i < dm->num_grps; ++i)
+    {
+      char buf[COMPUTED_KEY_SIZE];
+      const char *str = NULL;
+      size_t len = 0;
+      group_key_field (line, i, buf, &str, &len);
+      if (key->alloc - key->len < len)
         {
-          if (vnlog)
-            {
-              /* If using named-columns, find the column numbers after reading
-                 the header line. */
-              build_input_line_headers (&lr, true);
-              group_columns_find_named_columns ();
+          key->alloc = MAX (key->alloc * 2, key->len + len);
+          key->buf = xrealloc (key->buf, key->alloc);
+        }
+      if (len)
+        memcpy (key->buf + key->len, str, len);
+      key->lens[i] = len;
+      if (len >= sizeof (uint64_t))
+        key->tails[i] = key_column_tail (str, len);
+      key->len += len;
+    }
+}
 
-              fprintf (stdout, "# ");
-              const size_t num_fields = line_record_num_fields (thisline);
-              for (size_t i = num_fields ; i >= 1 ; --i) {
-                if (i<num_fields)
-                  print_field_separator ();
+/* Returns true if the group-by columns of LINE are the same as KEY
+   (as different () would compare them) */
+static bool
+group_key_matches (struct group_key *key, const struct line_record_t *line)
+{
+  size_t pos = 0;
 
-                const char *str;
-                size_t len;
-                if (line_record_get_field (thisline, i, &str, &len))
-                {
-                  ignore_value (fwrite (str, len, sizeof (char), stdout));
-                }
-              }
-              print_line_separator ();
+  for (size_t i = 0; i < dm->num_grps; ++i)
+    {
+      char buf[COMPUTED_KEY_SIZE];
+      const char *str = NULL;
+      size_t len = 0;
+      group_key_field (line, i, buf, &str, &len);
+      if (len != key->lens[i]
+          || (len >= sizeof (uint64_t)
+              && key_column_tail (str, len) != key->tails[i]))
+        return false;
+      if (len == 0)
+        continue;
 
+      /* With -i, the lines of a group usually have the same letter case:
+         they are compared case-insensitively only if they do not */
+      if (case_sensitive || !key->mixed_case)
+        {
+          if (memcmp (str, key->buf + pos, len) == 0)
+            {
+              pos += len;
               continue;
             }
+          if (case_sensitive)
+            return false;
+        }
+      if (strncasecmp (str, key->buf + pos, len) != 0)
+        return false;
+      key->mixed_case = true;
+      pos += len;
+    }
+  return true;
+}
 
-          /* If there is an header line (first line), and the user did not
-             request printing the header, skip it */
-          if (input_header && !output_header)
-            continue;
+/* Compares the group-by keys of two lines, in the order used by
+   'sort -s' (with -f for --ignore-case): with the locale's collating
+   sequence, or byte values. */
+static int
+compare_group_keys (const struct line_record_t *l1,
+                    const struct line_record_t *l2, bool collate)
+{
+  static char *buf1 = NULL, *buf2 = NULL;
+  static size_t alloc1 = 0, alloc2 = 0;
 
-          /* There is no input header line (first line already contains data),
-             and the user requested to generate output header line.
-             Print dummy header lines. */
-          if (!input_header && output_header)
+  for (size_t i = 0; i < dm->num_grps; ++i)
+    {
+      char key1[COMPUTED_KEY_SIZE], key2[COMPUTED_KEY_SIZE];
+      const char *str1 = NULL, *str2 = NULL;
+      size_t len1 = 0, len2 = 0;
+      int diff = 0;
+      group_key_field (l1, i, key1, &str1, &len1);
+      group_key_field (l2, i, key2, &str2, &len2);
+
+      /* Computed keys compare like their values */
+      if (collate && !dm->grps[i].op)
+        {
+          if (alloc1 <= len1)
             {
-              build_input_line_headers (thisline, false);
-              for (size_t i = num_fields; i > 0; --i)
+              alloc1 = len1 + 1;
+              buf1 = xrealloc (buf1, alloc1);
+            }
+          if (alloc2 <= len2)
+            {
+              alloc2 = len2 + 1;
+              buf2 = xrealloc (buf2, alloc2);
+            }
+          for (size_t j = 0; j < len1; ++j)
+            buf1[j] = case_sensitive ? str1[j] : toupper (to_uchar (str1[j]));
+          for (size_t j = 0; j < len2; ++j)
+            buf2[j] = case_sensitive ? str2[j] : toupper (to_uchar (str2[j]));
+          buf1[len1] = buf2[len2] = '\0';
+          diff = strcoll (buf1, buf2);
+        }
+      else
+        {
+          const size_t len = MIN (len1, len2);
+          for (size_t j = 0; j < len && !diff; ++j)
+            {
+              unsigned char c1 = to_uchar (str1[j]);
+              unsigned char c2 = to_uchar (str2[j]);
+              if (!case_sensitive)
                 {
-                  if (i < num_fields)
-                    print_field_separator ();
-                  fputs (get_input_field_name (i), stdout);
+                  c1 = toupper (c1);
+                  c2 = toupper (c2);
                 }
-              print_line_separator ();
+              diff = (c1 > c2) - (c1 < c2);
             }
+          if (!diff)
+            diff = (len1 > len2) - (len1 < len2);
         }
+      if (diff)
+        return diff;
+    }
+  return 0;
+}
 
-      /* Print the line, reversing field order */
-      for (size_t i = num_fields; i > 0; --i)
-        {
-          if (i < num_fields)
-            print_field_separator ();
+/* Returns true if the order of the lines of different groups
+   does not change the results */
+static bool
+hash_groups_independent ()
+{
+  /* The random values depend on the order of the calls */
+  for (size_t i = 0; i < dm->num_ops; ++i)
+    if (dm->ops[i].op == OP_RAND)
+      return false;
+  return true;
+}
 
-          const char* str = NULL;
-          size_t len = 0 ;
-          ignore_value (line_record_get_field (thisline, i, &str, &len));
-          fwrite (str, len, sizeof (char), stdout);
-        }
-      print_line_separator ();
+/* Returns the group-by column I of LINE, for the hash table
+   (see group_key_field ()) */
+static const char *
+hash_key_field (const struct line_record_t *line, size_t i, size_t *len)
+{
+  static _Thread_local char buf[COMPUTED_KEY_SIZE];
+  const char *str = NULL;
+  group_key_field (line, i, buf, &str, len);
+  return str;
+}
+
+/* Processes the input line number NUMBER in a group of the hash table
+   (errors are reported with its line number) */
+static bool
+hash_process_line (const struct line_record_t *line, size_t number,
+                   struct fieldop *ops)
+{
+  line_number = number;
+  return process_line (line, ops);
+}
+
+static void
+hash_print_group (const struct hash_group *g)
+{
+  print_group (&g->line, g->ops);
+}
+
+/* Prints the results of the group G, to be ranked with --top
+   once the saved results are merged */
+static long double
+hash_print_saved_group (const struct hash_group *g)
+{
+  print_group_results (&g->line, g->ops);
+  return top_groups ? g->ops[top_op].result : 0;
+}
+
+static void
+hash_add_result (const char *out, size_t len, long double value)
+{
+  if (!top_groups)
+    output_bytes (out, len);
+  else if (top_group_wanted (value))
+    top_group_add (value, out, len);
+}
+
+/* Starts collecting the groups with --hash-group, with the memory
+   budget MEMORY_LIMIT */
+static void
+init_hash_grouper (size_t memory_limit)
+{
+  struct hash_group_config *cfg = &hash_config;
+
+  cfg->ops = dm->ops;
+  cfg->num_ops = dm->num_ops;
+  cfg->num_keys = dm->num_grps;
+  cfg->max_key_field = 0;
+  for (size_t i = 0; i < dm->num_grps; ++i)
+    cfg->max_key_field = MAX (cfg->max_key_field, dm->grps[i].num);
+  cfg->input = &input_lines;
+  cfg->memory_limit = memory_limit;
+  cfg->threads = hash_groups_independent () ? num_threads : 1;
+  cfg->sort = sort_hash_groups;
+  /* The cross-tabulated results are printed later, in their own order */
+  cfg->any_order = crosstab_mode;
+  cfg->key_field = hash_key_field;
+  cfg->compare_keys = compare_group_keys;
+  cfg->process_line = hash_process_line;
+  cfg->print = hash_print_group;
+  cfg->print_saved = hash_print_saved_group;
+  cfg->add_result = hash_add_result;
+  hash_grouper = hash_grouper_init (cfg);
+}
+
+/* Prints the groups collected with --hash-group */
+static void
+print_hash_groups ()
+{
+  const size_t saved_line_number = line_number;
+
+  hash_grouper_print (hash_grouper);
+  line_number = saved_line_number;
+  hash_grouper_free (hash_grouper);
+  hash_grouper = NULL;
+}
+
+/* Combines the operation states of the next group of the state
+   file SF, whose first line is LINE, into the group with the
+   same key (LINE replaces the group's line if the operations would
+   have kept one of its lines, see merge_group_state ()) */
+static void
+merge_hash_group_state (struct line_record_t *line, struct state_file *sf)
+{
+  struct hash_group *g = hash_grouper_group (hash_grouper, line, 0);
+  bool keep_line = false;
+
+  for (size_t i = 0; i < dm->num_ops; ++i)
+    if (!field_op_merge_state (&g->ops[i], sf->f, &keep_line))
+      invalid_state_file (sf);
+  if (keep_line)
+    {
+      line_record_swap (&g->line, line);
+      line_record_keep (&g->line);
     }
-  line_record_free (&lr);
 }
 
-/*
-   read, parse, print file - without any additional operations
- */
+/* Sets the names of the input columns saved in the state file SF */
 static void
-noop_file ()
+set_state_column_names (const struct state_file *sf)
 {
-  struct line_record_t lr;
-  struct line_record_t *thisline;
+  struct line_record_t names;
 
-  thisline = &lr;
-  line_record_init (thisline);
-  while (line_record_fread (thisline, input_stream, eolchar,
-                            skip_comments, false))
+  line_record_init (&names);
+  names.fields = xnrealloc (names.fields, sf->num_names,
+                            sizeof *names.fields);
+  names.num_fields = names.alloc_fields = sf->num_names;
+  for (size_t i = 0; i < sf->num_names; ++i)
     {
-      line_number++;
+      names.fields[i].buf = sf->names[i];
+      names.fields[i].len = strlen (sf->names[i]);
+    }
+  build_input_line_headers (&names, true);
+  line_record_free (&names);
+
+  field_op_find_named_columns ();
+  group_columns_find_named_columns ();
+}
+
+/* 'merge-state': combines the groups of the state files written with
+   --emit-state (the input files, the first one being FIRST), and prints
+   their results (or their combined states, with --emit-state) */
+static void
+merge_state_files (struct state_file *first)
+{
+  struct line_record_t line;
+  bool header_printed = false;
+
+  line_record_init (&line);
+  if (first->num_names)
+    set_state_column_names (first);
+
+  if (emit_state)
+    emit_state_header (state_group_spec, state_op_args, state_num_op_args,
+                       print_full_line, first->num_names > 0);
+  else if (output_header && first->num_names)
+    {
+      print_column_headers ();
+      header_printed = true;
+    }
 
-      if (print_full_line)
+  sort_hash_groups = pipe_through_sort;
+  init_hash_grouper (SIZE_MAX);
+
+  for (size_t i = 0; i < MAX (num_input_files, 1); ++i)
+    {
+      struct state_file next;
+      struct state_file *sf = first;
+
+      if (i > 0)
         {
-          ignore_value (fwrite (line_record_buffer (thisline),
-                                line_record_length (thisline), sizeof (char),
-                                stdout));
-          print_line_separator ();
+          sf = &next;
+          open_state_file (sf, input_files[i]);
+          if (sf->header_len != first->header_len
+              || memcmp (sf->header, first->header, sf->header_len) != 0)
+            die (EXIT_FAILURE, 0,
+                 _("%s: the state file has different operations"),
+                 quotef (sf->name));
+        }
+
+      while (read_state_group (sf, &line))
+        {
+          /* Without input column names, the output header names the
+             fields of the first group's line */
+          if (output_header && !emit_state && !header_printed)
+            {
+              build_input_line_headers (&line, false);
+              print_column_headers ();
+              header_printed = true;
+            }
+          merge_hash_group_state (&line, sf);
         }
+      close_state_file (sf);
+      if (sf != first)
+        free_state_file (sf);
     }
-  line_record_free (&lr);
+
+  print_hash_groups ();
+  line_record_free (&line);
 }
 
 /*
-   Read file, ensure it is in tabular format
-   (same number of fields in each line)
+    Process each line in the input.
+
+    If the key of the current line is different from the previous one,
+    summarize the previous group and start a new one.
  */
 static void
-tabular_check_file ()
+process_file ()
 {
-  size_t prev_num_fields=0;
-  struct line_record_t lb1, lb2;
-  struct line_record_t *thisline, *prevline;
+  struct line_record_t lb;
+  struct line_record_t *group_first_line;
+  struct line_batch batch;
+  struct group_key key;
 
-  const uintmax_t n_lines = dm->mode_params.check_params.n_lines;
-  const uintmax_t n_fields = dm->mode_params.check_params.n_fields;
+  group_first_line = &lb;
 
-  thisline = &lb1;
-  prevline = &lb2;
+  line_record_init (group_first_line);
+  line_batch_init (&batch);
+  group_key_init (&key);
 
-  line_record_init (thisline);
-  line_record_init (prevline);
+  /* If there is an input header line, and it wasn't read already
+     in 'open_input' - read it now */
+  if (input_header && line_number==0)
+    process_input_header (&input_lines);
 
-  while (line_record_fread (thisline, input_stream, eolchar,
-                            skip_comments, false))
-    {
-      line_number++;
+  if (emit_state)
+    emit_state_header (state_group_spec, state_op_args, state_num_op_args,
+                       print_full_line, input_header);
 
-      const size_t num_fields = line_record_num_fields (thisline);
+  if (print_full_line && !line_mode)
+    fputs (_("datamash: Using -f/--full with non-linewise operations \
+is deprecated and will be disabled in a future release.\n"), stderr);
 
-      /* Check if the number of fields is different than expected/requested
-         on the command line (e.g. with 'datamash check 6 fields') */
-      if (n_fields && n_fields != num_fields)
-        {
-          fprintf (stderr, _("line %"PRIuMAX" (%"PRIuMAX" fields):\n  "),
-                       (uintmax_t)(line_number), (uintmax_t)num_fields);
-          ignore_value (fwrite (line_record_buffer (thisline),
-                                line_record_length (thisline), sizeof (char),
-                                stderr));
-          fputc ('\n', stderr);
-          die (EXIT_FAILURE, 0, _("check failed: line " \
-                       "%"PRIuMAX" has %"PRIuMAX" fields (expecting "\
-                       "%"PRIuMAX")"),
-                       (uintmax_t)line_number, (uintmax_t)num_fields,
-                       (uintmax_t)n_fields);
-        }
+  /* If there is an input header line, and the user requested an output
+     header line, and the input line was read successfully, print headers */
+  if (input_header && output_header && line_number==1)
+    print_column_headers ();
 
-      /* Check if the number of fields changed from one line to the next
-         (only if no expected number of fields specified on the command line).*/
-      else if (line_number>1 && num_fields != prev_num_fields)
+  /* Split only the fields used by the grouping columns and operations.
+     If the output header line is generated from the first input line,
+     that line must be split entirely (see below). */
+  if (input_header || !output_header)
+    {
+      input_lines.max_fields = max_used_column ();
+      save_header_length ();
+    }
+
+  while (input_batch_fread (&batch))
+    {
+      for (size_t i = 0; i < batch.num_lines; ++i)
         {
-          fprintf (stderr, _("line %"PRIuMAX" (%"PRIuMAX" fields):\n  "),
-                       (uintmax_t)(line_number-1), (uintmax_t)prev_num_fields);
-          ignore_value (fwrite (line_record_buffer (prevline),
-                                line_record_length (prevline), sizeof (char),
-                                stderr));
-          fputc ('\n', stderr);
-          fprintf (stderr, _("line %"PRIuMAX" (%"PRIuMAX" fields):\n  "),
-                       (uintmax_t)(line_number), (uintmax_t)num_fields);
-          ignore_value (fwrite (line_record_buffer (thisline),
-                                line_record_length (thisline), sizeof (char),
-                                stderr));
-          fputc ('\n', stderr);
-          die (EXIT_FAILURE, 0, _("check failed: line " \
-                       "%"PRIuMAX" has %"PRIuMAX" fields (previous line had "\
-                       "%"PRIuMAX")"),
-                       (uintmax_t)line_number, (uintmax_t)num_fields,
-                       (uintmax_t)prev_num_fields);
+          struct line_record_t *thisline = &batch.lines[i];
+          bool new_group = false;
+
+          line_number++;
+
+          /* If there's no input header line, and the user requested an
+             output header line, then generate output header line based on
+             the number of fields in the first (data, non-header) input
+             line */
+          if (line_number==1 && output_header && !input_header)
+            {
+              build_input_line_headers (thisline, false);
+              print_column_headers ();
+              input_lines.max_fields = max_used_column ();
+              save_header_length ();
+            }
+
+
+          if (hash_groups && dm->num_grps && !line_mode)
+            {
+              if (!hash_grouper)
+                init_hash_grouper (hash_buffer_size);
+              hash_grouper_add_line (hash_grouper, thisline, line_number);
+              continue;
+            }
+
+          /* If no keys are given, the entire input is considered one
+             group */
+          if (dm->num_grps || line_mode)
+            {
+              if (line_record_length (group_first_line) == 0 || line_mode)
+                new_group = true;
+              else if (key.valid)
+                new_group = !group_key_matches (&key, thisline);
+              else
+                {
+                  new_group = different (thisline, group_first_line);
+                  if (!new_group)
+                    group_key_set (&key, thisline);
+                }
+
+              if (new_group)
+                {
+                  process_group (group_first_line, false);
+                  group_first_line->len = 0;
+                  key.valid = false;
+                }
+            }
+          else
+            {
+              /* The entire line is a "group", if it's the first line,
+                 keep it */
+              new_group = (line_record_length (group_first_line) == 0);
+            }
+
+          lines_in_group++;
+          bool keep_line = process_line (thisline, dm->ops);
+
+          if (new_group || keep_line)
+            line_record_swap (group_first_line, thisline);
         }
-      prev_num_fields = num_fields;
 
-      SWAP_LINES (prevline, thisline);
+      /* The group's first line must remain valid during the next batch */
+      line_record_keep (group_first_line);
     }
 
-  /* Check if we read too many/few lines */
-  if (n_lines && n_lines != line_number)
+  /* Without input lines, no header line was generated */
+  save_header_length ();
+
+  /* summarize last group */
+  if (hash_groups && dm->num_grps && !line_mode)
     {
-      die (EXIT_FAILURE, 0, _("check failed: input had %"PRIuMAX" lines " \
-                              "(expecting %"PRIuMAX")"),
-           (uintmax_t)line_number, (uintmax_t)n_lines);
+      if (hash_grouper)
+        print_hash_groups ();
     }
+  else
+    process_group (group_first_line, true);
 
-  /* Print summary */
-  printf (ngettext ("%"PRIuMAX" line", "%"PRIuMAX" lines",
-          select_plural (line_number)), (uintmax_t)line_number);
-  fputs (", ", stdout);
-  printf (ngettext ("%"PRIuMAX" field", "%"PRIuMAX" fields",
-          select_plural (prev_num_fields)), (uintmax_t)prev_num_fields);
-  print_line_separator ();
-
-  line_record_free (&lb1);
-  line_record_free (&lb2);
+  line_record_free (&lb);
+  line_batch_free (&batch);
+  group_key_free (&key);
 }
 
 /*
-    Remove lines with duplicates keys from a file
+    Transpose rows and columns in input file
  */
 static void
-remove_dups_in_file ()
+transpose_file ()
 {
-  const char* str = NULL;
-  size_t len = 0;
-  struct line_record_t lr;
-  struct line_record_t *thisline;
-  Hash_table *ht;
-  const size_t init_table_size = rmdup_initial_size;
-
-  char* keys_buffer = NULL;
-  size_t keys_buffer_alloc = 0;
-  size_t next_key_pos = 0;
-
-  char** buffer_list = NULL;
-  size_t buffer_list_alloc = 0;
-  size_t buffer_list_size = 0;
-
-  thisline = &lr;
-  line_record_init (thisline);
-  ht = hash_initialize (init_table_size, NULL,
-                        hash_pjw, hash_compare_strings, NULL);
+  size_t num_lines = 0;
+  size_t alloc_lines = 0;
+  struct line_record_t *lines = NULL;
 
-  /* Allocate keys buffer */
-  keys_buffer_alloc = rmdup_initial_size ;
-  keys_buffer = xmalloc ( keys_buffer_alloc );
+  size_t max_num_fields = 0 ;
+  size_t prev_num_fields = 0 ;
 
-  /* List of allocated key-buffers */
-  buffer_list = x2nrealloc (NULL, &buffer_list_alloc, sizeof (char*));
-  buffer_list[0] = keys_buffer;
-  buffer_list_size = 1 ;
+  struct line_batch batch;
+  line_batch_init (&batch);
 
-  if (input_header)
+  /* Read all input lines - but instead of reusing line_record_t,
+     keep all lines in memory. */
+  while (line_batch_fread (&batch, &input_lines, eolchar, skip_comments))
     {
-      if (line_record_fread (thisline, input_stream, eolchar,
-                             skip_comments, vnlog))
+      for (size_t i = 0; i < batch.num_lines; ++i)
         {
-          line_number++;
-
-          /* If using named-columns, find the column numbers after reading the
-             header line. */
-          if (dm->header_required)
+          if (num_lines+1 > alloc_lines)
             {
-              build_input_line_headers (&lr, true);
-              group_columns_find_named_columns ();
+              alloc_lines += 1000;
+              lines = xnrealloc ( lines, alloc_lines,
+                                  sizeof (struct line_record_t));
             }
 
-          if (output_header)
-            {
-              if (vnlog)
-                fprintf (stdout, "# ");
-              const size_t num_fields = line_record_num_fields (thisline);
-              for (size_t i = 1 ; i <= num_fields ; ++i) {
-                if (i>1)
-                  print_field_separator ();
+          struct line_record_t *thisline = &lines[num_lines];
+          num_lines++;
+          line_record_init (thisline);
+          line_record_swap (thisline, &batch.lines[i]);
+          line_record_keep (thisline);
+          line_number++;
 
-                const char *str;
-                size_t len;
-                if (line_record_get_field (thisline, i, &str, &len))
-                  {
-                    ignore_value (fwrite (str, len, sizeof (char), stdout));
-                  }
-              }
-              print_line_separator ();
+          const size_t num_fields = line_record_num_fields (thisline);
+
+          if (strict && line_number>1 && num_fields != prev_num_fields)
+            {
+              const char *file;
+              const size_t line = input_file_line (line_number, &file);
+              input_line_error (file, _("transpose input error: line " \
+                     "%"PRIuMAX" has %"PRIuMAX" fields (previous lines " \
+                     "had %"PRIuMAX");\n" \
+                     "see --help to disable strict mode"),
+                     (uintmax_t)line, (uintmax_t)num_fields,
+                     (uintmax_t)prev_num_fields);
             }
+
+          prev_num_fields = num_fields;
+          max_num_fields = MAX (max_num_fields,num_fields);
         }
     }
+  line_batch_free (&batch);
 
-  assert (dm->num_grps==1); /* LCOV_EXCL_LINE */
-  const size_t key_col = dm->grps[0].num;
+  /* Output all fields */
+  for (size_t i = 1 ; i <= max_num_fields ; ++i)
+    {
+      for (size_t j = 0; j < line_number; ++j)
+        {
+          if (j>0)
+            print_field_separator ();
+
+          const struct line_record_t *line = &lines[j];
+          const char* str;
+          size_t len;
+          if (line_record_get_field (line, i, &str, &len))
+            output_field (str, len);
+          else
+            output_str (missing_field_filler);
+        }
+      print_line_separator ();
+    }
+
+  /* Free pointers */
+  for (size_t i = 0; i < num_lines; ++i)
+    line_record_free (&lines[i]);
+  free (lines);
+}
+
+/*
+    Reverse the fields in each line of the input file
+ */
+static void
+reverse_fields_in_file ()
+{
+  struct line_batch batch;
+  size_t prev_num_fields = 0;
+
+  line_batch_init (&batch);
+
+  /* With --vnlog, the header line is read from the comments prologue */
+  if (vnlog)
+    {
+      struct line_record_t lr;
+      line_record_init (&lr);
+      if (line_record_fread (&lr, &input_lines, eolchar, skip_comments, true))
+        {
+          line_number++;
+          prev_num_fields = line_record_num_fields (&lr);
+
+          /* If using named-columns, find the column numbers after reading
+             the header line. */
+          build_input_line_headers (&lr, true);
+          group_columns_find_named_columns ();
+
+          output_str ("# ");
+          const size_t num_fields = line_record_num_fields (&lr);
+          for (size_t i = num_fields ; i >= 1 ; --i) {
+            if (i<num_fields)
+              print_field_separator ();
+
+            const char *str;
+            size_t len;
+            if (line_record_get_field (&lr, i, &str, &len))
+            {
+              output_bytes (str, len);
+            }
+          }
+          print_line_separator ();
+        }
+      line_record_free (&lr);
+    }
+
+  while (line_batch_fread (&batch, &input_lines, eolchar, skip_comments))
+    {
+      for (size_t j = 0; j < batch.num_lines; ++j)
+        {
+          const struct line_record_t *thisline = &batch.lines[j];
+          line_number++;
+
+          const size_t num_fields = line_record_num_fields (thisline);
+
+          if (strict && line_number>1 && num_fields != prev_num_fields)
+            {
+              const char *file;
+              const size_t line = input_file_line (line_number, &file);
+              input_line_error (file, _("reverse-field input error: line " \
+                     "%"PRIuMAX" has %"PRIuMAX" fields (previous lines " \
+                     "had %"PRIuMAX");\n" \
+                     "see --help to disable strict mode"),
+                     (uintmax_t)line, (uintmax_t)num_fields,
+                     (uintmax_t)prev_num_fields);
+            }
+
+          prev_num_fields = num_fields;
+
+          /* Special handling for header line */
+          if (line_number == 1)
+            {
+              /* If there is an header line (first line), and the user did
+                 not request printing the header, skip it */
+              if (input_header && !output_header)
+                continue;
+
+              /* There is no input header line (first line already contains
+                 data), and the user requested to generate output header
+                 line. Print dummy header lines. */
+              if (!input_header && output_header)
+                {
+                  build_input_line_headers (thisline, false);
+                  for (size_t i = num_fields; i > 0; --i)
+                    {
+                      if (i < num_fields)
+                        print_field_separator ();
+                      output_str (get_input_field_name (i));
+                    }
+                  print_line_separator ();
+                }
+            }
+
+          /* Print the line, reversing field order */
+          for (size_t i = num_fields; i > 0; --i)
+            {
+              if (i < num_fields)
+                print_field_separator ();
+
+              const char* str = NULL;
+              size_t len = 0 ;
+              ignore_value (line_record_get_field (thisline, i, &str, &len));
+              output_field (str, len);
+            }
+          print_line_separator ();
+        }
+    }
+  line_batch_free (&batch);
+}
+
+/*
+   read, parse, print file - without any additional operations
+ */
+static void
+noop_file ()
+{
+  struct line_batch batch;
+
+  line_batch_init (&batch);
+  while (line_batch_fread (&batch, &input_lines, eolchar, skip_comments))
+    {
+      for (size_t i = 0; i < batch.num_lines; ++i)
+        {
+          const struct line_record_t *thisline = &batch.lines[i];
+          line_number++;
+
+          if (print_full_line)
+            {
+              output_bytes (line_record_buffer (thisline),
+                            line_record_length (thisline));
+              print_line_separator ();
+            }
+        }
+    }
+  line_batch_free (&batch);
+}
+
+/* Prints LINE, the line number NUMBER of FILE (if not NULL), which
+   has NUM_FIELDS fields, before a 'check' error */
+static void
+print_check_line (const char *file, size_t number,
+                  const struct line_record_t *line, size_t num_fields)
+{
+  if (file)
+    fprintf (stderr, "%s: ", file);
+  fprintf (stderr, _("line %"PRIuMAX" (%"PRIuMAX" fields):\n  "),
+               (uintmax_t)number, (uintmax_t)num_fields);
+  ignore_value (fwrite (line_record_buffer (line),
+                        line_record_length (line),
+                        sizeof (char), stderr));
+  fputc ('\n', stderr);
+}
+
+/* Reports two consecutive lines with a different number of fields:
+   PREVLINE, the line number PREV_LINE of PREV_FILE, and THISLINE, the
+   line number LINE of FILE (see input_file_line ()) */
+static noreturn void
+check_failed_lines (const char *prev_file, size_t prev_line,
+                    size_t prev_num_fields,
+                    const struct line_record_t *prevline,
+                    const char *file, size_t line, size_t num_fields,
+                    const struct line_record_t *thisline)
+{
+  print_check_line (prev_file, prev_line, prevline, prev_num_fields);
+  print_check_line (file, line, thisline, num_fields);
+  input_line_error (file, _("check failed: line " \
+                            "%"PRIuMAX" has %"PRIuMAX" fields (previous " \
+                            "line had %"PRIuMAX")"),
+                    (uintmax_t)line, (uintmax_t)num_fields,
+                    (uintmax_t)prev_num_fields);
+}
+
+/* Reports the input line number PREV_LINE_NUMBER (PREVLINE) and the
+   next one (THISLINE), which have a different number of fields */
+static noreturn void
+check_failed_num_fields (size_t prev_line_number, size_t prev_num_fields,
+                         const struct line_record_t *prevline,
+                         size_t num_fields,
+                         const struct line_record_t *thisline)
+{
+  const char *prev_file, *file;
+  const size_t prev_line = input_file_line (prev_line_number, &prev_file);
+  const size_t line = input_file_line (prev_line_number + 1, &file);
+
+  check_failed_lines (prev_file, prev_line, prev_num_fields, prevline,
+                      file, line, num_fields, thisline);
+}
+
+/* Checks the total number of lines, and prints the summary */
+static void
+check_summary (size_t num_lines, size_t num_fields)
+{
+  const uintmax_t n_lines = dm->mode_params.check_params.n_lines;
+
+  /* Check if we read too many/few lines */
+  if (n_lines && n_lines != num_lines)
+    {
+      die (EXIT_FAILURE, 0, _("check failed: input had %"PRIuMAX" lines " \
+                              "(expecting %"PRIuMAX")"),
+           (uintmax_t)num_lines, (uintmax_t)n_lines);
+    }
+
+  /* Print summary */
+  output_printf (ngettext ("%"PRIuMAX" line", "%"PRIuMAX" lines",
+          select_plural (num_lines)), (uintmax_t)num_lines);
+  output_str (", ");
+  output_printf (ngettext ("%"PRIuMAX" field", "%"PRIuMAX" fields",
+          select_plural (num_fields)), (uintmax_t)num_fields);
+  print_line_separator ();
+}
+
+/*
+   Read file, ensure it is in tabular format
+   (same number of fields in each line)
+ */
+static void
+tabular_check_file ()
+{
+  size_t prev_num_fields=0;
+  size_t first_num_fields=0;
+  struct line_record_t lb;
+  struct line_record_t *prevline;
+  struct line_record_t firstline;
+  struct line_batch batch;
+
+  const uintmax_t n_fields = dm->mode_params.check_params.n_fields;
+
+  prevline = &lb;
+
+  line_record_init (prevline);
+  line_record_init (&firstline);
+  line_batch_init (&batch);
+
+  while (line_batch_fread (&batch, &input_lines, eolchar, skip_comments))
+    {
+      for (size_t i = 0; i < batch.num_lines; ++i)
+        {
+          struct line_record_t *thisline = &batch.lines[i];
+          line_number++;
+
+          const size_t num_fields = line_record_num_fields (thisline);
+
+          /* Check if the number of fields is different than
+             expected/requested on the command line
+             (e.g. with 'datamash check 6 fields') */
+          if (n_fields && n_fields != num_fields)
+            {
+              const char *file;
+              const size_t line = input_file_line (line_number, &file);
+              print_check_line (file, line, thisline, num_fields);
+              input_line_error (file, _("check failed: line " \
+                                        "%"PRIuMAX" has %"PRIuMAX" fields "\
+                                        "(expecting %"PRIuMAX")"),
+                                (uintmax_t)line, (uintmax_t)num_fields,
+                                (uintmax_t)n_fields);
+            }
+
+          /* Check if the number of fields changed from one line to the next
+             (only if no expected number of fields specified on the
+             command line).*/
+          else if (line_number>1 && num_fields != prev_num_fields)
+            check_failed_num_fields (line_number - 1, prev_num_fields,
+                                     prevline, num_fields, thisline);
+          prev_num_fields = num_fields;
+
+          /* A worker reports its first line, to be checked against the
+             last line of the previous file */
+          if (worker_state && line_number == 1)
+            {
+              first_num_fields = num_fields;
+              line_record_assign (&firstline, line_record_buffer (thisline),
+                                  line_record_length (thisline));
+            }
+
+          line_record_swap (prevline, thisline);
+        }
+
+      /* The previous line must remain valid during the next batch */
+      line_record_keep (prevline);
+    }
+
+  if (worker_state)
+    {
+      if (fwrite (&line_number, sizeof line_number, 1, worker_state) != 1
+          || fwrite (&first_num_fields, sizeof first_num_fields, 1,
+                     worker_state) != 1
+          || fwrite (&prev_num_fields, sizeof prev_num_fields, 1,
+                     worker_state) != 1)
+        die (EXIT_FAILURE, errno, _("write error"));
+      save_line (&firstline, worker_state);
+      save_line (prevline, worker_state);
+    }
+  else
+    check_summary (line_number, prev_num_fields);
+
+  line_record_free (&lb);
+  line_record_free (&firstline);
+  line_batch_free (&batch);
+}
+
+/*
+    Remove lines with duplicates keys from a file
+ */
+static void
+remove_dups_in_file ()
+{
+  const char* str = NULL;
+  size_t len = 0;
+  struct line_record_t lr;
+  struct line_record_t *thisline;
+  struct line_batch batch;
+  struct key_intern *keys = key_intern_init ();
+
+  thisline = &lr;
+  line_record_init (thisline);
+  line_batch_init (&batch);
+
+  if (input_header)
+    {
+      if (line_record_fread (thisline, &input_lines, eolchar,
+                             skip_comments, vnlog))
+        {
+          line_number++;
+
+          /* If using named-columns, find the column numbers after reading the
+             header line. */
+          if (dm->header_required)
+            {
+              build_input_line_headers (&lr, true);
+              group_columns_find_named_columns ();
+            }
+
+          if (output_header)
+            {
+              if (vnlog)
+                output_str ("# ");
+              const size_t num_fields = line_record_num_fields (thisline);
+              for (size_t i = 1 ; i <= num_fields ; ++i) {
+                if (i>1)
+                  print_field_separator ();
+
+                const char *str;
+                size_t len;
+                if (line_record_get_field (thisline, i, &str, &len))
+                  {
+                    output_field (str, len);
+                  }
+              }
+              print_line_separator ();
+            }
+        }
+    }
+
+  assert (dm->num_grps==1); /* LCOV_EXCL_LINE */
+  const size_t key_col = dm->grps[0].num;
+
+  /* Split lines only up to the key column. New keys are printed
+     in full, and only those lines are split entirely. */
+  input_lines.max_fields = key_col;
+
+  /* TODO: handle (output_header && !input_header) by generating dummy headers
+           after the first line is read, and the number of fields is known. */
+
+  while (input_batch_fread (&batch))
+    {
+      for (size_t j = 0; j < batch.num_lines; ++j)
+        {
+          thisline = &batch.lines[j];
+          line_number++;
+
+          if (!line_record_get_field (thisline, key_col, &str, &len))
+            error_not_enough_fields (key_col,
+                                     line_record_num_fields (thisline));
+
+          /* Print the lines whose key was not seen before */
+          const size_t hash = key_intern_hash (str, len);
+          if (key_intern_find (keys, str, len, hash) == KEY_INTERN_NONE)
+            {
+              key_intern_add (keys, str, len, hash);
+              line_record_parse_all (thisline);
+              const size_t num_fields = line_record_num_fields (thisline);
+              for (size_t i = 1 ; i <= num_fields ; ++i) {
+                if (i>1)
+                  print_field_separator ();
+
+                const char *str;
+                size_t len;
+                if (line_record_get_field (thisline, i, &str, &len))
+                  {
+                    output_field (str, len);
+                  }
+              }
+              print_line_separator ();
+            }
+        }
+    }
+  line_record_free (&lr);
+  line_batch_free (&batch);
+  key_intern_free (keys);
+}
+
+
+/* Waits for the input feeder (if any), and exits if it failed.
+   The input feeder reports its own errors. */
+static void
+wait_input_feeder ()
+{
+  int status;
+
+  if (input_feeder <= 0)
+    return;
+
+  while (waitpid (input_feeder, &status, 0) < 0)
+    if (errno != EINTR)
+      die (EXIT_FAILURE, errno, _("waitpid failed"));
+  if (!WIFEXITED (status) || WEXITSTATUS (status) != EXIT_SUCCESS)
+    exit (EXIT_FAILURE);
+  input_feeder = -1;
+}
+
+/* Returns true if the standard input might be compressed,
+   and must be decompressed before it is sorted */
+static bool
+stdin_maybe_compressed ()
+{
+  struct stat st;
+  char head[COMPRESSION_MAGIC_LEN];
+
+  if (input_compression != COMPRESSION_AUTO)
+    return input_compression != COMPRESSION_NONE;
+
+  /* Only regular files can be examined without consuming the data */
+  if (fstat (STDIN_FILENO, &st) != 0 || !S_ISREG (st.st_mode))
+    return true;
+  const off_t pos = lseek (STDIN_FILENO, 0, SEEK_CUR);
+  if (pos < 0)
+    return true;
+  const ssize_t n = pread (STDIN_FILENO, head, sizeof head, pos);
+  return n > 0 && compression_detect (head, n) != COMPRESSION_NONE;
+}
+
+/* Starts a child process which reads the input (the input files, or the
+   standard input if it is compressed) and writes its lines to a pipe,
+   which becomes the standard input (passed to the 'sort' child-process).
+   The header line (if any) is written to a second pipe, and read
+   by this process. */
+static void
+start_input_feeder ()
+{
+  int fds[2];
+  int header_fds[2];
+
+  if (pipe (fds) != 0 || (input_header && pipe (header_fds) != 0))
+    die (EXIT_FAILURE, errno, _("cannot create pipe"));
+
+  output_flush ();
+  input_feeder = fork ();
+  if (input_feeder < 0)
+    die (EXIT_FAILURE, errno, _("cannot fork"));
+
+  if (input_feeder == 0)
+    {
+      struct line_input in;
+      struct line_batch batch;
+
+      close (fds[0]);
+      if (dup2 (fds[1], STDOUT_FILENO) < 0)
+        die (EXIT_FAILURE, errno, "dup2");
+      close (fds[1]);
+
+      if (input_files)
+        line_input_open_files (&in, input_files, num_input_files,
+                               input_header);
+      else
+        line_input_init (&in, stdin, true);
+      in.max_fields = 1;
+
+      if (input_header)
+        {
+          struct line_record_t lr;
+          FILE *header = fdopen (header_fds[1], "w");
+
+          close (header_fds[0]);
+          if (header == NULL)
+            die (EXIT_FAILURE, errno, "fdopen");
+          line_record_init (&lr);
+          if (line_record_fread (&lr, &in, eolchar, skip_comments, vnlog))
+            {
+              ignore_value (fwrite (line_record_buffer (&lr),
+                                    line_record_length (&lr),
+                                    sizeof (char), header));
+              fputc (eolchar, header);
+            }
+          if (fclose (header) != 0)
+            die (EXIT_FAILURE, errno, _("write error"));
+          line_record_free (&lr);
+        }
+
+      line_batch_init (&batch);
+      while (line_batch_fread (&batch, &in, eolchar, skip_comments))
+        for (size_t i = 0; i < batch.num_lines; ++i)
+          {
+            output_bytes (line_record_buffer (&batch.lines[i]),
+                          line_record_length (&batch.lines[i]));
+            print_line_separator ();
+          }
+      line_batch_free (&batch);
+      line_input_free (&in);
+      exit (EXIT_SUCCESS);
+    }
+
+  close (fds[1]);
+  if (dup2 (fds[0], STDIN_FILENO) < 0)
+    die (EXIT_FAILURE, errno, "dup2");
+  close (fds[0]);
+
+  if (input_header)
+    {
+      struct line_input header_input;
+      const size_t header_line = line_number;
+      FILE *header;
+
+      close (header_fds[1]);
+      header = fdopen (header_fds[0], "r");
+      if (header == NULL)
+        die (EXIT_FAILURE, errno, "fdopen");
+      line_input_init (&header_input, header, false);
+      process_input_header (&header_input);
+      line_input_free (&header_input);
+      fclose (header);
+
+      /* No header line: the input is empty, or the feeder failed */
+      if (line_number == header_line)
+        wait_input_feeder ();
+    }
+}
+
+/* Parses the argument of --sort-buffer-size and --hash-buffer-size
+   into SIZE: a size in KiB, or followed by a suffix (b for bytes,
+   K, M, G...) as with sort -S. Returns false if STR is invalid. */
+static bool
+parse_buffer_size (const char *str, size_t *size)
+{
+  char *suffix;
+  uintmax_t n;
+  strtol_error e = xstrtoumax (str, &suffix, 10, &n, "EgGkKmMPtTYZ");
+
+  if (e == LONGINT_OK && suffix > str && isdigit (to_uchar (suffix[-1])))
+    {
+      if (n <= UINTMAX_MAX / 1024)
+        n *= 1024;
+      else
+        e = LONGINT_OVERFLOW;
+    }
+  else if (e == LONGINT_INVALID_SUFFIX_CHAR && suffix > str
+           && isdigit (to_uchar (suffix[-1])) && STREQ (suffix, "b"))
+    e = LONGINT_OK;
+
+  if (e != LONGINT_OK || n == 0 || n > SIZE_MAX)
+    return false;
+  *size = n;
+  return true;
+}
+
+static void
+open_input ()
+{
+  if (pipe_through_sort && dm->num_grps>0 && sort_cmd)
+    {
+      char delim[2] = { 0, 0 };
+
+      if (input_files || stdin_maybe_compressed ())
+        start_input_feeder ();
+      else if (input_header)
+        {
+          struct line_input header_input;
+
+          /* Set no-buffering, to ensure only the first line is consumed */
+          setbuf (stdin,NULL);
+          /* Read the header line from STDIN, and pass the rest of it to
+             the 'sort' child-process */
+          line_input_init (&header_input, stdin, false);
+          process_input_header (&header_input);
+          line_input_free (&header_input);
+        }
+
+      char **args = xcalloc (dm->num_grps + 8, sizeof (char *));
+      int argc = 0;
+
+#ifdef SORT_WITHOUT_LOCALE
+      args[argc++] = "LC_ALL=C";
+#endif
+      args[argc++] = (char *)sort_cmd;
+#ifdef HAVE_STABLE_SORT
+      /* stable sort (-s) is needed to support first/last operations
+         (prevent sort from re-ordering lines which are not part of the group.
+         '-s' is not standard POSIX, but very commonly supported, including
+         on GNU coreutils, Busybox, FreeBSD, MacOSX */
+      args[argc++] = "-s";
+#endif
+
+      if (eolchar == '\0')
+        {
+#ifdef HAVE_ZERO_SORT
+          /* sort needs to understand -z to properly sort input using
+             NUL as the line delimiter */
+          args[argc++] = "-z";
+#else
+          die (EXIT_FAILURE, 0,
+                 _("-s and -z cannot be combined on this system"));
+#endif
+        }
+      if (!case_sensitive)
+        {
+          args[argc++] = "-f";
+        }
+
+      if (in_tab != TAB_WHITESPACE)
+        {
+          args[argc++] = "-t";
+          delim[0] = in_tab;
+          args[argc++] = delim;
+        }
+
+      int sort_spec = argc;
+      for (size_t i = 0; i < dm->num_grps; ++i)
+        {
+          char tmp[INT_BUFSIZE_BOUND (size_t) * 2 + 5];
+          const size_t col_num = dm->grps[i].num;
+          snprintf (tmp,sizeof (tmp),"-k%"PRIuMAX",%"PRIuMAX,
+                    (uintmax_t)col_num,(uintmax_t)col_num);
+          args[argc++] = xstrdup (tmp);
+        }
+
+      char *cmd = shell_quote_argv ((const char * const *) args);
+      while (sort_spec < argc)
+        {
+          free (args[sort_spec++]);
+        }
+      free (args);
+      input_stream = popen (cmd,"r");
+      free (cmd);
+      if (input_stream == NULL)
+        die (EXIT_FAILURE, 0, _("failed to run 'sort': popen failed"));
+    }
+  else
+    {
+      /* without grouping, there's no need to sort */
+      if (dm->num_grps == 0)
+        pipe_through_sort = false;
+      sort_input = pipe_through_sort;
+
+      if (input_files)
+        {
+          line_input_open_files (&input_lines, input_files, num_input_files,
+                                 input_header);
+          return;
+        }
+      input_stream = stdin;
+    }
+
+  line_input_init (&input_lines, input_stream, true);
+}
+
+static void
+close_input ()
+{
+  int i;
+
+  line_sorter_free (input_sorter);
+  input_sorter = NULL;
+  line_input_free (&input_lines);
+
+  /* The input files are closed by line_input_free () */
+  if (input_stream == NULL)
+    return;
+
+  if (ferror (input_stream))
+    die (EXIT_FAILURE, errno, _("read error"));
+
+  if (pipe_through_sort && !sort_input)
+    i = pclose (input_stream);
+  else
+    i = fclose (input_stream);
+
+  if (i != 0)
+    die (EXIT_FAILURE, errno, _("read error (on close)"));
+
+  wait_input_feeder ();
+}
+
+static void
+process_input ()
+{
+  switch (dm->mode)                              /* LCOV_EXCL_BR_LINE */
+    {
+    case MODE_PER_LINE:
+      line_mode = true;
+      /* fall through */
+    case MODE_GROUPBY:
+      process_file ();
+      break;
+
+    case MODE_NOOP:
+      noop_file ();
+      break;
+
+    case MODE_TRANSPOSE:
+      transpose_file ();
+      break;
+
+    case MODE_REVERSE:
+      reverse_fields_in_file ();
+      break;
+
+    case MODE_REMOVE_DUPS:
+      remove_dups_in_file ();
+      break;
+
+    case MODE_CROSSTAB:
+      assert ( dm->num_grps== 2 ); /* LCOV_EXCL_LINE */
+      assert ( dm->num_ops == 1 ); /* LCOV_EXCL_LINE */
+      crosstab_mode = true;
+      crosstab = crosstab_init ();
+      process_file ();
+      crosstab_print (crosstab);
+      crosstab_free (crosstab);
+      break;
+
+    case MODE_TABULAR_CHECK:
+      tabular_check_file ();
+      break;
+
+    case MODE_INVALID:                           /* LCOV_EXCL_LINE */
+    default:                                     /* LCOV_EXCL_LINE */
+      internal_error ("op mode");                /* LCOV_EXCL_LINE */
+    }
+}
+
+/* Returns true if the results of processing each input file separately
+   can be combined into the results of processing all of them */
+static bool
+parallel_mode_supported ()
+{
+#if HAVE_FORK
+  switch (dm->mode)                              /* LCOV_EXCL_BR_LINE */
+    {
+    case MODE_PER_LINE:
+    case MODE_TABULAR_CHECK:
+      return true;
+
+    case MODE_GROUPBY:
+      /* Each file must be sorted on its own; with --full, the printed line
+         could come from any file */
+      if (pipe_through_sort || hash_groups || print_full_line || emit_state
+          || top_groups)
+        return false;
+      /* With --narm, the values of the pair operations are paired across
+         lines (see field_op_pair_values ()), which depends on the values
+         of the other files */
+      for (size_t i = 0; i < dm->num_ops; ++i)
+        if (!field_op_mergeable (dm->ops[i].op)
+            || (remove_na_values && dm->ops[i].primary))
+          return false;
+      return true;
+
+    case MODE_NOOP:
+    case MODE_TRANSPOSE:
+    case MODE_REVERSE:
+    case MODE_REMOVE_DUPS:
+    case MODE_CROSSTAB:
+    case MODE_INVALID:
+    default:
+      return false;
+    }
+#else
+  return false;
+#endif
+}
+
+/* Processes input file I in a worker process */
+static void
+parallel_task (size_t i, FILE *state)
+{
+  worker_state = state;
+  input_files += i;
+  num_input_files = 1;
+
+  /* Start afresh: the main process might have read the header line, and
+     combined the results of other files */
+  line_number = 0;
+  free_column_headers ();
+  reset_field_ops ();
+
+  open_input ();
+  /* 'check' reads the header line as data: skip it in the other files,
+     as when reading the files one after the other */
+  if (i > 0 && input_header && dm->mode == MODE_TABULAR_CHECK)
+    line_input_skip_header (&input_lines);
+  process_input ();
+  close_input ();
+}
+
+/* Totals of the 'check' results of the files completed so far */
+static size_t check_lines = 0;
+static size_t check_fields = 0;
+static struct line_record_t check_lastline;
+/* The last file which had lines, and the number of its last line */
+static size_t check_file = 0;
+static size_t check_file_line = 0;
+
+/* Combines the 'check' results of the input file I */
+static void
+collect_check (size_t i, FILE *state)
+{
+  size_t lines, first_num_fields, last_num_fields;
+  struct line_record_t firstline, lastline;
+
+  if (fread (&lines, sizeof lines, 1, state) != 1
+      || fread (&first_num_fields, sizeof first_num_fields, 1, state) != 1
+      || fread (&last_num_fields, sizeof last_num_fields, 1, state) != 1)
+    die (EXIT_FAILURE, 0, _("read error"));
 
-  /* TODO: handle (output_header && !input_header) by generating dummy headers
-           after the first line is read, and the number of fields is known. */
+  line_record_init (&firstline);
+  line_record_init (&lastline);
+  if (!load_line (&firstline, state) || !load_line (&lastline, state))
+    die (EXIT_FAILURE, 0, _("read error"));
 
-  while (line_record_fread (thisline, input_stream, eolchar,
-                            skip_comments, false))
+  if (lines > 0)
     {
-      line_number++;
-
-      if (!line_record_get_field (thisline, key_col, &str, &len))
-        error_not_enough_fields (key_col, line_record_num_fields (thisline));
+      /* The header line of the files after the first one was skipped
+         (see parallel_task ()) */
+      const size_t header_skipped = i > 0 && input_header;
+
+      if (check_lines > 0 && !dm->mode_params.check_params.n_fields
+          && first_num_fields != check_fields)
+        check_failed_lines (input_files[check_file], check_file_line,
+                            check_fields, &check_lastline,
+                            input_files[i], 1 + header_skipped,
+                            first_num_fields, &firstline);
+
+      check_lines += lines;
+      check_file = i;
+      check_file_line = lines + header_skipped;
+      check_fields = last_num_fields;
+      line_record_swap (&check_lastline, &lastline);
+    }
 
-      /* Add key to the key buffer */
-      if (next_key_pos + len + 1 > keys_buffer_alloc)
-        {
-          /* Guard against really long keys. */
-          if (len + 1 > keys_buffer_alloc)
-            keys_buffer_alloc = len + 1;
-
-          keys_buffer = xmalloc ( keys_buffer_alloc ) ;
-          next_key_pos = 0;
-
-          /* Add new key-buffer to the list */
-          if (buffer_list_size == buffer_list_alloc)
-             buffer_list = x2nrealloc (buffer_list,
-                                       &buffer_list_alloc, sizeof (char*));
-          buffer_list[buffer_list_size++] = keys_buffer;
-        }
-      char *next_key = keys_buffer+next_key_pos;
-      memcpy (next_key, str, len);
-      next_key[len] = 0;
+  line_record_free (&firstline);
+  line_record_free (&lastline);
+}
 
-      /* Add key to buffer (if not found) */
-      const int i = hash_insert_if_absent (ht, next_key, NULL);
-      if ( i == -1 )
-        die (EXIT_FAILURE, errno, _("hash memory allocation error"));
+/* Prints the output header of the first file which has one,
+   and skips the others */
+static void
+collect_header (FILE *out, FILE *state)
+{
+  static bool header_printed = false;
+  off_t header_len;
 
-      if ( i == 1 )
-        {
-          /* This string was not found in the hash - new key */
-          next_key_pos += len+1;
-          const size_t num_fields = line_record_num_fields (thisline);
-          for (size_t i = 1 ; i <= num_fields ; ++i) {
-            if (i>1)
-              print_field_separator ();
+  if (fread (&header_len, sizeof header_len, 1, state) != 1)
+    die (EXIT_FAILURE, 0, _("read error"));
 
-            const char *str;
-            size_t len;
-            if (line_record_get_field (thisline, i, &str, &len))
-              {
-                ignore_value (fwrite (str, len, sizeof (char), stdout));
-              }
-          }
-          print_line_separator ();
-        }
+  if (header_printed)
+    {
+      if (fseeko (out, header_len, SEEK_SET) != 0)
+        die (EXIT_FAILURE, errno, _("read error"));
+    }
+  else if (header_len > 0)
+    {
+      copy_output (out, header_len);
+      header_printed = true;
     }
-  line_record_free (&lr);
-  hash_free (ht);
-  for (size_t i = 0 ; i < buffer_list_size; ++i)
-    free (buffer_list[i]);
-  free (buffer_list);
 }
 
-
 static void
-open_input ()
+collect_groups (FILE *out, FILE *state)
 {
-  if (pipe_through_sort && dm->num_grps>0)
-    {
-      char delim[2] = { 0, 0 };
-      char **args = xcalloc (dm->num_grps + 8, sizeof (char *));
-      int argc = 0;
+  collect_header (out, state);
 
-      if (input_header)
-        {
-          /* Set no-buffering, to ensure only the first line is consumed */
-          setbuf (stdin,NULL);
-          /* Read the header line from STDIN, and pass the rest of it to
-             the 'sort' child-process */
-          process_input_header (stdin);
-        }
+  /* The first group might continue the last group of the previous file */
+  if (load_line (&merge_group_line, state))
+    merge_group_state (&merge_group_line, state);
 
-#ifdef SORT_WITHOUT_LOCALE
-      args[argc++] = "LC_ALL=C";
-#endif
-      args[argc++] = (char *)sort_cmd;
-#ifdef HAVE_STABLE_SORT
-      /* stable sort (-s) is needed to support first/last operations
-         (prevent sort from re-ordering lines which are not part of the group.
-         '-s' is not standard POSIX, but very commonly supported, including
-         on GNU coreutils, Busybox, FreeBSD, MacOSX */
-      args[argc++] = "-s";
-#endif
+  /* If there's a last group, the first group is complete, and the groups
+     between them were printed by the worker */
+  if (load_line (&merge_group_line, state))
+    {
+      flush_pending_group ();
+      copy_output (out, -1);
+      merge_group_state (&merge_group_line, state);
+    }
+}
 
-      if (eolchar == '\0')
-        {
-#ifdef HAVE_ZERO_SORT
-          /* sort needs to understand -z to properly sort input using
-             NUL as the line delimiter */
-          args[argc++] = "-z";
-#else
-          die (EXIT_FAILURE, 0,
-                 _("-s and -z cannot be combined on this system"));
-#endif
-        }
-      if (!case_sensitive)
-        {
-          args[argc++] = "-f";
-        }
+/* Combines the results of input file I, in the main process */
+static void
+parallel_collect (size_t i, FILE *out, FILE *state)
+{
+  switch (dm->mode)                              /* LCOV_EXCL_BR_LINE */
+    {
+    case MODE_GROUPBY:
+      collect_groups (out, state);
+      break;
 
-      if (in_tab != TAB_WHITESPACE)
-        {
-          args[argc++] = "-t";
-          delim[0] = in_tab;
-          args[argc++] = delim;
-        }
+    case MODE_TABULAR_CHECK:
+      collect_check (i, state);
+      break;
 
-      int sort_spec = argc;
-      for (size_t i = 0; i < dm->num_grps; ++i)
-        {
-          char tmp[INT_BUFSIZE_BOUND (size_t) * 2 + 5];
-          const size_t col_num = dm->grps[i].num;
-          snprintf (tmp,sizeof (tmp),"-k%"PRIuMAX",%"PRIuMAX,
-                    (uintmax_t)col_num,(uintmax_t)col_num);
-          args[argc++] = xstrdup (tmp);
-        }
+    case MODE_PER_LINE:
+      collect_header (out, state);
+      copy_output (out, -1);
+      break;
 
-      char *cmd = shell_quote_argv ((const char * const *) args);
-      while (sort_spec < argc)
-        {
-          free (args[sort_spec++]);
-        }
-      free (args);
-      input_stream = popen (cmd,"r");
-      free (cmd);
-      if (input_stream == NULL)
-        die (EXIT_FAILURE, 0, _("failed to run 'sort': popen failed"));
-    }
-  else
-    {
-      /* without grouping, there's no need to sort */
-      input_stream = stdin;
-      pipe_through_sort = false;
+    case MODE_NOOP:
+    case MODE_TRANSPOSE:
+    case MODE_REVERSE:
+    case MODE_REMOVE_DUPS:
+    case MODE_CROSSTAB:
+    case MODE_INVALID:
+    default:
+      copy_output (out, -1);
+      break;
     }
 }
 
+/*
+   Processes each input file in a worker process (up to 'parallel_jobs'
+   at a time), and combines their results in the order of the files.
+ */
 static void
-close_input ()
+process_files_in_parallel ()
 {
-  int i;
+  /* Named columns are needed to compare the groups of different files */
+  if (input_header && dm->header_required)
+    {
+      struct line_input header_input;
+      line_input_open_files (&header_input, input_files, 1, false);
+      process_input_header (&header_input);
+      line_input_free (&header_input);
+    }
 
-  if (ferror (input_stream))
-    die (EXIT_FAILURE, errno, _("read error"));
+  line_record_init (&pending_group_line);
+  line_record_init (&merge_group_line);
+  line_record_init (&check_lastline);
 
-  if (pipe_through_sort)
-    i = pclose (input_stream);
-  else
-    i = fclose (input_stream);
+  run_workers (num_input_files, parallel_jobs, parallel_task,
+               parallel_collect);
 
-  if (i != 0)
-    die (EXIT_FAILURE, errno, _("read error (on close)"));
+  if (dm->mode == MODE_GROUPBY)
+    flush_pending_group ();
+  else if (dm->mode == MODE_TABULAR_CHECK)
+    check_summary (check_lines, check_fields);
+
+  line_record_free (&pending_group_line);
+  line_record_free (&merge_group_line);
+  line_record_free (&check_lastline);
 }
 
 int main (int argc, char* argv[])
@@ -1257,14 +2869,20 @@ int main (int argc, char* argv[])
   const char* premode_group_spec = NULL;
   bool force_seed = false;
   unsigned long int seed = 0;
+  const char **op_args = xnmalloc (argc, sizeof (char *));
+  int num_op_args = 0;
+  const char *files_from = NULL;
+  struct Tokens tok;
 
   DECL_LONG_DOUBLE_ROUNDING
   BEGIN_LONG_DOUBLE_ROUNDING ();
 
-  openbsd_pledge ();
-
   set_program_name (argv[0]);
 
+  /* wpath and cpath: the sort, hash and --parallel temporary files are
+     created (and removed) in TMPDIR */
+  openbsd_pledge ("stdio proc exec rpath wpath cpath");
+
 #ifdef FORCE_C_LOCALE
   /* Used on mingw/windows system */
   setlocale (LC_ALL, "C");
@@ -1275,14 +2893,21 @@ int main (int argc, char* argv[])
   textdomain (PACKAGE);
 
   init_blank_table ();
+  init_text_numbers ();
 
   atexit (close_stdout);
+  init_text_output ();
 
   while ((optc = getopt_long (argc, argv, short_options, long_options, NULL))
          != -1)
     {
       switch (optc)
         {
+        /* An operation (non-option argument) */
+        case 1:
+          op_args[num_op_args++] = optarg;
+          break;
+
         /* --skip-comments */
         case 'C':
           skip_comments = true;
@@ -1349,6 +2974,11 @@ int main (int argc, char* argv[])
           pipe_through_sort = true;
           break;
 
+        /* --hash-group */
+        case HASH_GROUP_OPTION:
+          hash_groups = true;
+          break;
+
         /* --seed */
         case 'S':
           force_seed = true;
@@ -1382,6 +3012,12 @@ int main (int argc, char* argv[])
             die (EXIT_FAILURE, 0,
                    _("the delimiter must be a single character"));
           in_tab = out_tab = optarg[0];
+          explicit_field_separator = true;
+          break;
+
+        /* --csv */
+        case CSV_OPTION:
+          csv_input = true;
           break;
 
         /* --output-delimiter */
@@ -1403,6 +3039,97 @@ int main (int argc, char* argv[])
           sort_cmd = xstrdup (optarg);
           break;
 
+        /* --sort-buffer-size */
+        case SORT_BUFFER_SIZE_OPTION:
+          if (!parse_buffer_size (optarg, &sort_buffer_size))
+            die (EXIT_FAILURE, 0, _("invalid sort buffer size: %s"),
+                 quote (optarg));
+          break;
+
+        /* --hash-buffer-size */
+        case HASH_BUFFER_SIZE_OPTION:
+          if (!parse_buffer_size (optarg, &hash_buffer_size))
+            die (EXIT_FAILURE, 0, _("invalid hash buffer size: %s"),
+                 quote (optarg));
+          break;
+
+        /* --files0-from */
+        case FILES0_FROM_OPTION:
+          files_from = optarg;
+          break;
+
+        /* --parallel */
+        case PARALLEL_OPTION:
+          {
+            uintmax_t n;
+            if (xstrtoumax (optarg, NULL, 10, &n, "") != LONGINT_OK
+                || n == 0 || n > SIZE_MAX)
+              die (EXIT_FAILURE, 0, _("invalid number of parallel jobs: %s"),
+                   quote (optarg));
+            parallel_jobs = n;
+          }
+          break;
+
+        /* --emit-state */
+        case EMIT_STATE_OPTION:
+          emit_state = true;
+          break;
+
+        /* --top */
+        case TOP_OPTION:
+          {
+            uintmax_t n;
+            if (xstrtoumax (optarg, NULL, 10, &n, "") != LONGINT_OK
+                || n == 0 || n > SIZE_MAX)
+              die (EXIT_FAILURE, 0, _("invalid number of groups: %s"),
+                   quote (optarg));
+            top_groups = n;
+          }
+          break;
+
+        /* --by */
+        case BY_OPTION:
+          {
+            uintmax_t n;
+            if (xstrtoumax (optarg, NULL, 10, &n, "") != LONGINT_OK
+                || n == 0 || n > SIZE_MAX)
+              die (EXIT_FAILURE, 0, _("invalid operation number: %s"),
+                   quote (optarg));
+            top_by = n;
+          }
+          break;
+
+        /* --threads */
+        case THREADS_OPTION:
+          {
+            uintmax_t n;
+            if (xstrtoumax (optarg, NULL, 10, &n, "") != LONGINT_OK
+                || n == 0 || n > SIZE_MAX)
+              die (EXIT_FAILURE, 0, _("invalid number of threads: %s"),
+                   quote (optarg));
+            num_threads = n;
+          }
+          break;
+
+        /* --decompress */
+        case DECOMPRESS_OPTION:
+          if (STREQ (optarg, "auto"))
+            input_compression = COMPRESSION_AUTO;
+          else if (STREQ (optarg, "none"))
+            input_compression = COMPRESSION_NONE;
+          else if (STREQ (optarg, "gzip"))
+            input_compression = COMPRESSION_GZIP;
+          else if (STREQ (optarg, "zstd"))
+            input_compression = COMPRESSION_ZSTD;
+          else
+            die (EXIT_FAILURE, 0, _("invalid compression format: %s"),
+                 quote (optarg));
+          if (!compression_supported (input_compression)
+              && input_compression != COMPRESSION_AUTO)
+            die (EXIT_FAILURE, 0, _("%s-compressed input is not supported"),
+                 compression_name (input_compression));
+          break;
+
         /* --collapse-delimiter */
         case'c':
           if (optarg[0] == '\0' || optarg[1] != '\0')
@@ -1426,9 +3153,14 @@ int main (int argc, char* argv[])
           exit (EXIT_SUCCESS);
           break;
 
-        /* ---rmdup-test */
+        /* ---rmdup-test (rmdup's keys table always starts small
+           and grows, so this is kept only for compatibility) */
         case UNDOC_RMDUP_TEST:
-          rmdup_initial_size = 1024;
+          break;
+
+        /* ---no-simd */
+        case UNDOC_NO_SIMD_OPTION:
+          use_simd = false;
           break;
 
         /* --help */
@@ -1442,27 +3174,198 @@ int main (int argc, char* argv[])
         }
     }
 
-  if (argc <= optind)
+  /* The arguments after '--' are the input files - unless no operation
+     was given before it ('datamash -- OP...') */
+  if (num_op_args == 0)
+    {
+      while (optind < argc)
+        op_args[num_op_args++] = argv[optind++];
+    }
+  else if (optind < argc)
+    {
+      input_files = argv + optind;
+      num_input_files = argc - optind;
+    }
+
+  if (files_from)
+    {
+      FILE *stream;
+
+      if (input_files)
+        {
+          error (0, 0, _("extra operand %s"), quoteaf (input_files[0]));
+          fprintf (stderr, "%s\n",
+                   _("file operands cannot be combined with --files0-from"));
+          usage (EXIT_FAILURE);
+        }
+
+      if (STREQ (files_from, "-"))
+        stream = stdin;
+      else
+        {
+          stream = fopen (files_from, "r");
+          if (stream == NULL)
+            die (EXIT_FAILURE, errno, _("cannot open %s for reading"),
+                 quoteaf (files_from));
+        }
+
+      readtokens0_init (&tok);
+      if (!readtokens0 (stream, &tok) || fclose (stream) != 0)
+        die (EXIT_FAILURE, 0, _("cannot read file names from %s"),
+             quoteaf (files_from));
+      if (tok.n_tok == 0)
+        die (EXIT_FAILURE, 0, _("no input from %s"), quoteaf (files_from));
+
+      for (size_t i = 0; i < tok.n_tok; ++i)
+        if (tok.tok[i][0] == '\0')
+          die (EXIT_FAILURE, 0, _("%s:%"PRIuMAX": invalid zero-length "
+                                  "file name"),
+               quotef (files_from), (uintmax_t)(i + 1));
+      input_files = tok.tok;
+      num_input_files = tok.n_tok;
+    }
+
+  if (num_op_args == 0)
     {
       error (0, 0, _("missing operation specifiers"));
       usage (EXIT_FAILURE);
     }
 
   init_random (force_seed, seed);
+  init_text_scan (use_simd);
+
+  if (csv_input)
+    {
+      if (vnlog)
+        die (EXIT_FAILURE, 0, _("--csv and --vnlog cannot be combined"));
+      if (in_tab == TAB_WHITESPACE)
+        die (EXIT_FAILURE, 0, _("--csv and --whitespace cannot be combined"));
+      if (in_tab == '"')
+        die (EXIT_FAILURE, 0,
+             _("the delimiter cannot be a double-quote with --csv"));
+      if (!explicit_field_separator)
+        in_tab = out_tab = ',';
+    }
 
   /* If --output-delimiter=X was used, override any previous output delimiter */
   if (explicit_output_delimiter != -1)
     out_tab = explicit_output_delimiter ;
 
+  /* 'merge-state' reads the operations, and the options needed to read
+     the groups, from the (first) state file */
+  const bool merge_state = (num_op_args >= 1
+                            && STREQ (op_args[0], "merge-state"));
+  struct state_file first_state;
+  if (merge_state && num_op_args > 1)
+    {
+      error (0, 0, _("extra operand %s"), quoteaf (op_args[1]));
+      fprintf (stderr, "%s\n",
+               _("state files are given after '--'"));
+      usage (EXIT_FAILURE);
+    }
+  if (merge_state)
+    {
+      if (premode != MODE_INVALID)
+        die (EXIT_FAILURE, 0,
+             _("merge-state reads the grouping from the state files"));
+      open_state_file (&first_state, input_files ? input_files[0] : "-");
+      case_sensitive = first_state.format[2];
+      print_full_line = first_state.format[3];
+      csv_input = first_state.format[4];
+      in_tab = first_state.in_tab;
+      if (first_state.group_spec)
+        premode = MODE_GROUPBY;
+      premode_group_spec = first_state.group_spec;
+      free (op_args);
+      op_args = first_state.op_args;
+      num_op_args = first_state.num_op_args;
+    }
+  state_group_spec = premode_group_spec;
+  state_op_args = op_args;
+  state_num_op_args = num_op_args;
+
   /* The rest of the parameters are the operations */
   if (premode == MODE_INVALID)
-    dm = datamash_ops_parse (argc - optind, (const char**)argv+optind);
+    dm = datamash_ops_parse (num_op_args, op_args);
   else
     dm = datamash_ops_parse_premode (premode, premode_group_spec,
-                            argc - optind, (const char**)argv+optind);
+                                     num_op_args, op_args);
+
+  /* The input lines cannot be sorted by computed keys (e.g. 'bin(2)'):
+     with -s, their groups are collected in a hash table and sorted */
+  if (pipe_through_sort)
+    for (size_t i = 0; i < dm->num_grps; ++i)
+      if (dm->grps[i].op)
+        hash_groups = true;
+
+  /* With --hash-group, the input is not sorted: -s sorts the results
+     (other modes still sort the input) */
+  if (hash_groups
+      && (dm->mode == MODE_GROUPBY || dm->mode == MODE_CROSSTAB))
+    {
+      sort_hash_groups = pipe_through_sort;
+      pipe_through_sort = false;
+    }
+  else
+    hash_groups = false;
+
+  if (csv_input && pipe_through_sort && sort_cmd)
+    die (EXIT_FAILURE, 0, _("--csv and --sort-cmd cannot be combined"));
+
+  if (emit_state || merge_state)
+    {
+      if (dm->mode != MODE_GROUPBY)
+        {
+          if (merge_state)
+            invalid_state_file (&first_state);
+          die (EXIT_FAILURE, 0,
+               _("--emit-state can only be used with grouping operations"));
+        }
+      /* The full line printed for a group could come from any file */
+      if (print_full_line && !merge_state)
+        die (EXIT_FAILURE, 0, _("--full cannot be used with --emit-state"));
+      for (size_t i = 0; i < dm->num_ops; ++i)
+        {
+          if (!field_op_mergeable (dm->ops[i].op))
+            die (EXIT_FAILURE, 0,
+                 _("operation %s cannot be used with --emit-state"),
+                 quote (get_field_operation_name (dm->ops[i].op)));
+          if (remove_na_values && dm->ops[i].primary && !merge_state)
+            die (EXIT_FAILURE, 0,
+                 _("operation %s cannot be used with --emit-state "
+                   "and --narm"),
+                 quote (get_field_operation_name (dm->ops[i].op)));
+        }
+    }
+
+  if (top_by && !top_groups)
+    die (EXIT_FAILURE, 0, _("--by requires --top"));
+  if (top_groups)
+    {
+      if (dm->mode != MODE_GROUPBY || emit_state)
+        die (EXIT_FAILURE, 0,
+             _("--top can only be used with grouping operations"));
+
+      /* Find the operation number TOP_BY (hidden operations, used by
+         the operations on pairs of fields, are not counted) */
+      size_t n = 0;
+      if (!top_by)
+        top_by = 1;
+      for (top_op = 0; top_op < dm->num_ops; ++top_op)
+        if (!dm->ops[top_op].subordinate && ++n == top_by)
+          break;
+      if (top_op == dm->num_ops)
+        die (EXIT_FAILURE, 0,
+             _("invalid operation number for --by: %"PRIuMAX),
+             (uintmax_t) top_by);
+      if (dm->ops[top_op].res_type != NUMERIC_RESULT)
+        die (EXIT_FAILURE, 0, _("operation %s cannot be used with --by"),
+             quote (get_field_operation_name (dm->ops[top_op].op)));
+    }
 
-  /* If using named-columns, but no input header - abort */
-  if (dm->header_required && !input_header)
+  /* If using named-columns, but no input header - abort
+     ('merge-state' reads the names from the state file) */
+  if (dm->header_required && !input_header && !merge_state)
     die (EXIT_FAILURE, 0,
            _("-H or --header-in must be used with named columns"));
 
@@ -1494,53 +3397,33 @@ int main (int argc, char* argv[])
              _("vnlog processing always uses '\\n' to terminate output lines"));
     }
 
-  open_input ();
-  switch (dm->mode)                              /* LCOV_EXCL_BR_LINE */
-    {
-    case MODE_PER_LINE:
-      line_mode = true;
-      /* fall through */
-    case MODE_GROUPBY:
-      process_file ();
-      break;
-
-    case MODE_NOOP:
-      noop_file ();
-      break;
-
-    case MODE_TRANSPOSE:
-      transpose_file ();
-      break;
-
-    case MODE_REVERSE:
-      reverse_fields_in_file ();
-      break;
-
-    case MODE_REMOVE_DUPS:
-      remove_dups_in_file ();
-      break;
-
-    case MODE_CROSSTAB:
-      assert ( dm->num_grps== 2 ); /* LCOV_EXCL_LINE */
-      assert ( dm->num_ops == 1 ); /* LCOV_EXCL_LINE */
-      crosstab_mode = true;
-      crosstab = crosstab_init ();
-      process_file ();
-      crosstab_print (crosstab);
-      crosstab_free (crosstab);
-      break;
+  /* With --emit-state, the header line is printed by 'merge-state' */
+  if (emit_state)
+    output_header = false;
 
-    case MODE_TABULAR_CHECK:
-      tabular_check_file ();
-      break;
+  name_input_files = num_input_files > 1;
 
-    case MODE_INVALID:                           /* LCOV_EXCL_LINE */
-    default:                                     /* LCOV_EXCL_LINE */
-      internal_error ("op mode");                /* LCOV_EXCL_LINE */
+  if (merge_state)
+    merge_state_files (&first_state);
+  else if (num_input_files > 1 && parallel_jobs > 1
+           && parallel_mode_supported ())
+    process_files_in_parallel ();
+  else
+    {
+      open_input ();
+      process_input ();
+      close_input ();
     }
+  if (top_groups)
+    print_top_groups ();
   free_column_headers ();
-  close_input ();
   datamash_ops_free (dm);
+  if (merge_state)
+    free_state_file (&first_state);
+  else
+    free (op_args);
+  if (files_from)
+    readtokens0_free (&tok);
 
   END_LONG_DOUBLE_ROUNDING ();
 
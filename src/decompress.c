@@ -0,0 +1,422 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+#if HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "system.h"
+#ifndef MIN
+#include "minmax.h"
+#endif
+#include "die.h"
+#include "safe-read.h"
+#include "xalloc.h"
+
+#include "decompress.h"
+
+enum compression input_compression = COMPRESSION_AUTO;
+
+/* Size of the compressed input buffer */
+enum { DECOMPRESS_INPUT_SIZE = 128 * 1024 };
+
+/* Number and size of the buffers in the ring of decompressed data */
+enum { DECOMPRESS_SLOTS = 4 };
+enum { DECOMPRESS_SLOT_SIZE = 256 * 1024 };
+
+struct decompress_slot
+{
+  char *data;
+  size_t len;
+};
+
+struct decompressor
+{
+  enum compression format;
+  int fd;
+
+  /* Compressed input */
+  char *in;
+  size_t in_pos;
+  size_t in_len;
+  bool in_eof;
+
+#if HAVE_ZLIB
+  z_stream zs;
+#endif
+#if HAVE_ZSTD
+  ZSTD_DStream *zds;
+#endif
+
+  /* Set by the decoder (see decompress_block ()) */
+  bool end_of_frame;    /* the last frame (or gzip member) ended */
+  bool done;            /* the end of the compressed data was reached */
+  bool failed;          /* read error, or invalid compressed data */
+  int read_errno;       /* errno of a read error (0 = invalid data) */
+  const char *message;  /* description of invalid data (NULL = truncated) */
+
+  /* Decompressed data, produced by the thread. The consumer reads slot
+     'first' (from 'offset'), the thread fills slot (first + filled). */
+  struct decompress_slot slots[DECOMPRESS_SLOTS];
+  size_t first;
+  size_t filled;
+  size_t offset;
+
+  /* If false, decompressor_read () decompresses the data directly */
+  bool threaded;
+#if HAVE_PTHREAD
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+  bool finished;        /* the thread will not produce more data */
+  bool stop;            /* the consumer asked the thread to stop */
+#endif
+};
+
+enum compression
+compression_detect (const char *buf, size_t len)
+{
+  const unsigned char *p = (const unsigned char *) buf;
+
+  if (len >= 2 && p[0] == 0x1f && p[1] == 0x8b)
+    return COMPRESSION_GZIP;
+  if (len >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f
+      && p[3] == 0xfd)
+    return COMPRESSION_ZSTD;
+  return COMPRESSION_NONE;
+}
+
+const char *
+compression_name (enum compression format)
+{
+  if (format == COMPRESSION_GZIP)
+    return "gzip";
+  if (format == COMPRESSION_ZSTD)
+    return "zstd";
+  return "none";
+}
+
+bool
+compression_supported (enum compression format)
+{
+#if HAVE_ZLIB
+  if (format == COMPRESSION_GZIP)
+    return true;
+#endif
+#if HAVE_ZSTD
+  if (format == COMPRESSION_ZSTD)
+    return true;
+#endif
+  return format == COMPRESSION_NONE;
+}
+
+/* Reads more compressed input, if all of it was consumed */
+static void
+decompress_fill_input (struct decompressor *d)
+{
+  if (d->in_pos < d->in_len || d->in_eof)
+    return;
+
+#if HAVE_PTHREAD
+  /* The thread can be cancelled (by decompressor_free ()) only while
+     waiting for input. */
+  if (d->threaded)
+    pthread_setcancelstate (PTHREAD_CANCEL_ENABLE, NULL);
+#endif
+  const size_t n = safe_read (d->fd, d->in, DECOMPRESS_INPUT_SIZE);
+#if HAVE_PTHREAD
+  if (d->threaded)
+    pthread_setcancelstate (PTHREAD_CANCEL_DISABLE, NULL);
+#endif
+
+  d->in_pos = d->in_len = 0;
+  if (n == SAFE_READ_ERROR)
+    {
+      d->failed = true;
+      d->read_errno = errno;
+    }
+  else if (n == 0)
+    d->in_eof = true;
+  else
+    d->in_len = n;
+}
+
+/* Decompresses up to SIZE bytes into OUT.
+   Returns the number of bytes produced: less than SIZE only at the end
+   of the data, or on failure (see 'done' and 'failed'). */
+static size_t
+decompress_block (struct decompressor *d, char *out, size_t size)
+{
+  size_t n = 0;
+
+  while (n < size && !d->done && !d->failed)
+    {
+      decompress_fill_input (d);
+      if (d->failed)
+        break;
+      if (d->in_pos == d->in_len && d->in_eof && d->end_of_frame)
+        {
+          d->done = true;
+          break;
+        }
+
+      const size_t in_pos = d->in_pos;
+      const size_t out_pos = n;
+
+#if HAVE_ZLIB
+      if (d->format == COMPRESSION_GZIP)
+        {
+          /* Concatenated gzip files (members) are decompressed as
+             one stream, like gzip(1) does. */
+          if (d->end_of_frame)
+            inflateReset (&d->zs);
+
+          d->zs.next_in = (unsigned char *) d->in + d->in_pos;
+          d->zs.avail_in = d->in_len - d->in_pos;
+          d->zs.next_out = (unsigned char *) out + n;
+          d->zs.avail_out = size - n;
+
+          const int rc = inflate (&d->zs, Z_NO_FLUSH);
+          n = size - d->zs.avail_out;
+          d->in_pos = d->in_len - d->zs.avail_in;
+          d->end_of_frame = (rc == Z_STREAM_END);
+
+          if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR)
+            {
+              d->failed = true;
+              d->message = d->zs.msg ? d->zs.msg : "inflate failed";
+              break;
+            }
+        }
+#endif
+#if HAVE_ZSTD
+      if (d->format == COMPRESSION_ZSTD)
+        {
+          ZSTD_inBuffer ib = { d->in, d->in_len, d->in_pos };
+          ZSTD_outBuffer ob = { out, size, n };
+
+          const size_t rc = ZSTD_decompressStream (d->zds, &ob, &ib);
+          n = ob.pos;
+          d->in_pos = ib.pos;
+
+          if (ZSTD_isError (rc))
+            {
+              d->failed = true;
+              d->message = ZSTD_getErrorName (rc);
+              break;
+            }
+          /* Zero: a frame was completely decoded and flushed */
+          d->end_of_frame = (rc == 0);
+        }
+#endif
+
+      /* The data ends in the middle of a frame */
+      if (n == out_pos && d->in_pos == in_pos && d->in_pos == d->in_len
+          && d->in_eof && !d->end_of_frame)
+        d->failed = true;
+    }
+  return n;
+}
+
+#if HAVE_PTHREAD
+static void *
+decompress_thread (void *arg)
+{
+  struct decompressor *d = arg;
+
+  pthread_setcancelstate (PTHREAD_CANCEL_DISABLE, NULL);
+  pthread_mutex_lock (&d->lock);
+  while (!d->finished)
+    {
+      while (d->filled == DECOMPRESS_SLOTS && !d->stop)
+        pthread_cond_wait (&d->not_full, &d->lock);
+      if (d->stop)
+        break;
+
+      struct decompress_slot *s =
+        &d->slots[(d->first + d->filled) % DECOMPRESS_SLOTS];
+      pthread_mutex_unlock (&d->lock);
+
+      s->len = decompress_block (d, s->data, DECOMPRESS_SLOT_SIZE);
+
+      pthread_mutex_lock (&d->lock);
+      if (s->len)
+        ++d->filled;
+      if (d->done || d->failed)
+        d->finished = true;
+      pthread_cond_signal (&d->not_empty);
+    }
+  pthread_mutex_unlock (&d->lock);
+  return NULL;
+}
+#endif
+
+struct decompressor *
+decompressor_start (int fd, enum compression format,
+                    const char *head, size_t head_len)
+{
+  if (!compression_supported (format) || format == COMPRESSION_NONE)
+    die (EXIT_FAILURE, 0, _("%s-compressed input is not supported"),
+         compression_name (format));
+
+  struct decompressor *d = XZALLOC (struct decompressor);
+  d->format = format;
+  d->fd = fd;
+  d->in = xmalloc (MAX (DECOMPRESS_INPUT_SIZE, head_len));
+  if (head_len)
+    memcpy (d->in, head, head_len);
+  d->in_len = head_len;
+
+#if HAVE_ZLIB
+  if (format == COMPRESSION_GZIP)
+    {
+      /* 16 + MAX_WBITS: decode gzip headers (not raw zlib data) */
+      if (inflateInit2 (&d->zs, 16 + MAX_WBITS) != Z_OK)
+        xalloc_die ();
+    }
+#endif
+#if HAVE_ZSTD
+  if (format == COMPRESSION_ZSTD)
+    {
+      d->zds = ZSTD_createDStream ();
+      if (d->zds == NULL || ZSTD_isError (ZSTD_initDStream (d->zds)))
+        xalloc_die ();
+    }
+#endif
+
+  for (size_t i = 0; i < DECOMPRESS_SLOTS; ++i)
+    d->slots[i].data = xmalloc (DECOMPRESS_SLOT_SIZE);
+
+#if HAVE_PTHREAD
+  pthread_mutex_init (&d->lock, NULL);
+  pthread_cond_init (&d->not_empty, NULL);
+  pthread_cond_init (&d->not_full, NULL);
+  d->threaded = true;
+  /* Without a thread, the data is decompressed when it is read. */
+  if (pthread_create (&d->thread, NULL, decompress_thread, d) != 0)
+    d->threaded = false;
+#endif
+  return d;
+}
+
+/* Reports the failure of the decoder (if any) */
+static void
+decompressor_check (const struct decompressor *d)
+{
+  if (!d->failed)
+    return;
+  if (d->read_errno)
+    die (EXIT_FAILURE, d->read_errno, _("read error"));
+  die (EXIT_FAILURE, 0, _("invalid %s-compressed input: %s"),
+       compression_name (d->format),
+       d->message ? d->message : _("unexpected end of input"));
+}
+
+size_t
+decompressor_read (struct decompressor *d, char *buf, size_t size)
+{
+  if (!d->threaded)
+    {
+      const size_t n = decompress_block (d, buf, size);
+      if (n == 0)
+        decompressor_check (d);
+      return n;
+    }
+
+#if HAVE_PTHREAD
+  pthread_mutex_lock (&d->lock);
+  while (d->filled == 0 && !d->finished)
+    pthread_cond_wait (&d->not_empty, &d->lock);
+  const bool empty = (d->filled == 0);
+  pthread_mutex_unlock (&d->lock);
+  if (empty)
+    {
+      decompressor_check (d);
+      return 0;
+    }
+
+  /* The thread never writes to the first filled slot */
+  struct decompress_slot *s = &d->slots[d->first];
+  const size_t n = MIN (size, s->len - d->offset);
+  memcpy (buf, s->data + d->offset, n);
+  d->offset += n;
+
+  if (d->offset == s->len)
+    {
+      pthread_mutex_lock (&d->lock);
+      d->first = (d->first + 1) % DECOMPRESS_SLOTS;
+      --d->filled;
+      d->offset = 0;
+      pthread_cond_signal (&d->not_full);
+      pthread_mutex_unlock (&d->lock);
+    }
+  return n;
+#else
+  return 0;
+#endif
+}
+
+void
+decompressor_free (struct decompressor *d)
+{
+#if HAVE_PTHREAD
+  if (d->threaded)
+    {
+      pthread_mutex_lock (&d->lock);
+      d->stop = true;
+      pthread_cond_signal (&d->not_full);
+      pthread_mutex_unlock (&d->lock);
+      /* The thread might be blocked reading more input */
+      pthread_cancel (d->thread);
+      pthread_join (d->thread, NULL);
+    }
+  pthread_cond_destroy (&d->not_full);
+  pthread_cond_destroy (&d->not_empty);
+  pthread_mutex_destroy (&d->lock);
+#endif
+
+#if HAVE_ZLIB
+  if (d->format == COMPRESSION_GZIP)
+    inflateEnd (&d->zs);
+#endif
+#if HAVE_ZSTD
+  if (d->format == COMPRESSION_ZSTD)
+    ZSTD_freeDStream (d->zds);
+#endif
+
+  for (size_t i = 0; i < DECOMPRESS_SLOTS; ++i)
+    free (d->slots[i].data);
+  free (d->in);
+  free (d);
+}
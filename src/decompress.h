@@ -0,0 +1,74 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Decompression of gzip (and zstd) input, on a separate thread which
+   fills a ring of buffers while the lines of the previous buffers
+   are being processed. */
+#ifndef __DECOMPRESS_H__
+#define __DECOMPRESS_H__
+
+enum compression
+{
+  COMPRESSION_AUTO = 0, /* detect the format from the first bytes */
+  COMPRESSION_NONE,
+  COMPRESSION_GZIP,
+  COMPRESSION_ZSTD
+};
+
+/* Format of the input (--decompress). Defaults to COMPRESSION_AUTO. */
+extern enum compression input_compression;
+
+/* Number of leading bytes examined by compression_detect () */
+enum { COMPRESSION_MAGIC_LEN = 4 };
+
+/* Returns the format of the data beginning with the LEN bytes at BUF
+   (COMPRESSION_NONE if it is not compressed). */
+enum compression
+compression_detect (const char *buf, size_t len);
+
+/* Returns the name of FORMAT (e.g. "gzip") */
+const char *
+compression_name (enum compression format);
+
+/* Returns true if FORMAT can be decompressed by this build */
+bool
+compression_supported (enum compression format);
+
+struct decompressor;
+
+/* Starts decompressing FORMAT data read from FD.
+   The first HEAD_LEN bytes of the data, which were already read
+   from FD, are at HEAD. Fails if FORMAT is not supported. */
+struct decompressor *
+decompressor_start (int fd, enum compression format,
+                    const char *head, size_t head_len);
+
+/* Copies up to SIZE bytes of decompressed data to BUF.
+   Returns the number of bytes copied (0 at the end of the data).
+   Fails on read errors and invalid (or truncated) compressed data. */
+size_t
+decompressor_read (struct decompressor *d, char *buf, size_t size);
+
+/* Stops the decompression (even if not all data was read), and
+   releases D. */
+void
+decompressor_free (struct decompressor *d);
+
+#endif
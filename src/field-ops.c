@@ -48,8 +48,12 @@
 #include "hashcode-mem.h"
 
 #include "utils.h"
+#include "tdigest.h"
+#include "hyperloglog.h"
+#include "key-intern.h"
 #include "text-options.h"
 #include "text-lines.h"
+#include "text-numbers.h"
 #include "column-headers.h"
 #include "op-defs.h"
 #include "field-ops.h"
@@ -97,29 +101,29 @@ struct operation_data operations[] =
   /* OP_PERCENTILE */
   {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_PSTDEV */
-  {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
+  {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_SSTDEV */
-  {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
+  {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_PVARIANCE */
-  {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
+  {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_SVARIANCE */
-  {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
+  {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_MAD */
   {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_MADRAW */
   {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_S_SKEWNESS */
-  {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
+  {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_P_SKEWNESS */
-  {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
+  {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_S_EXCESS_KURTOSIS */
-  {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
+  {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_P_EXCESS_KURTOSIS */
-  {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
+  {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_JARQUE_BETA */
-  {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
+  {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_DP_OMNIBUS */
-  {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
+  {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_MODE */
   {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_ANTIMODE */
@@ -147,15 +151,15 @@ struct operation_data operations[] =
   /* OP_SHA512 */
   {STRING_SCALAR, IGNORE_FIRST, STRING_RESULT},
   /* OP_P_COVARIANCE */
-  {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
+  {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_S_COVARIANCE */
-  {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
+  {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_P_PEARSON_COR */
-  {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
+  {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_S_PEARSON_COR */
-  {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
+  {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_DOT_PRODUCT */
-  {NUMERIC_VECTOR, IGNORE_FIRST, NUMERIC_RESULT},
+  {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_BIN_BUCKETS */
   {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_STRBIN */
@@ -186,27 +190,58 @@ struct operation_data operations[] =
   {STRING_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   /* OP_CUT */
   {STRING_SCALAR, IGNORE_FIRST, STRING_RESULT},
+  /* OP_APPROX_PERCENTILE */
+  {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
+  /* OP_APPROX_MEDIAN */
+  {NUMERIC_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
+  /* OP_APPROX_COUNT_UNIQUE */
+  {STRING_SCALAR, IGNORE_FIRST, NUMERIC_RESULT},
   {0, 0, NUMERIC_RESULT}
 };
 
 //struct fieldop* field_ops = NULL;
 
-enum { VALUES_BATCH_INCREMENT = 1024 };
+/* Buffers start small and grow geometrically: with --hash-group,
+   each group has its own buffers.
+   The string buffer always has room for one more byte
+   (see OP_DIRNAME). */
 
 /* Add a numeric value to the values vector, allocating memory as needed */
 static void
 field_op_add_value (struct fieldop *op, long double val)
 {
   if (op->num_values >= op->alloc_values)
-    {
-      op->alloc_values += VALUES_BATCH_INCREMENT;
-      op->values = xnrealloc (op->values, op->alloc_values,
-                              sizeof (long double));
-    }
+    op->values = x2nrealloc (op->values, &op->alloc_values,
+                             sizeof (long double));
   op->values[op->num_values] = val;
   op->num_values++;
 }
 
+/* Adds the pairs of values of this (primary) fieldop and its subordinate
+   fieldop which are both collected to the accumulated result: the n-th
+   value of one field is paired with the n-th value of the other.
+   The values wait in the values vector until the other field has a value
+   (which happens only when --narm removes some values). */
+static void
+field_op_pair_values (struct fieldop *op)
+{
+  struct fieldop *sub = op->subordinate_op;
+  while (op->num_paired < op->num_values && sub->num_paired < sub->num_values)
+    {
+      const long double x = op->values[op->num_paired++];
+      const long double y = sub->values[sub->num_paired++];
+      if (op->op == OP_DOT_PRODUCT)
+        op->value += x * y;
+      else
+        moments_add_pair (&op->moments, x, y);
+    }
+
+  if (op->num_paired == op->num_values)
+    op->num_paired = op->num_values = 0;
+  if (sub->num_paired == sub->num_values)
+    sub->num_paired = sub->num_values = 0;
+}
+
 static void
 field_op_reserve_out_buf (struct fieldop *op, const size_t minsize)
 {
@@ -247,7 +282,8 @@ field_op_add_string (struct fieldop *op, const char* str, size_t slen)
 {
   if (op->str_buf_used + slen+1 >= op->str_buf_alloc)
     {
-      op->str_buf_alloc += MAX (VALUES_BATCH_INCREMENT,slen+1);
+      op->str_buf_alloc = MAX (op->str_buf_alloc * 2,
+                               op->str_buf_used + slen + 2);
       op->str_buf = xrealloc (op->str_buf, op->str_buf_alloc);
     }
 
@@ -264,7 +300,7 @@ field_op_replace_string (struct fieldop *op, const char* str, size_t slen)
 {
   if (slen+1 >= op->str_buf_alloc)
     {
-      op->str_buf_alloc += MAX (VALUES_BATCH_INCREMENT,slen+1);
+      op->str_buf_alloc = MAX (op->str_buf_alloc * 2, slen + 2);
       op->str_buf = xrealloc (op->str_buf, op->str_buf_alloc);
     }
 
@@ -274,24 +310,115 @@ field_op_replace_string (struct fieldop *op, const char* str, size_t slen)
   op->str_buf_used = slen + 1 ;
 }
 
+/* Returns the hash value of the string STR (of SLEN bytes), ignoring
+   the letter case (as countunique does) unless case_sensitive */
+static uint64_t
+field_op_string_hash (struct fieldop *op, const char *str, size_t slen)
+{
+  if (case_sensitive)
+    return key_intern_hash64 (str, slen);
+
+  /* The output buffer is only used as a scratch buffer
+     until the operation is summarized */
+  field_op_reserve_out_buf (op, slen + 1);
+  for (size_t i = 0; i < slen; ++i)
+    op->out_buf[i] = tolower (to_uchar (str[i]));
+  return key_intern_hash64 (op->out_buf, slen);
+}
+
+/* Initial number of slots of the hash set of distinct strings
+   (a power of two).  The set is kept at most half full. */
+enum { STR_SET_SLOTS = 4 };
+
+/* Stores POS (the position of a string with the hash value HASH)
+   in the first free slot of the set */
+static void
+str_set_insert (struct fieldop *op, size_t hash, size_t pos)
+{
+  size_t i = hash & op->str_set_mask;
+  while (op->str_set[i].pos1)
+    i = (i + 1) & op->str_set_mask;
+  op->str_set[i].hash = hash;
+  op->str_set[i].pos1 = pos + 1;
+}
+
+/* Doubles the number of slots of the set */
+static void
+str_set_grow (struct fieldop *op)
+{
+  const size_t n = op->str_set_mask + 1;
+  struct str_set_slot *old = op->str_set;
+
+  op->str_set = XCALLOC (2 * n, struct str_set_slot);
+  op->str_set_mask = 2 * n - 1;
+  for (size_t i = 0; i < n; ++i)
+    if (old[i].pos1)
+      str_set_insert (op, old[i].hash, old[i].pos1 - 1);
+  free (old);
+}
+
+/* Returns true if the string at POS in the string buffer equals
+   the SLEN bytes at STR (which contain no NUL), ignoring the letter
+   case unless case_sensitive */
+static bool
+str_set_equal (const struct fieldop *op, size_t pos,
+               const char *str, size_t slen)
+{
+  /* The comparison stops at the end of a shorter string */
+  const char *s = op->str_buf + pos;
+  return (case_sensitive ? strncmp (s, str, slen)
+                         : strncasecmp (s, str, slen)) == 0
+         && s[slen] == '\0';
+}
+
+/* Adds a string to the strings vector, unless it was already added
+   (ignoring the letter case unless case_sensitive): the memory used
+   is proportional to the number of distinct strings */
+static void
+field_op_add_distinct_string (struct fieldop *op, const char *str,
+                              size_t slen)
+{
+  /* The strings are compared (and sorted) up to their first NUL */
+  slen = strnlen (str, slen);
+  const size_t hash = field_op_string_hash (op, str, slen);
+
+  if (!op->str_set)
+    {
+      op->str_set = XCALLOC (STR_SET_SLOTS, struct str_set_slot);
+      op->str_set_mask = STR_SET_SLOTS - 1;
+    }
+
+  for (size_t i = hash & op->str_set_mask; op->str_set[i].pos1;
+       i = (i + 1) & op->str_set_mask)
+    if (op->str_set[i].hash == hash
+        && str_set_equal (op, op->str_set[i].pos1 - 1, str, slen))
+      return;
+
+  if (op->num_strs + 1 > (op->str_set_mask + 1) / 2)
+    str_set_grow (op);
+  str_set_insert (op, hash, op->str_buf_used);
+  op->num_strs++;
+  field_op_add_string (op, str, slen);
+}
+
 /* Returns an array of string-pointers (char*),
    each pointing to a string in the string buffer
-   (added by field_op_add_string () ).
+   (added by field_op_add_distinct_string () ).
 
    The returned pointer must be free'd.
 
-   The returned pointer will have 'op->count+1' elements,
-   pointing to 'op->count' strings + one last NULL.
+   The returned pointer will have 'op->num_strs+1' elements,
+   pointing to 'op->num_strs' strings + one last NULL.
 */
 static const char **
 field_op_get_string_ptrs ( struct fieldop *op, bool sort,
                            bool sort_case_sensitive )
 {
-  const char **ptrs = xnmalloc (op->count+1, sizeof (char*));
+  const char **ptrs = xnmalloc (op->num_strs+1, sizeof (char*));
   char *p = op->str_buf;
   const char* pend = op->str_buf + op->str_buf_used;
   size_t idx=0;
-  while (p < pend && idx < op->count)
+  while (p < pend && idx < op->num_strs)
     {
       ptrs[idx++] = p;
       while ( p<pend && *p != '\0' )
@@ -303,7 +430,7 @@ field_op_get_string_ptrs ( struct fieldop *op, bool sort,
   if (sort)
     {
       /* Sort the string pointers */
-      qsort ( ptrs, op->count, sizeof (char*), sort_case_sensitive
+      qsort ( ptrs, op->num_strs, sizeof (char*), sort_case_sensitive
                                             ?cmpstringp
                                             :cmpstringp_nocase);
     }
@@ -317,6 +444,15 @@ field_op_sort_values (struct fieldop *op)
   qsortfl (op->values, op->num_values);
 }
 
+/* Moves the values needed for the quantile Q1 (and Q2, if it is not
+   negative) to their sorted positions, without sorting all the values */
+static void
+field_op_select_quantiles (struct fieldop *op, double q1, double q2)
+{
+  const double quantiles[2] = { q1, q2 };
+  select_quantiles (op->values, op->num_values, quantiles, (q2 < 0) ? 1 : 2);
+}
+
 void
 field_op_init (struct fieldop* /*out*/ op,
                enum field_operation oper,
@@ -345,14 +481,38 @@ field_op_init (struct fieldop* /*out*/ op,
     }
 }
 
-/* Ensure this (primary) fieldop has the same number of values as
+void
+field_op_clone (struct fieldop* /*out*/ copy, const struct fieldop *op)
+{
+  assert (copy != NULL && op != NULL); /* LCOV_EXCL_LINE */
+  assert (!op->field_by_name);         /* LCOV_EXCL_LINE */
+
+  *copy = *op;
+  copy->field_name = NULL;
+  copy->subordinate_op = NULL;
+
+  /* Buffers are allocated when values are collected */
+  copy->values = NULL;
+  copy->alloc_values = 0;
+  copy->str_buf = NULL;
+  copy->str_buf_alloc = 0;
+  copy->str_set = NULL;
+  copy->out_buf = NULL;
+  copy->out_buf_alloc = 0;
+  copy->digest = NULL;
+  copy->hll = NULL;
+
+  field_op_reset (copy);
+}
+
+/* Ensure this (primary) fieldop has collected the same number of values
    as it's subordinate fieldop. */
 static void
-verify_subordinate_num_values (const struct fieldop *op)
+verify_subordinate_count (const struct fieldop *op)
 {
   assert (op && !op->subordinate && op->subordinate_op);    /* LCOV_EXCL_LINE */
 
-  if (op->num_values != op->subordinate_op->num_values)
+  if (op->count != op->subordinate_op->count)
     die (EXIT_FAILURE, 0, _("input error for operation %s: \
 fields %"PRIuMAX",%"PRIuMAX" have different number of items"),
                             quote (get_field_operation_name (op->op)),
@@ -360,55 +520,78 @@ fields %"PRIuMAX",%"PRIuMAX" have different number of items"),
                             (uintmax_t)op->field);
 }
 
+/* Returns the result of the per-line numeric operation OP
+   (e.g. 'bin', 'round') on the field STR,
+   whose numeric value (if OP is numeric) is NUM_VALUE */
+static long double
+line_op_value (const struct fieldop *op, const char *str, size_t slen,
+               long double num_value)
+{
+  long double value = 0;
+
+  if (op->op == OP_BIN_BUCKETS)
+    {
+      const long double val = num_value / op->params.bin_bucket_size;
+      const long double frac = modfl (val, &value);
+      /* Buckets should follow this pattern:
+         ..., [-3x,-2x), [-2x,-x), [-x,0), [0,x), [x,2x), [2x,3x), ... */
+      if (signbit (value))
+        {
+          if (is_zero (frac))
+              value = pos_zero (value);
+          else
+              --value;
+        }
+      value *= op->params.bin_bucket_size;
+    }
+  else if (op->op == OP_STRBIN)
+    value = hash_pjw_bare (str,slen) % (op->params.strbin_bucket_size);
+  else if (op->op == OP_FLOOR)
+    value = pos_zero (floorl (num_value));
+  else if (op->op == OP_CEIL)
+    value = pos_zero (ceill (num_value));
+  else if (op->op == OP_ROUND)
+    value = pos_zero (roundl (num_value));
+  else if (op->op == OP_TRUNCATE)
+    {
+      modfl (num_value, &value);
+      value = pos_zero (value);
+    }
+  else if (op->op == OP_FRACTION)
+    {
+      long double dummy;
+      value = pos_zero (modfl (num_value, &dummy));
+    }
+  else if (op->op == OP_GETNUM)
+    value = extract_number (str, slen, op->params.get_num_type);
+  else
+    internal_error ("bad op");     /* LCOV_EXCL_LINE */
+
+  return value;
+}
+
 /* Add a value (from input) to the current field operation. */
 enum FIELD_OP_COLLECT_RESULT
 field_op_collect (struct fieldop *op,
                   const char* str, size_t slen)
 {
-  char *endptr=NULL;
   long double num_value = 0;
-  char tmpbuf[512];
   enum FIELD_OP_COLLECT_RESULT rc = FLOCR_OK;
 
   assert (str != NULL); /* LCOV_EXCL_LINE */
 
-  if (remove_na_values && is_na (str,slen))
-    return FLOCR_OK_SKIPPED;
-
   if (op->numeric)
     {
-      if (slen == 0)
-        return FLOCR_INVALID_NUMBER;
-#ifndef HAVE_BROKEN_STRTOLD
-      /* Usually, strtold stops at the field delimiter, but not always.
-         Optimistically try to avoid an extra copy, unless the strtold
-         implementation is known to be problematic. */
-      errno = 0;
-      num_value = strtold (str, &endptr);
-      if (errno==ERANGE || endptr==str || endptr<(str+slen))
+      /* N/A values are detected while parsing the number */
+      const enum number_parse_result nr = parse_number (str, slen,
+                                                        &num_value);
+      if (remove_na_values && (nr == NUMBER_NA || nr == NUMBER_NAN))
+        return FLOCR_OK_SKIPPED;
+      if (nr == NUMBER_NA || nr == NUMBER_INVALID)
         return FLOCR_INVALID_NUMBER;
-      /* On Cygwin, strtold doesn't stop at a tab character,
-         and returns invalid value.
-         Generally, strtold doesn't stop on field separators
-         that can be part of long double representations.
-         If strtold continued past the field delimiter, make
-         a copy of the input buffer and NUL-terminate it. */
-      if (endptr > (str+slen))
-        {
-#endif
-          if (slen >= sizeof (tmpbuf))
-            die (EXIT_FAILURE, 0,
-                    "internal error: input field too long (%zu)", slen);
-          memcpy (tmpbuf,str,slen);
-          tmpbuf[slen]=0;
-          errno = 0;
-          num_value = strtold (tmpbuf, &endptr);
-          if (errno==ERANGE || endptr==tmpbuf || endptr!=(tmpbuf+slen))
-            return FLOCR_INVALID_NUMBER;
-#ifndef HAVE_BROKEN_STRTOLD
-        }
-#endif
     }
+  else if (remove_na_values && is_na (str,slen))
+    return FLOCR_OK_SKIPPED;
 
   op->count++;
 
@@ -549,87 +732,77 @@ field_op_collect (struct fieldop *op,
       }
       break;
 
-    case OP_MEDIAN:
-    case OP_QUARTILE_1:
-    case OP_QUARTILE_3:
-    case OP_IQR:
-    case OP_PERCENTILE:
     case OP_PSTDEV:
     case OP_SSTDEV:
     case OP_PVARIANCE:
     case OP_SVARIANCE:
-    case OP_MAD:
-    case OP_MADRAW:
+      moments_add (&op->moments, num_value, 2);
+      break;
+
     case OP_S_SKEWNESS:
     case OP_P_SKEWNESS:
     case OP_S_EXCESS_KURTOSIS:
     case OP_P_EXCESS_KURTOSIS:
     case OP_JARQUE_BERA:
     case OP_DP_OMNIBUS:
-    case OP_MODE:
-    case OP_ANTIMODE:
+      moments_add (&op->moments, num_value, 4);
+      break;
+
     case OP_P_COVARIANCE:
     case OP_S_COVARIANCE:
     case OP_P_PEARSON_COR:
     case OP_S_PEARSON_COR:
     case OP_DOT_PRODUCT:
+      /* The subordinate operation is collected before the primary */
+      field_op_add_value (op, num_value);
+      if (!op->subordinate)
+        field_op_pair_values (op);
+      break;
+
+    case OP_MEDIAN:
+    case OP_QUARTILE_1:
+    case OP_QUARTILE_3:
+    case OP_IQR:
+    case OP_PERCENTILE:
+    case OP_MAD:
+    case OP_MADRAW:
+    case OP_MODE:
+    case OP_ANTIMODE:
     case OP_TRIMMED_MEAN:
       field_op_add_value (op, num_value);
       break;
 
-    case OP_UNIQUE:
+    case OP_APPROX_PERCENTILE:
+    case OP_APPROX_MEDIAN:
+      if (!op->digest)
+        op->digest = tdigest_init (op->params.approx.compression);
+      tdigest_add (op->digest, num_value);
+      break;
+
     case OP_COLLAPSE:
-    case OP_COUNT_UNIQUE:
       field_op_add_string (op, str, slen);
       break;
 
-    case OP_BIN_BUCKETS:
-      {
-        const long double val = num_value / op->params.bin_bucket_size;
-        const long double frac = modfl (val, & op->value);
-        /* Buckets should follow this pattern:
-           ..., [-3x,-2x), [-2x,-x), [-x,0), [0,x), [x,2x), [2x,3x), ... */
-        if (signbit (op->value))
-          {
-            if (is_zero (frac))
-                op->value = pos_zero (op->value);
-            else
-                --op->value;
-          }
-        op->value *= op->params.bin_bucket_size;
-      }
+    case OP_UNIQUE:
+    case OP_COUNT_UNIQUE:
+      field_op_add_distinct_string (op, str, slen);
       break;
 
-    case OP_STRBIN:
-      op->value = hash_pjw_bare (str,slen) % (op->params.strbin_bucket_size);
+    case OP_APPROX_COUNT_UNIQUE:
+      if (!op->hll)
+        op->hll = hll_init (op->params.hll_precision);
+      hll_add (op->hll, field_op_string_hash (op, str, slen));
       break;
 
+    case OP_BIN_BUCKETS:
+    case OP_STRBIN:
     case OP_FLOOR:
-      op->value = pos_zero (floorl (num_value));
-      break;
-
     case OP_CEIL:
-      op->value = pos_zero (ceill (num_value));
-      break;
-
     case OP_ROUND:
-      op->value = pos_zero (roundl (num_value));
-      break;
-
     case OP_TRUNCATE:
-      modfl (num_value, &op->value);
-      op->value = pos_zero (op->value);
-      break;
-
     case OP_FRACTION:
-      {
-        long double dummy;
-        op->value = pos_zero (modfl (num_value, &dummy));
-      };
-      break;
-
     case OP_GETNUM:
-      op->value = extract_number (str, slen, op->params.get_num_type);
+      op->value = line_op_value (op, str, slen, num_value);
       break;
 
     case OP_CUT:
@@ -647,6 +820,32 @@ field_op_collect (struct fieldop *op,
   return rc;
 }
 
+bool _GL_ATTRIBUTE_CONST
+field_op_is_key_transform (enum field_operation op)
+{
+  return op == OP_BIN_BUCKETS || op == OP_STRBIN || op == OP_FLOOR
+         || op == OP_CEIL || op == OP_ROUND || op == OP_TRUNCATE
+         || op == OP_FRACTION || op == OP_GETNUM;
+}
+
+enum FIELD_OP_COLLECT_RESULT
+field_op_transform (const struct fieldop *op, const char *str, size_t slen,
+                    long double *value)
+{
+  long double num_value = 0;
+
+  if (op->numeric)
+    {
+      const enum number_parse_result nr = parse_number (str, slen,
+                                                        &num_value);
+      if (nr == NUMBER_NA || nr == NUMBER_INVALID)
+        return FLOCR_INVALID_NUMBER;
+    }
+
+  *value = line_op_value (op, str, slen, num_value);
+  return FLOCR_OK;
+}
+
 /* Creates the "softmax" values based on op->values.
    Results are stored in op->out_buf.
    We use the 'safe softmax' implementation defined at
@@ -680,8 +879,8 @@ softmax ( struct fieldop *op )
   for (size_t i=0; i< op->num_values; i++)
     {
       memset (_out_buf, 0, numeric_output_bufsize);
-      snprintf (_out_buf, numeric_output_bufsize,
-                numeric_output_format, op->values[i]/denominator);
+      format_number (_out_buf, numeric_output_bufsize,
+                     op->values[i]/denominator);
       strncat (op->out_buf, _out_buf, numeric_output_bufsize);
       if (i != op->num_values - 1)
       {
@@ -690,72 +889,32 @@ softmax ( struct fieldop *op )
     }
 }
 
-/* creates a list of unique strings from op->str_buf .
+/* creates a sorted list of the unique strings of op->str_buf
+   (which are distinct, see field_op_add_distinct_string () ).
    results are stored in op->out_buf. */
 static void
 unique_value ( struct fieldop *op, bool case_sensitive )
 {
-  const char *last_str;
   char *pos;
 
   const char **ptrs = field_op_get_string_ptrs (op, true, case_sensitive);
 
-  /* Uniquify them */
   field_op_reserve_out_buf (op, op->str_buf_used);
   pos = op->out_buf ;
 
   /* Copy the first string */
-  last_str = ptrs[0];
   strcpy (pos, ptrs[0]);
   pos += strlen (ptrs[0]);
 
-  /* Copy the following strings, if they are different from the previous one */
-  for (size_t i = 1; i < op->count; ++i)
-    {
-      const char *newstr = ptrs[i];
-
-      if ((case_sensitive && (!STREQ (newstr, last_str)))
-          || (!case_sensitive && (strcasecmp (newstr, last_str)!=0)))
-        {
-          *pos++ = collapse_separator ;
-          strcpy (pos, newstr);
-          pos += strlen (newstr);
-        }
-      last_str = newstr;
-    }
-
-  free (ptrs);
-}
-
-/* Returns the number of unique string values in the given field operation */
-static size_t
-count_unique_values ( struct fieldop *op, bool case_sensitive )
-{
-  const char *last_str, **cur_str;
-  size_t count = 1 ;
-
-  const char **ptrs = field_op_get_string_ptrs (op, true, case_sensitive);
-
-  /* Copy the first string */
-  cur_str = ptrs;
-  last_str = *cur_str;
-  ++cur_str;
-
-  /* Copy the following strings, if they are different from the previous one */
-  while ( *cur_str != 0 )
+  /* Copy the following strings */
+  for (size_t i = 1; i < op->num_strs; ++i)
     {
-      if ((case_sensitive && (!STREQ (*cur_str, last_str)))
-          || (!case_sensitive && (strcasecmp (*cur_str, last_str)!=0)))
-        {
-          ++count;
-        }
-      last_str = *cur_str;
-      ++cur_str;
+      *pos++ = collapse_separator ;
+      strcpy (pos, ptrs[i]);
+      pos += strlen (ptrs[i]);
     }
 
   free (ptrs);
-
-  return count;
 }
 
 /* Returns a nul-terimated string, composed of all the values
@@ -801,6 +960,8 @@ field_op_summarize_empty (struct fieldop *op)
     case OP_QUARTILE_3:
     case OP_IQR:
     case OP_PERCENTILE:
+    case OP_APPROX_PERCENTILE:
+    case OP_APPROX_MEDIAN:
     case OP_MAD:
     case OP_MADRAW:
     case OP_PSTDEV:
@@ -831,6 +992,7 @@ field_op_summarize_empty (struct fieldop *op)
     case OP_SUM:
     case OP_COUNT:
     case OP_COUNT_UNIQUE:
+    case OP_APPROX_COUNT_UNIQUE:
       numeric_result = 0;
       break;
 
@@ -878,9 +1040,9 @@ field_op_summarize_empty (struct fieldop *op)
 
   if (op->res_type==NUMERIC_RESULT)
     {
+      op->result = numeric_result;
       field_op_reserve_out_buf (op, numeric_output_bufsize);
-      snprintf (op->out_buf, op->out_buf_alloc,
-                numeric_output_format, numeric_result);
+      format_number (op->out_buf, op->out_buf_alloc, numeric_result);
     }
 }
 
@@ -947,38 +1109,44 @@ field_op_summarize (struct fieldop *op)
       break;
 
     case OP_MEDIAN:
-      field_op_sort_values (op);
+      field_op_select_quantiles (op, 0.5, -1);
       numeric_result = median_value ( op->values, op->num_values );
       break;
 
     case OP_QUARTILE_1:
-      field_op_sort_values (op);
+      field_op_select_quantiles (op, 1.0/4.0, -1);
       numeric_result = quartile1_value ( op->values, op->num_values );
       break;
 
     case OP_QUARTILE_3:
-      field_op_sort_values (op);
+      field_op_select_quantiles (op, 3.0/4.0, -1);
       numeric_result = quartile3_value ( op->values, op->num_values );
       break;
 
     case OP_IQR:
-      field_op_sort_values (op);
+      field_op_select_quantiles (op, 1.0/4.0, 3.0/4.0);
       numeric_result = quartile3_value ( op->values, op->num_values )
                        - quartile1_value ( op->values, op->num_values );
       break;
 
     case OP_PERCENTILE:
-      field_op_sort_values (op);
+      field_op_select_quantiles (op, (double) op->params.percentile / 100.0,
+                                 -1);
       numeric_result = percentile_value ( op->values, op->num_values,
                                           op->params.percentile );
       break;
 
+    case OP_APPROX_PERCENTILE:
+    case OP_APPROX_MEDIAN:
+      numeric_result = tdigest_quantile (op->digest,
+                                 (double) op->params.approx.percentile / 100.0);
+      break;
+
     case OP_SOFTMAX:
       softmax (op);
       break;
 
     case OP_TRIMMED_MEAN:
-      field_op_sort_values (op);
       numeric_result = trimmed_mean_value ( op->values, op->num_values,
                                             op->params.trimmed_mean);
       break;
@@ -988,70 +1156,60 @@ field_op_summarize (struct fieldop *op)
       break;
 
     case OP_PSTDEV:
-      numeric_result = stdev_value ( op->values, op->num_values, DF_POPULATION);
+      numeric_result = stdev_value ( &op->moments, DF_POPULATION);
       break;
 
     case OP_SSTDEV:
-      numeric_result = stdev_value ( op->values, op->num_values, DF_SAMPLE);
+      numeric_result = stdev_value ( &op->moments, DF_SAMPLE);
       break;
 
     case OP_PVARIANCE:
-      numeric_result = variance_value ( op->values, op->num_values,
-                                        DF_POPULATION);
+      numeric_result = variance_value ( &op->moments, DF_POPULATION);
       break;
 
     case OP_SVARIANCE:
-      numeric_result = variance_value ( op->values, op->num_values,
-                                        DF_SAMPLE);
+      numeric_result = variance_value ( &op->moments, DF_SAMPLE);
       break;
 
     case OP_MAD:
-      field_op_sort_values (op);
       numeric_result = mad_value ( op->values, op->num_values, 1.4826 );
       break;
 
     case OP_MADRAW:
-      field_op_sort_values (op);
       numeric_result = mad_value ( op->values, op->num_values, 1.0 );
       break;
 
     case OP_S_SKEWNESS:
-      numeric_result = skewness_value ( op->values, op->num_values,
-                                        DF_SAMPLE );
+      numeric_result = skewness_value ( &op->moments, DF_SAMPLE );
       break;
 
     case OP_P_SKEWNESS:
-      numeric_result = skewness_value ( op->values, op->num_values,
-                                        DF_POPULATION );
+      numeric_result = skewness_value ( &op->moments, DF_POPULATION );
       break;
 
     case OP_S_EXCESS_KURTOSIS:
-      numeric_result = excess_kurtosis_value ( op->values, op->num_values,
-                                               DF_SAMPLE );
+      numeric_result = excess_kurtosis_value ( &op->moments, DF_SAMPLE );
       break;
 
     case OP_P_EXCESS_KURTOSIS:
-      numeric_result = excess_kurtosis_value ( op->values, op->num_values,
-                                               DF_POPULATION );
+      numeric_result = excess_kurtosis_value ( &op->moments, DF_POPULATION );
       break;
 
     case OP_JARQUE_BERA:
-      numeric_result = jarque_bera_pvalue ( op->values, op->num_values );
+      numeric_result = jarque_bera_pvalue ( &op->moments );
       break;
 
     case OP_DP_OMNIBUS:
-      numeric_result = dagostino_pearson_omnibus_pvalue ( op->values,
-                                                          op->num_values );
+      numeric_result = dagostino_pearson_omnibus_pvalue ( &op->moments );
       break;
 
     case OP_P_COVARIANCE:
     case OP_S_COVARIANCE:
       assert (!op->subordinate);                       /* LCOV_EXCL_LINE */
       assert (op->subordinate_op);                     /* LCOV_EXCL_LINE */
-      verify_subordinate_num_values (op);
-      numeric_result = covariance_value (op->values,
-                                         op->subordinate_op->values,
-                                         op->num_values,
+      verify_subordinate_count (op);
+      field_op_pair_values (op);
+      numeric_result = covariance_value (&op->moments,
                                          (op->op==OP_P_COVARIANCE)?
                                                 DF_POPULATION:DF_SAMPLE );
       break;
@@ -1060,10 +1218,9 @@ field_op_summarize (struct fieldop *op)
     case OP_S_PEARSON_COR:
       assert (!op->subordinate);                       /* LCOV_EXCL_LINE */
       assert (op->subordinate_op);                     /* LCOV_EXCL_LINE */
-      verify_subordinate_num_values (op);
-      numeric_result = pearson_corr_value (op->values,
-                                           op->subordinate_op->values,
-                                           op->num_values,
+      verify_subordinate_count (op);
+      field_op_pair_values (op);
+      numeric_result = pearson_corr_value (&op->moments,
                                            (op->op==OP_P_PEARSON_COR)?
                                                 DF_POPULATION:DF_SAMPLE);
       break;
@@ -1071,10 +1228,9 @@ field_op_summarize (struct fieldop *op)
     case OP_DOT_PRODUCT:
       assert (!op->subordinate);                       /* LCOV_EXCL_LINE */
       assert (op->subordinate_op);                     /* LCOV_EXCL_LINE */
-      verify_subordinate_num_values (op);
-      numeric_result = dot_product_value (op->values,
-                                          op->subordinate_op->values,
-                                          op->num_values );
+      verify_subordinate_count (op);
+      field_op_pair_values (op);
+      numeric_result = op->value;
       break;
 
     case OP_MODE:
@@ -1093,7 +1249,12 @@ field_op_summarize (struct fieldop *op)
       break;
 
     case OP_COUNT_UNIQUE:
-      numeric_result = count_unique_values (op,case_sensitive);
+      /* The strings are distinct, and need not be sorted */
+      numeric_result = op->num_strs;
+      break;
+
+    case OP_APPROX_COUNT_UNIQUE:
+      numeric_result = roundl (hll_count (op->hll));
       break;
 
     case OP_BASE64:
@@ -1205,9 +1366,9 @@ field_op_summarize (struct fieldop *op)
 
   if (op->res_type==NUMERIC_RESULT)
     {
+      op->result = numeric_result;
       field_op_reserve_out_buf (op, numeric_output_bufsize);
-      snprintf (op->out_buf, op->out_buf_alloc,
-                numeric_output_format, numeric_result);
+      format_number (op->out_buf, op->out_buf_alloc, numeric_result);
     }
 }
 
@@ -1218,10 +1379,27 @@ field_op_reset (struct fieldop *op)
   op->first = true;
   op->count = 0 ;
   op->value = 0;
+  memset (&op->moments, 0, sizeof op->moments);
+  if (op->digest)
+    tdigest_reset (op->digest);
+  if (op->hll)
+    hll_reset (op->hll);
   op->num_values = 0 ;
+  op->num_paired = 0;
   op->str_buf_used = 0;
   op->out_buf_used = 0;
   /* note: op->str_buf and op->str_alloc are not free'd, and reused */
+
+  /* A small set is reused, but clearing a large one for every group
+     would be slower than allocating it again */
+  if (op->str_set && op->str_set_mask + 1 > STR_SET_SLOTS)
+    {
+      free (op->str_set);
+      op->str_set = NULL;
+    }
+  else if (op->str_set)
+    memset (op->str_set, 0, STR_SET_SLOTS * sizeof *op->str_set);
+  op->num_strs = 0;
 }
 
 void
@@ -1236,6 +1414,10 @@ field_op_free (struct fieldop* op)
   op->str_buf_alloc = 0;
   op->str_buf_used = 0;
 
+  free (op->str_set);
+  op->str_set = NULL;
+  op->num_strs = 0;
+
   free (op->out_buf);
   op->out_buf = NULL;
   op->out_buf_alloc = 0;
@@ -1243,6 +1425,358 @@ field_op_free (struct fieldop* op)
 
   free (op->field_name);
   op->field_name = NULL;
+
+  tdigest_free (op->digest);
+  op->digest = NULL;
+
+  hll_free (op->hll);
+  op->hll = NULL;
+}
+
+bool
+field_op_mergeable (enum field_operation op)
+{
+  switch (op)                                    /* LCOV_EXCL_BR_LINE */
+    {
+    case OP_COUNT:
+    case OP_SUM:
+    case OP_MIN:
+    case OP_MAX:
+    case OP_ABSMIN:
+    case OP_ABSMAX:
+    case OP_RANGE:
+    case OP_FIRST:
+    case OP_LAST:
+    case OP_MEAN:
+    case OP_GEOMEAN:
+    case OP_HARMMEAN:
+    case OP_MS:
+    case OP_RMS:
+    case OP_MEDIAN:
+    case OP_QUARTILE_1:
+    case OP_QUARTILE_3:
+    case OP_IQR:
+    case OP_PERCENTILE:
+    case OP_PSTDEV:
+    case OP_SSTDEV:
+    case OP_PVARIANCE:
+    case OP_SVARIANCE:
+    case OP_MAD:
+    case OP_MADRAW:
+    case OP_S_SKEWNESS:
+    case OP_P_SKEWNESS:
+    case OP_S_EXCESS_KURTOSIS:
+    case OP_P_EXCESS_KURTOSIS:
+    case OP_JARQUE_BERA:
+    case OP_DP_OMNIBUS:
+    case OP_MODE:
+    case OP_ANTIMODE:
+    case OP_UNIQUE:
+    case OP_COLLAPSE:
+    case OP_COUNT_UNIQUE:
+    case OP_P_COVARIANCE:
+    case OP_S_COVARIANCE:
+    case OP_P_PEARSON_COR:
+    case OP_S_PEARSON_COR:
+    case OP_DOT_PRODUCT:
+    case OP_TRIMMED_MEAN:
+    case OP_APPROX_PERCENTILE:
+    case OP_APPROX_MEDIAN:
+    case OP_APPROX_COUNT_UNIQUE:
+      return true;
+
+    /* 'rand' keeps a single sample (without the weight needed to
+       combine two samples), 'softmax' and the per-line operations
+       keep only the last value. */
+    case OP_RAND:
+    case OP_BASE64:
+    case OP_DEBASE64:
+    case OP_MD5:
+    case OP_SHA1:
+    case OP_SHA224:
+    case OP_SHA256:
+    case OP_SHA384:
+    case OP_SHA512:
+    case OP_BIN_BUCKETS:
+    case OP_STRBIN:
+    case OP_FLOOR:
+    case OP_CEIL:
+    case OP_ROUND:
+    case OP_TRUNCATE:
+    case OP_FRACTION:
+    case OP_SOFTMAX:
+    case OP_DIRNAME:
+    case OP_BASENAME:
+    case OP_EXTNAME:
+    case OP_BARENAME:
+    case OP_GETNUM:
+    case OP_CUT:
+    case OP_INVALID:
+    default:
+      return false;
+    }
+}
+
+/* Returns true if the collected values of OP are kept in op->moments */
+static bool _GL_ATTRIBUTE_PURE
+field_op_uses_moments (const struct fieldop *op)
+{
+  const enum field_operation o = op->op;
+  return !op->subordinate
+         && (o == OP_PSTDEV || o == OP_SSTDEV
+             || o == OP_PVARIANCE || o == OP_SVARIANCE
+             || o == OP_S_SKEWNESS || o == OP_P_SKEWNESS
+             || o == OP_S_EXCESS_KURTOSIS || o == OP_P_EXCESS_KURTOSIS
+             || o == OP_JARQUE_BERA || o == OP_DP_OMNIBUS
+             || o == OP_P_COVARIANCE || o == OP_S_COVARIANCE
+             || o == OP_P_PEARSON_COR || o == OP_S_PEARSON_COR);
+}
+
+/* Returns true if the collected values of OP are kept in op->digest */
+static bool _GL_ATTRIBUTE_PURE
+field_op_uses_digest (const struct fieldop *op)
+{
+  return op->op == OP_APPROX_PERCENTILE || op->op == OP_APPROX_MEDIAN;
+}
+
+static void
+write_state (const void *ptr, size_t size, FILE *stream)
+{
+  if (size && fwrite (ptr, 1, size, stream) != size)
+    die (EXIT_FAILURE, errno, _("write error"));
+}
+
+static bool
+read_state (void *ptr, size_t size, FILE *stream)
+{
+  return fread (ptr, 1, size, stream) == size;
+}
+
+/* Number of bytes read at once by read_state_bytes () */
+enum { STATE_READ_SIZE = 65536 };
+
+/* Reads SIZE bytes of STREAM into *BUF (of *ALLOC bytes) from position
+   POS, growing *BUF with the bytes read, so that an invalid size fails
+   at the end of STREAM instead of allocating SIZE bytes.
+   Returns false if STREAM ends before. */
+static bool
+read_state_bytes (char **buf, size_t *alloc, size_t pos, size_t size,
+                  FILE *stream)
+{
+  for (size_t done = 0; done < size;)
+    {
+      const size_t n = MIN (size - done, STATE_READ_SIZE);
+      if (pos + done + n > *alloc)
+        {
+          *alloc = MAX (2 * *alloc, pos + done + n);
+          *buf = xrealloc (*buf, *alloc);
+        }
+      if (!read_state (*buf + pos + done, n, stream))
+        return false;
+      done += n;
+    }
+  return true;
+}
+
+/* Appends the N bytes at P to the state buffer BUF */
+static char *
+append_state (char *buf, const void *p, size_t n)
+{
+  if (n)
+    memcpy (buf, p, n);
+  return buf + n;
+}
+
+const char *
+field_op_state (const struct fieldop *op, size_t *len)
+{
+  static char *buf = NULL;
+  static size_t alloc = 0;
+
+  const size_t moments_size = field_op_uses_moments (op)
+                              ? sizeof op->moments : 0;
+  const size_t n = sizeof op->count + sizeof op->value
+                   + sizeof op->num_values
+                   + op->num_values * sizeof *op->values
+                   + sizeof op->str_buf_used + op->str_buf_used
+                   + moments_size
+                   + (field_op_uses_digest (op)
+                      ? tdigest_state_size (op->digest) : 0)
+                   + (op->op == OP_APPROX_COUNT_UNIQUE
+                      ? hll_state_size (op->hll) : 0);
+  if (n > alloc)
+    {
+      alloc = MAX (alloc * 2, n);
+      buf = xrealloc (buf, alloc);
+    }
+
+  char *p = buf;
+  p = append_state (p, &op->count, sizeof op->count);
+  p = append_state (p, &op->value, sizeof op->value);
+  p = append_state (p, &op->num_values, sizeof op->num_values);
+  p = append_state (p, op->values, op->num_values * sizeof *op->values);
+  p = append_state (p, &op->str_buf_used, sizeof op->str_buf_used);
+  p = append_state (p, op->str_buf, op->str_buf_used);
+  p = append_state (p, &op->moments, moments_size);
+  if (field_op_uses_digest (op))
+    p = tdigest_save_state (op->digest, p);
+  if (op->op == OP_APPROX_COUNT_UNIQUE)
+    hll_save_state (op->hll, p);
+  *len = n;
+  return buf;
+}
+
+void
+field_op_save_state (const struct fieldop *op, FILE *stream)
+{
+  size_t len;
+  const char *state = field_op_state (op, &len);
+  write_state (state, len, stream);
+}
+
+bool
+field_op_merge_state (struct fieldop *op, FILE *stream, bool *keep_line)
+{
+  size_t count, num_values, str_len;
+  long double value;
+
+  if (!read_state (&count, sizeof count, stream)
+      || !read_state (&value, sizeof value, stream)
+      || !read_state (&num_values, sizeof num_values, stream))
+    return false;
+
+  /* The other values are appended to this operation's values */
+  const size_t values_pos = op->first ? 0 : op->num_values;
+  char *values_buf = (char *) op->values;
+  size_t values_alloc = op->alloc_values * sizeof *op->values;
+  const bool values_read
+    = (num_values <= SIZE_MAX / sizeof *op->values
+       && read_state_bytes (&values_buf, &values_alloc,
+                            values_pos * sizeof *op->values,
+                            num_values * sizeof *op->values, stream));
+  op->values = (long double *) values_buf;
+  op->alloc_values = values_alloc / sizeof *op->values;
+  if (!values_read || !read_state (&str_len, sizeof str_len, stream)
+      || str_len == SIZE_MAX)
+    return false;
+  const long double *values = op->values + values_pos;
+
+  const size_t str_pos = (op->op == OP_FIRST || op->op == OP_LAST
+                          || op->first) ? 0 : op->str_buf_used;
+  char *strs = NULL;
+  size_t strs_alloc = 0;
+  struct moments moments;
+  if (field_op_uses_digest (op) && !op->digest)
+    op->digest = tdigest_init (op->params.approx.compression);
+  if (op->op == OP_APPROX_COUNT_UNIQUE && !op->hll)
+    op->hll = hll_init (op->params.hll_precision);
+  if (!read_state_bytes (&strs, &strs_alloc, 0, str_len, stream))
+    {
+      free (strs);
+      return false;
+    }
+  strs = xrealloc (strs, str_len + 1);
+  if ((field_op_uses_moments (op)
+          && !read_state (&moments, sizeof moments, stream))
+      || (field_op_uses_digest (op)
+          && !tdigest_merge_state (op->digest, stream))
+      || (op->op == OP_APPROX_COUNT_UNIQUE
+          && !hll_merge_state (op->hll, stream)))
+    {
+      free (strs);
+      return false;
+    }
+
+  if (count == 0)
+    {
+      free (strs);
+      return true;
+    }
+
+  if (field_op_uses_moments (op))
+    moments_merge (&op->moments, &moments);
+
+  if (op->op == OP_UNIQUE || op->op == OP_COUNT_UNIQUE)
+    {
+      /* Add the other strings which are not in this operation's set */
+      strs[str_len] = '\0';
+      for (size_t pos = 0; pos < str_len; pos += strlen (strs + pos) + 1)
+        field_op_add_distinct_string (op, strs + pos, strlen (strs + pos));
+    }
+  else if (op->first || op->op != OP_FIRST)
+    {
+      if (str_pos + str_len + 1 > op->str_buf_alloc)
+        {
+          op->str_buf_alloc = str_pos + str_len + 1;
+          op->str_buf = xrealloc (op->str_buf, op->str_buf_alloc);
+        }
+      memcpy (op->str_buf + str_pos, strs, str_len);
+      op->str_buf_used = str_pos + str_len;
+    }
+  free (strs);
+
+  if (op->first)
+    {
+      op->value = value;
+      op->num_values = num_values;
+    }
+  else
+    {
+      /* Replace only with a strictly smaller/larger value, as
+         field_op_collect () does, so that ties keep the earlier value */
+      if (op->op == OP_MIN)
+        {
+          if (value < op->value)
+            {
+              op->value = value;
+              *keep_line = true;
+            }
+        }
+      else if (op->op == OP_MAX)
+        {
+          if (value > op->value)
+            {
+              op->value = value;
+              *keep_line = true;
+            }
+        }
+      else if (op->op == OP_ABSMIN)
+        {
+          if (fabsl (value) < fabsl (op->value))
+            {
+              op->value = value;
+              *keep_line = true;
+            }
+        }
+      else if (op->op == OP_ABSMAX)
+        {
+          if (fabsl (value) > fabsl (op->value))
+            {
+              op->value = value;
+              *keep_line = true;
+            }
+        }
+      else if (op->op == OP_RANGE)
+        {
+          /* The other minimum and maximum were appended */
+          op->values[0] = MIN (op->values[0], values[0]);
+          op->values[1] = MAX (op->values[1], values[1]);
+        }
+      else
+        {
+          /* The other string replaced the last one (see above) */
+          if (op->op == OP_LAST)
+            *keep_line = true;
+
+          /* Sums (and counts) are added; vectors were appended */
+          op->value += value;
+          op->num_values += num_values;
+        }
+    }
+
+  op->count += count;
+  op->first = false;
+  return true;
 }
 
 const char*
@@ -63,6 +63,15 @@ struct operation_data
   enum operation_result_type res_type;
 };
 
+/* A slot of the hash set of the distinct strings of a fieldop
+   (open addressing with linear probing) */
+struct str_set_slot
+{
+  size_t hash;
+  size_t pos1;  /* position of the string in str_buf plus one,
+                   0 if the slot is empty */
+};
+
 /* Operation on a field */
 struct fieldop
 {
@@ -89,7 +98,13 @@ struct fieldop
     long double bin_bucket_size;
     size_t strbin_bucket_size;
     long double percentile;
+    struct
+    {
+      long double percentile;
+      long double compression;
+    } approx;
     long double coldness;
+    unsigned int hll_precision;
     long double trimmed_mean;
     enum extract_number_type get_num_type;
   } params;
@@ -101,23 +116,40 @@ struct fieldop
   size_t count; /* number of items collected so far in a group */
   long double value; /* for single-value operations (sum, min, max, absmin,
                         absmax, mean) - this is the accumulated value */
+  struct moments moments; /* for operations computed from the moments
+                             of the values (stdev, skewness, pcov...) */
+  struct tdigest *digest; /* for approximate quantiles (aperc, amedian),
+                             allocated when the first value is collected */
+  struct hll *hll; /* for acountunique, allocated like 'digest' */
 
   /* NUMERIC_VECTOR operations */
   long double *values;     /* array for multi-valued ops (median,mode,stdev) */
   size_t      num_values;  /* number of used values */
   size_t      alloc_values;/* number of allocated values */
+  size_t      num_paired;  /* for pair operations (pcov, dotprod...): number
+                              of values already added to the result */
 
   /* String buffer for STRING_VECTOR operations */
   char *str_buf;   /* points to the beginning of the buffer */
   size_t str_buf_used; /* number of bytes used in the buffer */
   size_t str_buf_alloc; /* number of bytes allocated in the buffer */
 
+  /* Hash set of the strings in str_buf, for operations which keep only
+     the distinct strings (unique, countunique) */
+  struct str_set_slot *str_set; /* allocated with the first string */
+  size_t str_set_mask;  /* number of slots minus one */
+  size_t num_strs;      /* number of strings in the set */
+
   /* Output buffer containing the final results of an operation,
      set by 'summarize' functions.
      also used for line operations (md5/sha1/256/512/base64). */
   char *out_buf;
   size_t out_buf_used;
   size_t out_buf_alloc;
+
+  /* The unformatted result of NUMERIC_RESULT operations,
+     set by 'summarize' functions. */
+  long double result;
 };
 
 /* Initializes a new field-op, using an *existing* (pre-allocated) struct. */
@@ -126,6 +158,13 @@ field_op_init (struct fieldop* /*in-out*/ op,
                enum field_operation oper,
                bool by_name, size_t num, const char* name);
 
+/* Initializes COPY as a new instance of the operation OP (same operation,
+   field and parameters), with no collected values.
+   COPY does not share any buffers with OP. If OP has a subordinate
+   operation, COPY->subordinate_op must be set by the caller. */
+void
+field_op_clone (struct fieldop* /*out*/ copy, const struct fieldop *op);
+
 /* Frees the internal structures in the field-op.
    Does *not* free 'op' itself */
 void
@@ -140,6 +179,19 @@ field_op_free (struct fieldop* op);
 enum FIELD_OP_COLLECT_RESULT
 field_op_collect (struct fieldop *op, const char* str, size_t slen);
 
+/* Returns true if operation OP computes a value from each line
+   which can be used as a group-by key (e.g. 'bin', 'round'). */
+bool
+field_op_is_key_transform (enum field_operation op);
+
+/* Stores in VALUE the result of the per-line operation OP
+   (see field_op_is_key_transform ()) on the input field STR,
+   without changing OP.
+   Returns FLOCR_INVALID_NUMBER if OP requires a number and STR is not. */
+enum FIELD_OP_COLLECT_RESULT
+field_op_transform (const struct fieldop *op, const char *str, size_t slen,
+                    long double *value);
+
 /* Evaluates to true/false depending if the value returned from
    field_op_collect represents a successful operation. */
 #define field_op_ok(X) \
@@ -164,6 +216,32 @@ field_op_summarize (struct fieldop *op);
 void
 field_op_reset (struct fieldop *op);
 
+/* Returns true if the collected state of operation OP over consecutive
+   runs of input lines can be combined with field_op_merge_state (). */
+bool
+field_op_mergeable (enum field_operation op);
+
+/* Writes the collected state of OP to STREAM, to be combined
+   later with field_op_merge_state () by a process running the same
+   program (the format is not portable). */
+void
+field_op_save_state (const struct fieldop *op, FILE *stream);
+
+/* Returns the state written by field_op_save_state () in a buffer
+   (valid until the next call), and stores its length in LEN */
+const char *
+field_op_state (const struct fieldop *op, size_t *len);
+
+/* Reads a state written by field_op_save_state () for the same
+   operation, and combines it into OP, as if the values were collected
+   after OP's current values. Sets KEEP_LINE to true if collecting the
+   values would have kept one of their lines (see FLOCR_OK_KEEP_LINE),
+   e.g. a larger maximum: the line saved with the state then replaces
+   the group's line.
+   Returns false if the state could not be read. */
+bool
+field_op_merge_state (struct fieldop *op, FILE *stream, bool *keep_line);
+
 /* Output precision, to be used with "printf ("%.*Lg",)" */
 extern int field_op_output_precision;
 
@@ -0,0 +1,977 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <locale.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "system.h"
+
+#include "die.h"
+#include "hard-locale.h"
+#include "linebuffer.h"
+#include "stdnoreturn.h"
+#include "xalloc.h"
+
+#include "text-options.h"
+#include "text-output.h"
+#include "text-lines.h"
+#include "text-sort.h"
+#include "op-defs.h"
+#include "utils.h"
+#include "field-ops.h"
+#include "tdigest.h"
+#include "hyperloglog.h"
+#include "key-intern.h"
+#include "hash-group.h"
+
+/* Memory used for each group by the hash table, the list of groups
+   and the allocator's headers */
+enum { HASH_GROUP_OVERHEAD = 16 * sizeof (void *) };
+
+/* Number of spill files: each file is grouped after the input was read
+   (and partitioned again, with another hash, if it does not fit) */
+enum { HASH_SPILL_PARTITIONS = 16 };
+
+#if HAVE_PTHREAD
+/* With threads, the main thread reads the input and sends each line
+   to the worker thread of its key's partition. Each worker collects
+   the groups of its keys in its own set of groups; the groups are
+   printed by the main thread after the input was read. */
+enum { HASH_WORKER_SLOTS = 4 };
+enum { HASH_BATCH_LINES = 4096 };
+enum { HASH_BATCH_BYTES = 1024 * 1024 };
+#endif
+
+/* A set of groups (with threads, each thread collects the groups
+   of some keys) */
+struct hash_groups
+{
+  const struct hash_group_config *cfg;
+  struct key_intern *keys;      /* the group-by keys of the groups */
+  struct hash_group **list;     /* by key ID (in first-seen order) */
+  size_t num_groups;
+  size_t alloc_groups;
+  size_t memory;                /* estimated memory used by the groups */
+  size_t memory_limit;
+  FILE *spill_files[HASH_SPILL_PARTITIONS];
+  unsigned int spill_level;
+
+  /* The group-by keys of the current line (see hash_key_encode ()) */
+  char *key;
+  size_t key_len;
+  size_t key_alloc;
+};
+
+#if HAVE_PTHREAD
+struct hash_batch_line
+{
+  size_t line_number;
+  size_t offset;        /* position of the line in the batch's data */
+  size_t len;
+  size_t hash;          /* hash value of the line's key */
+};
+
+/* Lines sent to a worker */
+struct hash_batch
+{
+  char *data;           /* the lines, each followed by a NUL */
+  size_t used;
+  size_t alloc;
+  struct hash_batch_line *lines;
+  size_t num_lines;
+};
+
+struct hash_worker
+{
+  struct hash_groups groups;
+  size_t max_fields;    /* number of fields split in each line */
+
+  /* Ring of batches: the worker groups the lines of the 'filled'
+     batches starting at 'first'; the main thread fills the next one
+     ('fill', if not NULL) */
+  struct hash_batch slots[HASH_WORKER_SLOTS];
+  size_t first;
+  size_t filled;
+  struct hash_batch *fill;
+
+  bool finished;        /* the main thread will not send more lines */
+  bool failed;          /* the worker stopped on an invalid line */
+  char *error;          /* the error message of the invalid line */
+  size_t error_line;
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+};
+
+/* The worker running on the current thread (NULL on the main thread) */
+static _Thread_local struct hash_worker *current_worker = NULL;
+#endif
+
+struct hash_grouper
+{
+  const struct hash_group_config *cfg;
+  struct hash_groups groups;    /* the groups of the main thread */
+  bool collate;                 /* sort with the locale's order */
+
+#if HAVE_PTHREAD
+  struct hash_worker *workers;
+  size_t num_workers;           /* 0 if no worker is running */
+  bool workers_started;
+#endif
+};
+
+static void
+hash_groups_init (struct hash_groups *hgs,
+                  const struct hash_group_config *cfg, size_t memory_limit)
+{
+  memset (hgs, 0, sizeof *hgs);
+  hgs->cfg = cfg;
+  hgs->memory_limit = memory_limit;
+}
+
+/* Stores the group-by keys of LINE in the key buffer of HGS, as one
+   string (in lower case with --ignore-case). Each key but the last
+   is preceded by its length, so that 'ab','c' and 'a','bc' differ. */
+static void
+hash_key_encode (struct hash_groups *hgs, const struct line_record_t *line)
+{
+  const size_t num_keys = hgs->cfg->num_keys;
+
+  hgs->key_len = 0;
+  for (size_t i = 0; i < num_keys; ++i)
+    {
+      size_t len;
+      const char *str = hgs->cfg->key_field (line, i, &len);
+
+      const size_t need = hgs->key_len + sizeof len + len;
+      if (need > hgs->key_alloc)
+        {
+          hgs->key_alloc = MAX (hgs->key_alloc * 2, need);
+          hgs->key = xrealloc (hgs->key, hgs->key_alloc);
+        }
+      if (i + 1 < num_keys)
+        {
+          memcpy (hgs->key + hgs->key_len, &len, sizeof len);
+          hgs->key_len += sizeof len;
+        }
+
+      char *p = hgs->key + hgs->key_len;
+      if (case_sensitive)
+        memcpy (p, str, len);
+      else
+        for (size_t j = 0; j < len; ++j)
+          p[j] = tolower (to_uchar (str[j]));
+      hgs->key_len += len;
+    }
+}
+
+/* Stores the group-by keys of LINE in the key buffer of HGS,
+   and returns their hash value */
+static size_t
+hash_key (struct hash_groups *hgs, const struct line_record_t *line)
+{
+  hash_key_encode (hgs, line);
+  return key_intern_hash (hgs->key, hgs->key_len);
+}
+
+/* Returns the (estimated) memory used by the collected values of OPS */
+static size_t _GL_ATTRIBUTE_PURE
+hash_group_ops_memory (const struct fieldop *ops, size_t num_ops)
+{
+  size_t n = 0;
+  for (size_t i = 0; i < num_ops; ++i)
+    n += ops[i].alloc_values * sizeof (long double)
+         + ops[i].str_buf_alloc + ops[i].out_buf_alloc
+         + (ops[i].str_set
+            ? (ops[i].str_set_mask + 1) * sizeof *ops[i].str_set : 0)
+         + (ops[i].digest ? tdigest_memory (ops[i].digest) : 0)
+         + (ops[i].hll ? hll_memory (ops[i].hll) : 0);
+  return n;
+}
+
+/* Mixes the bits of the hash value HASH
+   (with a different function for each LEVEL) */
+static uint64_t _GL_ATTRIBUTE_CONST
+hash_mix (size_t hash, unsigned int level)
+{
+  uint64_t h = (uint64_t) hash + level * UINT64_C (0x9E3779B97F4A7C15);
+  h = (h ^ (h >> 33)) * UINT64_C (0xFF51AFD7ED558CCD);
+  h ^= h >> 33;
+  return h;
+}
+
+/* Returns the spill file partition of a key with hash value HASH.
+   Each level of partitioning uses a different function of the hash. */
+static size_t _GL_ATTRIBUTE_CONST
+hash_spill_partition (size_t hash, unsigned int level)
+{
+  return hash_mix (hash, level) % HASH_SPILL_PARTITIONS;
+}
+
+/* Writes LINE (and its line number NUMBER) to its spill file.
+   The records are read by read_spill_file (). */
+static void
+spill_line (struct hash_groups *hgs, const struct line_record_t *line,
+            size_t number, size_t hash)
+{
+  const size_t p = hash_spill_partition (hash, hgs->spill_level);
+  if (!hgs->spill_files[p])
+    hgs->spill_files[p] = sort_tmpfile ();
+
+  const size_t hdr[2] = { number, line_record_length (line) };
+  if (fwrite (hdr, sizeof hdr, 1, hgs->spill_files[p]) != 1
+      || fwrite (line_record_buffer (line), 1, hdr[1],
+                 hgs->spill_files[p]) != hdr[1])
+    die (EXIT_FAILURE, errno, _("write error (temporary file)"));
+}
+
+/* Adds a new group to HGS, whose first line is LINE, the input line
+   number NUMBER (the key of LINE, with the hash value HASH, is in HGS's
+   key buffer). The content of LINE is exchanged with the group's line. */
+static struct hash_group *
+add_group (struct hash_groups *hgs, struct line_record_t *line,
+           size_t number, size_t hash)
+{
+  const struct hash_group_config *cfg = hgs->cfg;
+
+  if (!hgs->keys)
+    hgs->keys = key_intern_init ();
+  const size_t id = key_intern_add (hgs->keys, hgs->key, hgs->key_len, hash);
+  assert (id == hgs->num_groups);                /* LCOV_EXCL_LINE */
+
+  struct hash_group *g = xmalloc (sizeof *g);
+  line_record_init (&g->line);
+  line_record_swap (&g->line, line);
+  line_record_keep (&g->line);
+  g->order = number;
+  g->ops = XNMALLOC (cfg->num_ops, struct fieldop);
+  for (size_t i = 0; i < cfg->num_ops; ++i)
+    {
+      field_op_clone (&g->ops[i], &cfg->ops[i]);
+      if (cfg->ops[i].subordinate_op)
+        g->ops[i].subordinate_op =
+          &g->ops[cfg->ops[i].subordinate_op - cfg->ops];
+    }
+
+  if (hgs->num_groups == hgs->alloc_groups)
+    hgs->list = x2nrealloc (hgs->list, &hgs->alloc_groups,
+                            sizeof *hgs->list);
+  hgs->list[hgs->num_groups++] = g;
+
+  hgs->memory += sizeof *g + HASH_GROUP_OVERHEAD + hgs->key_len
+                 + cfg->num_ops * sizeof *g->ops
+                 + g->line.lbuf.size
+                 + g->line.alloc_fields * sizeof *g->line.fields;
+  return g;
+}
+
+/* Returns the group of HGS with the key in HGS's key buffer (with the
+   hash value HASH), or NULL */
+static struct hash_group *
+find_group (const struct hash_groups *hgs, size_t hash)
+{
+  if (!hgs->keys)
+    return NULL;
+  const size_t id = key_intern_find (hgs->keys, hgs->key, hgs->key_len,
+                                     hash);
+  return id == KEY_INTERN_NONE ? NULL : hgs->list[id];
+}
+
+/* Collects LINE, the input line number NUMBER (whose key, with the hash
+   value HASH, is in HGS's key buffer - see hash_key ()) into the group
+   of HGS with the same key (a new group is created for a new key, or
+   the line is spilled to a temporary file if the groups exceed the
+   memory budget). The content of LINE might be exchanged with a kept
+   line. */
+static void
+process_group_line (struct hash_groups *hgs, struct line_record_t *line,
+                    size_t number, size_t hash)
+{
+  const struct hash_group_config *cfg = hgs->cfg;
+  struct hash_group *g = find_group (hgs, hash);
+  size_t mem;
+
+  if (!g && hgs->num_groups && hgs->memory > hgs->memory_limit)
+    {
+      spill_line (hgs, line, number, hash);
+      return;
+    }
+  if (!g)
+    {
+      g = add_group (hgs, line, number, hash);
+      mem = hash_group_ops_memory (g->ops, cfg->num_ops);
+      cfg->process_line (&g->line, number, g->ops);
+    }
+  else
+    {
+      mem = hash_group_ops_memory (g->ops, cfg->num_ops);
+      if (cfg->process_line (line, number, g->ops))
+        {
+          line_record_swap (&g->line, line);
+          line_record_keep (&g->line);
+        }
+    }
+  hgs->memory += hash_group_ops_memory (g->ops, cfg->num_ops) - mem;
+}
+
+/* The order of the groups while they are sorted by compare_groups () */
+static const struct hash_group_config *sort_cfg;
+static bool sort_collate;
+
+static int
+compare_groups (const void *p1, const void *p2)
+{
+  const struct hash_group *g1 = *(struct hash_group * const *) p1;
+  const struct hash_group *g2 = *(struct hash_group * const *) p2;
+  int diff = sort_cfg->compare_keys (&g1->line, &g2->line, sort_collate);
+  if (!diff)
+    diff = (g1->order > g2->order) - (g1->order < g2->order);
+  return diff;
+}
+
+/* Frees the groups of HGS */
+static void
+free_groups (struct hash_groups *hgs)
+{
+  for (size_t i = 0; i < hgs->num_groups; ++i)
+    {
+      struct hash_group *g = hgs->list[i];
+      for (size_t j = 0; j < hgs->cfg->num_ops; ++j)
+        field_op_free (&g->ops[j]);
+      free (g->ops);
+      line_record_free (&g->line);
+      free (g);
+    }
+
+  key_intern_free (hgs->keys);
+  hgs->keys = NULL;
+  free (hgs->key);
+  hgs->key = NULL;
+  hgs->key_len = hgs->key_alloc = 0;
+  free (hgs->list);
+  hgs->list = NULL;
+  hgs->num_groups = hgs->alloc_groups = 0;
+  hgs->memory = 0;
+}
+
+/* Prints the results of group G, or saves them in RESULTS
+   (if not NULL) as a record read by result_read () */
+static void
+print_group (const struct hash_group_config *cfg, const struct hash_group *g,
+             FILE *results)
+{
+  if (!results)
+    {
+      cfg->print (g);
+      return;
+    }
+
+  /* The ranking value is saved with the output, which is ranked
+     (with --top) once it is merged */
+  size_t out_len;
+  output_capture_begin ();
+  const long double value = cfg->print_saved (g);
+  const char *out = output_capture_end (&out_len);
+
+  const size_t hdr[3] = { g->order, line_record_length (&g->line), out_len };
+  if (fwrite (hdr, sizeof hdr, 1, results) != 1
+      || fwrite (&value, sizeof value, 1, results) != 1
+      || fwrite (line_record_buffer (&g->line), 1, hdr[1], results) != hdr[1]
+      || fwrite (out, 1, out_len, results) != out_len)
+    die (EXIT_FAILURE, errno, _("write error (temporary file)"));
+}
+
+/* The results of the groups of a spill file (or of the groups which
+   were in memory), in the output order */
+struct hash_result
+{
+  FILE *f;
+  bool valid;                   /* false after the last result */
+  size_t order;
+  long double value;            /* the ranking value */
+  struct line_record_t line;    /* the group's line, for sorting */
+  char *line_buf;
+  size_t line_len;
+  size_t line_alloc;
+  char *out;                    /* the output of the group */
+  size_t out_len;
+  size_t out_alloc;
+};
+
+/* Reads the next result of R */
+static void
+result_read (const struct hash_grouper *hg, struct hash_result *r)
+{
+  size_t hdr[3];
+
+  r->valid = fread (hdr, sizeof hdr, 1, r->f) == 1;
+  if (!r->valid)
+    {
+      if (ferror (r->f))
+        die (EXIT_FAILURE, errno, _("read error (temporary file)"));
+      return;
+    }
+
+  r->order = hdr[0];
+  if (r->line_alloc <= hdr[1])
+    {
+      r->line_alloc = MAX (r->line_alloc * 2, hdr[1] + 1);
+      r->line_buf = xrealloc (r->line_buf, r->line_alloc);
+    }
+  if (r->out_alloc < hdr[2])
+    {
+      r->out_alloc = MAX (r->out_alloc * 2, hdr[2]);
+      r->out = xrealloc (r->out, r->out_alloc);
+    }
+  r->line_len = hdr[1];
+  r->out_len = hdr[2];
+  if (fread (&r->value, sizeof r->value, 1, r->f) != 1
+      || fread (r->line_buf, 1, hdr[1], r->f) != hdr[1]
+      || fread (r->out, 1, hdr[2], r->f) != hdr[2])
+    die (EXIT_FAILURE, errno, _("read error (temporary file)"));
+  r->line_buf[hdr[1]] = '\0';
+  if (hg->cfg->sort)
+    line_record_set (&r->line, r->line_buf, hdr[1],
+                     hg->cfg->input->max_fields);
+}
+
+/* Returns true if the result A is printed before B */
+static bool
+result_less (const struct hash_grouper *hg, const struct hash_result *a,
+             const struct hash_result *b)
+{
+  if (hg->cfg->sort)
+    {
+      int diff = hg->cfg->compare_keys (&a->line, &b->line, hg->collate);
+      if (diff)
+        return diff < 0;
+    }
+  return a->order < b->order;
+}
+
+/* Merges the N result files IN (each in the output order) into TO,
+   or prints them if TO is NULL. The files are closed. */
+static void
+merge_results (const struct hash_grouper *hg, FILE **in, size_t n, FILE *to)
+{
+  struct hash_result *r = XCALLOC (n, struct hash_result);
+
+  for (size_t i = 0; i < n; ++i)
+    {
+      r[i].f = in[i];
+      line_record_init (&r[i].line);
+      rewind (r[i].f);
+      result_read (hg, &r[i]);
+    }
+
+  /* There are only a few files: find the next result linearly */
+  for (;;)
+    {
+      struct hash_result *next = NULL;
+      for (size_t i = 0; i < n; ++i)
+        if (r[i].valid && (!next || result_less (hg, &r[i], next)))
+          next = &r[i];
+      if (!next)
+        break;
+
+      if (!to)
+        hg->cfg->add_result (next->out, next->out_len, next->value);
+      else
+        {
+          const size_t len = next->line_len;
+          const size_t hdr[3] = { next->order, len, next->out_len };
+          if (fwrite (hdr, sizeof hdr, 1, to) != 1
+              || fwrite (&next->value, sizeof next->value, 1, to) != 1
+              || fwrite (next->line_buf, 1, len, to) != len
+              || fwrite (next->out, 1, next->out_len, to) != next->out_len)
+            die (EXIT_FAILURE, errno, _("write error (temporary file)"));
+        }
+      result_read (hg, next);
+    }
+
+  for (size_t i = 0; i < n; ++i)
+    {
+      fclose (r[i].f);
+      line_record_free (&r[i].line);
+      free (r[i].line_buf);
+      free (r[i].out);
+    }
+  free (r);
+}
+
+/* Groups the lines of the spill file F into HGS
+   (at partitioning level LEVEL) */
+static void
+read_spill_file (struct hash_groups *hgs, FILE *f, unsigned int level)
+{
+  struct line_record_t lr;
+  char *buf = NULL;
+  size_t alloc = 0;
+  size_t hdr[2];
+
+  hgs->spill_level = level;
+  line_record_init (&lr);
+  rewind (f);
+  while (fread (hdr, sizeof hdr, 1, f) == 1)
+    {
+      if (alloc <= hdr[1])
+        {
+          alloc = MAX (alloc * 2, hdr[1] + 1);
+          buf = xrealloc (buf, alloc);
+        }
+      if (fread (buf, 1, hdr[1], f) != hdr[1])
+        die (EXIT_FAILURE, errno, _("read error (temporary file)"));
+      buf[hdr[1]] = '\0';
+
+      /* Errors are reported with the input line number */
+      line_record_set (&lr, buf, hdr[1], hgs->cfg->input->max_fields);
+      process_group_line (hgs, &lr, hdr[0], hash_key (hgs, &lr));
+    }
+  if (ferror (f))
+    die (EXIT_FAILURE, errno, _("read error (temporary file)"));
+  line_record_free (&lr);
+  free (buf);
+}
+
+/* Prints the groups of HGS, and frees them. The groups of the spilled
+   lines are then grouped and printed, in the same order as if all the
+   groups had been in memory.
+   If RESULTS is not NULL, the results are saved there instead
+   (see print_group ()). */
+static void
+print_groups (struct hash_grouper *hg, struct hash_groups *hgs,
+              FILE *results)
+{
+  const struct hash_group_config *cfg = hgs->cfg;
+  FILE *spill[HASH_SPILL_PARTITIONS];
+  FILE *parts[HASH_SPILL_PARTITIONS + 1];
+  size_t num_parts = 0;
+  const unsigned int level = hgs->spill_level;
+  bool spilled = false;
+
+  for (size_t i = 0; i < HASH_SPILL_PARTITIONS; ++i)
+    {
+      spill[i] = hgs->spill_files[i];
+      hgs->spill_files[i] = NULL;
+      spilled |= spill[i] != NULL;
+    }
+
+  if (cfg->sort && !cfg->any_order && hgs->num_groups > 1)
+    {
+      hg->collate = hard_locale (LC_COLLATE);
+      sort_cfg = cfg;
+      sort_collate = hg->collate;
+      qsort (hgs->list, hgs->num_groups, sizeof *hgs->list, compare_groups);
+    }
+
+  /* Groups printed in any order are printed as they are grouped */
+  if (spilled && !cfg->any_order)
+    parts[num_parts++] = sort_tmpfile ();
+
+  for (size_t i = 0; i < hgs->num_groups; ++i)
+    print_group (cfg, hgs->list[i], num_parts ? parts[0] : results);
+  free_groups (hgs);
+
+  if (!spilled)
+    return;
+
+  for (size_t i = 0; i < HASH_SPILL_PARTITIONS; ++i)
+    {
+      if (!spill[i])
+        continue;
+      read_spill_file (hgs, spill[i], level + 1);
+      fclose (spill[i]);
+      if (num_parts)
+        parts[num_parts] = sort_tmpfile ();
+      print_groups (hg, hgs, num_parts ? parts[num_parts] : NULL);
+      if (num_parts)
+        num_parts++;
+    }
+  hgs->spill_level = level;
+
+  if (num_parts)
+    merge_results (hg, parts, num_parts, results);
+}
+
+#if HAVE_PTHREAD
+/* Groups the lines sent to the worker ARG */
+static void *
+hash_worker_run (void *arg)
+{
+  struct hash_worker *w = arg;
+  struct line_record_t lr;
+
+  current_worker = w;
+  line_record_init (&lr);
+
+  pthread_mutex_lock (&w->lock);
+  while (true)
+    {
+      while (w->filled == 0 && !w->finished)
+        pthread_cond_wait (&w->not_empty, &w->lock);
+      if (w->filled == 0)
+        break;
+
+      /* The main thread never writes to the filled batches */
+      struct hash_batch *b = &w->slots[w->first];
+      pthread_mutex_unlock (&w->lock);
+
+      for (size_t i = 0; i < b->num_lines; ++i)
+        {
+          const struct hash_batch_line *l = &b->lines[i];
+          line_record_set (&lr, b->data + l->offset, l->len, w->max_fields);
+          hash_key_encode (&w->groups, &lr);
+          process_group_line (&w->groups, &lr, l->line_number, l->hash);
+        }
+      b->num_lines = 0;
+      b->used = 0;
+
+      pthread_mutex_lock (&w->lock);
+      w->first = (w->first + 1) % HASH_WORKER_SLOTS;
+      --w->filled;
+      pthread_cond_signal (&w->not_full);
+    }
+  pthread_mutex_unlock (&w->lock);
+
+  line_record_free (&lr);
+  return NULL;
+}
+
+/* Sends the remaining lines to the workers of HG, and waits
+   until they have grouped them (or failed) */
+static void
+finish_workers (struct hash_grouper *hg)
+{
+  for (size_t i = 0; i < hg->num_workers; ++i)
+    {
+      struct hash_worker *w = &hg->workers[i];
+      pthread_mutex_lock (&w->lock);
+      if (w->fill)
+        ++w->filled;
+      w->fill = NULL;
+      w->finished = true;
+      pthread_cond_signal (&w->not_empty);
+      pthread_mutex_unlock (&w->lock);
+    }
+  for (size_t i = 0; i < hg->num_workers; ++i)
+    pthread_join (hg->workers[i].thread, NULL);
+}
+
+/* Stops the workers of HG. If a worker found an invalid line
+   (or MSG is not NULL: the main thread found an invalid line, the input
+   line number NUMBER), reports the error of the first invalid line
+   and exits. */
+static void
+check_workers (struct hash_grouper *hg, const char *msg, size_t number)
+{
+  size_t first_line = number;
+
+  finish_workers (hg);
+  hg->num_workers = 0;
+  for (size_t i = 0; i < hg->cfg->threads; ++i)
+    {
+      const struct hash_worker *w = &hg->workers[i];
+      if (w->failed && (!msg || w->error_line < first_line))
+        {
+          msg = w->error;
+          first_line = w->error_line;
+        }
+    }
+  if (msg)
+    die (EXIT_FAILURE, 0, "%s", msg);
+}
+
+static void
+free_workers (struct hash_grouper *hg)
+{
+  for (size_t i = 0; i < hg->cfg->threads; ++i)
+    {
+      struct hash_worker *w = &hg->workers[i];
+      for (size_t j = 0; j < HASH_WORKER_SLOTS; ++j)
+        {
+          free (w->slots[j].data);
+          free (w->slots[j].lines);
+        }
+      pthread_cond_destroy (&w->not_full);
+      pthread_cond_destroy (&w->not_empty);
+      pthread_mutex_destroy (&w->lock);
+    }
+  free (hg->workers);
+  hg->workers = NULL;
+}
+
+/* Starts the workers of HG. If no thread can be created,
+   the lines are grouped by the main thread. */
+static void
+start_workers (struct hash_grouper *hg)
+{
+  const struct hash_group_config *cfg = hg->cfg;
+
+  hg->workers_started = true;
+  hg->workers = XCALLOC (cfg->threads, struct hash_worker);
+  for (size_t i = 0; i < cfg->threads; ++i)
+    {
+      struct hash_worker *w = &hg->workers[i];
+      hash_groups_init (&w->groups, cfg, cfg->memory_limit / cfg->threads);
+      w->max_fields = cfg->input->max_fields;
+      for (size_t j = 0; j < HASH_WORKER_SLOTS; ++j)
+        w->slots[j].lines = XNMALLOC (HASH_BATCH_LINES,
+                                      struct hash_batch_line);
+      pthread_mutex_init (&w->lock, NULL);
+      pthread_cond_init (&w->not_empty, NULL);
+      pthread_cond_init (&w->not_full, NULL);
+      if (pthread_create (&w->thread, NULL, hash_worker_run, w) != 0)
+        break;
+      ++hg->num_workers;
+    }
+
+  /* The main thread splits only the group-by columns */
+  if (hg->num_workers)
+    cfg->input->max_fields = cfg->max_key_field;
+  else
+    free_workers (hg);
+}
+
+/* Sends LINE, the input line number NUMBER, to the worker of its key's
+   partition */
+static void
+send_worker_line (struct hash_grouper *hg, const struct line_record_t *line,
+                  size_t number)
+{
+  const size_t hash = hash_key (&hg->groups, line);
+  /* The spill files of the workers use the low bits of the same mix */
+  struct hash_worker *w =
+    &hg->workers[(hash_mix (hash, 0) >> 32) % hg->num_workers];
+
+  if (!w->fill)
+    {
+      pthread_mutex_lock (&w->lock);
+      while (w->filled == HASH_WORKER_SLOTS && !w->failed)
+        pthread_cond_wait (&w->not_full, &w->lock);
+      const bool failed = w->failed;
+      if (!failed)
+        w->fill = &w->slots[(w->first + w->filled) % HASH_WORKER_SLOTS];
+      pthread_mutex_unlock (&w->lock);
+
+      /* Stop reading: all the previous lines were sent */
+      if (failed)
+        check_workers (hg, NULL, number);
+    }
+
+  struct hash_batch *b = w->fill;
+  const size_t len = line_record_length (line);
+  if (b->alloc - b->used <= len)
+    {
+      b->alloc = MAX (b->alloc * 2, b->used + len + 1);
+      b->data = xrealloc (b->data, b->alloc);
+    }
+  memcpy (b->data + b->used, line_record_buffer (line), len);
+  b->data[b->used + len] = '\0';
+
+  struct hash_batch_line *l = &b->lines[b->num_lines++];
+  l->line_number = number;
+  l->offset = b->used;
+  l->len = len;
+  l->hash = hash;
+  b->used += len + 1;
+
+  if (b->num_lines == HASH_BATCH_LINES || b->used >= HASH_BATCH_BYTES)
+    {
+      pthread_mutex_lock (&w->lock);
+      ++w->filled;
+      w->fill = NULL;
+      pthread_cond_signal (&w->not_empty);
+      pthread_mutex_unlock (&w->lock);
+    }
+}
+
+static int
+compare_group_order (const void *p1, const void *p2)
+{
+  const struct hash_group *g1 = *(struct hash_group * const *) p1;
+  const struct hash_group *g2 = *(struct hash_group * const *) p2;
+  return (g1->order > g2->order) - (g1->order < g2->order);
+}
+
+/* Prints the groups collected by the workers of HG
+   (in the same order as if they were collected by one thread),
+   and frees the workers */
+static void
+print_worker_groups (struct hash_grouper *hg)
+{
+  const struct hash_group_config *cfg = hg->cfg;
+  const size_t n = hg->num_workers;
+  bool spilled = false;
+
+  check_workers (hg, NULL, 0);
+  cfg->input->max_fields = hg->workers[0].max_fields;
+
+  for (size_t i = 0; i < n; ++i)
+    for (size_t j = 0; j < HASH_SPILL_PARTITIONS; ++j)
+      spilled |= hg->workers[i].groups.spill_files[j] != NULL;
+
+  if (cfg->any_order)
+    {
+      for (size_t i = 0; i < n; ++i)
+        print_groups (hg, &hg->workers[i].groups, NULL);
+    }
+  else if (!spilled)
+    {
+      /* Print all the groups together */
+      struct hash_groups *hgs = &hg->groups;
+      for (size_t i = 0; i < n; ++i)
+        {
+          struct hash_groups *wg = &hg->workers[i].groups;
+          if (wg->num_groups > hgs->alloc_groups - hgs->num_groups)
+            {
+              hgs->alloc_groups = hgs->num_groups + wg->num_groups;
+              hgs->list = xnrealloc (hgs->list, hgs->alloc_groups,
+                                     sizeof *hgs->list);
+            }
+          if (wg->num_groups)
+            memcpy (hgs->list + hgs->num_groups, wg->list,
+                    wg->num_groups * sizeof *wg->list);
+          hgs->num_groups += wg->num_groups;
+          hgs->memory += wg->memory;
+
+          /* The groups now belong to HGS (which is only printed,
+             so their keys are not needed) */
+          key_intern_free (wg->keys);
+          free (wg->key);
+          free (wg->list);
+        }
+      if (!cfg->sort)
+        qsort (hgs->list, hgs->num_groups, sizeof *hgs->list,
+               compare_group_order);
+      print_groups (hg, hgs, NULL);
+    }
+  else
+    {
+      /* Each worker's groups (including its spilled lines) are grouped
+         with the entire memory budget, one worker after the other */
+      FILE **results = XNMALLOC (n, FILE *);
+      hg->collate = hard_locale (LC_COLLATE);
+      for (size_t i = 0; i < n; ++i)
+        {
+          hg->workers[i].groups.memory_limit = cfg->memory_limit;
+          results[i] = sort_tmpfile ();
+          print_groups (hg, &hg->workers[i].groups, results[i]);
+        }
+      merge_results (hg, results, n, NULL);
+      free (results);
+    }
+
+  free_workers (hg);
+}
+#endif
+
+struct hash_grouper *
+hash_grouper_init (const struct hash_group_config *cfg)
+{
+  struct hash_grouper *hg = XZALLOC (struct hash_grouper);
+  hg->cfg = cfg;
+  hash_groups_init (&hg->groups, cfg, cfg->memory_limit);
+  return hg;
+}
+
+void
+hash_grouper_add_line (struct hash_grouper *hg, struct line_record_t *line,
+                       size_t number)
+{
+#if HAVE_PTHREAD
+  if (hg->cfg->threads > 1 && !hg->workers_started)
+    start_workers (hg);
+  if (hg->num_workers)
+    {
+      send_worker_line (hg, line, number);
+      return;
+    }
+#endif
+  process_group_line (&hg->groups, line, number, hash_key (&hg->groups, line));
+}
+
+struct hash_group *
+hash_grouper_group (struct hash_grouper *hg, struct line_record_t *line,
+                    size_t number)
+{
+  const size_t hash = hash_key (&hg->groups, line);
+  struct hash_group *g = find_group (&hg->groups, hash);
+
+  if (!g)
+    g = add_group (&hg->groups, line, number, hash);
+  return g;
+}
+
+void
+hash_grouper_print (struct hash_grouper *hg)
+{
+#if HAVE_PTHREAD
+  if (hg->num_workers)
+    {
+      print_worker_groups (hg);
+      return;
+    }
+#endif
+  print_groups (hg, &hg->groups, NULL);
+}
+
+void
+hash_grouper_free (struct hash_grouper *hg)
+{
+  if (!hg)
+    return;
+  free_groups (&hg->groups);
+  free (hg);
+}
+
+void
+hash_grouper_error (struct hash_grouper *hg, char *msg, size_t number)
+{
+#if HAVE_PTHREAD
+  struct hash_worker *w = current_worker;
+  if (w)
+    {
+      pthread_mutex_lock (&w->lock);
+      w->failed = true;
+      w->error = msg;
+      w->error_line = number;
+      pthread_cond_signal (&w->not_full);
+      pthread_mutex_unlock (&w->lock);
+      pthread_exit (NULL);
+    }
+  if (hg && hg->num_workers)
+    check_workers (hg, msg, number);
+#endif
+  die (EXIT_FAILURE, 0, "%s", msg);
+}
@@ -0,0 +1,123 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Grouping of input lines by their group-by keys in a hash table
+   (--hash-group): the input need not be sorted.
+   Once the groups exceed the memory budget, lines with new keys are
+   written to temporary files, partitioned by the hash of their keys
+   ("grace hash" grouping), and grouped after the input was read.
+   With several threads, the lines are sent to the thread of their
+   key's partition. The groups are printed in the order of their first
+   line, or sorted by their keys. */
+#ifndef __HASH_GROUP_H__
+#define __HASH_GROUP_H__
+
+/* A group of input lines with the same key */
+struct hash_group
+{
+  /* The group's first line (or the line kept for --full) */
+  struct line_record_t line;
+  size_t order;         /* the group's position in the input */
+  struct fieldop *ops;  /* the group's operations */
+};
+
+/* How the lines are grouped, and the groups printed */
+struct hash_group_config
+{
+  /* The operations of each group are copies of the NUM_OPS operations
+     OPS (whose subordinate operations are among OPS) */
+  const struct fieldop *ops;
+  size_t num_ops;
+
+  /* The group-by columns: their number, and the highest column number */
+  size_t num_keys;
+  size_t max_key_field;
+
+  /* The input, whose lines are split into fields up to its 'max_fields':
+     with threads, the main thread splits only the group-by columns */
+  struct line_input *input;
+
+  size_t memory_limit;  /* memory budget of the groups */
+  size_t threads;       /* number of threads (if > 1) */
+  bool sort;            /* print the groups sorted by their keys */
+  bool any_order;       /* the groups can be printed in any order */
+
+  /* Returns the group-by column I of LINE (or the key computed from it),
+     and stores its length in LEN. It must remain valid until the next
+     call on the same thread. */
+  const char *(*key_field) (const struct line_record_t *line, size_t i,
+                            size_t *len);
+
+  /* Compares the group-by columns of two lines (by the locale's collating
+     sequence if COLLATE is true), to sort the groups */
+  int (*compare_keys) (const struct line_record_t *a,
+                       const struct line_record_t *b, bool collate);
+
+  /* Processes the input line number NUMBER with the operations OPS of
+     its group. Returns true if the line must be kept as the group's
+     line. Called by the worker threads too. */
+  bool (*process_line) (const struct line_record_t *line, size_t number,
+                        struct fieldop *ops);
+
+  /* Prints the results of a group */
+  void (*print) (const struct hash_group *g);
+
+  /* Prints the results of a group, which are saved to be printed later
+     with add_result (), and returns the value by which they are ranked
+     (with --top) */
+  long double (*print_saved) (const struct hash_group *g);
+  void (*add_result) (const char *out, size_t len, long double value);
+};
+
+struct hash_grouper;
+
+/* Creates a grouper of the lines, with the configuration CFG
+   (which must remain valid) */
+struct hash_grouper *
+hash_grouper_init (const struct hash_group_config *cfg);
+
+/* Collects LINE, the input line number NUMBER, into its group.
+   The content of LINE might be exchanged with a kept line. */
+void
+hash_grouper_add_line (struct hash_grouper *hg, struct line_record_t *line,
+                       size_t number);
+
+/* Returns the group of the key of LINE (the input line number NUMBER),
+   adding a group (without processing LINE) if there is none. The content
+   of LINE might be exchanged with the new group's line. */
+struct hash_group *
+hash_grouper_group (struct hash_grouper *hg, struct line_record_t *line,
+                    size_t number);
+
+/* Prints the groups collected in HG, and frees them */
+void
+hash_grouper_print (struct hash_grouper *hg);
+
+void
+hash_grouper_free (struct hash_grouper *hg);
+
+/* Reports the error MSG (allocated with malloc) of the input line number
+   NUMBER, and exits. In a worker thread of HG, only the worker stops:
+   the main thread reports the error of the first invalid line, as if
+   the lines had been processed in order. */
+noreturn void
+hash_grouper_error (struct hash_grouper *hg, char *msg, size_t number);
+
+#endif
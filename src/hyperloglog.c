@@ -0,0 +1,384 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minmax.h"
+#include "xalloc.h"
+
+#include "system.h"
+#include "hyperloglog.h"
+
+/* Each entry of the sparse list is the index of a register of
+   a sketch of 2^HLL_SPARSE_PRECISION registers, and its rank
+   (in the low HLL_RANK_BITS bits) */
+enum { HLL_SPARSE_PRECISION = 25 };
+enum { HLL_RANK_BITS = 6 };
+#define HLL_RANK_MASK ((UINT32_C (1) << HLL_RANK_BITS) - 1)
+
+/* Initial number of entries of the sparse list */
+enum { HLL_SPARSE_ALLOC = 16 };
+
+struct hll
+{
+  unsigned int precision;
+  uint8_t *registers;   /* 2^PRECISION registers, NULL while sparse */
+
+  /* The sparse list: the first NUM_SORTED entries are sorted (with one
+     entry for each index), the others were added since */
+  uint32_t *sparse;
+  size_t num_sparse;
+  size_t num_sorted;
+  size_t alloc_sparse;
+};
+
+static size_t _GL_ATTRIBUTE_PURE
+hll_num_registers (const struct hll *h)
+{
+  return (size_t) 1 << h->precision;
+}
+
+/* Returns the rank of W: the position of its highest set bit,
+   1 for the top bit.  W must not be zero. */
+static unsigned int _GL_ATTRIBUTE_CONST
+hll_rank (uint64_t w)
+{
+  unsigned int rank = 1;
+  for (; !(w & (UINT64_C (1) << 63)); w <<= 1)
+    ++rank;
+  return rank;
+}
+
+struct hll*
+hll_init (unsigned int precision)
+{
+  assert (precision >= HLL_MIN_PRECISION         /* LCOV_EXCL_LINE */
+          && precision <= HLL_MAX_PRECISION);
+
+  struct hll *h = xcalloc (1, sizeof *h);
+  h->precision = precision;
+  return h;
+}
+
+void
+hll_free (struct hll *h)
+{
+  if (!h)
+    return;
+  free (h->registers);
+  free (h->sparse);
+  free (h);
+}
+
+void
+hll_reset (struct hll *h)
+{
+  /* Start again with the (more accurate) sparse list */
+  free (h->registers);
+  h->registers = NULL;
+  h->num_sparse = 0;
+  h->num_sorted = 0;
+}
+
+size_t _GL_ATTRIBUTE_PURE
+hll_memory (const struct hll *h)
+{
+  return sizeof *h + (h->registers ? hll_num_registers (h) : 0)
+         + h->alloc_sparse * sizeof *h->sparse;
+}
+
+static void
+hll_set_register (struct hll *h, size_t idx, unsigned int rank)
+{
+  if (rank > h->registers[idx])
+    h->registers[idx] = rank;
+}
+
+/* Updates the registers of H with the sparse list ENTRY:
+   the bits of its index below the PRECISION highest ones come
+   before the bits its rank was computed from */
+static void
+hll_add_entry_dense (struct hll *h, uint32_t entry)
+{
+  const unsigned int extra = HLL_SPARSE_PRECISION - h->precision;
+  const uint32_t idx = entry >> HLL_RANK_BITS;
+  const uint32_t low = idx & ((UINT32_C (1) << extra) - 1);
+  const unsigned int rank = low ? hll_rank ((uint64_t) low << (64 - extra))
+                                : extra + (entry & HLL_RANK_MASK);
+  hll_set_register (h, idx >> extra, rank);
+}
+
+static int
+hll_entry_compare (const void *a, const void *b)
+{
+  const uint32_t x = *(const uint32_t *) a;
+  const uint32_t y = *(const uint32_t *) b;
+  return (x > y) - (x < y);
+}
+
+/* Sorts the sparse list of H, keeping the entry with the highest
+   rank for each index */
+static void
+hll_compact (struct hll *h)
+{
+  if (h->num_sorted == h->num_sparse)
+    return;
+
+  qsort (h->sparse, h->num_sparse, sizeof *h->sparse, hll_entry_compare);
+  size_t out = 0;
+  for (size_t i = 0; i < h->num_sparse; ++i)
+    {
+      /* Entries with the same index are sorted by rank */
+      if (out > 0 && (h->sparse[out - 1] >> HLL_RANK_BITS)
+                     == (h->sparse[i] >> HLL_RANK_BITS))
+        h->sparse[out - 1] = h->sparse[i];
+      else
+        h->sparse[out++] = h->sparse[i];
+    }
+  h->num_sparse = out;
+  h->num_sorted = out;
+}
+
+/* Replaces the sparse list of H with the registers */
+static void
+hll_to_dense (struct hll *h)
+{
+  h->registers = xcalloc (hll_num_registers (h), 1);
+  for (size_t i = 0; i < h->num_sparse; ++i)
+    hll_add_entry_dense (h, h->sparse[i]);
+
+  free (h->sparse);
+  h->sparse = NULL;
+  h->alloc_sparse = 0;
+  h->num_sparse = 0;
+  h->num_sorted = 0;
+}
+
+static void
+hll_add_entry (struct hll *h, uint32_t entry)
+{
+  if (h->registers)
+    {
+      hll_add_entry_dense (h, entry);
+      return;
+    }
+
+  /* Skip a repeated value */
+  if (h->num_sparse > 0 && h->sparse[h->num_sparse - 1] == entry)
+    return;
+
+  if (h->num_sparse == h->alloc_sparse)
+    {
+      hll_compact (h);
+      /* Grow the list while it is more than half full after removing
+         the repeated indexes, until it is as large as the registers */
+      if (h->alloc_sparse == 0 || h->num_sparse > h->alloc_sparse / 2)
+        {
+          if (h->alloc_sparse * sizeof *h->sparse >= hll_num_registers (h))
+            {
+              hll_to_dense (h);
+              hll_add_entry_dense (h, entry);
+              return;
+            }
+          h->alloc_sparse = MAX (2 * h->alloc_sparse, HLL_SPARSE_ALLOC);
+          h->sparse = xnrealloc (h->sparse, h->alloc_sparse,
+                                 sizeof *h->sparse);
+        }
+    }
+  h->sparse[h->num_sparse++] = entry;
+}
+
+void
+hll_add (struct hll *h, uint64_t hash)
+{
+  if (h->registers)
+    {
+      /* The guard bit limits the rank to 64-PRECISION+1 */
+      const unsigned int p = h->precision;
+      hll_set_register (h, hash >> (64 - p),
+                        hll_rank ((hash << p) | (UINT64_C (1) << (p - 1))));
+      return;
+    }
+
+  const uint32_t idx = hash >> (64 - HLL_SPARSE_PRECISION);
+  const unsigned int rank = hll_rank ((hash << HLL_SPARSE_PRECISION)
+                         | (UINT64_C (1) << (HLL_SPARSE_PRECISION - 1)));
+  hll_add_entry (h, (idx << HLL_RANK_BITS) | rank);
+}
+
+/* The functions sigma and tau of Ertl's estimator */
+static double _GL_ATTRIBUTE_CONST
+hll_sigma (double x)
+{
+  if (x >= 1)
+    return HUGE_VAL;
+  double y = 1;
+  double z = x;
+  double prev;
+  do
+    {
+      x *= x;
+      prev = z;
+      z += x * y;
+      y += y;
+    }
+  while (z > prev);
+  return z;
+}
+
+static double _GL_ATTRIBUTE_CONST
+hll_tau (double x)
+{
+  if (x <= 0 || x >= 1)
+    return 0;
+  double y = 1;
+  double z = 1 - x;
+  double prev;
+  do
+    {
+      x = sqrt (x);
+      prev = z;
+      y *= 0.5;
+      z -= (1 - x) * (1 - x) * y;
+    }
+  while (z < prev);
+  return z / 3;
+}
+
+/* Returns the estimated cardinality of a sketch of M registers, whose
+   ranks are at most Q+1, and with HIST[K] registers of rank K */
+static double _GL_ATTRIBUTE_PURE
+hll_estimate (const size_t *hist, unsigned int q, double m)
+{
+  double z = m * hll_tau (1 - hist[q + 1] / m);
+  for (unsigned int k = q; k >= 1; --k)
+    z = 0.5 * (z + hist[k]);
+  z += m * hll_sigma (hist[0] / m);
+  return m * m / (2 * log (2) * z);
+}
+
+double
+hll_count (struct hll *h)
+{
+  size_t hist[64] = { 0 };
+
+  if (h->registers)
+    {
+      const size_t m = hll_num_registers (h);
+      for (size_t i = 0; i < m; ++i)
+        ++hist[h->registers[i]];
+      return hll_estimate (hist, 64 - h->precision, m);
+    }
+
+  /* The sparse list gives the registers of a sketch of higher precision */
+  hll_compact (h);
+  const size_t m = (size_t) 1 << HLL_SPARSE_PRECISION;
+  for (size_t i = 0; i < h->num_sparse; ++i)
+    ++hist[h->sparse[i] & HLL_RANK_MASK];
+  hist[0] = m - h->num_sparse;
+  return hll_estimate (hist, 64 - HLL_SPARSE_PRECISION, m);
+}
+
+size_t _GL_ATTRIBUTE_PURE
+hll_state_size (const struct hll *h)
+{
+  size_t n = 3 * sizeof (size_t);
+  if (h && h->registers)
+    n += hll_num_registers (h);
+  else if (h)
+    n += h->num_sparse * sizeof *h->sparse;
+  return n;
+}
+
+/* Appends the N bytes at P to BUF */
+static char *
+hll_append (char *buf, const void *p, size_t n)
+{
+  if (n)
+    memcpy (buf, p, n);
+  return buf + n;
+}
+
+char *
+hll_save_state (const struct hll *h, char *buf)
+{
+  const size_t precision = h ? h->precision : 0;
+  const size_t dense = h && h->registers;
+  const size_t num = !h ? 0 : dense ? hll_num_registers (h) : h->num_sparse;
+  buf = hll_append (buf, &precision, sizeof precision);
+  buf = hll_append (buf, &dense, sizeof dense);
+  buf = hll_append (buf, &num, sizeof num);
+  if (dense)
+    buf = hll_append (buf, h->registers, num);
+  else if (num)
+    buf = hll_append (buf, h->sparse, num * sizeof *h->sparse);
+  return buf;
+}
+
+bool
+hll_merge_state (struct hll *h, FILE *stream)
+{
+  size_t precision, dense, num;
+  if (fread (&precision, sizeof precision, 1, stream) != 1
+      || fread (&dense, sizeof dense, 1, stream) != 1
+      || fread (&num, sizeof num, 1, stream) != 1)
+    return false;
+
+  if (num == 0 && !dense)
+    return true;
+  if (precision != h->precision)
+    return false;
+
+  if (dense)
+    {
+      if (num != hll_num_registers (h))
+        return false;
+      if (!h->registers)
+        hll_to_dense (h);
+      for (size_t i = 0; i < num; ++i)
+        {
+          const int rank = getc (stream);
+          if (rank == EOF || rank > 65 - (int) h->precision)
+            return false;
+          hll_set_register (h, i, rank);
+        }
+      return true;
+    }
+
+  for (size_t i = 0; i < num; ++i)
+    {
+      uint32_t entry;
+      if (fread (&entry, sizeof entry, 1, stream) != 1
+          || (entry >> (HLL_SPARSE_PRECISION + HLL_RANK_BITS)) != 0
+          || (entry & HLL_RANK_MASK) == 0
+          || (entry & HLL_RANK_MASK) > 65 - HLL_SPARSE_PRECISION)
+        return false;
+      hll_add_entry (h, entry);
+    }
+  return true;
+}
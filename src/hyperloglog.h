@@ -0,0 +1,81 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* HyperLogLog: an estimate of the number of distinct values, from their
+   64-bit hash values, in a fixed amount of memory.  A few distinct values
+   are kept as a sorted list of (index, rank) pairs of a sketch of 2^25
+   registers (the sparse representation of HyperLogLog++, see Heule,
+   Nunkesser and Hall, 2013), replaced by an array of 2^PRECISION byte
+   registers once the list would be larger.  The cardinality is estimated
+   with the improved estimator of O. Ertl, "New cardinality estimation
+   algorithms for HyperLogLog sketches" (2017), which does not need the
+   bias correction tables of HyperLogLog++.
+   The standard error is about 1.04/sqrt (2^PRECISION). */
+#ifndef __HYPERLOGLOG_H__
+#define __HYPERLOGLOG_H__
+
+/* Default and allowed values of the precision */
+#define HLL_PRECISION 12
+#define HLL_MIN_PRECISION 4
+#define HLL_MAX_PRECISION 18
+
+struct hll;
+
+/* Returns a new, empty sketch of 2^PRECISION registers
+   (PRECISION between HLL_MIN_PRECISION and HLL_MAX_PRECISION) */
+struct hll*
+hll_init (unsigned int precision);
+
+void
+hll_free (struct hll *h);
+
+/* Removes all values from H */
+void
+hll_reset (struct hll *h);
+
+/* Approximate number of bytes allocated by H */
+size_t
+hll_memory (const struct hll *h);
+
+/* Adds a value, whose 64-bit hash value is HASH */
+void
+hll_add (struct hll *h, uint64_t hash);
+
+/* Returns the estimated number of distinct values added to H */
+double
+hll_count (struct hll *h);
+
+/* Number of bytes written by hll_save_state () */
+size_t
+hll_state_size (const struct hll *h);
+
+/* Writes the state of H (which may be NULL, for an empty sketch)
+   to BUF (hll_state_size () bytes), and returns BUF past the
+   written bytes */
+char *
+hll_save_state (const struct hll *h, char *buf);
+
+/* Reads a state written by hll_save_state () from STREAM, and adds its
+   values to H.  Returns false if the state could not be read, or was
+   saved with a different precision. */
+bool
+hll_merge_state (struct hll *h, FILE *stream);
+
+#endif
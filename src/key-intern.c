@@ -0,0 +1,268 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "xalloc.h"
+
+#include "system.h"
+#include "key-intern.h"
+
+/* Size of the first block of the arena. Each new block is twice
+   as large as the previous one, up to KEY_ARENA_MAX_BLOCK bytes
+   (or larger, for a longer key). */
+enum { KEY_ARENA_BLOCK = 16 * 1024 };
+enum { KEY_ARENA_MAX_BLOCK = 4 * 1024 * 1024 };
+
+/* Initial number of slots in the table (a power of two).
+   The table is kept at most half full. */
+enum { KEY_INTERN_SLOTS = 256 };
+
+struct key_intern_entry
+{
+  const char *key;      /* in the arena, NUL-terminated */
+  size_t len;
+};
+
+/* A slot of the open-addressing (linear probing) table */
+struct key_intern_slot
+{
+  size_t hash;
+  size_t id1;           /* the key's ID plus one, 0 if the slot is empty */
+};
+
+struct key_intern
+{
+  struct key_intern_entry *entries;     /* indexed by ID */
+  size_t num_entries;
+  size_t alloc_entries;
+
+  struct key_intern_slot *slots;
+  size_t mask;                          /* number of slots minus one */
+
+  /* The arena: blocks are never moved or freed before key_intern_free () */
+  char **blocks;
+  size_t num_blocks;
+  size_t alloc_blocks;
+  size_t block_size;    /* size of the next block */
+  char *next;           /* free space in the last block */
+  size_t avail;
+
+  size_t memory;        /* bytes allocated for the arena */
+};
+
+static inline uint64_t _GL_ATTRIBUTE_CONST
+rotl64 (uint64_t x, unsigned int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+/* Mixes the 8-byte word W into the hash value H */
+static inline uint64_t _GL_ATTRIBUTE_CONST
+key_hash_round (uint64_t h, uint64_t w)
+{
+  return rotl64 (h ^ (w * UINT64_C (0xC2B2AE3D27D4EB4F)), 31)
+         * UINT64_C (0x9E3779B97F4A7C15);
+}
+
+/* Hashes 8 bytes at a time (instead of one, as hash_pjw () does),
+   with a final avalanche step (from MurmurHash3) so that all the bits
+   of the result can be used to select a slot. */
+uint64_t _GL_ATTRIBUTE_PURE
+key_intern_hash64 (const char *key, size_t len)
+{
+  uint64_t h = len * UINT64_C (0x9E3779B97F4A7C15);
+  uint64_t w;
+
+  for (; len >= sizeof w; key += sizeof w, len -= sizeof w)
+    {
+      memcpy (&w, key, sizeof w);
+      h = key_hash_round (h, w);
+    }
+  if (len)
+    {
+      w = 0;
+      memcpy (&w, key, len);
+      h = key_hash_round (h, w);
+    }
+
+  h ^= h >> 33;
+  h *= UINT64_C (0xFF51AFD7ED558CCD);
+  h ^= h >> 33;
+  h *= UINT64_C (0xC4CEB9FE1A85EC53);
+  h ^= h >> 33;
+  return h;
+}
+
+size_t _GL_ATTRIBUTE_PURE
+key_intern_hash (const char *key, size_t len)
+{
+  return key_intern_hash64 (key, len);
+}
+
+struct key_intern*
+key_intern_init (void)
+{
+  struct key_intern *ki = XZALLOC (struct key_intern);
+  ki->slots = XCALLOC (KEY_INTERN_SLOTS, struct key_intern_slot);
+  ki->mask = KEY_INTERN_SLOTS - 1;
+  ki->block_size = KEY_ARENA_BLOCK;
+  return ki;
+}
+
+void
+key_intern_free (struct key_intern *ki)
+{
+  if (!ki)
+    return;
+  for (size_t i = 0; i < ki->num_blocks; ++i)
+    free (ki->blocks[i]);
+  free (ki->blocks);
+  free (ki->entries);
+  free (ki->slots);
+  free (ki);
+}
+
+size_t _GL_ATTRIBUTE_PURE
+key_intern_count (const struct key_intern *ki)
+{
+  return ki->num_entries;
+}
+
+size_t _GL_ATTRIBUTE_PURE
+key_intern_memory (const struct key_intern *ki)
+{
+  return ki->memory
+         + ki->alloc_entries * sizeof *ki->entries
+         + (ki->mask + 1) * sizeof *ki->slots;
+}
+
+size_t _GL_ATTRIBUTE_PURE
+key_intern_find (const struct key_intern *ki, const char *key, size_t len,
+                 size_t hash)
+{
+  for (size_t i = hash & ki->mask; ; i = (i + 1) & ki->mask)
+    {
+      const struct key_intern_slot *s = &ki->slots[i];
+      if (!s->id1)
+        return KEY_INTERN_NONE;
+      if (s->hash == hash)
+        {
+          const struct key_intern_entry *e = &ki->entries[s->id1 - 1];
+          if (e->len == len && (len == 0 || memcmp (e->key, key, len) == 0))
+            return s->id1 - 1;
+        }
+    }
+}
+
+/* Stores ID (with the hash value HASH) in the first free slot */
+static void
+key_intern_insert_slot (struct key_intern *ki, size_t hash, size_t id)
+{
+  size_t i = hash & ki->mask;
+  while (ki->slots[i].id1)
+    i = (i + 1) & ki->mask;
+  ki->slots[i].hash = hash;
+  ki->slots[i].id1 = id + 1;
+}
+
+/* Doubles the number of slots */
+static void
+key_intern_grow (struct key_intern *ki)
+{
+  const size_t n = ki->mask + 1;
+  struct key_intern_slot *old = ki->slots;
+
+  ki->slots = XCALLOC (2 * n, struct key_intern_slot);
+  ki->mask = 2 * n - 1;
+  for (size_t i = 0; i < n; ++i)
+    if (old[i].id1)
+      key_intern_insert_slot (ki, old[i].hash, old[i].id1 - 1);
+  free (old);
+}
+
+/* Returns SIZE bytes of the arena */
+static char *
+key_arena_alloc (struct key_intern *ki, size_t size)
+{
+  if (size > ki->avail)
+    {
+      const size_t block = MAX (ki->block_size, size);
+      if (ki->num_blocks == ki->alloc_blocks)
+        ki->blocks = x2nrealloc (ki->blocks, &ki->alloc_blocks,
+                                 sizeof *ki->blocks);
+      ki->next = ki->blocks[ki->num_blocks++] = xmalloc (block);
+      ki->avail = block;
+      ki->memory += block;
+      if (ki->block_size < KEY_ARENA_MAX_BLOCK)
+        ki->block_size *= 2;
+    }
+
+  char *p = ki->next;
+  ki->next += size;
+  ki->avail -= size;
+  return p;
+}
+
+size_t
+key_intern_add (struct key_intern *ki, const char *key, size_t len,
+                size_t hash)
+{
+  if (ki->num_entries + 1 > (ki->mask + 1) / 2)
+    key_intern_grow (ki);
+
+  char *copy = key_arena_alloc (ki, len + 1);
+  if (len)
+    memcpy (copy, key, len);
+  copy[len] = '\0';
+
+  if (ki->num_entries == ki->alloc_entries)
+    ki->entries = x2nrealloc (ki->entries, &ki->alloc_entries,
+                              sizeof *ki->entries);
+  const size_t id = ki->num_entries++;
+  ki->entries[id].key = copy;
+  ki->entries[id].len = len;
+  key_intern_insert_slot (ki, hash, id);
+  return id;
+}
+
+size_t
+key_intern_id (struct key_intern *ki, const char *key, size_t len)
+{
+  const size_t hash = key_intern_hash (key, len);
+  const size_t id = key_intern_find (ki, key, len, hash);
+  if (id != KEY_INTERN_NONE)
+    return id;
+  return key_intern_add (ki, key, len, hash);
+}
+
+const char*
+key_intern_key (const struct key_intern *ki, size_t id, size_t *len)
+{
+  assert (id < ki->num_entries);                 /* LCOV_EXCL_LINE */
+  if (len)
+    *len = ki->entries[id].len;
+  return ki->entries[id].key;
+}
@@ -0,0 +1,76 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Interning of keys: each distinct key (a byte string, which may
+   contain any byte) is stored once, in an arena, and is identified
+   by a dense integer ID (0, 1, 2... in the order the keys were added). */
+#ifndef __KEY_INTERN_H__
+#define __KEY_INTERN_H__
+
+/* Returned by key_intern_find () for a key which was not added */
+#define KEY_INTERN_NONE SIZE_MAX
+
+struct key_intern;
+
+/* Returns the hash value of the LEN bytes at KEY */
+size_t
+key_intern_hash (const char *key, size_t len);
+
+/* Same as key_intern_hash (), with all 64 bits of the hash value
+   (even where size_t is smaller) */
+uint64_t
+key_intern_hash64 (const char *key, size_t len);
+
+struct key_intern*
+key_intern_init (void);
+
+void
+key_intern_free (struct key_intern *ki);
+
+/* Number of keys in KI (the next ID to be assigned) */
+size_t
+key_intern_count (const struct key_intern *ki);
+
+/* Approximate number of bytes allocated by KI */
+size_t
+key_intern_memory (const struct key_intern *ki);
+
+/* Returns the ID of the LEN bytes at KEY (whose hash value is HASH),
+   or KEY_INTERN_NONE if the key was not added to KI */
+size_t
+key_intern_find (const struct key_intern *ki, const char *key, size_t len,
+                 size_t hash);
+
+/* Adds the LEN bytes at KEY (whose hash value is HASH, and which
+   must not be in KI) to KI, and returns its new ID */
+size_t
+key_intern_add (struct key_intern *ki, const char *key, size_t len,
+                size_t hash);
+
+/* Returns the ID of the LEN bytes at KEY, adding it if needed */
+size_t
+key_intern_id (struct key_intern *ki, const char *key, size_t len);
+
+/* Returns the key with the ID ID (NUL-terminated), and stores
+   its length in LEN (if not NULL) */
+const char*
+key_intern_key (const struct key_intern *ki, size_t id, size_t *len);
+
+#endif
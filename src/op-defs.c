@@ -103,6 +103,9 @@ struct field_operation_definition field_operations[] =
   {"getnum",      OP_GETNUM,            MODE_PER_LINE},
   {"cut",         OP_CUT,               MODE_PER_LINE},
   {"echo",        OP_CUT,               MODE_PER_LINE},
+  {"aperc",       OP_APPROX_PERCENTILE, MODE_GROUPBY},
+  {"amedian",     OP_APPROX_MEDIAN,     MODE_GROUPBY},
+  {"acountunique", OP_APPROX_COUNT_UNIQUE, MODE_GROUPBY},
   {NULL,          OP_INVALID,           MODE_INVALID}
 };
 
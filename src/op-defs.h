@@ -91,7 +91,11 @@ enum field_operation
   OP_EXTNAME,       /* guess extension of file name */
   OP_BARENAME,      /* like basename without the guessed extension  */
   OP_GETNUM,        /* Extract a number from a string */
-  OP_CUT            /* like cut (1) */
+  OP_CUT,           /* like cut (1) */
+  OP_APPROX_PERCENTILE, /* Percentile estimated with a t-digest */
+  OP_APPROX_MEDIAN, /* Median estimated with a t-digest */
+  OP_APPROX_COUNT_UNIQUE /* Number of unique values, estimated with
+                            HyperLogLog */
 };
 
 enum processing_mode
@@ -32,6 +32,8 @@
 #include "op-parser.h"
 #include "utils.h"
 #include "field-ops.h"
+#include "tdigest.h"
+#include "hyperloglog.h"
 #include "text-options.h"
 
 static struct datamash_ops *dm = NULL;
@@ -128,6 +130,7 @@ add_group_col (bool by_name, size_t num, const char* name)
 
   p->num = num;
   p->name = NULL;
+  p->op = NULL;
   p->by_name = by_name;
   if (by_name)
     {
@@ -201,6 +204,55 @@ set_op_params (struct fieldop *op)
       return;
     }
 
+  if (op->op==OP_APPROX_COUNT_UNIQUE)
+    {
+      op->params.hll_precision = HLL_PRECISION;
+      if (_params_used==1)
+        {
+          if (_params[0].type != PARAM_INT
+              || _params[0].u < HLL_MIN_PRECISION
+              || _params[0].u > HLL_MAX_PRECISION)
+            die (EXIT_FAILURE, 0, _("invalid precision value %Lg " \
+                 "(expected %d <= X <= %d)"), _params[0].f,
+                 HLL_MIN_PRECISION, HLL_MAX_PRECISION);
+          op->params.hll_precision = _params[0].u;
+        }
+      if (_params_used>1)
+        die (EXIT_FAILURE, 0, _("too many parameters for operation %s"),
+                                    quote (get_field_operation_name (op->op)));
+      return;
+    }
+
+  if (op->op==OP_APPROX_PERCENTILE || op->op==OP_APPROX_MEDIAN)
+    {
+      /* aperc:[PERCENTILE[:COMPRESSION]], amedian[:COMPRESSION] */
+      size_t n = 0;
+      op->params.approx.percentile = 50;
+      op->params.approx.compression = TDIGEST_COMPRESSION;
+      if (op->op==OP_APPROX_PERCENTILE)
+        {
+          op->params.approx.percentile = 95; /* default percentile */
+          if (_params_used>n)
+            op->params.approx.percentile = _params[n++].f;
+          if (!(op->params.approx.percentile >= 0.0
+                && op->params.approx.percentile <= 100.0))
+            die (EXIT_FAILURE, 0, _("invalid percentile value %Lg"),
+                 op->params.approx.percentile);
+        }
+      if (_params_used>n)
+        op->params.approx.compression = _params[n++].f;
+      if (!(op->params.approx.compression >= TDIGEST_MIN_COMPRESSION
+            && op->params.approx.compression <= TDIGEST_MAX_COMPRESSION))
+        die (EXIT_FAILURE, 0, _("invalid compression value %Lg " \
+             "(expected %d <= X <= %d)"),
+             op->params.approx.compression,
+             TDIGEST_MIN_COMPRESSION, TDIGEST_MAX_COMPRESSION);
+      if (_params_used>n)
+        die (EXIT_FAILURE, 0, _("too many parameters for operation %s"),
+                                    quote (get_field_operation_name (op->op)));
+      return;
+    }
+
   if (op->op==OP_SOFTMAX)
     {
       op->params.coldness = 1; /* default thermodynamic beta */
@@ -323,6 +375,8 @@ parse_simple_operation_column (struct parser_field_t /*OUTPUT*/ *p,
       /* fallthrough */
 
     case TOK_FLOAT:
+    case TOK_LPAREN:
+    case TOK_RPAREN:
     default:
       die (EXIT_FAILURE, 0, _("invalid field '%s' for operation %s"),
           scanner_identifier,
@@ -435,6 +489,8 @@ parse_operation_params (enum field_operation op)
         case TOK_COMMA:
         case TOK_DASH:
         case TOK_COLONS:
+        case TOK_LPAREN:
+        case TOK_RPAREN:
         default:
           die (EXIT_FAILURE, 0, _("invalid parameter %s for operation %s"),
                                   scanner_identifier,
@@ -556,6 +612,41 @@ parse_operations (enum processing_mode pm)
     }
 }
 
+/* Parses a group-by key computed by the per-line operation NAME
+   from a column, e.g. 'bin:10(3)' or 'round(price)' */
+static void
+parse_group_key_operation (const char *name)
+{
+  enum processing_mode pm;
+
+  reset_parsed_operation ();
+  fop = get_field_operation (name, &pm);
+  if (!field_op_is_key_transform (fop))
+    die (EXIT_FAILURE, 0, _("invalid group key operation %s"), quote (name));
+
+  parse_operation_params (fop);
+  if (scanner_get_token () != TOK_LPAREN)
+    die (EXIT_FAILURE, 0, _("missing field for operation %s"),
+         quote (get_field_operation_name (fop)));
+
+  struct parser_field_t *f = alloc_next_field ();
+  parse_simple_operation_column (f, false, false);
+  if (scanner_get_token () != TOK_RPAREN)
+    die (EXIT_FAILURE, 0, _("missing ')' after the field of operation %s"),
+         quote (get_field_operation_name (fop)));
+
+  add_group_col (f->by_name, f->num, f->name);
+  struct group_column_t *g = &dm->grps[dm->num_grps - 1];
+  g->op = XZALLOC (struct fieldop);
+  #ifdef _STANDALONE_
+  g->op->op = fop;
+  #else
+  field_op_init (g->op, fop, f->by_name, f->num, f->name);
+  #endif
+  set_op_params (g->op);
+  reset_parsed_operation ();
+}
+
 static void
 parse_mode_column (enum processing_mode pm)
 {
@@ -567,7 +658,17 @@ parse_mode_column (enum processing_mode pm)
   switch (tok)                                   /* LCOV_EXCL_BR */
     {
     case TOK_IDENTIFIER:
-      ADD_NAMED_GROUP (scanner_identifier);
+      {
+        /* A column name, or an operation computing the key,
+           e.g. 'bin:10(3)' */
+        char *name = xstrdup (scanner_identifier);
+        tok = scanner_peek_token ();
+        if (tok == TOK_COLONS || tok == TOK_LPAREN)
+          parse_group_key_operation (name);
+        else
+          ADD_NAMED_GROUP (name);
+        free (name);
+      }
       break;
 
     case TOK_WHITESPACE:                        /* LCOV_EXCL_LINE */
@@ -609,6 +710,8 @@ parse_mode_column (enum processing_mode pm)
     case TOK_DASH:
     case TOK_COLONS:
     case TOK_FLOAT:
+    case TOK_LPAREN:
+    case TOK_RPAREN:
     default:
       die (EXIT_FAILURE, 0, _("invalid field '%s' for operation %s"),
           scanner_identifier,
@@ -728,6 +831,9 @@ parse_mode ()
 
   case MODE_REMOVE_DUPS:
     parse_mode_column_list (pm);
+    if (dm->grps[0].op)
+      die (EXIT_FAILURE, 0, _("operation %s cannot use a computed key"),
+           quote (get_processing_mode_name (pm)));
     break;
 
   case MODE_CROSSTAB:
@@ -836,7 +942,14 @@ datamash_ops_free ( struct datamash_ops* p )
 {
   assert (p != NULL);                            /* LCOV_EXCL_LINE */
   for (size_t i=0; i<p->num_grps; ++i)
-    free (p->grps[i].name);
+    {
+      free (p->grps[i].name);
+      #ifndef _STANDALONE_
+      if (p->grps[i].op)
+        field_op_free (p->grps[i].op);
+      #endif
+      free (p->grps[i].op);
+    }
   free (p->grps);
   p->grps = NULL;
 
@@ -888,10 +1001,14 @@ datamash_ops_debug_print ( const struct datamash_ops* p )
   for (size_t i=0; i<p->num_grps; ++i)
     {
       const struct group_column_t *tmp = &p->grps[i];
+      if (tmp->op)
+        printf ("  group-by '%s' of", get_field_operation_name (tmp->op->op));
+      else
+        printf ("  group-by");
       if (tmp->by_name)
-        printf ("  group-by named column '%s'\n",tmp->name);
+        printf (" named column '%s'\n",tmp->name);
       else
-        printf ("  group-by numeric column %zu\n",tmp->num);
+        printf (" numeric column %zu\n",tmp->num);
     }
 
   for (size_t i=0; i<p->num_ops; ++i)
@@ -28,6 +28,9 @@ struct group_column_t
   bool   by_name;   /* true if the user gave a column name */
   char*  name;      /* column name - to be converted to number after
                        header line is read */
+  struct fieldop *op; /* if not NULL, the key is the result of this
+                         per-line operation on the column,
+                         e.g. 'bin:10(3)' */
 };
 
 struct op_column_t
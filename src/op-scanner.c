@@ -151,6 +151,18 @@ scanner_get_token ()
       set_identifier (":", 1);
       return TOK_COLONS;
     }
+  if (*scan_pos == '(')
+    {
+      ++scan_pos;
+      set_identifier ("(", 1);
+      return TOK_LPAREN;
+    }
+  if (*scan_pos == ')')
+    {
+      ++scan_pos;
+      set_identifier (")", 1);
+      return TOK_RPAREN;
+    }
 
   /* Integer or floating-point value */
   if (c_isdigit (*scan_pos))
@@ -267,6 +279,14 @@ int TESTMAIN (int argc, const char* argv[])
       printf ("TOK_COLONS\n");
       break;
 
+    case TOK_LPAREN:
+      printf ("TOK_LPAREN\n");
+      break;
+
+    case TOK_RPAREN:
+      printf ("TOK_RPAREN\n");
+      break;
+
     default:
       die (EXIT_FAILURE, 0 ,_("unknown token %d\n"),tok);
     }
@@ -33,6 +33,8 @@ enum TOKEN
   TOK_COMMA,
   TOK_DASH,
   TOK_COLONS,
+  TOK_LPAREN,
+  TOK_RPAREN,
   TOK_WHITESPACE
 };
 
@@ -0,0 +1,248 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "die.h"
+#include "linebuffer.h"
+#include "minmax.h"
+#include "quote.h"
+#include "stdnoreturn.h"
+#include "xalloc.h"
+
+#include "system.h"
+#include "text-options.h"
+#include "text-output.h"
+#include "text-lines.h"
+#include "column-headers.h"
+#include "op-defs.h"
+#include "utils.h"
+#include "field-ops.h"
+#include "state-file.h"
+
+/* Beginning of the output of --emit-state */
+static const char state_magic[] = "GNU datamash state 1\n";
+
+/* Writes the string S (of LEN bytes) to the output, after its length */
+static void
+emit_state_string (const char *s, size_t len)
+{
+  output_bytes ((const char *) &len, sizeof len);
+  output_bytes (s, len);
+}
+
+void
+emit_state_header (const char *group_spec, const char **op_args,
+                   size_t num_op_args, bool full_line, bool column_names)
+{
+  const unsigned char format[] = { sizeof (size_t), sizeof (long double),
+                                   case_sensitive, full_line, csv_input };
+  const size_t num_names = column_names ? get_num_column_headers () : 0;
+
+  output_bytes (state_magic, sizeof state_magic - 1);
+  output_bytes ((const char *) format, sizeof format);
+  output_bytes ((const char *) &in_tab, sizeof in_tab);
+
+  output_char (group_spec != NULL);
+  if (group_spec)
+    emit_state_string (group_spec, strlen (group_spec));
+  output_bytes ((const char *) &num_op_args, sizeof num_op_args);
+  for (size_t i = 0; i < num_op_args; ++i)
+    emit_state_string (op_args[i], strlen (op_args[i]));
+
+  output_bytes ((const char *) &num_names, sizeof num_names);
+  for (size_t i = 1; i <= num_names; ++i)
+    emit_state_string (get_input_field_name (i),
+                       strlen (get_input_field_name (i)));
+}
+
+void
+emit_group_state (const struct line_record_t *line,
+                  const struct fieldop *ops, size_t num_ops)
+{
+  emit_state_string (line_record_buffer (line), line_record_length (line));
+  for (size_t i = 0; i < num_ops; ++i)
+    {
+      size_t len;
+      const char *state = field_op_state (&ops[i], &len);
+      output_bytes (state, len);
+    }
+}
+
+void
+invalid_state_file (const struct state_file *sf)
+{
+  die (EXIT_FAILURE, 0, _("%s: invalid state file"), quotef (sf->name));
+}
+
+/* Reads N bytes of the state file SF into P */
+static void
+read_state_file (struct state_file *sf, void *p, size_t n)
+{
+  if (fread (p, 1, n, sf->f) != n)
+    {
+      if (ferror (sf->f))
+        die (EXIT_FAILURE, errno, "%s", quotef (sf->name));
+      invalid_state_file (sf);
+    }
+
+  if (sf->in_header)
+    {
+      if (sf->header_alloc - sf->header_len < n)
+        {
+          sf->header_alloc = MAX (sf->header_alloc * 2, sf->header_len + n);
+          sf->header = xrealloc (sf->header, sf->header_alloc);
+        }
+      memcpy (sf->header + sf->header_len, p, n);
+      sf->header_len += n;
+    }
+}
+
+/* Reads LEN bytes of the state file SF into a new string.
+   The memory grows with the bytes read, so that an invalid length
+   fails at the end of the file (e.g. that of concatenated state files)
+   instead of allocating LEN bytes. */
+static char *
+read_state_bytes (struct state_file *sf, size_t len)
+{
+  enum { STATE_READ_SIZE = 65536 };
+  size_t alloc = MIN (len, STATE_READ_SIZE) + 1;
+  char *buf = xmalloc (alloc);
+
+  for (size_t done = 0; done < len;)
+    {
+      const size_t n = MIN (len - done, STATE_READ_SIZE);
+      if (done + n >= alloc)
+        {
+          alloc = MAX (2 * alloc, done + n + 1);
+          buf = xrealloc (buf, alloc);
+        }
+      read_state_file (sf, buf + done, n);
+      done += n;
+    }
+  buf[len] = '\0';
+  return buf;
+}
+
+/* Reads a string written by emit_state_string () */
+static char *
+read_state_string (struct state_file *sf)
+{
+  size_t len;
+  read_state_file (sf, &len, sizeof len);
+  return read_state_bytes (sf, len);
+}
+
+void
+open_state_file (struct state_file *sf, const char *name)
+{
+  char magic[sizeof state_magic - 1];
+  size_t n;
+
+  memset (sf, 0, sizeof *sf);
+  sf->name = name;
+  sf->f = STREQ (name, "-") ? stdin : fopen (name, "r");
+  if (!sf->f)
+    die (EXIT_FAILURE, errno, "%s", quotef (name));
+
+  sf->in_header = true;
+  if (fread (magic, 1, sizeof magic, sf->f) != sizeof magic
+      || memcmp (magic, state_magic, sizeof magic) != 0)
+    die (EXIT_FAILURE, 0, _("%s: not a datamash state file"), quotef (name));
+
+  read_state_file (sf, sf->format, sizeof sf->format);
+  if (sf->format[0] != sizeof (size_t)
+      || sf->format[1] != sizeof (long double))
+    die (EXIT_FAILURE, 0, _("%s: state file from an incompatible system"),
+         quotef (name));
+  read_state_file (sf, &sf->in_tab, sizeof sf->in_tab);
+
+  unsigned char grouped;
+  read_state_file (sf, &grouped, 1);
+  if (grouped)
+    sf->group_spec = read_state_string (sf);
+
+  /* The arrays grow with the strings read, like read_state_bytes () */
+  size_t alloc = 0;
+  read_state_file (sf, &n, sizeof n);
+  if (n == 0)
+    invalid_state_file (sf);
+  for (sf->num_op_args = 0; sf->num_op_args < n; ++sf->num_op_args)
+    {
+      if (sf->num_op_args == alloc)
+        sf->op_args = x2nrealloc (sf->op_args, &alloc, sizeof *sf->op_args);
+      sf->op_args[sf->num_op_args] = read_state_string (sf);
+    }
+
+  alloc = 0;
+  read_state_file (sf, &n, sizeof n);
+  for (sf->num_names = 0; sf->num_names < n; ++sf->num_names)
+    {
+      if (sf->num_names == alloc)
+        sf->names = x2nrealloc (sf->names, &alloc, sizeof *sf->names);
+      sf->names[sf->num_names] = read_state_string (sf);
+    }
+
+  sf->in_header = false;
+}
+
+bool
+read_state_group (struct state_file *sf, struct line_record_t *line)
+{
+  size_t len;
+  const size_t n = fread (&len, 1, sizeof len, sf->f);
+  if (n == 0 && !ferror (sf->f))
+    return false;
+  if (n != sizeof len)
+    read_state_file (sf, (char *) &len + n, sizeof len - n);
+
+  char *buf = read_state_bytes (sf, len);
+  line_record_assign (line, buf, len);
+  free (buf);
+  return true;
+}
+
+void
+close_state_file (struct state_file *sf)
+{
+  if (sf->f == stdin)
+    clearerr (stdin);
+  else if (fclose (sf->f) != 0)
+    die (EXIT_FAILURE, errno, "%s", quotef (sf->name));
+}
+
+void
+free_state_file (struct state_file *sf)
+{
+  free (sf->header);
+  free (sf->group_spec);
+  for (size_t i = 0; i < sf->num_op_args; ++i)
+    free ((char *) sf->op_args[i]);
+  free (sf->op_args);
+  for (size_t i = 0; i < sf->num_names; ++i)
+    free (sf->names[i]);
+  free (sf->names);
+}
@@ -0,0 +1,87 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* The output of --emit-state, read by 'merge-state': a header with the
+   operations and the options needed to read the groups, then the first
+   line of each group followed by the states of its operations
+   (see field_op_state ()). */
+#ifndef __STATE_FILE_H__
+#define __STATE_FILE_H__
+
+/* A file written with --emit-state, read by 'merge-state' */
+struct state_file
+{
+  FILE *f;
+  const char *name;
+
+  /* The header, as read (to compare the files) */
+  char *header;
+  size_t header_len;
+  size_t header_alloc;
+  bool in_header;
+
+  /* The content of the header */
+  unsigned char format[5];
+  int in_tab;
+  char *group_spec;             /* NULL if -g was not used */
+  const char **op_args;
+  size_t num_op_args;
+  char **names;
+  size_t num_names;
+};
+
+/* Writes the beginning of the output of --emit-state: the options needed
+   to read the states (FULL_LINE is --full), the group-by columns
+   GROUP_SPEC (NULL without grouping) and the NUM_OP_ARGS operation
+   arguments OP_ARGS, and the names of the input columns (if COLUMN_NAMES
+   is true) */
+void
+emit_state_header (const char *group_spec, const char **op_args,
+                   size_t num_op_args, bool full_line, bool column_names);
+
+/* With --emit-state, writes the group whose first line is LINE,
+   and the states of its NUM_OPS operations OPS */
+void
+emit_group_state (const struct line_record_t *line,
+                  const struct fieldop *ops, size_t num_ops);
+
+/* Fails with the name of the state file SF */
+noreturn void
+invalid_state_file (const struct state_file *sf);
+
+/* Opens the state file NAME ("-" is the standard input) into SF,
+   and reads its header (written by emit_state_header ()) */
+void
+open_state_file (struct state_file *sf, const char *name);
+
+/* Reads the first line of the next group of SF into LINE, which is
+   followed by the states of its operations (read them with
+   field_op_merge_state ()). Returns false at the end of the file. */
+bool
+read_state_group (struct state_file *sf, struct line_record_t *line);
+
+void
+close_state_file (struct state_file *sf);
+
+/* Frees the header values read by open_state_file () */
+void
+free_state_file (struct state_file *sf);
+
+#endif
@@ -230,11 +230,12 @@ enum
 
 
 static inline void
-openbsd_pledge ()
+openbsd_pledge (const char *promises _GL_UNUSED)
 {
 #ifdef HAVE_PLEDGE
   /* On OpenBSD, use pledge (2) to limit privileges */
-  pledge ("stdio proc exec rpath", NULL);
+  if (pledge (promises, NULL) != 0)
+    error (EXIT_FAILURE, errno, "pledge");
 #endif
 }
 
@@ -0,0 +1,371 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minmax.h"
+#include "xalloc.h"
+
+#include "system.h"
+#include "utils.h"
+#include "tdigest.h"
+
+struct centroid
+{
+  long double mean;
+  double weight;        /* number of values in the centroid */
+};
+
+struct tdigest
+{
+  double compression;
+  double sin_step;      /* sine and cosine of one unit of the scale */
+  double cos_step;      /* function, see tdigest_q_limit () */
+
+  /* The centroids, sorted by mean, unless UNSORTED
+     (after tdigest_merge_state ()) */
+  struct centroid *c;
+  size_t num;
+  size_t alloc;
+  size_t num_merged;    /* number of centroids after the last merge */
+  bool unsorted;
+
+  /* The values added since the centroids were last merged */
+  long double *buf;
+  size_t num_buf;
+  size_t alloc_buf;
+
+  double total;         /* number of values */
+  long double min, max;
+};
+
+struct tdigest*
+tdigest_init (double compression)
+{
+  assert (compression >= TDIGEST_MIN_COMPRESSION  /* LCOV_EXCL_LINE */
+          && compression <= TDIGEST_MAX_COMPRESSION);
+
+  static const double pi = 3.14159265358979323846;
+  struct tdigest *td = xcalloc (1, sizeof *td);
+  td->compression = compression;
+  td->sin_step = sin (pi / (2 * compression));
+  td->cos_step = cos (pi / (2 * compression));
+  return td;
+}
+
+void
+tdigest_free (struct tdigest *td)
+{
+  if (!td)
+    return;
+  free (td->c);
+  free (td->buf);
+  free (td);
+}
+
+void
+tdigest_reset (struct tdigest *td)
+{
+  td->num = 0;
+  td->num_merged = 0;
+  td->unsorted = false;
+  td->num_buf = 0;
+  td->total = 0;
+  td->min = td->max = 0;
+}
+
+size_t _GL_ATTRIBUTE_PURE
+tdigest_memory (const struct tdigest *td)
+{
+  return sizeof *td + td->alloc * sizeof *td->c
+         + td->alloc_buf * sizeof *td->buf;
+}
+
+/* Number of values added before merging them into the centroids */
+static size_t _GL_ATTRIBUTE_PURE
+tdigest_max_buffer (const struct tdigest *td)
+{
+  return 2 * (size_t) ceil (td->compression);
+}
+
+static bool _GL_ATTRIBUTE_PURE
+tdigest_empty (const struct tdigest *td)
+{
+  return td->num == 0 && td->num_buf == 0;
+}
+
+static int
+centroid_compare (const void *a, const void *b)
+{
+  const struct centroid *x = a;
+  const struct centroid *y = b;
+  return (x->mean > y->mean) - (x->mean < y->mean);
+}
+
+/* The scale function k1 of the t-digest maps the quantile Q to
+   2*COMPRESSION/pi * asin (2Q-1).  A centroid starting at quantile Q
+   may extend up to the quantile one unit of the scale further,
+   which is returned.  Centroids are thus smaller near the tails;
+   there are about 2.5*COMPRESSION of them, and those around the median
+   hold up to pi/(4*COMPRESSION) of the values.  (With the usual
+   COMPRESSION/(2*pi) factor, they hold up to 3% of the values with
+   a compression of 100, and the rank of the estimated median is often
+   1% away.)
+   With S = 2Q-1 = sin (A), this is (sin (A + pi/(2*COMPRESSION)) + 1) / 2,
+   or 1 once A + pi/(2*COMPRESSION) reaches pi/2. */
+static double _GL_ATTRIBUTE_PURE
+tdigest_q_limit (const struct tdigest *td, double q)
+{
+  const double s = 2 * q - 1;
+  if (s >= td->cos_step)
+    return 1;
+  return (s * td->cos_step + sqrt (1 - s * s) * td->sin_step + 1) / 2;
+}
+
+/* Sorts the centroids and the added values of TD */
+static void
+tdigest_sort (struct tdigest *td)
+{
+  if (td->unsorted)
+    qsort (td->c, td->num, sizeof *td->c, centroid_compare);
+  td->unsorted = false;
+  sortfl (td->buf, td->num_buf);
+}
+
+/* Stores in C the next centroid of TD (sorted with tdigest_sort ())
+   by increasing mean, from the centroids at position *I and the added
+   values (as centroids of one value) at position *J.
+   Returns false once all were stored. */
+static bool
+tdigest_next (const struct tdigest *td, size_t *i, size_t *j,
+              struct centroid *c)
+{
+  if (*j < td->num_buf && (*i == td->num || td->buf[*j] < td->c[*i].mean))
+    {
+      c->mean = td->buf[(*j)++];
+      c->weight = 1;
+      return true;
+    }
+  if (*i < td->num)
+    {
+      *c = td->c[(*i)++];
+      return true;
+    }
+  return false;
+}
+
+/* Merges the added values into the centroids of TD, merging adjacent
+   centroids as long as they stay within the limit of the scale function */
+static void
+tdigest_flush (struct tdigest *td)
+{
+  const size_t n = td->num + td->num_buf;
+  if (n == 0)
+    return;
+
+  tdigest_sort (td);
+  struct centroid *c = xnmalloc (n, sizeof *c);
+  size_t i = 0, j = 0, out = 0;
+  double before = 0;  /* weight of the centroids before C[OUT] */
+  double limit = td->total * tdigest_q_limit (td, 0);
+  struct centroid next;
+  tdigest_next (td, &i, &j, &c[0]);
+  while (tdigest_next (td, &i, &j, &next))
+    {
+      const double w = c[out].weight + next.weight;
+      if (before + w <= limit)
+        {
+          c[out].mean += (next.mean - c[out].mean) * (next.weight / w);
+          c[out].weight = w;
+        }
+      else
+        {
+          before += c[out].weight;
+          limit = td->total * tdigest_q_limit (td, before / td->total);
+          c[++out] = next;
+        }
+    }
+
+  free (td->c);
+  td->c = c;
+  td->num = out + 1;
+  td->num_merged = td->num;
+  td->alloc = n;
+  td->num_buf = 0;
+}
+
+/* Adds a centroid of WEIGHT values whose mean is MEAN */
+static void
+tdigest_add_centroid (struct tdigest *td, long double mean, double weight)
+{
+  if (td->num == td->alloc)
+    td->c = x2nrealloc (td->c, &td->alloc, sizeof *td->c);
+  td->c[td->num].mean = mean;
+  td->c[td->num].weight = weight;
+  ++td->num;
+  td->unsorted = true;
+  td->total += weight;
+}
+
+void
+tdigest_add (struct tdigest *td, long double value)
+{
+  if (td->num_buf == td->alloc_buf)
+    {
+      /* Values are merged into the centroids by batches of twice
+         the compression (keeping the cost of the merges low).
+         The buffer grows up to that size, like the buffers of the other
+         operations: with --hash-group, each group has its own digest. */
+      const size_t max_buf = tdigest_max_buffer (td);
+      if (td->alloc_buf < max_buf)
+        {
+          td->alloc_buf = MIN (MAX (2 * td->alloc_buf, 16), max_buf);
+          td->buf = xnrealloc (td->buf, td->alloc_buf, sizeof *td->buf);
+        }
+      else
+        tdigest_flush (td);
+    }
+
+  if (tdigest_empty (td) || value < td->min)
+    td->min = value;
+  if (tdigest_empty (td) || value > td->max)
+    td->max = value;
+  td->buf[td->num_buf++] = value;
+  ++td->total;
+}
+
+long double
+tdigest_quantile (struct tdigest *td, double q)
+{
+  assert (q >= 0 && q <= 1);                     /* LCOV_EXCL_LINE */
+
+  /* The values of a centroid are centered around its mean:
+     interpolate between the means of adjacent centroids, using the rank
+     of their centers, and between the minimum (and maximum) value
+     and the first (and last) centroid.  With ranks 0..TOTAL-1, this
+     is the same as quantile_value () for centroids of one value. */
+  tdigest_sort (td);
+  size_t i = 0, j = 0;
+  struct centroid c, next;
+  if (!tdigest_next (td, &i, &j, &c))
+    return nanl ("");
+
+  const double h = (td->total - 1) * q;
+  double center = (c.weight - 1) / 2;
+  if (h <= center)
+    return (center > 0) ? td->min + (c.mean - td->min) * (h / center)
+                        : c.mean;
+
+  double before = 0;    /* weight of the centroids before C */
+  while (tdigest_next (td, &i, &j, &next))
+    {
+      const double next_center = before + c.weight + (next.weight - 1) / 2;
+      if (h < next_center)
+        return c.mean + (h - center) / (next_center - center)
+                        * (next.mean - c.mean);
+      before += c.weight;
+      center = next_center;
+      c = next;
+    }
+
+  const double last = td->total - 1;
+  if (h > center && last > center)
+    return c.mean + (td->max - c.mean) * ((h - center) / (last - center));
+  return c.mean;
+}
+
+size_t _GL_ATTRIBUTE_PURE
+tdigest_state_size (const struct tdigest *td)
+{
+  const size_t num = td ? td->num + td->num_buf : 0;
+  return sizeof num + 2 * sizeof td->min
+         + num * (sizeof td->c->mean + sizeof td->c->weight);
+}
+
+/* Appends the N bytes at P to BUF */
+static char *
+tdigest_append (char *buf, const void *p, size_t n)
+{
+  memcpy (buf, p, n);
+  return buf + n;
+}
+
+char *
+tdigest_save_state (const struct tdigest *td, char *buf)
+{
+  const size_t num = td ? td->num + td->num_buf : 0;
+  const long double min = td ? td->min : 0;
+  const long double max = td ? td->max : 0;
+  buf = tdigest_append (buf, &num, sizeof num);
+  buf = tdigest_append (buf, &min, sizeof min);
+  buf = tdigest_append (buf, &max, sizeof max);
+  /* Written member by member, without the structure's padding */
+  for (size_t i = 0; i < num; ++i)
+    {
+      const bool value = (i >= td->num);
+      const long double mean = value ? td->buf[i - td->num] : td->c[i].mean;
+      const double weight = value ? 1 : td->c[i].weight;
+      buf = tdigest_append (buf, &mean, sizeof mean);
+      buf = tdigest_append (buf, &weight, sizeof weight);
+    }
+  return buf;
+}
+
+bool
+tdigest_merge_state (struct tdigest *td, FILE *stream)
+{
+  size_t num;
+  long double min, max;
+  if (fread (&num, sizeof num, 1, stream) != 1
+      || fread (&min, sizeof min, 1, stream) != 1
+      || fread (&max, sizeof max, 1, stream) != 1)
+    return false;
+
+  if (num == 0)
+    return true;
+
+  if (tdigest_empty (td) || min < td->min)
+    td->min = min;
+  if (tdigest_empty (td) || max > td->max)
+    td->max = max;
+
+  for (size_t i = 0; i < num; ++i)
+    {
+      long double mean;
+      double weight;
+      if (fread (&mean, sizeof mean, 1, stream) != 1
+          || fread (&weight, sizeof weight, 1, stream) != 1
+          || !(weight > 0))
+        return false;
+      tdigest_add_centroid (td, mean, weight);
+
+      /* Merge them by batches, like tdigest_add () */
+      if (td->num - td->num_merged >= tdigest_max_buffer (td))
+        tdigest_flush (td);
+    }
+  return true;
+}
@@ -0,0 +1,77 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* t-digest: an approximation of the distribution of numeric values,
+   used to estimate their quantiles in a fixed amount of memory.
+   The values are summarized as centroids (a mean and a weight), which
+   are smaller near the tails of the distribution.  Digests of separate
+   runs of values can be merged.  See T. Dunning and O. Ertl,
+   "Computing Extremely Accurate Quantiles Using t-Digests" (2019). */
+#ifndef __TDIGEST_H__
+#define __TDIGEST_H__
+
+/* Default and allowed values of the compression parameter,
+   which bounds the number of centroids kept */
+#define TDIGEST_COMPRESSION 100
+#define TDIGEST_MIN_COMPRESSION 10
+#define TDIGEST_MAX_COMPRESSION 100000
+
+struct tdigest;
+
+/* Returns a new, empty digest with the given compression
+   (between TDIGEST_MIN_COMPRESSION and TDIGEST_MAX_COMPRESSION) */
+struct tdigest*
+tdigest_init (double compression);
+
+void
+tdigest_free (struct tdigest *td);
+
+/* Removes all values from TD (keeping its memory) */
+void
+tdigest_reset (struct tdigest *td);
+
+/* Approximate number of bytes allocated by TD */
+size_t
+tdigest_memory (const struct tdigest *td);
+
+void
+tdigest_add (struct tdigest *td, long double value);
+
+/* Returns the estimated quantile Q (0 <= Q <= 1) of the values added
+   to TD, interpolated like quantile_value () (and equal to it while
+   TD holds each value in its own centroid), or NAN if TD is empty. */
+long double
+tdigest_quantile (struct tdigest *td, double q);
+
+/* Number of bytes written by tdigest_save_state () */
+size_t
+tdigest_state_size (const struct tdigest *td);
+
+/* Writes the state of TD to BUF (tdigest_state_size () bytes),
+   and returns BUF past the written bytes */
+char *
+tdigest_save_state (const struct tdigest *td, char *buf);
+
+/* Reads a state written by tdigest_save_state () from STREAM, and adds
+   its values to TD.  Returns false if the state could not be read. */
+bool
+tdigest_merge_state (struct tdigest *td, FILE *stream);
+
+#endif
@@ -24,6 +24,11 @@
 #include <assert.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 
 #include "system.h"
 #ifndef MAX
@@ -31,15 +36,26 @@
 #endif
 #include "linebuffer.h"
 #include "xalloc.h"
+#include "safe-read.h"
+#include "ignore-value.h"
 
 #include "text-options.h"
 #include "text-lines.h"
+#include "text-scan.h"
+#include "decompress.h"
 #include "die.h"
 
 void
 line_record_init (struct line_record_t* lr)
 {
   initbuffer (&lr->lbuf);
+  lr->buf = NULL;
+  lr->len = 0;
+  lr->truncated = false;
+  lr->trailing_comments = false;
+  lr->transient = false;
+  lr->unquoted = NULL;
+  lr->unquoted_alloc = 0;
   lr->alloc_fields = 10 ;
   lr->num_fields = 0;
   lr->fields = XNMALLOC (lr->alloc_fields, struct field_record_t);
@@ -50,9 +66,9 @@ static void
 line_record_debug_print_fields (const struct line_record_t *lr)
 {
   fputs ("line_record_t = {\n",stderr);
-  fprintf (stderr, "  linebuffer.length = %zu\n", lr->lbuf.length);
-  fputs ("  linebuffer.buffer = '",stderr);
-    fwrite (lr->lbuf.buffer,lr->lbuf.length,sizeof (char),stderr);
+  fprintf (stderr, "  length = %zu\n", lr->len);
+  fputs ("  buffer = '",stderr);
+    fwrite (lr->buf,lr->len,sizeof (char),stderr);
   fputs ("'\n",stderr);
 
   fprintf (stderr, "  num_fields = %zu\n", lr->num_fields);
@@ -91,106 +107,528 @@ line_record_reserve_fields (struct line_record_t* lr, const size_t n)
     }
 }
 
+static inline void
+line_record_add_field (struct line_record_t *lr, size_t *num_fields,
+                       const char* beg, size_t len)
+{
+  line_record_reserve_fields (lr, *num_fields);
+  lr->fields[*num_fields].buf = beg;
+  lr->fields[*num_fields].len = len;
+  ++(*num_fields);
+}
+
+/* Byte sets used to find field boundaries, built on first use
+   (or when the field delimiter changes). */
+static struct
+{
+  int delim;                     /* field delimiter, or -1 if not built */
+  bool vector;                   /* false if there are too many blanks */
+  struct text_scan_set plain;    /* the delimiter (or the blank characters) */
+  struct text_scan_set comment;  /* same as 'plain', plus '#' */
+} field_sets = { -1, false, { { 0 }, { false } }, { { 0 }, { false } } };
+
 static void
-line_record_parse_fields (/* The buffer. May or may not be the one in the
-                             following argument */
-                          const struct linebuffer* lbuf,
+field_sets_prepare (int field_delim)
+{
+  char chars[TEXT_SCAN_MAX_CHARS];
+  size_t n = 0;
 
-                          /* Used ONLY for the fields. The buffer is picked up
-                             from the above argument */
+  if (field_sets.delim == field_delim)
+    return;
+  field_sets.delim = field_delim;
+  field_sets.vector = true;
+
+  if (field_delim != TAB_WHITESPACE)
+    chars[n++] = field_delim;
+  else
+    {
+      for (int c = 0; c <= UCHAR_MAX; ++c)
+        {
+          if (!blanks[c])
+            continue;
+          /* Leave room for the comment character */
+          if (n == TEXT_SCAN_MAX_CHARS - 1)
+            {
+              field_sets.vector = false;
+              return;
+            }
+          chars[n++] = c;
+        }
+      if (n == 0)
+        {
+          field_sets.vector = false;
+          return;
+        }
+    }
+
+  text_scan_set_init (&field_sets.plain, chars, n);
+  chars[n++] = '#';
+  text_scan_set_init (&field_sets.comment, chars, n);
+}
+
+/* Finds bytes of a text_scan_set in a buffer,
+   one TEXT_SCAN_BLOCK-sized block at a time. */
+struct scan_cursor
+{
+  const char *buf;
+  size_t len;
+  const struct text_scan_set *set;
+  size_t base;       /* offset of the current block */
+  uint64_t mask;     /* members of 'set' in the current block */
+  uint64_t valid;    /* valid bytes in the current block */
+};
+
+static inline void
+scan_cursor_init (struct scan_cursor *c, const char *buf, size_t len,
+                  const struct text_scan_set *set)
+{
+  c->buf = buf;
+  c->len = len;
+  c->set = set;
+  c->base = SIZE_MAX;
+  c->mask = c->valid = 0;
+}
+
+/* Returns the position of the first byte at or after POS which is
+   (if MEMBER is true) or is not (if MEMBER is false) in the cursor's set.
+   Returns the buffer length if there is no such byte. */
+static inline size_t
+scan_cursor_next (struct scan_cursor *c, size_t pos, bool member)
+{
+  while (pos < c->len)
+    {
+      if (pos < c->base || pos - c->base >= TEXT_SCAN_BLOCK)
+        {
+          const size_t n = MIN (c->len - pos, TEXT_SCAN_BLOCK);
+          c->base = pos;
+          c->mask = text_scan_block (c->buf + pos, n, c->set);
+          c->valid = (n == TEXT_SCAN_BLOCK) ? UINT64_MAX
+                                            : ((((uint64_t) 1) << n) - 1);
+        }
+
+      const uint64_t m = ((member ? c->mask : ~c->mask) & c->valid)
+                         >> (pos - c->base);
+      if (m)
+        return pos + text_scan_first (m);
+      pos = c->base + TEXT_SCAN_BLOCK;
+    }
+  return c->len;
+}
+
+/* Split fields on a single delimiter character */
+static void
+line_record_parse_delimited (const char* buf, size_t buflen,
+                             struct line_record_t *lr,
+                             bool ignore_trailing_comments,
+                             size_t max_fields)
+{
+  size_t num_fields = 0;
+  size_t beg = 0;
+  struct scan_cursor cur;
+
+  scan_cursor_init (&cur, buf, buflen,
+                    ignore_trailing_comments ? &field_sets.comment
+                                             : &field_sets.plain);
+
+  while (buflen)
+    {
+      const size_t end = scan_cursor_next (&cur, beg, true);
+
+      /* A trailing comment ends the line. A field which was cut
+         by the comment character is kept, an empty one is not. */
+      if (ignore_trailing_comments && end < buflen && buf[end] == '#')
+        {
+          if (end > beg)
+            line_record_add_field (lr, &num_fields, buf + beg, end - beg);
+          break;
+        }
+
+      line_record_add_field (lr, &num_fields, buf + beg, end - beg);
+      if (end == buflen)
+        break;
+      if (num_fields == max_fields)
+        {
+          lr->truncated = true;
+          break;
+        }
+      beg = end + 1; /* Skip the delimiter */
+    }
+  lr->num_fields = num_fields;
+}
+
+/* Split fields on white-space transitions
+   (multiple whitespaces are one delimiter) */
+static void
+line_record_parse_blanks (const char* buf, size_t buflen,
                           struct line_record_t *lr,
-                          int field_delim,
                           bool ignore_trailing_comments,
-                          bool ignore_trailing_whitespace)
+                          bool ignore_trailing_whitespace,
+                          size_t max_fields)
 {
   size_t num_fields = 0;
   size_t pos = 0;
-  const size_t buflen = lbuf->length;
-  const char*  fptr   = lbuf->buffer;
+  struct scan_cursor blank, field_end;
 
-#define IS_TRAILING_COMMENT \
-  (ignore_trailing_comments && (*fptr == '#'))
+#define IS_COMMENT_AT(p) \
+  (ignore_trailing_comments && (p) < buflen && buf[(p)] == '#')
 
-  /* Move 'fptr' to point to the beginning of 'field' */
-  if (field_delim != TAB_WHITESPACE)
+  scan_cursor_init (&blank, buf, buflen, &field_sets.plain);
+  scan_cursor_init (&field_end, buf, buflen,
+                    ignore_trailing_comments ? &field_sets.comment
+                                             : &field_sets.plain);
+
+  while (pos < buflen && !IS_COMMENT_AT (pos))
     {
-      while (buflen && pos<=buflen && !IS_TRAILING_COMMENT)
+      /* Skip leading whitespace */
+      const size_t beg = scan_cursor_next (&blank, pos, false);
+
+      /* Scan buffer until next whitespace (or comment) */
+      size_t end = beg;
+      if (beg < buflen && !IS_COMMENT_AT (beg))
+        end = scan_cursor_next (&field_end, beg, true);
+
+      /* Add new field */
+      if (!ignore_trailing_whitespace || end > beg)
+        line_record_add_field (lr, &num_fields, buf + beg, end - beg);
+
+      if (IS_COMMENT_AT (end))
+        break;
+      if (num_fields == max_fields && end < buflen)
         {
-          /* scan buffer until next delimiter */
-          const char* field_beg = fptr;
-          while (pos<buflen
-                 && !IS_TRAILING_COMMENT
-                 && (*fptr != field_delim))
-            {
-              ++fptr;
-              ++pos;
-            }
+          lr->truncated = true;
+          break;
+        }
+      pos = end;
+    }
+  lr->num_fields = num_fields;
+#undef IS_COMMENT_AT
+}
 
-          /* Add new field */
-          line_record_reserve_fields (lr, num_fields);
-          lr->fields[num_fields].buf = field_beg;
-          lr->fields[num_fields].len = fptr - field_beg;
-          ++num_fields;
+/* Split fields on white-space transitions, one byte at a time.
+   Used when the locale has too many blank characters for the
+   text-scan kernels. */
+static void
+line_record_parse_blanks_bytewise (const char* buf, size_t buflen,
+                                   struct line_record_t *lr,
+                                   bool ignore_trailing_comments,
+                                   bool ignore_trailing_whitespace,
+                                   size_t max_fields)
+{
+  size_t num_fields = 0;
+  size_t pos = 0;
+  const char*  fptr   = buf;
 
-          if (IS_TRAILING_COMMENT)
-            pos = buflen;
+#define IS_TRAILING_COMMENT \
+  (ignore_trailing_comments && (*fptr == '#'))
 
-          /* Skip the delimiter */
+  while (pos<buflen && !IS_TRAILING_COMMENT)
+    {
+      /* Skip leading whitespace */
+      while (pos<buflen
+             && !IS_TRAILING_COMMENT
+             && blanks[to_uchar (*fptr)])
+        {
+          ++fptr;
           ++pos;
+        }
+
+      /* Scan buffer until next whitespace */
+      const char* field_beg = fptr;
+      size_t flen = 0;
+      while (pos<buflen
+             && !IS_TRAILING_COMMENT
+             && !blanks[to_uchar (*fptr)])
+        {
           ++fptr;
+          ++pos;
+          ++flen;
+        }
+
+      /* Add new field */
+      if (!ignore_trailing_whitespace || flen > 0)
+        line_record_add_field (lr, &num_fields, field_beg, flen);
+
+      if (num_fields == max_fields && pos < buflen)
+        {
+          lr->truncated = true;
+          break;
         }
-      lr->num_fields = num_fields;
     }
-  else
+  lr->num_fields = num_fields;
+#undef IS_TRAILING_COMMENT
+}
+
+/* Returns the quoting state after each byte of a 64-byte block:
+   bit I is set if byte I is inside a quoted field, given the positions
+   of the quote characters in QUOTES (and the state before the block in
+   CARRY, all ones or all zeros). This is a carry-less multiplication of
+   QUOTES by all ones, i.e. an XOR of all the lower bits. */
+static inline uint64_t
+csv_quote_mask (uint64_t quotes, uint64_t carry)
+{
+  quotes ^= quotes << 1;
+  quotes ^= quotes << 2;
+  quotes ^= quotes << 4;
+  quotes ^= quotes << 8;
+  quotes ^= quotes << 16;
+  quotes ^= quotes << 32;
+  return quotes ^ carry;
+}
+
+/* Byte sets used by the CSV tokenizer, built on first use */
+static struct
+{
+  int eol;                       /* line delimiter, or -1 if not built */
+  struct text_scan_set quote;    /* the quote character */
+  struct text_scan_set eol_set;  /* the line delimiter */
+} csv_sets = { -1, { { 0 }, { false } }, { { 0 }, { false } } };
+
+static void
+csv_sets_prepare (char eol)
+{
+  if (csv_sets.eol == to_uchar (eol))
+    return;
+  csv_sets.eol = to_uchar (eol);
+  text_scan_set_init (&csv_sets.quote, "\"", 1);
+  text_scan_set_init (&csv_sets.eol_set, &eol, 1);
+}
+
+/* Returns the first line delimiter EOL in [P,END) which is not inside
+   a quoted field, or NULL. *IN_QUOTES is the quoting state at P;
+   if NULL is returned, it is updated to the state at END. */
+static const char *
+csv_find_eol (const char *p, const char *end, char eol, bool *in_quotes)
+{
+  uint64_t carry = *in_quotes ? UINT64_MAX : 0;
+
+  csv_sets_prepare (eol);
+  while (p < end)
     {
-      /* delimiter is white-space transition
-         (multiple whitespaces are one delimiter) */
-      while (pos<buflen && !IS_TRAILING_COMMENT)
+      const size_t n = MIN ((size_t) (end - p), TEXT_SCAN_BLOCK);
+      const uint64_t inside =
+        csv_quote_mask (text_scan_block (p, n, &csv_sets.quote), carry);
+      const uint64_t eols = text_scan_block (p, n, &csv_sets.eol_set)
+                            & ~inside;
+      if (eols)
         {
-          /* Skip leading whitespace */
-          while (pos<buflen
-                 && !IS_TRAILING_COMMENT
-                 && blanks[to_uchar (*fptr)])
-            {
-              ++fptr;
-              ++pos;
-            }
+          *in_quotes = false;
+          return p + text_scan_first (eols);
+        }
+      carry = (inside >> 63) ? UINT64_MAX : 0;
+      p += n;
+    }
+  *in_quotes = (carry != 0);
+  return NULL;
+}
 
-          /* Scan buffer until next whitespace */
-          const char* field_beg = fptr;
-          size_t flen = 0;
-          while (pos<buflen
-                 && !IS_TRAILING_COMMENT
-                 && !blanks[to_uchar (*fptr)])
-            {
-              ++fptr;
-              ++pos;
-              ++flen;
-            }
+static void
+csv_unterminated_quote (void)
+{
+  die (EXIT_FAILURE, 0, _("invalid CSV input: unterminated quoted field"));
+}
+
+/* Finds the end of the line beginning at P (see csv_find_eol) */
+static inline const char *
+line_find_eol (const char *p, const char *end, char delimiter,
+               bool *in_quotes)
+{
+  if (csv_input)
+    return csv_find_eol (p, end, delimiter, in_quotes);
+  return memchr (p, delimiter, end - p);
+}
+
+/* Adds a CSV field. If it contains quotes (QUOTED is true), they are
+   removed (and doubled quotes inside a quoted part are replaced by
+   a single quote) into the record's 'unquoted' buffer. */
+static inline void
+line_record_add_csv_field (struct line_record_t *lr, size_t *num_fields,
+                           const char *beg, size_t len, bool quoted,
+                           size_t *unquoted_used)
+{
+  if (!quoted)
+    {
+      line_record_add_field (lr, num_fields, beg, len);
+      return;
+    }
+
+  char *out = lr->unquoted + *unquoted_used;
+  const char *end = beg + len;
+  size_t n = 0;
+  bool in_quotes = false;
+  for (const char *p = beg; p < end; ++p)
+    {
+      if (*p != '"')
+        out[n++] = *p;
+      else if (in_quotes && p + 1 < end && p[1] == '"')
+        out[n++] = *p++;
+      else
+        in_quotes = !in_quotes;
+    }
+  *unquoted_used += n;
+  line_record_add_field (lr, num_fields, out, n);
+}
+
+/* Split CSV fields on the field delimiter, unless it is inside quotes.
+   Fields without quotes point into BUF; only quoted fields are copied. */
+static void
+line_record_parse_csv (const char* buf, size_t buflen,
+                       struct line_record_t *lr, size_t max_fields)
+{
+  size_t num_fields = 0;
+  size_t beg = 0;
+  size_t unquoted_used = 0;
+  bool quoted = false;      /* the current field contains a quote */
+  uint64_t carry = 0;
+
+  if (buflen == 0)
+    {
+      lr->num_fields = 0;
+      return;
+    }
+
+  /* The unquoted fields are never longer than the line */
+  if (lr->unquoted_alloc < buflen)
+    {
+      lr->unquoted_alloc = MAX (buflen, lr->unquoted_alloc * 2);
+      free (lr->unquoted);
+      lr->unquoted = xmalloc (lr->unquoted_alloc);
+    }
+
+  csv_sets_prepare (eolchar);
+  for (size_t base = 0; base < buflen; base += TEXT_SCAN_BLOCK)
+    {
+      const size_t n = MIN (buflen - base, TEXT_SCAN_BLOCK);
+      uint64_t quotes = text_scan_block (buf + base, n, &csv_sets.quote);
+      const uint64_t inside = csv_quote_mask (quotes, carry);
+      uint64_t delims = text_scan_block (buf + base, n, &field_sets.plain)
+                        & ~inside;
+      carry = (inside >> 63) ? UINT64_MAX : 0;
 
-          /* Add new field */
-          if (!ignore_trailing_whitespace || flen > 0)
+      while (delims)
+        {
+          const unsigned int i = text_scan_first (delims);
+          quoted = quoted || (quotes & ((((uint64_t) 1) << i) - 1));
+          line_record_add_csv_field (lr, &num_fields, buf + beg,
+                                     base + i - beg, quoted, &unquoted_used);
+          if (num_fields == max_fields)
             {
-              line_record_reserve_fields (lr, num_fields);
-              lr->fields[num_fields].buf = field_beg;
-              lr->fields[num_fields].len = flen;
-              ++num_fields;
+              lr->truncated = true;
+              lr->num_fields = num_fields;
+              return;
             }
+          /* Forget the quotes of this field */
+          quotes &= ~((((uint64_t) 2) << i) - 1);
+          delims &= delims - 1;
+          beg = base + i + 1;
+          quoted = false;
         }
-      lr->num_fields = num_fields;
+      quoted = quoted || quotes;
     }
+
+  line_record_add_csv_field (lr, &num_fields, buf + beg, buflen - beg,
+                             quoted, &unquoted_used);
+  lr->num_fields = num_fields;
 }
 
+static void
+line_record_parse_fields (/* The buffer. May or may not be the one in the
+                             following argument */
+                          const char* buf, size_t buflen,
 
-static bool
-line_record_is_comment (const struct line_record_t* lr)
+                          /* Used ONLY for the fields. The buffer is picked up
+                             from the above argument */
+                          struct line_record_t *lr,
+                          int field_delim,
+                          bool ignore_trailing_comments,
+                          bool ignore_trailing_whitespace,
+
+                          /* Stop after this many fields (0 = split the
+                             entire line) */
+                          size_t max_fields)
+{
+  field_sets_prepare (field_delim);
+  lr->truncated = false;
+  lr->trailing_comments = ignore_trailing_comments;
+
+  if (csv_input && field_delim != TAB_WHITESPACE)
+    line_record_parse_csv (buf, buflen, lr, max_fields);
+  else if (field_delim != TAB_WHITESPACE)
+    line_record_parse_delimited (buf, buflen, lr, ignore_trailing_comments,
+                                 max_fields);
+  else if (field_sets.vector)
+    line_record_parse_blanks (buf, buflen, lr, ignore_trailing_comments,
+                              ignore_trailing_whitespace, max_fields);
+  else
+    line_record_parse_blanks_bytewise (buf, buflen, lr,
+                                       ignore_trailing_comments,
+                                       ignore_trailing_whitespace,
+                                       max_fields);
+}
+
+void
+line_record_parse_all (struct line_record_t *lr)
+{
+  if (!lr->truncated)
+    return;
+
+  line_record_parse_fields (line_record_buffer (lr), line_record_length (lr),
+                            lr, in_tab, lr->trailing_comments, vnlog, 0);
+}
+
+void
+line_record_assign (struct line_record_t *lr, const char *buf, size_t len)
+{
+  if ((size_t) lr->lbuf.size < len + 1)
+    {
+      lr->lbuf.size = len + 1;
+      lr->lbuf.buffer = xrealloc (lr->lbuf.buffer, lr->lbuf.size);
+    }
+  if (len)
+    memcpy (lr->lbuf.buffer, buf, len);
+  lr->lbuf.buffer[len] = 0;
+  lr->lbuf.length = len;
+  lr->buf = lr->lbuf.buffer;
+  lr->len = len;
+  lr->transient = false;
+
+  line_record_parse_fields (lr->buf, lr->len, lr, in_tab,
+                            vnlog && skip_comments, vnlog, 0);
+}
+
+void
+line_record_set (struct line_record_t *lr, const char *buf, size_t len,
+                 size_t max_fields)
+{
+  lr->buf = buf;
+  lr->len = len;
+  lr->transient = true;
+
+  line_record_parse_fields (lr->buf, lr->len, lr, in_tab,
+                            vnlog && skip_comments, vnlog, max_fields);
+}
+
+
+/* Returns the offset of the first character in LR which is not
+   a space or a tab (or the line length, if there's none). */
+static size_t
+line_record_skip_blanks (const struct line_record_t* lr, size_t s)
 {
   const char* pch = line_record_buffer (lr);
+  const size_t len = line_record_length (lr);
+  while (s < len && (pch[s] == ' ' || pch[s] == '\t'))
+    ++s;
+  return s;
+}
 
+static bool
+line_record_is_comment (const struct line_record_t* lr)
+{
   /* Skip white space at beginning of line */
-  size_t s = strspn (pch, " \t");
+  size_t s = line_record_skip_blanks (lr, 0);
+  if (s == line_record_length (lr))
+    return false;
   /* First non-whitespace character */
-  char c = pch[s];
+  char c = line_record_buffer (lr)[s];
   return (c=='#' || c==';');
 }
 
@@ -201,42 +639,469 @@ static int
 line_leading_comment_count (const struct line_record_t* lr)
 {
   const char* pch = line_record_buffer (lr);
+  const size_t len = line_record_length (lr);
 
   /* Skip white space at beginning of line */
-  size_t s = strspn (pch, " \t");
-  /* First non-whitespace character */
-  const char* c = &pch[s];
+  size_t s = line_record_skip_blanks (lr, 0);
 
   /* empty line? */
-  if (c[0] == '\0')
+  if (s == len)
     return 2;
 
   /* not a comment? */
-  if (c[0] != '#')
+  if (pch[s] != '#')
     return 0;
 
   /* Have at least a single comment */
-  if (c[1] == '#' || c[1] == '!')
+  if (s + 1 < len && (pch[s+1] == '#' || pch[s+1] == '!'))
     return 2;
   else
     return 1;
 }
 
-bool
-line_record_fread (struct /* in/out */ line_record_t *lr,
-                   FILE *stream, char delimiter,
-                   bool skip_comments,
-                   bool vnlog_prologue)
+/* Returns the buffer in which the input is read by line_input_refill (),
+   allocating it if needed */
+static struct line_input_buffer *
+line_input_buffer (struct line_input *in, size_t n, size_t min_size)
+{
+  struct line_input_buffer *b = &in->bufs[n % LINE_INPUT_BUFFERS];
+  if (b->size < min_size)
+    {
+      b->size = MAX (min_size, MAX (b->size * 2, LINE_INPUT_BLOCK));
+      free (b->data);
+      b->data = xmalloc (b->size);
+    }
+  return b;
+}
+
+/* Reads the first bytes of a pipe (or an empty file), and decompresses
+   the rest of it if needed. Otherwise, the bytes are the beginning of
+   the input buffer. */
+static void
+line_input_detect_compression (struct line_input *in)
+{
+  char head[COMPRESSION_MAGIC_LEN];
+  size_t len = 0;
+
+  while (len < sizeof head)
+    {
+      const size_t n = safe_read (in->fd, head + len, sizeof head - len);
+      if (n == SAFE_READ_ERROR)
+        die (EXIT_FAILURE, errno, _("read error"));
+      if (n == 0)
+        break;
+      len += n;
+    }
+
+  enum compression format = input_compression;
+  if (format == COMPRESSION_AUTO)
+    format = compression_detect (head, len);
+  if (format != COMPRESSION_NONE)
+    {
+      in->dec = decompressor_start (in->fd, format, head, len);
+      return;
+    }
+
+  struct line_input_buffer *b = line_input_buffer (in, in->cur, len + 1);
+  memcpy (b->data, head, len);
+  in->pos = b->data;
+  in->end = b->data + len;
+  in->eof = (len < sizeof head);
+}
+
+/* Requests the next window of the mapped input, so that the pages
+   are read from the file before they are needed */
+static void
+line_input_advise_map (struct line_input *in)
+{
+#if HAVE_MADVISE && defined MADV_WILLNEED
+  /* After a line longer than a window, skip the windows already read */
+  if (in->map_advised < in->pos)
+    in->map_advised = in->map + (in->pos - in->map) / LINE_INPUT_MAP_WINDOW
+                                * LINE_INPUT_MAP_WINDOW;
+
+  const char *end = in->map + in->map_len;
+  const size_t len = MIN (LINE_INPUT_MAP_WINDOW,
+                          (size_t) (end - in->map_advised));
+  ignore_value (madvise ((char *) in->map_advised, len, MADV_WILLNEED));
+  in->map_advised += len;
+#else
+  in->map_advised = in->map + in->map_len;
+#endif
+}
+
+/* Prepares reading from STREAM (see line_input_init ()) */
+static void
+line_input_attach (struct line_input *in, FILE *stream, bool buffered)
+{
+  in->stream = stream;
+  in->map = NULL;
+  in->map_len = 0;
+  in->map_offset = 0;
+  in->pos = in->end = NULL;
+  in->fd = -1;
+  in->eof = false;
+  in->dec = NULL;
+
+#if HAVE_MMAP
+  /* Only regular files can be mapped. */
+  struct stat st;
+  const int fd = fileno (stream);
+  if (fd < 0 || fstat (fd, &st) != 0 || !S_ISREG (st.st_mode))
+    goto not_mapped;
+
+  const off_t start = ftello (stream);
+  if (start < 0 || st.st_size <= start)
+    goto not_mapped;
+
+  /* The mapping must begin at a page boundary */
+  const long int pagesize = sysconf (_SC_PAGESIZE);
+  if (pagesize <= 0)
+    goto not_mapped;
+  const off_t map_offset = start - (start % pagesize);
+  if ((uintmax_t) (st.st_size - map_offset) > SIZE_MAX)
+    goto not_mapped;
+  const size_t map_len = st.st_size - map_offset;
+
+  void *p = mmap (NULL, map_len, PROT_READ, MAP_PRIVATE, fd, map_offset);
+  if (p == MAP_FAILED)
+    goto not_mapped;
+
+  const char *pos = (const char *) p + (start - map_offset);
+  enum compression format = input_compression;
+  if (format == COMPRESSION_AUTO)
+    format = compression_detect (pos, MIN (st.st_size - start,
+                                           COMPRESSION_MAGIC_LEN));
+  if (format != COMPRESSION_NONE && buffered)
+    {
+      /* Compressed files are read like pipes */
+      munmap (p, map_len);
+      if (lseek (fd, start, SEEK_SET) < 0)
+        die (EXIT_FAILURE, errno, _("read error"));
+      in->fd = fd;
+      in->dec = decompressor_start (fd, format, NULL, 0);
+      return;
+    }
+
+# if HAVE_MADVISE && defined MADV_SEQUENTIAL
+  /* The file is read once, from beginning to end. */
+  ignore_value (madvise (p, map_len, MADV_SEQUENTIAL));
+# endif
+
+  in->map = p;
+  in->map_len = map_len;
+  in->map_offset = map_offset;
+  in->pos = pos;
+  in->end = in->map + map_len;
+  in->map_advised = in->map;
+  line_input_advise_map (in);
+  return;
+
+ not_mapped:
+#endif
+  /* Pipes, terminals and empty files are read in large blocks,
+     directly from the file descriptor - unless the caller needs the
+     stream positioned right after the last line read (e.g. when the
+     rest of the input is passed to a child process). */
+  if (buffered)
+    {
+      in->fd = fileno (stream);
+      if (input_compression != COMPRESSION_NONE)
+        line_input_detect_compression (in);
+    }
+}
+
+/* Releases the mapping of the current stream (if any), setting the
+   position of the stream to the first unread byte. */
+static void
+line_input_detach (struct line_input *in)
+{
+#if HAVE_MMAP
+  if (in->map)
+    {
+      const off_t offset = in->map_offset + (in->pos - in->map);
+      if (fseeko (in->stream, offset, SEEK_SET) != 0)
+        die (EXIT_FAILURE, errno, _("read error"));
+      munmap (in->map, in->map_len);
+      in->map = NULL;
+    }
+#endif
+  if (in->dec)
+    {
+      decompressor_free (in->dec);
+      in->dec = NULL;
+    }
+  in->pos = in->end = NULL;
+}
+
+/* Opens an input file ("-" is the standard input) */
+static FILE *
+line_input_open (const char *file)
+{
+  if (STREQ (file, "-"))
+    return stdin;
+
+  FILE *f = fopen (file, "r");
+  if (f == NULL)
+    die (EXIT_FAILURE, errno, "%s", quotef (file));
+  return f;
+}
+
+/* Closes the current input file */
+static void
+line_input_close (struct line_input *in)
+{
+  const char *file = in->files[in->next_file - 1];
+
+  if (ferror (in->stream))
+    die (EXIT_FAILURE, errno, "%s: %s", quotef (file), _("read error"));
+  if (in->stream == stdin)
+    clearerr (stdin);
+  else if (fclose (in->stream) != 0)
+    die (EXIT_FAILURE, errno, "%s", quotef (file));
+  in->stream = NULL;
+}
+
+static void
+line_input_next_file (struct line_input *in)
+{
+  line_input_detach (in);
+  line_input_close (in);
+
+  FILE *f = line_input_open (in->files[in->next_file++]);
+  line_input_attach (in, f, true);
+  /* If all previous files were empty, this file's header is the
+     first one */
+  in->header_pending = in->headers && in->started;
+
+  in->opened[in->num_opened].first_line = in->num_lines;
+  in->opened[in->num_opened].header_skipped = in->header_pending;
+  in->num_opened++;
+}
+
+/* Reads the next line from a memory-mapped input.
+   The line is not copied - LR points directly to the mapped file.
+   The only exception is the last line of a file which does not end with
+   a delimiter: it is copied into LR's linebuffer and NUL-terminated, so
+   that functions such as strtold(3) never read beyond the mapping. */
+static bool
+line_input_read_mapped (struct line_record_t* lr, struct line_input *in,
+                        char delimiter)
+{
+  if (in->pos >= in->end)
+    return false;
+
+  if (in->map_advised < in->end
+      && in->map_advised - in->pos < LINE_INPUT_MAP_WINDOW / 2)
+    line_input_advise_map (in);
+
+  const char *beg = in->pos;
+  bool in_quotes = false;
+  const char *eol = line_find_eol (beg, in->end, delimiter, &in_quotes);
+  /* With several input files, the mapping is released when switching
+     to the next file */
+  lr->transient = (in->files != NULL);
+  if (eol)
+    {
+      lr->buf = beg;
+      lr->len = eol - beg;
+      in->pos = eol + 1;
+      return true;
+    }
+  if (in_quotes)
+    csv_unterminated_quote ();
+
+  const size_t len = in->end - beg;
+  if ((size_t) lr->lbuf.size < len + 1)
+    {
+      lr->lbuf.size = len + 1;
+      lr->lbuf.buffer = xrealloc (lr->lbuf.buffer, lr->lbuf.size);
+    }
+  memcpy (lr->lbuf.buffer, beg, len);
+  lr->lbuf.buffer[len] = 0;
+  lr->lbuf.length = len;
+  lr->buf = lr->lbuf.buffer;
+  lr->len = len;
+  lr->transient = false;
+  in->pos = in->end;
+  return true;
+}
+
+/* Moves the unread tail of the current buffer to the beginning of the
+   next buffer in the ring, and fills the rest of it with read(2).
+   Returns the number of bytes read (0 at end of file). */
+static size_t
+line_input_refill (struct line_input *in)
+{
+  const size_t tail = in->end - in->pos;
+
+  /* Grow the buffer if the tail (a long line) leaves too little room.
+     One byte is reserved for NUL-terminating the last line. */
+  struct line_input_buffer *next =
+    line_input_buffer (in, in->cur + 1, tail + LINE_INPUT_BLOCK / 2 + 1);
+
+  if (tail)
+    memcpy (next->data, in->pos, tail);
+  in->cur = (in->cur + 1) % LINE_INPUT_BUFFERS;
+
+  size_t n;
+  if (in->dec)
+    n = decompressor_read (in->dec, next->data + tail,
+                           next->size - tail - 1);
+  else
+    n = safe_read (in->fd, next->data + tail, next->size - tail - 1);
+  if (n == SAFE_READ_ERROR)
+    die (EXIT_FAILURE, errno, _("read error"));
+  if (n == 0)
+    in->eof = true;
+
+  in->pos = next->data;
+  in->end = next->data + tail + n;
+  return n;
+}
+
+/* Reads the next line from the input buffers.
+   LR points directly into the buffer: the line remains valid until
+   the buffer is refilled (see line_record_keep ()).
+   Returns 1 if a line was read, 0 at end of file, and -1 if the buffer
+   must be refilled but MAY_REFILL is false. */
+static int
+line_input_read_blocks (struct line_record_t* lr, struct line_input *in,
+                        char delimiter, bool may_refill)
+{
+  size_t scanned = 0;
+  bool in_quotes = false;
+
+  while (true)
+    {
+      const char *beg = in->pos;
+      const char *eol = NULL;
+      if (beg + scanned < in->end)
+        eol = line_find_eol (beg + scanned, in->end, delimiter, &in_quotes);
+      if (eol)
+        {
+          lr->buf = beg;
+          lr->len = eol - beg;
+          lr->transient = true;
+          in->pos = eol + 1;
+          return 1;
+        }
+
+      if (in->eof)
+        {
+          if (beg == in->end)
+            return 0;
+          if (in_quotes)
+            csv_unterminated_quote ();
+
+          /* Last line, without a delimiter */
+          *((char*) in->end) = '\0';
+          lr->buf = beg;
+          lr->len = in->end - beg;
+          lr->transient = true;
+          in->pos = in->end;
+          return 1;
+        }
+
+      if (!may_refill)
+        return -1;
+
+      /* The tail of the buffer was already searched. */
+      scanned = in->end - in->pos;
+      line_input_refill (in);
+    }
+}
+
+/* Reads the next CSV line from STREAM with stdio, one byte at a time:
+   line delimiters inside quoted fields are part of the line. */
+static int
+line_input_read_csv_stream (struct line_record_t* lr, FILE *stream,
+                            char delimiter)
+{
+  struct linebuffer *lb = &lr->lbuf;
+  bool in_quotes = false;
+  size_t len = 0;
+  int c;
+
+  while ((c = getc (stream)) != EOF)
+    {
+      if (c == to_uchar (delimiter) && !in_quotes)
+        break;
+      if (c == '"')
+        in_quotes = !in_quotes;
+      if (len + 1 >= (size_t) lb->size)
+        {
+          lb->size = MAX (lb->size * 2, 128);
+          lb->buffer = xrealloc (lb->buffer, lb->size);
+        }
+      lb->buffer[len++] = c;
+    }
+  if (c == EOF && len == 0)
+    return 0;
+  if (in_quotes)
+    csv_unterminated_quote ();
+
+  lb->buffer[len] = '\0';
+  lb->length = len;
+  lr->buf = lb->buffer;
+  lr->len = len;
+  lr->transient = false;
+  return 1;
+}
+
+static int
+line_input_read (struct line_record_t* lr, struct line_input *in,
+                 char delimiter, bool may_refill)
+{
+  if (in->map)
+    return line_input_read_mapped (lr, in, delimiter);
+
+  if (in->fd >= 0)
+    return line_input_read_blocks (lr, in, delimiter, may_refill);
+
+  if (csv_input)
+    return line_input_read_csv_stream (lr, in->stream, delimiter);
+
+  if (readlinebuffer_delim (&lr->lbuf, in->stream, delimiter) == 0)
+    return 0;
+  linebuffer_nullify (&lr->lbuf);
+  lr->buf = lr->lbuf.buffer;
+  lr->len = lr->lbuf.length;
+  lr->transient = false;
+  return 1;
+}
+
+/* Reads the next line which is not skipped (comments, vnlog prologue),
+   and splits it into fields.
+   Returns 1 if a line was read, 0 at end of file, and -1 if the input
+   buffer must be refilled but MAY_REFILL is false. */
+static int
+line_input_next (struct /* in/out */ line_record_t *lr,
+                 struct line_input *in, char delimiter,
+                 bool skip_comments, bool vnlog_prologue, bool may_refill)
 {
   while (1)
     {
-      if (readlinebuffer_delim (&lr->lbuf, stream, delimiter) == 0)
-        return false;
-      linebuffer_nullify (&lr->lbuf);
+      const int rc = line_input_read (lr, in, delimiter, may_refill);
+      if (rc == 0 && in->next_file < in->num_files)
+        {
+          /* Switching files releases the current input buffer */
+          if (!may_refill)
+            return -1;
+          line_input_next_file (in);
+          continue;
+        }
+      if (rc != 1)
+        return rc;
+
+      /* CSV lines can end with CR-LF */
+      if (csv_input && delimiter == '\n' && lr->len
+          && lr->buf[lr->len - 1] == '\r')
+        --lr->len;
 
       if (vnlog)
         {
-          if (vnlog_prologue)
+          if (vnlog_prologue || in->header_pending)
             {
               /* Validate and process single-commented vnlog header.
                  Skip double-comments and empty lines. */
@@ -248,37 +1113,45 @@ line_record_fread (struct /* in/out */ line_record_t *lr,
                   /* Strip the comment characters.
                      Skip leading regex '^\s*#\s*' */
                   const char* pch = line_record_buffer (lr);
-                  size_t s = strspn (pch, " \t");
-                  s += strspn (pch + s, "#");
-                  s += strspn (pch + s, " \t");
-                  struct linebuffer lbuf = lr->lbuf;
-                  lbuf.buffer += s;
-                  lbuf.length -= s;
-                  if (lbuf.buffer[0] == '\0')
+                  const size_t len = line_record_length (lr);
+                  size_t s = line_record_skip_blanks (lr, 0);
+                  while (s < len && pch[s] == '#')
+                    ++s;
+                  s = line_record_skip_blanks (lr, s);
+                  if (s == len)
                     /* Ignore empty comment line. */
                     continue;
-                  line_record_parse_fields (&lbuf, lr, in_tab,
+                  line_record_parse_fields (pch + s, len - s, lr, in_tab,
 
                                             // do NOT ignore comments. We're
                                             // parsing the prologue
                                             false,
 
                                             // ignore trailing whitespace
-                                            true
+                                            true,
+
+                                            // all fields are column names
+                                            0
                                             );
-                  return true;
+                  if (in->header_pending && !vnlog_prologue)
+                    {
+                      in->header_pending = false;
+                      continue;
+                    }
+                  in->started = true;
+                  in->num_lines++;
+                  return 1;
                 }
 
               die (EXIT_FAILURE, 0,
-                   _("invalid vnlog data: received record before header: '%s'"),
-                line_record_buffer (lr));
+                   _("invalid vnlog data: received record before header: '%.*s'"),
+                   (int) MIN (line_record_length (lr), INT_MAX),
+                   line_record_buffer (lr));
             }
 
           /* vnlog data. Skip comments and empty lines */
-          const char* pch = line_record_buffer (lr);
-          size_t s = strspn (pch, " \t");
-          char c = pch[s];
-          if (c=='#' || c=='\0')
+          size_t s = line_record_skip_blanks (lr, 0);
+          if (s == line_record_length (lr) || line_record_buffer (lr)[s]=='#')
             continue;
           break;
         }
@@ -286,16 +1159,100 @@ line_record_fread (struct /* in/out */ line_record_t *lr,
       if (skip_comments && line_record_is_comment (lr))
         continue;
 
+      if (in->header_pending)
+        {
+          in->header_pending = false;
+          continue;
+        }
+
       break;
     }
 
-  line_record_parse_fields (&lr->lbuf, lr, in_tab,
+  line_record_parse_fields (line_record_buffer (lr), line_record_length (lr),
+                            lr, in_tab,
                             /* Ignore trailing comments only if --vnlog */
                             vnlog && skip_comments,
 
                             /* ignore trailing whitespace only if --vnlog */
-                            vnlog);
-  return true;
+                            vnlog,
+
+                            in->max_fields);
+  in->started = true;
+  in->num_lines++;
+  return 1;
+}
+
+bool
+line_record_fread (struct /* in/out */ line_record_t *lr,
+                   struct line_input *in, char delimiter,
+                   bool skip_comments,
+                   bool vnlog_prologue)
+{
+  return line_input_next (lr, in, delimiter, skip_comments, vnlog_prologue,
+                          true) == 1;
+}
+
+void
+line_record_keep (struct line_record_t *lr)
+{
+  if (!lr->transient)
+    return;
+
+  const char *old = lr->buf;
+  if ((size_t) lr->lbuf.size < lr->len + 1)
+    {
+      lr->lbuf.size = lr->len + 1;
+      lr->lbuf.buffer = xrealloc (lr->lbuf.buffer, lr->lbuf.size);
+    }
+  memcpy (lr->lbuf.buffer, old, lr->len);
+  lr->lbuf.buffer[lr->len] = 0;
+  lr->lbuf.length = lr->len;
+  lr->buf = lr->lbuf.buffer;
+
+  /* Unquoted CSV fields are already in the record's own storage */
+  const char *unq = lr->unquoted;
+  for (size_t i = 0; i < lr->num_fields; ++i)
+    if (!unq || lr->fields[i].buf < unq
+        || lr->fields[i].buf >= unq + lr->unquoted_alloc)
+      lr->fields[i].buf = lr->buf + (lr->fields[i].buf - old);
+  lr->transient = false;
+}
+
+void
+line_batch_init (struct line_batch *batch)
+{
+  batch->num_lines = 0;
+  batch->alloc_lines = LINE_BATCH_SIZE;
+  batch->lines = XNMALLOC (batch->alloc_lines, struct line_record_t);
+  for (size_t i = 0; i < batch->alloc_lines; ++i)
+    line_record_init (&batch->lines[i]);
+}
+
+void
+line_batch_free (struct line_batch *batch)
+{
+  for (size_t i = 0; i < batch->alloc_lines; ++i)
+    line_record_free (&batch->lines[i]);
+  free (batch->lines);
+  batch->lines = NULL;
+  batch->num_lines = batch->alloc_lines = 0;
+}
+
+size_t
+line_batch_fread (struct line_batch *batch, struct line_input *in,
+                  char delimiter, bool skip_comments)
+{
+  size_t n = 0;
+
+  /* Stop at the end of the current buffer (unless no line was read yet):
+     refilling it might overwrite the lines of the previous batch. */
+  while (n < batch->alloc_lines
+         && line_input_next (&batch->lines[n], in, delimiter,
+                             skip_comments, false, n == 0) == 1)
+    ++n;
+
+  batch->num_lines = n;
+  return n;
 }
 
 void
@@ -303,8 +1260,95 @@ line_record_free (struct line_record_t* lr)
 {
   freebuffer (&lr->lbuf);
   lr->lbuf.buffer = NULL;
+  lr->buf = NULL;
+  lr->len = 0;
   free (lr->fields);
   lr->fields = NULL;
   lr->alloc_fields = 0;
+  free (lr->unquoted);
+  lr->unquoted = NULL;
+  lr->unquoted_alloc = 0;
   lr->num_fields = 0;
 }
+
+void
+line_input_init (struct line_input *in, FILE *stream, bool buffered)
+{
+  in->max_fields = 0;
+  in->cur = 0;
+  for (size_t i = 0; i < LINE_INPUT_BUFFERS; ++i)
+    {
+      in->bufs[i].data = NULL;
+      in->bufs[i].size = 0;
+    }
+  in->files = NULL;
+  in->num_files = in->next_file = 0;
+  in->headers = in->header_pending = in->started = false;
+  in->num_lines = 0;
+  in->opened = NULL;
+  in->num_opened = 0;
+
+  line_input_attach (in, stream, buffered);
+}
+
+void
+line_input_open_files (struct line_input *in, char *const *files,
+                       size_t num_files, bool headers)
+{
+  assert (num_files > 0); /* LCOV_EXCL_LINE */
+
+  line_input_init (in, line_input_open (files[0]), true);
+  in->files = files;
+  in->num_files = num_files;
+  in->next_file = 1;
+  in->headers = headers;
+
+  in->opened = XNMALLOC (num_files, struct line_input_file);
+  in->opened[0].first_line = 0;
+  in->opened[0].header_skipped = false;
+  in->num_opened = 1;
+}
+
+void
+line_input_skip_header (struct line_input *in)
+{
+  in->header_pending = true;
+  if (in->files)
+    in->opened[in->num_opened - 1].header_skipped = true;
+}
+
+const char *
+line_input_file_line (const struct line_input *in, size_t number,
+                      size_t *line)
+{
+  if (!in->files)
+    {
+      *line = number;
+      return NULL;
+    }
+
+  /* Empty files have the same first line as the next one */
+  size_t i = in->num_opened - 1;
+  while (i > 0 && in->opened[i].first_line >= number)
+    --i;
+  *line = number - in->opened[i].first_line + in->opened[i].header_skipped;
+  return in->files[i];
+}
+
+void
+line_input_free (struct line_input *in)
+{
+  line_input_detach (in);
+  if (in->files && in->stream)
+    line_input_close (in);
+  free (in->opened);
+  in->opened = NULL;
+  in->files = NULL;
+
+  for (size_t i = 0; i < LINE_INPUT_BUFFERS; ++i)
+    {
+      free (in->bufs[i].data);
+      in->bufs[i].data = NULL;
+      in->bufs[i].size = 0;
+    }
+}
@@ -31,25 +31,125 @@ struct field_record_t
 struct line_record_t
 {
   /* buffer of the entire line, as created with gnulib's
-     readlinbuffer_delim */
+     readlinbuffer_delim. Used only when the line could not be
+     referenced directly in the input (e.g. reading from a pipe). */
   struct linebuffer lbuf;
 
-  /* array of fields. Each valid field is a pointer to 'lbuf' */
+  /* The content of the line (without the line delimiter).
+     Points either to 'lbuf' or directly into a memory-mapped input file.
+     NOT guaranteed to be NUL-terminated. */
+  const char* buf;
+  size_t len;
+
+  /* array of fields. Each valid field is a pointer to 'buf' */
   struct field_record_t *fields;
   size_t num_fields;    /* number of fields in this line */
   size_t alloc_fields;  /* number of fields allocated */
+
+  /* True if 'buf' points into an input buffer which will be reused
+     (see line_record_keep ()). */
+  bool transient;
+
+  /* True if the line was split only up to the input's 'max_fields':
+     the line has more fields than 'num_fields'. */
+  bool truncated;
+  bool trailing_comments; /* ignore_trailing_comments used for splitting */
+
+  /* With --csv, quoted fields are unquoted into this buffer
+     (other fields point to 'buf'). */
+  char *unquoted;
+  size_t unquoted_alloc;
+};
+
+/* Number of buffers in the read(2) ring, and their initial size */
+enum { LINE_INPUT_BUFFERS = 2 };
+enum { LINE_INPUT_BLOCK = 128 * 1024 };
+
+/* Memory-mapped input is requested from the file (MADV_WILLNEED) in
+   windows of this size, the next one when half of the current one has
+   been read */
+enum { LINE_INPUT_MAP_WINDOW = 8 * 1024 * 1024 };
+
+struct line_input_buffer
+{
+  char *data;
+  size_t size;
+};
+
+/* Source of input lines.
+   Regular files are memory-mapped and lines are returned without
+   copying; other inputs (pipes, terminals) are read in large blocks
+   into a ring of buffers. Compressed inputs are decompressed on a
+   separate thread (see decompress.h), and read like pipes.
+   Several files can be read one after the other as a single input
+   (see line_input_open_files ()). */
+struct line_input
+{
+  FILE *stream;
+
+  /* Block input (-1 if the input is mapped, or read with stdio) */
+  int fd;
+  bool eof;
+  struct decompressor *dec; /* if not NULL, read from it instead of 'fd' */
+  size_t cur;           /* current buffer in 'bufs' */
+  struct line_input_buffer bufs[LINE_INPUT_BUFFERS];
+
+  /* Memory-mapped input (NULL if not mapped) */
+  char *map;            /* page-aligned start of the mapping */
+  size_t map_len;       /* length of the mapping */
+  off_t map_offset;     /* file offset of 'map' */
+  const char *map_advised; /* end of the part of 'map' requested ahead */
+
+  const char *pos;      /* next unread byte (in 'map' or 'bufs') */
+  const char *end;      /* one past the last valid byte */
+
+  /* Split only the first 'max_fields' fields of each line
+     (0 = split the entire line). */
+  size_t max_fields;
+
+  /* Input files (NULL if reading a single stream) */
+  char *const *files;
+  size_t num_files;
+  size_t next_file;     /* index of the next file to open */
+  bool headers;         /* each file begins with a header line */
+  bool header_pending;  /* skip the next line (the current file's header) */
+  bool started;         /* a line was returned */
+
+  /* Lines returned, and the files opened so far (see
+     line_input_file_line ()). 'num_opened' is updated after the
+     entry of the opened file, so that other threads can read them. */
+  size_t num_lines;
+  struct line_input_file *opened;
+  _Atomic size_t num_opened;
+};
+
+/* An input file read by a line_input */
+struct line_input_file
+{
+  size_t first_line;    /* number of lines returned before the file */
+  bool header_skipped;  /* the file's header line was not returned */
+};
+
+/* Maximum number of lines returned by one call to line_batch_fread () */
+enum { LINE_BATCH_SIZE = 1024 };
+
+struct line_batch
+{
+  struct line_record_t *lines;
+  size_t num_lines;
+  size_t alloc_lines;
 };
 
 static inline size_t
 line_record_length (const struct line_record_t *lr)
 {
-  return lr->lbuf.length;
+  return lr->len;
 }
 
 static inline const char*
 line_record_buffer (const struct line_record_t *lr)
 {
-  return lr->lbuf.buffer;
+  return lr->buf;
 }
 
 static inline size_t
@@ -77,15 +177,104 @@ line_record_get_field (const struct line_record_t *lr, const size_t n,
   return true;
 }
 
+/* Exchange the contents of two line records */
+static inline void
+line_record_swap (struct line_record_t *a, struct line_record_t *b)
+{
+  struct line_record_t tmp = *a;
+  *a = *b;
+  *b = tmp;
+}
+
 void
 line_record_init (struct line_record_t* lr);
 
+/* Read the next line (skipping comments if requested).
+   The line might point into an input buffer: it remains valid until
+   the next read from IN, unless kept with line_record_keep (). */
 bool
 line_record_fread (struct /* in/out */ line_record_t* lr,
-                   FILE *stream, char delimiter, bool skip_comments,
+                   struct line_input *in, char delimiter, bool skip_comments,
                    bool vnlog_prologue);
 
 void
 line_record_free (struct line_record_t* lr);
 
+/* Split the rest of a line which was read with a 'max_fields' limit */
+void
+line_record_parse_all (struct line_record_t* lr);
+
+/* Copy the line BUF (LEN bytes) into LR and split all of its fields,
+   as if it was read from the input (e.g. a line saved by another
+   process). */
+void
+line_record_assign (struct line_record_t *lr, const char *buf, size_t len);
+
+/* Set LR to the line BUF (LEN bytes, without the line delimiter),
+   and split its first MAX_FIELDS fields (0 = all), as if it was read
+   from the input. BUF is not copied: it must remain valid while LR is
+   used, or until LR is kept with line_record_keep (). */
+void
+line_record_set (struct line_record_t *lr, const char *buf, size_t len,
+                 size_t max_fields);
+
+/* Copy a line which points into an input buffer into the record's own
+   storage, so it remains valid after the next read. */
+void
+line_record_keep (struct line_record_t* lr);
+
+void
+line_batch_init (struct line_batch *batch);
+
+void
+line_batch_free (struct line_batch *batch);
+
+/* Read up to LINE_BATCH_SIZE lines (skipping comments if requested).
+   Returns the number of lines read (0 at end of file).
+   The lines remain valid until the next call: use line_record_keep ()
+   (after moving a line out of the batch with line_record_swap ())
+   to keep it longer. */
+size_t
+line_batch_fread (struct line_batch *batch, struct line_input *in,
+                  char delimiter, bool skip_comments);
+
+/* Prepare reading lines from STREAM, starting at its current position.
+   If STREAM is a regular file, it is memory-mapped. Otherwise, if
+   BUFFERED is true, it is read in large blocks directly from its file
+   descriptor; if BUFFERED is false, it is read with stdio (and nothing
+   beyond the last line returned is consumed, if STREAM is unbuffered).
+   Unless BUFFERED is false, compressed input is decompressed
+   (according to 'input_compression'). */
+void
+line_input_init (struct line_input *in, FILE *stream, bool buffered);
+
+/* Prepare reading NUM_FILES files, one after the other, as one input
+   ("-" is the standard input). If HEADERS is true, the header line
+   (or vnlog prologue) of each file after the first one is skipped.
+   Files are opened when reached, and closed at their end. */
+void
+line_input_open_files (struct line_input *in, char *const *files,
+                       size_t num_files, bool headers);
+
+/* Skip the header line (or vnlog prologue) of the current file */
+void
+line_input_skip_header (struct line_input *in);
+
+/* Returns the name of the file of the line number NUMBER of IN
+   (counting the lines returned, from 1), and sets *LINE to its line
+   number in that file (counting the file's skipped header line).
+   Returns NULL, and sets *LINE to NUMBER, if IN is a single stream.
+   Can be called from any thread, for a line already returned. */
+const char *
+line_input_file_line (const struct line_input *in, size_t number,
+                      size_t *line);
+
+/* Release the mapping and buffers, and close the last input file
+   (if opened by line_input_open_files). If a single stream was
+   memory-mapped, its position is set to the first unread
+   byte, so that other readers (e.g. a child process) can continue
+   from the same location. */
+void
+line_input_free (struct line_input *in);
+
 #endif
@@ -0,0 +1,630 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <float.h>
+#include <locale.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "system.h"
+#include "die.h"
+#include "c-ctype.h"
+#include "utils.h"
+#include "text-options.h"
+#include "text-numbers.h"
+
+/* A decimal mantissa of up to MAX_EXACT_DIGITS digits, and powers of ten
+   up to 10^MAX_EXACT_POWER, are exactly representable as long double:
+   multiplying or dividing one by the other gives the correctly rounded
+   value, exactly as strtold would. */
+#if LDBL_MANT_DIG >= 64
+# define MAX_EXACT_DIGITS 19    /* 10^19 < 2^64 */
+# define MAX_EXACT_POWER 27     /* 5^27 < 2^64 */
+#elif LDBL_MANT_DIG >= 53
+# define MAX_EXACT_DIGITS 15    /* 10^15 < 2^53 */
+# define MAX_EXACT_POWER 22     /* 5^22 < 2^53 */
+#else
+# define MAX_EXACT_DIGITS 0     /* always use strtold */
+# define MAX_EXACT_POWER 0
+#endif
+
+static const long double powers_of_ten[] =
+{
+  1e0L,  1e1L,  1e2L,  1e3L,  1e4L,  1e5L,  1e6L,  1e7L,  1e8L,  1e9L,
+  1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L,
+  1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L
+};
+
+static const uint64_t int_powers_of_ten[] =
+{
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+  1000000000, 10000000000, 100000000000, 1000000000000,
+  10000000000000, 100000000000000, 1000000000000000,
+  10000000000000000, 100000000000000000, 1000000000000000000
+};
+
+/* Decimal point of the current locale, or -1 if it is not a single byte
+   (in which case all values are converted by strtold). */
+static int decimal_point = '.';
+
+/* 10^38 < 2^128 */
+#define MAX_POWER_128 38
+
+/* Formatting results exactly requires 128-bit integers,
+   and a long double mantissa which fits in 64 bits. */
+#if defined __SIZEOF_INT128__ && LDBL_MANT_DIG <= 64
+# define FAST_NUMBER_FORMAT 1
+typedef unsigned __int128 uint128;
+
+static uint128 powers_of_ten_128[MAX_POWER_128 + 1];
+#else
+# define FAST_NUMBER_FORMAT 0
+#endif
+
+/* numeric_output_format, parsed by update_number_format () */
+static struct
+{
+  bool fast;            /* if false, always use snprintf */
+  char prefix[MAX_NUMERIC_FORMAT_LEN + 1];      /* text before the '%' */
+  size_t prefix_len;
+  char suffix[MAX_NUMERIC_FORMAT_LEN + 1];      /* text after the type */
+  size_t suffix_len;
+  bool left_justify;    /* '-' flag */
+  bool zero_pad;        /* '0' flag */
+  char sign;            /* '+' or ' ' flags, or 0 */
+  int width;
+  int precision;
+  char type;            /* 'e', 'f' or 'g' */
+  bool upper;           /* 'E' or 'G' */
+} number_format;
+
+void
+init_text_numbers (void)
+{
+  const struct lconv *lc = localeconv ();
+  const char *dp = lc ? lc->decimal_point : NULL;
+
+  if (dp && dp[0] && !dp[1])
+    decimal_point = to_uchar (dp[0]);
+  else
+    decimal_point = -1;
+
+#if FAST_NUMBER_FORMAT
+  uint128 p = 1;
+  for (int i = 0; i < MAX_POWER_128; ++i, p *= 10)
+    powers_of_ten_128[i] = p;
+  powers_of_ten_128[MAX_POWER_128] = p;
+#endif
+
+  update_number_format ();
+}
+
+static enum number_parse_result
+parse_number_strtold (const char *str, size_t len, long double *value)
+{
+  char *endptr = NULL;
+  char tmpbuf[512];
+
+#ifndef HAVE_BROKEN_STRTOLD
+  /* Usually, strtold stops at the field delimiter, but not always.
+     Optimistically try to avoid an extra copy, unless the strtold
+     implementation is known to be problematic. */
+  errno = 0;
+  *value = strtold (str, &endptr);
+  if (errno==ERANGE || endptr==str || endptr<(str+len))
+    return NUMBER_INVALID;
+  /* On Cygwin, strtold doesn't stop at a tab character,
+     and returns invalid value.
+     Generally, strtold doesn't stop on field separators
+     that can be part of long double representations.
+     If strtold continued past the field delimiter, make
+     a copy of the input buffer and NUL-terminate it. */
+  if (endptr == (str+len))
+    return NUMBER_OK;
+#endif
+
+  if (len >= sizeof (tmpbuf))
+    die (EXIT_FAILURE, 0,
+         "internal error: input field too long (%zu)", len);
+  memcpy (tmpbuf, str, len);
+  tmpbuf[len] = 0;
+  errno = 0;
+  *value = strtold (tmpbuf, &endptr);
+  if (errno==ERANGE || endptr==tmpbuf || endptr!=(tmpbuf+len))
+    return NUMBER_INVALID;
+  return NUMBER_OK;
+}
+
+/* Values which are not plain decimal numbers */
+static enum number_parse_result
+parse_number_slow (const char *str, size_t len, long double *value)
+{
+  if (len == 0)
+    return NUMBER_INVALID;
+
+  if (is_na (str, len))
+    {
+      /* 'NA' and 'N/A' are not numbers, but 'NaN' is */
+      if (len == 3 && c_tolower (str[1]) == 'a')
+        {
+          parse_number_strtold (str, len, value);
+          return NUMBER_NAN;
+        }
+      return NUMBER_NA;
+    }
+
+  return parse_number_strtold (str, len, value);
+}
+
+enum number_parse_result
+parse_number (const char *str, size_t len, long double *value)
+{
+  const char *p = str;
+  const char *end = str + len;
+  bool negative = false;
+  bool any_digits = false;
+  uint64_t mantissa = 0;
+  int digits = 0;               /* significant digits in MANTISSA */
+  int exponent = 0;
+
+  if (p < end && (*p == '-' || *p == '+'))
+    negative = (*p++ == '-');
+
+  /* Integer part. Leading zeros are not significant. */
+  for (; p < end && c_isdigit (*p); ++p)
+    {
+      any_digits = true;
+      if (mantissa == 0 && *p == '0')
+        continue;
+      if (++digits > MAX_EXACT_DIGITS)
+        return parse_number_slow (str, len, value);
+      mantissa = mantissa * 10 + (*p - '0');
+    }
+
+  /* Fractional part */
+  if (p < end && to_uchar (*p) == decimal_point)
+    {
+      for (++p; p < end && c_isdigit (*p); ++p)
+        {
+          any_digits = true;
+          --exponent;
+          if (mantissa == 0 && *p == '0')
+            continue;
+          if (++digits > MAX_EXACT_DIGITS)
+            return parse_number_slow (str, len, value);
+          mantissa = mantissa * 10 + (*p - '0');
+        }
+    }
+
+  if (!any_digits)
+    return parse_number_slow (str, len, value);
+
+  /* Exponent */
+  if (p < end && (*p == 'e' || *p == 'E'))
+    {
+      bool negative_exp = false;
+      int exp_value = 0;
+
+      ++p;
+      if (p < end && (*p == '-' || *p == '+'))
+        negative_exp = (*p++ == '-');
+      if (p == end || !c_isdigit (*p))
+        return parse_number_slow (str, len, value);
+      for (; p < end && c_isdigit (*p); ++p)
+        {
+          exp_value = exp_value * 10 + (*p - '0');
+          if (exp_value > 10 * MAX_EXACT_POWER)
+            return parse_number_slow (str, len, value);
+        }
+      exponent += negative_exp ? -exp_value : exp_value;
+    }
+
+  if (p != end)
+    return parse_number_slow (str, len, value);
+
+  /* A small integer with a large exponent (e.g. '1e30'):
+     move the excess of the exponent into the mantissa. */
+  if (exponent > MAX_EXACT_POWER
+      && digits + (exponent - MAX_EXACT_POWER) <= MAX_EXACT_DIGITS)
+    {
+      mantissa *= int_powers_of_ten[exponent - MAX_EXACT_POWER];
+      exponent = MAX_EXACT_POWER;
+    }
+
+  if (exponent > MAX_EXACT_POWER || exponent < -MAX_EXACT_POWER)
+    {
+      if (mantissa != 0)
+        return parse_number_slow (str, len, value);
+      exponent = 0;
+    }
+
+  long double v = mantissa;
+  if (exponent < 0)
+    v /= powers_of_ten[-exponent];
+  else
+    v *= powers_of_ten[exponent];
+
+  *value = negative ? -v : v;
+  return NUMBER_OK;
+}
+
+/* Copy the literal text in FMT up to the first directive (or the end
+   of the string) into OUT (of MAX_NUMERIC_FORMAT_LEN+1 bytes),
+   replacing '%%' with '%'. Returns a pointer past the copied text. */
+static const char *
+copy_format_text (const char *fmt, char *out, size_t *out_len)
+{
+  size_t n = 0;
+
+  while (*fmt && !(fmt[0] == '%' && fmt[1] != '%'))
+    {
+      if (*fmt == '%')
+        ++fmt;
+      if (n < MAX_NUMERIC_FORMAT_LEN)
+        out[n++] = *fmt;
+      ++fmt;
+    }
+  out[n] = '\0';
+  *out_len = n;
+  return fmt;
+}
+
+void
+update_number_format (void)
+{
+  const char *p = numeric_output_format;
+  char *end;
+  long l;
+
+  number_format.fast = false;
+  if (!FAST_NUMBER_FORMAT || decimal_point < 0)
+    return;
+
+  p = copy_format_text (p, number_format.prefix, &number_format.prefix_len);
+  if (*p++ != '%')
+    return;
+
+  number_format.left_justify = false;
+  number_format.zero_pad = false;
+  number_format.sign = 0;
+  for (;; ++p)
+    {
+      if (*p == '-')
+        number_format.left_justify = true;
+      else if (*p == '0')
+        number_format.zero_pad = true;
+      else if (*p == '+')
+        number_format.sign = '+';
+      else if (*p == ' ')
+        {
+          if (number_format.sign != '+')
+            number_format.sign = ' ';
+        }
+      else
+        break;                  /* '#' and '\'' are left to snprintf */
+    }
+  if (number_format.left_justify)
+    number_format.zero_pad = false;
+
+  number_format.width = 0;
+  if (c_isdigit (*p))
+    {
+      l = strtol (p, &end, 10);
+      if (l > MAX_NUMERIC_FORMAT_LEN)
+        return;
+      number_format.width = l;
+      p = end;
+    }
+
+  number_format.precision = 6;
+  if (*p == '.')
+    {
+      ++p;
+      l = strtol (p, &end, 10);
+      if (l > MAX_POWER_128)
+        return;
+      number_format.precision = l;
+      p = end;
+    }
+
+  if (*p++ != 'L')
+    return;
+  if (*p == 'e' || *p == 'f' || *p == 'g')
+    number_format.upper = false;
+  else if (*p == 'E' || *p == 'G')
+    number_format.upper = true;
+  else
+    return;                     /* %a and %F (only for inf/nan) */
+  number_format.type = c_tolower (*p++);
+
+  p = copy_format_text (p, number_format.suffix, &number_format.suffix_len);
+  if (*p)
+    return;
+
+  number_format.fast = true;
+}
+
+#if FAST_NUMBER_FORMAT
+/* Store M * 2^E * 10^S, rounded to the nearest integer (ties to even,
+   like printf) in *Q.  Returns false if the result can't be computed
+   exactly with 128-bit integers. */
+static bool
+scale_round (uint64_t m, int e, int s, uint128 *q)
+{
+  uint128 num = m;
+  uint128 den = 1;
+  uint128 r;
+
+  /* M < 2^64, and 10^19 < 2^64 */
+  if (s > 19 || s < -MAX_POWER_128)
+    return false;
+  if (s > 0)
+    num *= powers_of_ten_128[s];
+  else if (s < 0)
+    den = powers_of_ten_128[-s];
+
+  if (e > 0)
+    {
+      if (e >= 128 || (num >> (128 - e)) != 0)
+        return false;
+      num <<= e;
+    }
+  else if (e < 0 && den == 1)
+    {
+      /* Dividing by a power of two */
+      if (e <= -128)
+        return false;
+      const uint128 half = ((uint128) 1) << (-e - 1);
+      r = num & ((half << 1) - 1);
+      *q = num >> -e;
+      if (r > half || (r == half && (*q & 1)))
+        ++*q;
+      return true;
+    }
+  else if (e < 0)
+    {
+      if (e <= -127 || (den >> (127 + e)) != 0)
+        return false;
+      den <<= -e;
+    }
+
+  if (den == 1)
+    {
+      *q = num;
+      return true;
+    }
+
+  *q = num / den;
+  r = num % den;
+  if (r > den - r || (r == den - r && (*q & 1)))
+    ++*q;
+  return true;
+}
+
+/* Write the decimal digits of Q into BUF, zero-padded to at least
+   MIN_DIGITS digits. Returns the number of digits. */
+static int
+uint128_digits (uint128 q, char *buf, int min_digits)
+{
+  char tmp[MAX_POWER_128 + 2];
+  int n = 0;
+
+  do
+    {
+      /* Use 64-bit divisions for the lower 19 digits */
+      uint64_t low = q % 10000000000000000000ULL;
+      q /= 10000000000000000000ULL;
+      for (int i = 0; i < 19 && (low || q); ++i)
+        {
+          tmp[n++] = '0' + (low % 10);
+          low /= 10;
+        }
+    }
+  while (q);
+
+  while (n < min_digits)
+    tmp[n++] = '0';
+  for (int i = 0; i < n; ++i)
+    buf[i] = tmp[n - 1 - i];
+  return n;
+}
+
+/* Format the absolute value of VALUE (without the sign) into BODY,
+   with the type and precision of number_format. Returns the length
+   of the result, or -1 if it can't be done exactly. */
+static int
+format_number_body (long double value, char *body)
+{
+  char digits[MAX_POWER_128 + 2];
+  const int prec = number_format.precision;
+  const char dp = decimal_point;
+  uint64_t m = 0;
+  int e = 0;
+  int be = 0;
+  int n = 0;
+  uint128 q = 0;
+
+  if (value > 0)
+    {
+      const long double f = frexpl (value, &be);
+      m = (uint64_t) ldexpl (f, LDBL_MANT_DIG);
+      e = be - LDBL_MANT_DIG;
+    }
+
+  if (number_format.type == 'f')
+    {
+      if (!scale_round (m, e, prec, &q))
+        return -1;
+      const int nd = uint128_digits (q, digits, prec + 1);
+      const int int_digits = nd - prec;
+      memcpy (body, digits, int_digits);
+      n = int_digits;
+      if (prec > 0)
+        {
+          body[n++] = dp;
+          memcpy (body + n, digits + int_digits, prec);
+          n += prec;
+        }
+      return n;
+    }
+
+  /* %e and %g: P significant digits, the first has decimal exponent X */
+  const int p = (number_format.type == 'e') ? prec + 1 : (prec ? prec : 1);
+  int x = 0;
+  if (p > MAX_POWER_128)
+    return -1;
+  if (m)
+    {
+      /* Estimate X from the binary exponent, then adjust it */
+      x = (int) floor ((be - 1) * 0.30102999566398119521);
+      for (int tries = 0; ; ++tries)
+        {
+          if (tries == 3 || !scale_round (m, e, p - 1 - x, &q))
+            return -1;
+          if (q >= powers_of_ten_128[p])
+            ++x;
+          else if (q < powers_of_ten_128[p - 1])
+            --x;
+          else
+            break;
+        }
+    }
+  uint128_digits (q, digits, p);
+
+  bool exp_style = true;
+  int frac_digits = p - 1;
+  if (number_format.type == 'g')
+    {
+      /* Trailing zeros are removed */
+      while (frac_digits > 0 && digits[frac_digits] == '0')
+        --frac_digits;
+      exp_style = (x < -4 || x >= p);
+    }
+
+  if (!exp_style)
+    {
+      /* %g with fixed-point notation */
+      if (x >= 0)
+        {
+          memcpy (body, digits, x + 1);
+          n = x + 1;
+          frac_digits -= x;
+          if (frac_digits > 0)
+            {
+              body[n++] = dp;
+              memcpy (body + n, digits + x + 1, frac_digits);
+              n += frac_digits;
+            }
+        }
+      else
+        {
+          body[n++] = '0';
+          body[n++] = dp;
+          for (int i = 0; i < -x - 1; ++i)
+            body[n++] = '0';
+          memcpy (body + n, digits, frac_digits + 1);
+          n += frac_digits + 1;
+        }
+      return n;
+    }
+
+  body[n++] = digits[0];
+  if (frac_digits > 0)
+    {
+      body[n++] = dp;
+      memcpy (body + n, digits + 1, frac_digits);
+      n += frac_digits;
+    }
+  body[n++] = number_format.upper ? 'E' : 'e';
+  body[n++] = (x < 0) ? '-' : '+';
+  const unsigned int ax = (x < 0) ? -x : x;
+  if (ax >= 100)
+    body[n++] = '0' + ax / 100;
+  body[n++] = '0' + (ax / 10) % 10;
+  body[n++] = '0' + ax % 10;
+  return n;
+}
+#endif
+
+int
+format_number (char *buf, size_t size, long double value)
+{
+#if FAST_NUMBER_FORMAT
+  /* The longest body: 39 integer digits, a decimal point
+     and MAX_POWER_128 fraction digits */
+  char body[2 * MAX_POWER_128 + 8];
+  int n;
+
+  if (!number_format.fast || !isfinite (value))
+    goto slow;
+
+  const bool negative = signbit (value);
+  n = format_number_body (negative ? -value : value, body);
+  if (n < 0)
+    goto slow;
+
+  const char sign = negative ? '-' : number_format.sign;
+  const size_t len = n + (sign != 0);
+  const size_t pad = (len < (size_t) number_format.width)
+                     ? number_format.width - len : 0;
+  const size_t total = number_format.prefix_len + len + pad
+                       + number_format.suffix_len;
+  if (total >= size)
+    goto slow;
+
+  char *o = buf;
+  memcpy (o, number_format.prefix, number_format.prefix_len);
+  o += number_format.prefix_len;
+  if (pad && !number_format.left_justify && !number_format.zero_pad)
+    {
+      memset (o, ' ', pad);
+      o += pad;
+    }
+  if (sign)
+    *o++ = sign;
+  if (pad && number_format.zero_pad)
+    {
+      memset (o, '0', pad);
+      o += pad;
+    }
+  memcpy (o, body, n);
+  o += n;
+  if (pad && number_format.left_justify)
+    {
+      memset (o, ' ', pad);
+      o += pad;
+    }
+  memcpy (o, number_format.suffix, number_format.suffix_len);
+  o += number_format.suffix_len;
+  *o = '\0';
+  return o - buf;
+
+ slow:
+#endif
+  return snprintf (buf, size, numeric_output_format, value);
+}
@@ -0,0 +1,64 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Convert numeric input fields to long double values, and numeric results
+   back to text.
+   Plain decimal numbers (optionally with an exponent) which can be
+   converted exactly are handled directly; everything else (hexadecimal
+   values, infinities, leading whitespace, very long or very large
+   numbers) is converted by strtold (3), giving the same results.
+   Likewise, results are formatted directly when the output format is
+   a simple %e, %f or %g directive and the value is in a range which
+   can be rounded exactly with 128-bit integers; otherwise (and on systems
+   without 128-bit integers) snprintf (3) is used. */
+#ifndef __TEXT_NUMBERS_H__
+#define __TEXT_NUMBERS_H__
+
+enum number_parse_result
+{
+  NUMBER_OK,            /* a valid number */
+  NUMBER_NA,            /* 'NA' or 'N/A' (see is_na ()) */
+  NUMBER_NAN,           /* 'NaN' - both an N/A value and a valid number */
+  NUMBER_INVALID        /* empty field, or not a number */
+};
+
+/* Find the decimal point of the current locale, and parse the
+   numeric output format.
+   Must be called once (after setlocale) before parse_number ()
+   and format_number (). */
+void
+init_text_numbers (void);
+
+/* Parse the LEN bytes at STR (which need not be NUL-terminated)
+   as a number. On NUMBER_OK and NUMBER_NAN, the value is stored in *VALUE.
+   Numbers which are out of range are invalid. */
+enum number_parse_result
+parse_number (const char *str, size_t len, long double *value);
+
+/* Parse numeric_output_format again, after it was changed */
+void
+update_number_format (void);
+
+/* Format VALUE with numeric_output_format into BUF (of SIZE bytes).
+   Returns the length of the result, like snprintf (3). */
+int
+format_number (char *buf, size_t size, long double value);
+
+#endif
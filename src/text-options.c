@@ -30,6 +30,7 @@
 #include "die.h"
 #include "double-format.h"
 #include "text-options.h"
+#include "text-numbers.h"
 
 /* The character marking end of line. Default to \n. */
 char eolchar = '\n';
@@ -70,6 +71,8 @@ bool skip_comments = false;
 
 bool vnlog = false;
 
+bool csv_input = false;
+
 #define UCHAR_LIM (UCHAR_MAX + 1)
 bool blanks[UCHAR_LIM];
 
@@ -84,14 +87,6 @@ init_blank_table (void)
     }
 }
 
-/* Force generation of these inline'd symbols, needed to avoid
-   "undefined reference" when compiling with coverage instrumentation.
-   See: http://stackoverflow.com/a/16245669 */
-void print_field_separator ();
-void print_line_separator ();
-
-
-
 /* Calculate the required size of the output buffer */
 static void
 finalize_numeric_output_buffer ()
@@ -100,6 +95,7 @@ finalize_numeric_output_buffer ()
   long double d = LDBL_MAX;
   int n = snprintf (&c, 1, numeric_output_format, d);
   numeric_output_bufsize = n + 100 ;
+  update_number_format ();
 }
 
 void
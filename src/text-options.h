@@ -70,6 +70,11 @@ extern bool skip_comments;
 
 extern bool vnlog;
 
+/* if true, the input is CSV (RFC 4180): fields can be enclosed in
+   double-quotes, and quoted fields can contain the field delimiter,
+   line delimiters and doubled double-quotes. */
+extern bool csv_input;
+
 #define UCHAR_LIM (UCHAR_MAX + 1)
 extern bool blanks[UCHAR_LIM];
 
@@ -77,19 +82,6 @@ extern bool blanks[UCHAR_LIM];
 void
 init_blank_table (void);
 
-static inline void
-print_field_separator ()
-{
-  putchar (out_tab);
-}
-
-static inline void
-print_line_separator ()
-{
-  putchar (eolchar);
-}
-
-
 void
 set_numeric_output_precision (const char* digits);
 
@@ -0,0 +1,265 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <errno.h>
+#include <error.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "system.h"
+#include "die.h"
+#include "ignore-value.h"
+#include "minmax.h"
+#include "progname.h"
+#include "xalloc.h"
+
+#include "text-options.h"
+#include "text-output.h"
+
+char text_output_buf[TEXT_OUTPUT_SIZE];
+size_t text_output_len = 0;
+bool text_output_line_buffered = false;
+
+/* Captured output (see output_capture_begin ()) */
+static bool capturing = false;
+static char *capture_buf = NULL;
+static size_t capture_len = 0;
+static size_t capture_alloc = 0;
+
+/* Force generation of these inline'd symbols, needed to avoid
+   "undefined reference" when compiling with coverage instrumentation.
+   See: http://stackoverflow.com/a/16245669 */
+void print_field_separator ();
+void print_line_separator ();
+
+static void
+capture_append (const char *p, size_t n)
+{
+  if (n == 0)
+    return;
+  if (capture_alloc - capture_len < n)
+    {
+      capture_alloc = MAX (capture_alloc * 2, capture_len + n);
+      capture_buf = xrealloc (capture_buf, capture_alloc);
+    }
+  memcpy (capture_buf + capture_len, p, n);
+  capture_len += n;
+}
+
+/* Writes the buffered output followed by N bytes at P.
+   Returns false on write errors. */
+static bool
+output_write (const char *p, size_t n)
+{
+  struct iovec iov[2];
+  int iovcnt = 0;
+
+  if (capturing)
+    {
+      capture_append (text_output_buf, text_output_len);
+      capture_append (p, n);
+      text_output_len = 0;
+      return true;
+    }
+
+  if (text_output_len)
+    {
+      iov[iovcnt].iov_base = text_output_buf;
+      iov[iovcnt].iov_len = text_output_len;
+      ++iovcnt;
+    }
+  if (n)
+    {
+      iov[iovcnt].iov_base = (char *) p;
+      iov[iovcnt].iov_len = n;
+      ++iovcnt;
+    }
+  text_output_len = 0;
+
+  struct iovec *v = iov;
+  while (iovcnt > 0)
+    {
+      ssize_t w = writev (STDOUT_FILENO, v, iovcnt);
+      if (w < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return false;
+        }
+
+      /* Skip the written data (writes to pipes can be partial) */
+      while (iovcnt > 0 && (size_t) w >= v->iov_len)
+        {
+          w -= v->iov_len;
+          ++v;
+          --iovcnt;
+        }
+      if (iovcnt > 0)
+        {
+          v->iov_base = (char *) v->iov_base + w;
+          v->iov_len -= w;
+        }
+    }
+  return true;
+}
+
+void
+output_flush (void)
+{
+  if (text_output_len && !output_write (NULL, 0))
+    die (EXIT_FAILURE, errno, _("write error"));
+}
+
+/* Flushes the output at exit (like close_stdout () does for stdout) */
+static void
+output_close (void)
+{
+  if (text_output_len && !output_write (NULL, 0))
+    {
+      error (0, errno, _("write error"));
+      _exit (EXIT_FAILURE);
+    }
+}
+
+/* Called by error () instead of printing the program name: the pending
+   output is written first, as error () does with fflush (stdout), so
+   that messages follow the output lines they refer to */
+static void
+output_error_progname (void)
+{
+  /* A write error would be reported (again) while reporting it */
+  if (text_output_len)
+    ignore_value (output_write (NULL, 0));
+  fprintf (stderr, "%s: ", program_name);
+}
+
+void
+init_text_output (void)
+{
+  atexit (output_close);
+  error_print_progname = output_error_progname;
+
+  /* Like stdio, write complete lines to a terminal without delay */
+  text_output_line_buffered = isatty (STDOUT_FILENO);
+}
+
+void
+output_bytes_slow (const char *p, size_t n)
+{
+  if (n >= TEXT_OUTPUT_SIZE / 2)
+    {
+      if (!output_write (p, n))
+        die (EXIT_FAILURE, errno, _("write error"));
+      return;
+    }
+
+  output_flush ();
+  memcpy (text_output_buf, p, n);
+  text_output_len = n;
+}
+
+void
+output_csv_field (const char *p, size_t n)
+{
+  bool quote = false;
+  for (size_t i = 0; i < n && !quote; ++i)
+    quote = p[i] == '"' || p[i] == out_tab || p[i] == eolchar
+            || p[i] == '\n' || p[i] == '\r';
+  if (!quote)
+    {
+      output_bytes (p, n);
+      return;
+    }
+
+  output_char ('"');
+  for (const char *end = p + n; p < end; )
+    {
+      const char *q = memchr (p, '"', end - p);
+      if (!q)
+        {
+          output_bytes (p, end - p);
+          break;
+        }
+      output_bytes (p, q + 1 - p);
+      output_char ('"');
+      p = q + 1;
+    }
+  output_char ('"');
+}
+
+void
+output_printf (const char *format, ...)
+{
+  va_list ap;
+
+  va_start (ap, format);
+  size_t avail = TEXT_OUTPUT_SIZE - text_output_len;
+  int n = vsnprintf (text_output_buf + text_output_len, avail, format, ap);
+  va_end (ap);
+  if (n < 0)
+    die (EXIT_FAILURE, errno, _("write error"));
+  if ((size_t) n < avail)
+    {
+      text_output_len += n;
+      return;
+    }
+
+  /* Not enough room: format again after flushing (or into a temporary
+     buffer, if it would not fit at all) */
+  output_flush ();
+  char *buf = text_output_buf;
+  if ((size_t) n >= TEXT_OUTPUT_SIZE)
+    buf = xmalloc (n + 1);
+  va_start (ap, format);
+  vsnprintf (buf, n + 1, format, ap);
+  va_end (ap);
+  if (buf == text_output_buf)
+    text_output_len = n;
+  else
+    {
+      output_bytes (buf, n);
+      free (buf);
+    }
+}
+
+void
+output_capture_begin (void)
+{
+  output_flush ();
+  capturing = true;
+  capture_len = 0;
+}
+
+const char *
+output_capture_end (size_t *len)
+{
+  capture_append (text_output_buf, text_output_len);
+  text_output_len = 0;
+  capturing = false;
+  *len = capture_len;
+  return capture_buf;
+}
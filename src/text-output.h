@@ -0,0 +1,132 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Buffered standard output.
+   Output is appended to a large buffer (without the locking of stdio),
+   which is written to the standard output file descriptor when full,
+   at exit, before error messages, after each line if the standard
+   output is a terminal, or with output_flush (). Data larger than half of the
+   buffer is written directly, in one writev(2) call with the buffered
+   data. The standard output must not be written with stdio (e.g.
+   printf(3)) unless output_flush () was called first.
+   "text-options.h" must be included before this file. */
+#ifndef __TEXT_OUTPUT_H__
+#define __TEXT_OUTPUT_H__
+
+enum { TEXT_OUTPUT_SIZE = 256 * 1024 };
+
+extern char text_output_buf[TEXT_OUTPUT_SIZE];
+extern size_t text_output_len;
+
+/* If true, the output is written after each line */
+extern bool text_output_line_buffered;
+
+/* Registers the flushing of the output at exit, and before the messages
+   of error (). Must be called after atexit (close_stdout), so that the
+   output is written before the standard output is closed. */
+void
+init_text_output (void);
+
+/* Writes the buffered output. Fails on write errors. */
+void
+output_flush (void);
+
+/* Appends N bytes at P (called when they do not fit in the buffer) */
+void
+output_bytes_slow (const char *p, size_t n);
+
+/* Appends the field of N bytes at P, enclosed in double-quotes (and
+   with its double-quotes doubled) if it contains the output field
+   delimiter, a double-quote or a line delimiter (called with --csv) */
+void
+output_csv_field (const char *p, size_t n);
+
+/* Appends formatted output, formatting directly into the buffer */
+void
+output_printf (const char *format, ...);
+
+/* Starts capturing the output: the buffered output is written, and
+   the following output is kept in memory until output_capture_end () */
+void
+output_capture_begin (void);
+
+/* Stops capturing the output. Returns the captured output (valid until
+   the next capture), and stores its length in LEN. */
+const char *
+output_capture_end (size_t *len);
+
+static inline void
+output_bytes (const char *p, size_t n)
+{
+  if (n <= TEXT_OUTPUT_SIZE - text_output_len)
+    {
+      memcpy (text_output_buf + text_output_len, p, n);
+      text_output_len += n;
+    }
+  else
+    output_bytes_slow (p, n);
+}
+
+static inline void
+output_str (const char *s)
+{
+  output_bytes (s, strlen (s));
+}
+
+static inline void
+output_char (char c)
+{
+  if (text_output_len == TEXT_OUTPUT_SIZE)
+    output_flush ();
+  text_output_buf[text_output_len++] = c;
+}
+
+/* Appends an output field: with --csv, it is quoted as needed
+   (RFC 4180), so that the output can be read as CSV */
+static inline void
+output_field (const char *p, size_t n)
+{
+  if (csv_input)
+    output_csv_field (p, n);
+  else
+    output_bytes (p, n);
+}
+
+static inline void
+output_field_str (const char *s)
+{
+  output_field (s, strlen (s));
+}
+
+static inline void
+print_field_separator ()
+{
+  output_char (out_tab);
+}
+
+static inline void
+print_line_separator ()
+{
+  output_char (eolchar);
+  if (text_output_line_buffered)
+    output_flush ();
+}
+
+#endif
@@ -0,0 +1,130 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#include "system.h"
+#include "text-scan.h"
+
+uint64_t (*text_scan_kernel) (const char *p,
+                              const struct text_scan_set *set) = NULL;
+
+void
+text_scan_set_init (struct text_scan_set *set, const char *chars, size_t n)
+{
+  assert (n > 0 && n <= TEXT_SCAN_MAX_CHARS); /* LCOV_EXCL_LINE */
+
+  memset (set->member, 0, sizeof set->member);
+  for (size_t i = 0; i < TEXT_SCAN_MAX_CHARS; ++i)
+    {
+      set->chars[i] = to_uchar (chars[i < n ? i : 0]);
+      set->member[set->chars[i]] = true;
+    }
+}
+
+static uint64_t
+text_scan_portable (const char *p, const struct text_scan_set *set)
+{
+  uint64_t m = 0;
+  for (unsigned int i = 0; i < TEXT_SCAN_BLOCK; ++i)
+    m |= ((uint64_t) set->member[to_uchar (p[i])]) << i;
+  return m;
+}
+
+#if HAVE_X86_SIMD
+__attribute__ ((target ("sse2")))
+static inline uint32_t
+text_scan_sse2_16 (const char *p, const __m128i *c)
+{
+  const __m128i v = _mm_loadu_si128 ((const __m128i *) p);
+  const __m128i eq = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, c[0]),
+                                                 _mm_cmpeq_epi8 (v, c[1])),
+                                   _mm_or_si128 (_mm_cmpeq_epi8 (v, c[2]),
+                                                 _mm_cmpeq_epi8 (v, c[3])));
+  return (uint16_t) _mm_movemask_epi8 (eq);
+}
+
+__attribute__ ((target ("sse2")))
+static uint64_t
+text_scan_sse2 (const char *p, const struct text_scan_set *set)
+{
+  __m128i c[TEXT_SCAN_MAX_CHARS];
+  for (int i = 0; i < TEXT_SCAN_MAX_CHARS; ++i)
+    c[i] = _mm_set1_epi8 ((char) set->chars[i]);
+
+  return ((uint64_t) text_scan_sse2_16 (p, c))
+         | ((uint64_t) text_scan_sse2_16 (p + 16, c) << 16)
+         | ((uint64_t) text_scan_sse2_16 (p + 32, c) << 32)
+         | ((uint64_t) text_scan_sse2_16 (p + 48, c) << 48);
+}
+
+__attribute__ ((target ("avx2")))
+static inline uint32_t
+text_scan_avx2_32 (const char *p, const __m256i *c)
+{
+  const __m256i v = _mm256_loadu_si256 ((const __m256i *) p);
+  const __m256i eq =
+    _mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (v, c[0]),
+                                      _mm256_cmpeq_epi8 (v, c[1])),
+                     _mm256_or_si256 (_mm256_cmpeq_epi8 (v, c[2]),
+                                      _mm256_cmpeq_epi8 (v, c[3])));
+  return (uint32_t) _mm256_movemask_epi8 (eq);
+}
+
+__attribute__ ((target ("avx2")))
+static uint64_t
+text_scan_avx2 (const char *p, const struct text_scan_set *set)
+{
+  __m256i c[TEXT_SCAN_MAX_CHARS];
+  for (int i = 0; i < TEXT_SCAN_MAX_CHARS; ++i)
+    c[i] = _mm256_set1_epi8 ((char) set->chars[i]);
+
+  return ((uint64_t) text_scan_avx2_32 (p, c))
+         | ((uint64_t) text_scan_avx2_32 (p + 32, c) << 32);
+}
+#endif
+
+void
+init_text_scan (bool use_simd)
+{
+  text_scan_kernel = text_scan_portable;
+
+#if HAVE_X86_SIMD
+  if (!use_simd)
+    return;
+
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+    text_scan_kernel = text_scan_avx2;
+  else if (__builtin_cpu_supports ("sse2"))
+    text_scan_kernel = text_scan_sse2;
+#else
+  (void) use_simd;
+#endif
+}
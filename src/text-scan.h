@@ -0,0 +1,92 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Scan text for a small set of bytes, 64 bytes at a time.
+   On x86, SSE2 or AVX2 kernels are selected at run time;
+   other systems use a portable (table-driven) implementation. */
+#ifndef __TEXT_SCAN_H__
+#define __TEXT_SCAN_H__
+
+/* Number of bytes examined by one call to text_scan_block () */
+enum { TEXT_SCAN_BLOCK = 64 };
+
+/* Maximum number of distinct bytes in a scan set */
+enum { TEXT_SCAN_MAX_CHARS = 4 };
+
+struct text_scan_set
+{
+  /* The bytes to search for. Unused slots repeat the first byte,
+     so that the vector kernels can always compare against all of them. */
+  unsigned char chars[TEXT_SCAN_MAX_CHARS];
+
+  /* Membership table, used by the portable kernel */
+  bool member[UCHAR_MAX + 1];
+};
+
+/* Initialize SET to search for the N bytes in CHARS.
+   N must be between 1 and TEXT_SCAN_MAX_CHARS. */
+void
+text_scan_set_init (struct text_scan_set *set, const char *chars, size_t n);
+
+/* Selected kernel - set by init_text_scan () */
+extern uint64_t (*text_scan_kernel) (const char *p,
+                                     const struct text_scan_set *set);
+
+/* Select the fastest kernel supported by the CPU
+   (or the portable kernel, if USE_SIMD is false).
+   Must be called once before text_scan_block (). */
+void
+init_text_scan (bool use_simd);
+
+/* Returns a bit-mask of the positions of the bytes in SET
+   found in the N bytes at P (bit 0 = P[0]).
+   N must not exceed TEXT_SCAN_BLOCK. Bits at or above N are zero.  */
+static inline uint64_t
+text_scan_block (const char *p, size_t n, const struct text_scan_set *set)
+{
+  if (n == TEXT_SCAN_BLOCK)
+    return text_scan_kernel (p, set);
+
+  /* Never read beyond the end of the buffer (which might be the end
+     of a memory-mapped file): scan a padded copy instead. */
+  char tmp[TEXT_SCAN_BLOCK] = { 0 };
+  memcpy (tmp, p, n);
+  return text_scan_kernel (tmp, set) & ((((uint64_t) 1) << n) - 1);
+}
+
+/* Index of the lowest set bit in (non-zero) M */
+static inline unsigned int
+text_scan_first (uint64_t m)
+{
+  assert (m != 0); /* LCOV_EXCL_LINE */
+#if defined __GNUC__ || defined __clang__
+  return __builtin_ctzll (m);
+#else
+  unsigned int i = 0;
+  while (!(m & 1))
+    {
+      m >>= 1;
+      ++i;
+    }
+  return i;
+#endif
+}
+
+#endif
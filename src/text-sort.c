@@ -0,0 +1,1045 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <locale.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "system.h"
+#ifndef MIN
+#include "minmax.h"
+#endif
+#include "die.h"
+#include "hard-locale.h"
+#include "linebuffer.h"
+#include "quote.h"
+#include "xalloc.h"
+
+#include "text-options.h"
+#include "text-lines.h"
+#include "text-sort.h"
+
+/* Size of the blocks holding the lines (and their keys) */
+enum { SORT_CHUNK_SIZE = 1024 * 1024 };
+
+/* Maximum number of runs merged at the same time */
+enum { SORT_MAX_MERGE = 16 };
+
+/* Maximum number of sorting threads, and minimum number of lines
+   sorted by each thread */
+enum { SORT_MAX_THREADS = 8 };
+enum { SORT_MIN_THREAD_LINES = 16 * 1024 };
+
+/* Stdio buffer size of the temporary files */
+enum { SORT_RUN_BUFFER = 128 * 1024 };
+
+/* A line and its sort key.
+   The key is the concatenation of the encoded key fields (see
+   sort_key_append_bytes () and sort_key_append_collated ()), so that
+   comparing keys with memcmp(3) compares the key fields in order.
+   The keys of lines which were read in order are built only when
+   needed (see line_sorter_add ()). */
+struct sort_record
+{
+  uint64_t prefix;      /* the first 8 bytes of the key (big-endian) */
+  const char *key;
+  size_t key_len;
+  const char *line;     /* the line, without its delimiter */
+  size_t len;
+};
+
+/* A buffer holding a key being built */
+struct sort_key
+{
+  char *data;
+  size_t len;
+  size_t alloc;
+};
+
+/* A block of memory holding lines and keys */
+struct sort_chunk
+{
+  char *data;
+  size_t size;
+  size_t used;
+};
+
+/* A sorted run in a temporary file: each record is written as
+   the key's length, the line's length, the key and the line. */
+struct sort_run
+{
+  FILE *stream;         /* NULL after the last record was read */
+  char *buf;            /* the current record's key and line */
+  size_t alloc;
+  struct sort_record rec;
+};
+
+/* Merging of sorted runs: a binary heap of the indexes of the runs
+   (with a current record), ordered by their current records */
+struct sort_merge
+{
+  struct sort_run *runs;
+  size_t *heap;
+  size_t heap_len;
+};
+
+struct line_sorter
+{
+  size_t *keys;
+  size_t num_keys;
+  size_t max_key;
+  bool fold_case;
+  bool collate;         /* compare with strxfrm(3) keys */
+  size_t buffer_size;
+  size_t threads;
+
+  /* Lines read and not yet written to a run */
+  struct sort_record *recs;
+  size_t num_recs;
+  size_t alloc_recs;
+  struct sort_record *tmp;  /* merge sort buffer */
+  struct sort_chunk *chunks;
+  size_t num_chunks;
+  size_t cur_chunk;
+  size_t used;          /* bytes of lines and keys in the chunks */
+
+  /* The first 'in_order' lines (not yet written to a run) were read
+     in order: until a line is not, their keys are not stored, and
+     they need not be sorted */
+  size_t in_order;
+  size_t in_order_keys;  /* bytes of their keys */
+
+  struct sort_key key;      /* the key of the current line */
+  struct sort_key prev_key; /* the key of the previous line */
+  struct sort_key aux_key;  /* the key of a line read in order */
+  struct line_record_t aux_line;
+  char *field;          /* NUL-terminated copy of a key field */
+  size_t field_alloc;
+
+  /* Runs written to temporary files (none if all the lines were
+     sorted in memory) */
+  struct sort_run *runs;
+  size_t num_runs;
+  size_t alloc_runs;
+
+  bool started;
+  const struct sort_record *sorted; /* all the lines, sorted in memory */
+  size_t next;                      /* next line of 'sorted' */
+  struct sort_merge merge;          /* merging of 'runs' */
+
+  /* Copies of the lines of the current batch (merging only) */
+  char *out;
+  size_t out_alloc;
+  size_t *out_len;
+};
+
+static inline uint64_t
+sort_key_prefix (const char *key, size_t len)
+{
+  uint64_t p = 0;
+  for (size_t i = 0; i < 8; ++i)
+    p = (p << 8) | (i < len ? to_uchar (key[i]) : 0);
+  return p;
+}
+
+static inline int
+sort_key_compare (const char *a, size_t a_len, const char *b, size_t b_len)
+{
+  const int diff = memcmp (a, b, MIN (a_len, b_len));
+  if (diff)
+    return diff;
+  return (a_len > b_len) - (a_len < b_len);
+}
+
+static inline int
+sort_record_compare (const struct sort_record *a, const struct sort_record *b)
+{
+  if (a->prefix != b->prefix)
+    return a->prefix < b->prefix ? -1 : 1;
+  /* Every key has the same number of (zero) field separators,
+     so keys of up to 8 bytes with the same prefix are equal */
+  if (a->key_len <= sizeof a->prefix && b->key_len <= sizeof b->prefix)
+    return 0;
+  return sort_key_compare (a->key, a->key_len, b->key, b->key_len);
+}
+
+static char *
+sort_key_reserve (struct sort_key *k, size_t used, size_t n)
+{
+  if (k->alloc - used < n)
+    {
+      if (SIZE_MAX - used < n)
+        xalloc_die ();
+      k->alloc = MAX (k->alloc * 2, used + n);
+      k->data = xrealloc (k->data, k->alloc);
+    }
+  return k->data + used;
+}
+
+/* Appends the field STR (LEN bytes) to the key K (USED bytes so far),
+   comparing byte values: bytes 0 and 1 are encoded as two bytes (1,1)
+   and (1,2), and the field ends with a 0 byte. Returns the new length
+   of the key. */
+static size_t
+sort_key_append_bytes (const struct line_sorter *s, struct sort_key *k,
+                       size_t used, const char *str, size_t len)
+{
+  if (len > (SIZE_MAX - 1) / 2)
+    xalloc_die ();
+  char *p = sort_key_reserve (k, used, len * 2 + 1);
+  char *const start = p;
+
+  /* Most fields are copied as they are */
+  if (!s->fold_case && !memchr (str, 0, len) && !memchr (str, 1, len))
+    {
+      memcpy (p, str, len);
+      p[len] = 0;
+      return used + len + 1;
+    }
+
+  for (size_t i = 0; i < len; ++i)
+    {
+      unsigned char c = to_uchar (str[i]);
+      if (s->fold_case)
+        c = toupper (c);
+      if (c <= 1)
+        {
+          *p++ = 1;
+          c++;
+        }
+      *p++ = c;
+    }
+  *p++ = 0;
+  return used + (p - start);
+}
+
+/* Appends the field STR (LEN bytes) to the key K (USED bytes so far),
+   transformed with strxfrm(3), and followed by a 0 byte.
+   Returns the new length of the key. */
+static size_t
+sort_key_append_collated (struct line_sorter *s, struct sort_key *k,
+                          size_t used, const char *str, size_t len)
+{
+  if (s->field_alloc <= len)
+    {
+      s->field_alloc = MAX (s->field_alloc * 2, len + 1);
+      s->field = xrealloc (s->field, s->field_alloc);
+    }
+  for (size_t i = 0; i < len; ++i)
+    s->field[i] = s->fold_case ? toupper (to_uchar (str[i])) : str[i];
+  s->field[len] = '\0';
+
+  size_t avail = k->alloc - used;
+  errno = 0;
+  size_t n = strxfrm (k->data + used, s->field, avail);
+  if (n >= avail)
+    {
+      sort_key_reserve (k, used, n + 1);
+      n = strxfrm (k->data + used, s->field, n + 1);
+    }
+  if (errno)
+    die (EXIT_FAILURE, errno, _("string transformation failed"));
+
+  sort_key_reserve (k, used + n, 1)[0] = 0;
+  return used + n + 1;
+}
+
+/* Stores the key of LR in K. Missing key fields are empty. */
+static void
+sort_key_build (struct line_sorter *s, struct sort_key *k,
+                const struct line_record_t *lr)
+{
+  size_t used = 0;
+  for (size_t i = 0; i < s->num_keys; ++i)
+    {
+      const char *str = "";
+      size_t len = 0;
+      line_record_get_field (lr, s->keys[i], &str, &len);
+      if (s->collate)
+        used = sort_key_append_collated (s, k, used, str, len);
+      else
+        used = sort_key_append_bytes (s, k, used, str, len);
+    }
+  k->len = used;
+}
+
+/* Builds the key of REC (a line read in order) in s->aux_key */
+static void
+sort_record_build_key (struct line_sorter *s, struct sort_record *rec)
+{
+  line_record_set (&s->aux_line, rec->line, rec->len, s->max_key);
+  sort_key_build (s, &s->aux_key, &s->aux_line);
+  rec->key = s->aux_key.data;
+  rec->key_len = s->aux_key.len;
+  rec->prefix = sort_key_prefix (rec->key, rec->key_len);
+}
+
+/* Returns N bytes in the sorter's chunks */
+static char *
+sort_chunk_alloc (struct line_sorter *s, size_t n)
+{
+  while (s->cur_chunk < s->num_chunks)
+    {
+      struct sort_chunk *c = &s->chunks[s->cur_chunk];
+      if (c->size - c->used >= n)
+        {
+          char *p = c->data + c->used;
+          c->used += n;
+          s->used += n;
+          return p;
+        }
+      s->cur_chunk++;
+    }
+
+  s->chunks = xnrealloc (s->chunks, s->num_chunks + 1, sizeof *s->chunks);
+  struct sort_chunk *c = &s->chunks[s->num_chunks++];
+  c->size = MAX (n, SORT_CHUNK_SIZE);
+  c->data = xmalloc (c->size);
+  c->used = n;
+  s->used += n;
+  return c->data;
+}
+
+/* Stable insertion sort, for short ranges */
+static void
+sort_records_insertion (struct sort_record *r, size_t n)
+{
+  for (size_t i = 1; i < n; ++i)
+    {
+      const struct sort_record x = r[i];
+      size_t j = i;
+      while (j > 0 && sort_record_compare (&r[j - 1], &x) > 0)
+        {
+          r[j] = r[j - 1];
+          --j;
+        }
+      r[j] = x;
+    }
+}
+
+/* Merges the sorted ranges A (NA records) and B (NB records) into OUT.
+   Records of A come first if their keys are equal. */
+static void
+sort_records_merge (const struct sort_record *a, size_t na,
+                    const struct sort_record *b, size_t nb,
+                    struct sort_record *out)
+{
+  while (na && nb)
+    {
+      if (sort_record_compare (b, a) < 0)
+        {
+          *out++ = *b++;
+          --nb;
+        }
+      else
+        {
+          *out++ = *a++;
+          --na;
+        }
+    }
+  memcpy (out, a, na * sizeof *a);
+  memcpy (out + na, b, nb * sizeof *b);
+}
+
+static void sort_records_to (struct sort_record *r, struct sort_record *tmp,
+                             size_t n);
+
+/* Stable merge sort of the N records R, using TMP (N records).
+   The halves are sorted into TMP (see sort_records_to ()), so that
+   every level of the recursion moves the records once. */
+static void
+sort_records (struct sort_record *r, struct sort_record *tmp, size_t n)
+{
+  if (n <= 16)
+    {
+      sort_records_insertion (r, n);
+      return;
+    }
+
+  const size_t h = n / 2;
+  sort_records_to (r, tmp, h);
+  sort_records_to (r + h, tmp + h, n - h);
+  sort_records_merge (tmp, h, tmp + h, n - h, r);
+}
+
+/* Like sort_records (), but the sorted records are stored in TMP */
+static void
+sort_records_to (struct sort_record *r, struct sort_record *tmp, size_t n)
+{
+  if (n <= 16)
+    {
+      sort_records_insertion (r, n);
+      memcpy (tmp, r, n * sizeof *r);
+      return;
+    }
+
+  const size_t h = n / 2;
+  sort_records (r, tmp, h);
+  sort_records (r + h, tmp + h, n - h);
+  sort_records_merge (r, h, r + h, n - h, tmp);
+}
+
+#if HAVE_PTHREAD
+/* A part of a parallel sort: sorting R (N records, using TMP), or
+   merging the sorted ranges R (N records) and R + N (N2 records)
+   into TMP */
+struct sort_task
+{
+  struct sort_record *r;
+  struct sort_record *tmp;
+  size_t n;
+  size_t n2;
+  bool merge;
+};
+
+static void *
+sort_task_run (void *arg)
+{
+  struct sort_task *t = arg;
+  if (t->merge)
+    sort_records_merge (t->r, t->n, t->r + t->n, t->n2, t->tmp);
+  else
+    sort_records (t->r, t->tmp, t->n);
+  return NULL;
+}
+
+/* Runs the N tasks T, on separate threads (except the first one) */
+static void
+sort_tasks_run (struct sort_task *t, size_t n)
+{
+  pthread_t *threads = XNMALLOC (n, pthread_t);
+  bool *started = XNMALLOC (n, bool);
+
+  for (size_t i = 1; i < n; ++i)
+    {
+      started[i] = pthread_create (&threads[i], NULL, sort_task_run,
+                                   &t[i]) == 0;
+      if (!started[i])
+        sort_task_run (&t[i]);
+    }
+  sort_task_run (&t[0]);
+  for (size_t i = 1; i < n; ++i)
+    if (started[i])
+      pthread_join (threads[i], NULL);
+
+  free (started);
+  free (threads);
+}
+#endif
+
+/* Sorts the N records R (using TMP), with up to THREADS threads.
+   Returns the sorted records: either R or TMP. */
+static struct sort_record *
+sort_records_parallel (struct sort_record *r, struct sort_record *tmp,
+                       size_t n, size_t threads)
+{
+#if HAVE_PTHREAD
+  const size_t parts = MIN (threads, n / SORT_MIN_THREAD_LINES);
+  if (parts > 1)
+    {
+      /* Sort PARTS ranges at the same time, then merge pairs of
+         neighbouring ranges (at the same time) until one is left. */
+      struct sort_task *t = XNMALLOC (parts, struct sort_task);
+      size_t *bounds = XNMALLOC (parts + 1, size_t);
+      for (size_t i = 0; i <= parts; ++i)
+        bounds[i] = n / parts * i + MIN (i, n % parts);
+
+      for (size_t i = 0; i < parts; ++i)
+        {
+          t[i].r = r + bounds[i];
+          t[i].tmp = tmp + bounds[i];
+          t[i].n = bounds[i + 1] - bounds[i];
+          t[i].merge = false;
+        }
+      sort_tasks_run (t, parts);
+
+      struct sort_record *src = r;
+      struct sort_record *dst = tmp;
+      size_t num_bounds = parts;
+      while (num_bounds > 1)
+        {
+          size_t nt = 0;
+          for (size_t i = 0; i + 1 < num_bounds; i += 2)
+            {
+              t[nt].r = src + bounds[i];
+              t[nt].tmp = dst + bounds[i];
+              t[nt].n = bounds[i + 1] - bounds[i];
+              t[nt].n2 = bounds[i + 2] - bounds[i + 1];
+              t[nt].merge = true;
+              nt++;
+            }
+          if (num_bounds % 2)
+            memcpy (dst + bounds[num_bounds - 1], src + bounds[num_bounds - 1],
+                    (n - bounds[num_bounds - 1]) * sizeof *src);
+          sort_tasks_run (t, nt);
+
+          /* Keep the boundaries of the merged ranges */
+          size_t nb = 0;
+          for (size_t i = 0; i < num_bounds; i += 2)
+            bounds[nb++] = bounds[i];
+          bounds[nb] = n;
+          num_bounds = nb;
+
+          struct sort_record *x = src;
+          src = dst;
+          dst = x;
+        }
+      free (bounds);
+      free (t);
+      return src;
+    }
+#else
+  (void) threads;
+#endif
+
+  sort_records (r, tmp, n);
+  return r;
+}
+
+/* Sorts the lines in memory. Returns the sorted lines:
+   either s->recs or s->tmp. Lines read in order are not sorted
+   again: only the following ones are, and they are merged. */
+static struct sort_record *
+line_sorter_sort (struct line_sorter *s)
+{
+  const size_t n = s->num_recs;
+  const size_t p = s->in_order;
+  if (p == n)
+    return s->recs;
+
+  s->tmp = xnrealloc (s->tmp, s->alloc_recs, sizeof *s->tmp);
+  struct sort_record *r = sort_records_parallel (s->recs + p, s->tmp + p,
+                                                 n - p, s->threads);
+  if (p == 0)
+    return r;
+  if (r != s->recs + p)
+    memcpy (s->recs + p, r, (n - p) * sizeof *r);
+  sort_records_merge (s->recs, p, s->recs + p, n - p, s->tmp);
+  return s->tmp;
+}
+
+FILE *
+sort_tmpfile (void)
+{
+  const char *dir = getenv ("TMPDIR");
+  if (!dir || !*dir)
+    dir = "/tmp";
+
+  char *name = xmalloc (strlen (dir) + sizeof "/datamashXXXXXX");
+  stpcpy (stpcpy (name, dir), "/datamashXXXXXX");
+  const int fd = mkstemp (name);
+  if (fd < 0)
+    die (EXIT_FAILURE, errno, _("failed to create temporary file in %s"),
+         quoteaf (dir));
+  /* The file is removed when closed */
+  unlink (name);
+  free (name);
+
+  FILE *f = fdopen (fd, "w+");
+  if (f == NULL)
+    die (EXIT_FAILURE, errno, _("failed to create temporary file in %s"),
+         quoteaf (dir));
+  setvbuf (f, NULL, _IOFBF, SORT_RUN_BUFFER);
+  return f;
+}
+
+static void
+sort_run_write (FILE *f, const struct sort_record *rec)
+{
+  if (fwrite (&rec->key_len, sizeof rec->key_len, 1, f) != 1
+      || fwrite (&rec->len, sizeof rec->len, 1, f) != 1
+      || fwrite (rec->key, 1, rec->key_len, f) != rec->key_len
+      || fwrite (rec->line, 1, rec->len, f) != rec->len)
+    die (EXIT_FAILURE, errno, _("write error"));
+}
+
+/* Starts reading a run written to F */
+static void
+sort_run_init (struct sort_run *run, FILE *f)
+{
+  if (fflush (f) != 0 || fseeko (f, 0, SEEK_SET) != 0)
+    die (EXIT_FAILURE, errno, _("write error"));
+  run->stream = f;
+  run->buf = NULL;
+  run->alloc = 0;
+}
+
+/* Reads the next record of RUN. Returns false after the last one. */
+static bool
+sort_run_next (struct sort_run *run)
+{
+  if (!run->stream)
+    return false;
+
+  size_t key_len, len;
+  if (fread (&key_len, sizeof key_len, 1, run->stream) != 1)
+    {
+      if (ferror (run->stream))
+        die (EXIT_FAILURE, errno, _("read error"));
+      fclose (run->stream);
+      run->stream = NULL;
+      return false;
+    }
+  if (fread (&len, sizeof len, 1, run->stream) != 1)
+    die (EXIT_FAILURE, errno, _("read error"));
+
+  if (run->alloc < key_len + len)
+    {
+      run->alloc = MAX (run->alloc * 2, key_len + len);
+      run->buf = xrealloc (run->buf, run->alloc);
+    }
+  if (fread (run->buf, 1, key_len + len, run->stream) != key_len + len)
+    die (EXIT_FAILURE, errno, _("read error"));
+
+  run->rec.key = run->buf;
+  run->rec.key_len = key_len;
+  run->rec.prefix = sort_key_prefix (run->buf, key_len);
+  run->rec.line = run->buf + key_len;
+  run->rec.len = len;
+  return true;
+}
+
+static void
+sort_run_free (struct sort_run *run)
+{
+  if (run->stream)
+    fclose (run->stream);
+  run->stream = NULL;
+  free (run->buf);
+  run->buf = NULL;
+}
+
+/* Returns true if the current record of run A comes before
+   the current record of run B (earlier runs first, for equal keys) */
+static inline bool
+sort_merge_less (const struct sort_merge *m, size_t a, size_t b)
+{
+  const int diff = sort_record_compare (&m->runs[a].rec, &m->runs[b].rec);
+  return diff < 0 || (diff == 0 && a < b);
+}
+
+static void
+sort_merge_sift_down (struct sort_merge *m, size_t i)
+{
+  while (true)
+    {
+      const size_t l = 2 * i + 1;
+      const size_t r = l + 1;
+      size_t min = i;
+      if (l < m->heap_len && sort_merge_less (m, m->heap[l], m->heap[min]))
+        min = l;
+      if (r < m->heap_len && sort_merge_less (m, m->heap[r], m->heap[min]))
+        min = r;
+      if (min == i)
+        return;
+      const size_t x = m->heap[i];
+      m->heap[i] = m->heap[min];
+      m->heap[min] = x;
+      i = min;
+    }
+}
+
+/* Starts merging the N runs RUNS */
+static void
+sort_merge_init (struct sort_merge *m, struct sort_run *runs, size_t n)
+{
+  m->runs = runs;
+  m->heap = XNMALLOC (n, size_t);
+  m->heap_len = 0;
+  for (size_t i = 0; i < n; ++i)
+    if (sort_run_next (&runs[i]))
+      m->heap[m->heap_len++] = i;
+  for (size_t i = m->heap_len / 2; i-- > 0; )
+    sort_merge_sift_down (m, i);
+}
+
+/* Returns the next record of the merge (NULL after the last one).
+   It remains valid until sort_merge_advance () is called. */
+static inline const struct sort_record *
+sort_merge_peek (const struct sort_merge *m)
+{
+  return m->heap_len ? &m->runs[m->heap[0]].rec : NULL;
+}
+
+static void
+sort_merge_advance (struct sort_merge *m)
+{
+  if (!sort_run_next (&m->runs[m->heap[0]]))
+    m->heap[0] = m->heap[--m->heap_len];
+  sort_merge_sift_down (m, 0);
+}
+
+static void
+sort_merge_free (struct sort_merge *m)
+{
+  free (m->heap);
+  m->heap = NULL;
+  m->heap_len = 0;
+}
+
+/* Appends a run, written to F */
+static void
+line_sorter_add_run (struct line_sorter *s, FILE *f)
+{
+  if (s->num_runs == s->alloc_runs)
+    s->runs = x2nrealloc (s->runs, &s->alloc_runs, sizeof *s->runs);
+  sort_run_init (&s->runs[s->num_runs++], f);
+}
+
+/* Sorts the lines in memory, and writes them to a new run */
+static void
+line_sorter_spill (struct line_sorter *s)
+{
+  FILE *f = sort_tmpfile ();
+  if (s->in_order == s->num_recs)
+    {
+      /* The lines are in order: their keys are built as they are
+         written */
+      for (size_t i = 0; i < s->num_recs; ++i)
+        {
+          struct sort_record rec = s->recs[i];
+          sort_record_build_key (s, &rec);
+          sort_run_write (f, &rec);
+        }
+    }
+  else
+    {
+      const struct sort_record *r = line_sorter_sort (s);
+      for (size_t i = 0; i < s->num_recs; ++i)
+        sort_run_write (f, &r[i]);
+    }
+  line_sorter_add_run (s, f);
+
+  s->num_recs = 0;
+  s->in_order = 0;
+  s->in_order_keys = 0;
+  s->used = 0;
+  s->cur_chunk = 0;
+  for (size_t i = 0; i < s->num_chunks; ++i)
+    s->chunks[i].used = 0;
+}
+
+/* Merges the N runs RUNS into a new run, stored in RUNS[0] */
+static void
+line_sorter_merge_runs (struct sort_run *runs, size_t n)
+{
+  struct sort_merge m;
+  const struct sort_record *rec;
+  FILE *f = sort_tmpfile ();
+
+  sort_merge_init (&m, runs, n);
+  while ((rec = sort_merge_peek (&m)) != NULL)
+    {
+      sort_run_write (f, rec);
+      sort_merge_advance (&m);
+    }
+  sort_merge_free (&m);
+
+  for (size_t i = 0; i < n; ++i)
+    sort_run_free (&runs[i]);
+  sort_run_init (&runs[0], f);
+}
+
+/* Merges groups of neighbouring runs, until they can be merged
+   at the same time */
+static void
+line_sorter_reduce_runs (struct line_sorter *s)
+{
+  while (s->num_runs > SORT_MAX_MERGE)
+    {
+      size_t n = 0;
+      for (size_t i = 0; i < s->num_runs; i += SORT_MAX_MERGE)
+        {
+          const size_t k = MIN (SORT_MAX_MERGE, s->num_runs - i);
+          if (k > 1)
+            line_sorter_merge_runs (&s->runs[i], k);
+          s->runs[n++] = s->runs[i];
+        }
+      s->num_runs = n;
+    }
+}
+
+/* Returns true if N more bytes of lines and keys (and one more line)
+   would exceed the memory budget of S. The merge sort buffer counts
+   only if the lines must be SORTED. */
+static inline bool
+line_sorter_full (const struct line_sorter *s, size_t n, bool sorted)
+{
+  return (s->used + n + (sorted ? 2 : 1) * (s->num_recs + 1) * sizeof *s->recs
+          > s->buffer_size);
+}
+
+/* Stores the keys of the lines read in order, before the first line
+   which is not */
+static void
+line_sorter_build_keys (struct line_sorter *s)
+{
+  for (size_t i = 0; i < s->in_order; ++i)
+    {
+      struct sort_record *rec = &s->recs[i];
+      sort_record_build_key (s, rec);
+      char *p = sort_chunk_alloc (s, rec->key_len);
+      memcpy (p, rec->key, rec->key_len);
+      rec->key = p;
+    }
+  s->in_order_keys = 0;
+}
+
+/* Adds the line LR. If STABLE is true, LR remains valid until the
+   sorter is freed, and it is not copied. */
+static void
+line_sorter_add (struct line_sorter *s, const struct line_record_t *lr,
+                 bool stable)
+{
+  sort_key_build (s, &s->key, lr);
+  const size_t key_len = s->key.len;
+  const size_t len = line_record_length (lr);
+  const size_t line_size = stable ? 0 : len + 1;
+
+  if (s->num_recs
+      && line_sorter_full (s, key_len + line_size,
+                           s->in_order < s->num_recs))
+    line_sorter_spill (s);
+
+  bool in_order = s->in_order == s->num_recs;
+  if (in_order && s->num_recs)
+    in_order = sort_key_compare (s->prev_key.data, s->prev_key.len,
+                                 s->key.data, key_len) <= 0;
+
+  /* The current key becomes the previous one */
+  const struct sort_key k = s->prev_key;
+  s->prev_key = s->key;
+  s->key = k;
+
+  if (!in_order && s->in_order == s->num_recs)
+    {
+      /* The first line out of order: the lines before it are written
+         to a run (without sorting them) if their keys do not fit */
+      if (line_sorter_full (s, s->in_order_keys + key_len + line_size, true))
+        {
+          line_sorter_spill (s);
+          in_order = true;
+        }
+      else
+        line_sorter_build_keys (s);
+    }
+
+  if (s->num_recs == s->alloc_recs)
+    s->recs = x2nrealloc (s->recs, &s->alloc_recs, sizeof *s->recs);
+  struct sort_record *rec = &s->recs[s->num_recs++];
+
+  if (in_order)
+    {
+      s->in_order++;
+      s->in_order_keys += key_len;
+      rec->key = NULL;
+      rec->key_len = 0;
+      rec->prefix = 0;
+    }
+  else
+    {
+      char *p = sort_chunk_alloc (s, key_len);
+      memcpy (p, s->prev_key.data, key_len);
+      rec->key = p;
+      rec->key_len = key_len;
+      rec->prefix = sort_key_prefix (p, key_len);
+    }
+
+  if (stable)
+    rec->line = line_record_buffer (lr);
+  else
+    {
+      /* Lines are NUL-terminated, as in line_input's buffers, so that
+         strtold(3) never reads beyond them */
+      char *p = sort_chunk_alloc (s, len + 1);
+      memcpy (p, line_record_buffer (lr), len);
+      p[len] = '\0';
+      rec->line = p;
+    }
+  rec->len = len;
+}
+
+/* Returns true if LR points into the memory-mapped input IN, which
+   remains valid until IN is freed (unlike the mappings of several
+   input files) */
+static bool
+line_is_mapped (const struct line_input *in, const struct line_record_t *lr)
+{
+  const char *p = line_record_buffer (lr);
+  return in->map && !in->files && p >= in->map && p < in->map + in->map_len;
+}
+
+/* Reads and sorts all the lines of IN */
+static void
+line_sorter_read (struct line_sorter *s, struct line_input *in,
+                  char delimiter, bool skip_comments)
+{
+  struct line_batch batch;
+  const size_t max_fields = in->max_fields;
+
+  /* Only the keys are needed */
+  in->max_fields = s->max_key;
+  line_batch_init (&batch);
+  while (line_batch_fread (&batch, in, delimiter, skip_comments))
+    for (size_t i = 0; i < batch.num_lines; ++i)
+      line_sorter_add (s, &batch.lines[i],
+                       line_is_mapped (in, &batch.lines[i]));
+  line_batch_free (&batch);
+  in->max_fields = max_fields;
+
+  if (s->num_runs == 0)
+    {
+      s->sorted = line_sorter_sort (s);
+      s->next = 0;
+      return;
+    }
+
+  if (s->num_recs)
+    line_sorter_spill (s);
+  line_sorter_reduce_runs (s);
+  sort_merge_init (&s->merge, s->runs, s->num_runs);
+}
+
+struct line_sorter *
+line_sorter_init (const size_t *keys, size_t num_keys, bool fold_case,
+                  size_t buffer_size, size_t threads)
+{
+  struct line_sorter *s = xzalloc (sizeof *s);
+
+  assert (num_keys > 0); /* LCOV_EXCL_LINE */
+  s->keys = xmemdup (keys, num_keys * sizeof *keys);
+  s->num_keys = num_keys;
+  for (size_t i = 0; i < num_keys; ++i)
+    s->max_key = MAX (s->max_key, keys[i]);
+  s->fold_case = fold_case;
+  s->collate = hard_locale (LC_COLLATE);
+  s->buffer_size = buffer_size;
+  sort_key_reserve (&s->key, 0, 64);
+  sort_key_reserve (&s->prev_key, 0, 64);
+  sort_key_reserve (&s->aux_key, 0, 64);
+  line_record_init (&s->aux_line);
+
+  if (threads == 0)
+    {
+      threads = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+      const long int n = sysconf (_SC_NPROCESSORS_ONLN);
+      if (n > 1)
+        threads = MIN (n, SORT_MAX_THREADS);
+#endif
+    }
+  s->threads = threads;
+  return s;
+}
+
+size_t
+line_sorter_fread (struct line_sorter *s, struct line_batch *batch,
+                   struct line_input *in, char delimiter, bool skip_comments)
+{
+  size_t n = 0;
+
+  if (!s->started)
+    {
+      line_sorter_read (s, in, delimiter, skip_comments);
+      s->started = true;
+    }
+
+  if (s->num_runs == 0)
+    {
+      /* The lines are in the sorter's memory until it is freed */
+      while (n < batch->alloc_lines && s->next < s->num_recs)
+        {
+          const struct sort_record *rec = &s->sorted[s->next++];
+          line_record_set (&batch->lines[n++], rec->line, rec->len,
+                           in->max_fields);
+        }
+    }
+  else
+    {
+      /* Copy the merged lines: the runs' buffers are reused */
+      const struct sort_record *rec;
+      size_t used = 0;
+      if (!s->out_len)
+        s->out_len = XNMALLOC (batch->alloc_lines, size_t);
+      while (n < batch->alloc_lines
+             && (rec = sort_merge_peek (&s->merge)) != NULL)
+        {
+          if (s->out_alloc - used <= rec->len)
+            {
+              s->out_alloc = MAX (s->out_alloc * 2, used + rec->len + 1);
+              s->out = xrealloc (s->out, s->out_alloc);
+            }
+          memcpy (s->out + used, rec->line, rec->len);
+          s->out[used + rec->len] = '\0';
+          used += rec->len + 1;
+          s->out_len[n++] = rec->len;
+          sort_merge_advance (&s->merge);
+        }
+
+      used = 0;
+      for (size_t i = 0; i < n; ++i)
+        {
+          line_record_set (&batch->lines[i], s->out + used, s->out_len[i],
+                           in->max_fields);
+          used += s->out_len[i] + 1;
+        }
+    }
+
+  batch->num_lines = n;
+  return n;
+}
+
+void
+line_sorter_free (struct line_sorter *s)
+{
+  if (!s)
+    return;
+
+  sort_merge_free (&s->merge);
+  for (size_t i = 0; i < s->num_runs; ++i)
+    sort_run_free (&s->runs[i]);
+  free (s->runs);
+  for (size_t i = 0; i < s->num_chunks; ++i)
+    free (s->chunks[i].data);
+  free (s->chunks);
+  free (s->recs);
+  free (s->tmp);
+  free (s->key.data);
+  free (s->prev_key.data);
+  free (s->aux_key.data);
+  line_record_free (&s->aux_line);
+  free (s->field);
+  free (s->keys);
+  free (s->out);
+  free (s->out_len);
+  free (s);
+}
@@ -0,0 +1,62 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Sorting of input lines by their group-by keys (--sort).
+   Lines are sorted in memory, on several threads; inputs larger than
+   the memory budget are sorted in runs, which are written to temporary
+   files and merged. Lines which are read in order are not sorted again. */
+#ifndef __TEXT_SORT_H__
+#define __TEXT_SORT_H__
+
+/* Default memory budget of a sorter (--sort-buffer-size) */
+enum { SORT_BUFFER_DEFAULT = 256 * 1024 * 1024 };
+
+struct line_sorter;
+
+/* Creates a sorter of lines by their NUM_KEYS fields KEYS
+   (1 = first field), in the order of the locale's collating sequence
+   (ignoring case if FOLD_CASE is true), like 'sort -s -kN,N'.
+   Lines with equal keys keep their input order.
+   Up to BUFFER_SIZE bytes of lines are sorted in memory at a time,
+   with up to THREADS threads (0 = one per processor). */
+struct line_sorter *
+line_sorter_init (const size_t *keys, size_t num_keys, bool fold_case,
+                  size_t buffer_size, size_t threads);
+
+/* Reads up to LINE_BATCH_SIZE sorted lines into BATCH.
+   The first call reads all the (remaining) lines of IN, as
+   line_batch_fread () would; the lines are split into fields according
+   to IN's current 'max_fields'.
+   Returns the number of lines read (0 after the last line).
+   The lines remain valid until the next call. */
+size_t
+line_sorter_fread (struct line_sorter *s, struct line_batch *batch,
+                   struct line_input *in, char delimiter, bool skip_comments);
+
+/* Releases S (and removes its temporary files) */
+void
+line_sorter_free (struct line_sorter *s);
+
+/* Returns a new (empty) temporary file in $TMPDIR (or /tmp),
+   which is removed when closed. Fails if it cannot be created. */
+FILE *
+sort_tmpfile (void);
+
+#endif
@@ -70,6 +70,17 @@ median_value (const long double * const values, size_t n)
 #endif
 }
 
+/* Stores in H the position of 'quantile' in a sorted array of N values,
+   and in FLOOR,CEIL the positions of the values it is interpolated from */
+static void
+quantile_position (size_t n, double quantile,
+                   double *h, size_t *floor_pos, size_t *ceil_pos)
+{
+  *h = ( (n-1) * quantile ) ;
+  *floor_pos = floor (*h);
+  *ceil_pos = ceil (*h);
+}
+
 /* This implementation follows R's summary () and quantile (type=7) functions.
    See discussion here:
    http://tolstoy.newcastle.edu.au/R/e17/help/att-1067/Quartiles_in_R.pdf */
@@ -83,9 +94,9 @@ quantile_value (const long double * const values,
   if (n==1)
     return values[0];
 
-  const double h = ( (n-1) * quantile ) ;
-  const size_t h_floor = floor (h);
-  const size_t h_ceil = ceil (h);
+  double h;
+  size_t h_floor, h_ceil;
+  quantile_position (n, quantile, &h, &h_floor, &h_ceil);
   return values[h_floor] + (h-h_floor) * ( values[h_ceil] - values[h_floor] ) ;
 }
 
@@ -100,17 +111,19 @@ percentile_value (const long double * const values,
 }
 
 
-/* Given a sorted array of doubles, return the MAD value
+/* Given an array of doubles, return the MAD value
    (median absolute deviation), with scale constant 'scale' */
-long double _GL_ATTRIBUTE_PURE
-mad_value (const long double * const values, size_t n, double scale)
+long double
+mad_value (long double *values, size_t n, double scale)
 {
+  static const double median_quantile = 0.5;
+  select_quantiles (values, n, &median_quantile, 1);
   const long double median = median_value (values,n);
   long double *mads = xnmalloc (n,sizeof (long double));
   long double mad = 0 ;
   for (size_t i=0; i<n; ++i)
     mads[i] = fabsl (median - values[i]);
-  qsortfl (mads,n);
+  select_quantiles (mads, n, &median_quantile, 1);
   mad = median_value (mads,n);
   free (mads);
   return mad * scale;
@@ -127,129 +140,147 @@ arithmetic_mean_value (const long double * const values, const size_t n)
   return mean;
 }
 
-long double _GL_ATTRIBUTE_PURE
-variance_value (const long double * const values, size_t n, int df)
+void
+moments_add (struct moments *m, long double x, int order)
 {
-  long double sum=0;
-  long double mean;
-  long double variance;
+  if (m->n == 0)
+    m->shift = x;
 
-  assert (df>=0); /* LCOV_EXCL_LINE */
-  if ( (size_t)df == n )
-    return nanl ("");
+  const long double n = ++m->n;
+  const long double delta = (x - m->shift) - m->mean;
+  const long double delta_n = delta / n;
 
-  mean = arithmetic_mean_value (values, n);
+  if (order > 2)
+    {
+      const long double delta_n2 = delta_n * delta_n;
+      const long double term1 = delta * delta_n * (n - 1);
+      m->m4 += term1 * delta_n2 * (n*n - 3*n + 3)
+               + 6 * delta_n2 * m->m2 - 4 * delta_n * m->m3;
+      m->m3 += term1 * delta_n * (n - 2) - 3 * delta_n * m->m2;
+    }
+  m->mean += delta_n;
+  m->m2 += delta * (delta - delta_n);
+}
 
-  sum = 0 ;
-  for (size_t i = 0; i < n; i++)
-    sum += (values[i] - mean) * (values[i] - mean);
+void
+moments_add_pair (struct moments *m, long double a, long double b)
+{
+  if (m->n == 0)
+    {
+      m->shift = a;
+      m->shift_b = b;
+    }
+
+  const long double r = 1.0L / ++m->n;
+  const long double delta = (a - m->shift) - m->mean;
+  const long double delta_b = (b - m->shift_b) - m->mean_b;
+  const long double delta_n = delta * r;
+  const long double delta_b_n = delta_b * r;
+
+  m->mean += delta_n;
+  m->mean_b += delta_b_n;
+  m->m2 += delta * (delta - delta_n);
+  m->m2_b += delta_b * (delta_b - delta_b_n);
+  m->comoment += delta * (delta_b - delta_b_n);
+}
 
-  variance = sum / ( n - df );
+void
+moments_merge (struct moments *m, const struct moments *other)
+{
+  if (other->n == 0)
+    return;
+  if (m->n == 0)
+    {
+      *m = *other;
+      return;
+    }
 
-  return variance;
+  const long double na = m->n;
+  const long double nb = other->n;
+  const long double n = na + nb;
+  const long double delta = (other->shift - m->shift)
+                            + (other->mean - m->mean);
+  const long double delta_b = (other->shift_b - m->shift_b)
+                              + (other->mean_b - m->mean_b);
+  const long double delta2 = delta * delta;
+  const long double f = na * nb / n;
+
+  /* Each moment is updated using the lower moments of both series */
+  m->m4 += other->m4 + delta2 * delta2 * f * (na*na - na*nb + nb*nb) / (n*n)
+           + 6 * delta2 * (na*na * other->m2 + nb*nb * m->m2) / (n*n)
+           + 4 * delta * (na * other->m3 - nb * m->m3) / n;
+  m->m3 += other->m3 + delta2 * delta * f * (na - nb) / n
+           + 3 * delta * (na * other->m2 - nb * m->m2) / n;
+  m->m2 += other->m2 + delta2 * f;
+  m->m2_b += other->m2_b + delta_b * delta_b * f;
+  m->comoment += other->comoment + delta * delta_b * f;
+  m->mean += delta * nb / n;
+  m->mean_b += delta_b * nb / n;
+  m->n += other->n;
 }
 
 long double _GL_ATTRIBUTE_PURE
-covariance_value ( const long double * const valuesA,
-                   const long double * const valuesB, size_t n, int df )
+variance_value (const struct moments *m, int df)
 {
-  long double sum=0;
-  long double meanA, meanB;
-  long double covariance;
-
   assert (df>=0); /* LCOV_EXCL_LINE */
-  if ( (size_t)df == n )
+  if ( (size_t)df == m->n )
     return nanl ("");
 
-  meanA = arithmetic_mean_value (valuesA, n);
-  meanB = arithmetic_mean_value (valuesB, n);
-
-  sum = 0 ;
-  for (size_t i = 0; i < n; i++)
-    sum += (valuesA[i] - meanA) * (valuesB[i] - meanB);
+  return m->m2 / ( m->n - df );
+}
 
-  covariance = sum / ( n - df );
+long double _GL_ATTRIBUTE_PURE
+covariance_value (const struct moments *m, int df)
+{
+  assert (df>=0); /* LCOV_EXCL_LINE */
+  if ( (size_t)df == m->n )
+    return nanl ("");
 
-  return covariance;
+  return m->comoment / ( m->n - df );
 }
 
 long double
-pearson_corr_value ( const long double * const valuesA,
-                     const long double * const valuesB, size_t n, int df)
+pearson_corr_value (const struct moments *m, int df)
 {
-  long double meanA, meanB, sumA=0, sumB=0, sumCo=0;
   long double sdA, sdB;
   long double covariance;
   long double cor;
 
   assert (df>=0); /* LCOV_EXCL_LINE */
-  if ( (size_t)df == n )
+  if ( (size_t)df == m->n )
     return nanl ("");
 
-  meanA = arithmetic_mean_value (valuesA, n);
-  meanB = arithmetic_mean_value (valuesB, n);
-
-  for (size_t i = 0; i < n; i++)
-    {
-      const long double a = (valuesA[i] - meanA);
-      const long double b = (valuesB[i] - meanB);
-      sumA += a*a;
-      sumB += b*b;
-      sumCo += a*b;
-    }
-
-  covariance = sumCo/(n-df);
-  sdA = sqrtl (sumA/(n-df));
-  sdB = sqrtl (sumB/(n-df));
+  covariance = m->comoment / (m->n - df);
+  sdA = sqrtl (m->m2 / (m->n - df));
+  sdB = sqrtl (m->m2_b / (m->n - df));
 
   cor = covariance / ( sdA * sdB );
   return cor;
 }
 
-long double _GL_ATTRIBUTE_PURE
-dot_product_value ( const long double * const valuesA,
-                    const long double * const valuesB, size_t n )
-{
-  long double sum=0;
-
-  for (size_t i = 0; i < n; i++)
-    sum += valuesA[i] * valuesB[i];
-
-  return sum;
-}
-
-
 long double
-stdev_value (const long double * const values, size_t n, int df)
+stdev_value (const struct moments *m, int df)
 {
-  return sqrtl ( variance_value ( values, n, df ) );
+  return sqrtl ( variance_value ( m, df ) );
 }
 
 /*
- Given an array of doubles, return the skewness
+ Given the moments of a series, return the skewness
  'df' is degrees-of-freedom. Use DF_POPULATION or DF_SAMPLE (see above).
  */
 long double
-skewness_value (const long double * const values, size_t n, int df)
+skewness_value (const struct moments *m, int df)
 {
-  long double moment2=0;
-  long double moment3=0;
-  long double mean;
+  const size_t n = m->n;
+  long double moment2;
+  long double moment3;
   long double skewness;
 
   if (n<=1)
     return nanl ("");
 
-  mean = arithmetic_mean_value (values, n);
-
-  for (size_t i = 0; i < n; i++)
-    {
-      const long double t = (values[i] - mean);
-      moment2 += t*t;
-      moment3 += t*t*t;
-    }
-  moment2 /= n;
-  moment3 /= n;
+  moment2 = m->m2 / n;
+  moment3 = m->m3 / n;
 
   /* can't use 'powl (moment2,3.0/2.0)' - not all systems have powl */
   skewness = moment3 / sqrtl (moment2*moment2*moment2);
@@ -275,10 +306,10 @@ SES_value (size_t n)
 
 /* Skewness Test statistics Z = ( sample skewness / SES ) */
 long double
-skewnessZ_value (const long double * const values, size_t n)
+skewnessZ_value (const struct moments *m)
 {
-  const long double skew = skewness_value (values,n,DF_SAMPLE);
-  const long double SES = SES_value (n);
+  const long double skew = skewness_value (m,DF_SAMPLE);
+  const long double SES = SES_value (m->n);
   if (isnan (skew) || isnan (SES) )
     return nanl ("");
   return skew/SES;
@@ -286,30 +317,22 @@ skewnessZ_value (const long double * const values, size_t n)
 
 
 /*
- Given an array of doubles, return the excess kurtosis
+ Given the moments of a series, return the excess kurtosis
  'df' is degrees-of-freedom. Use DF_POPULATION or DF_SAMPLE (see above).
  */
 long double _GL_ATTRIBUTE_PURE
-excess_kurtosis_value (const long double * const values, size_t n, int df)
+excess_kurtosis_value (const struct moments *m, int df)
 {
-  long double moment2=0;
-  long double moment4=0;
-  long double mean;
+  const size_t n = m->n;
+  long double moment2;
+  long double moment4;
   long double excess_kurtosis;
 
   if (n<=1)
     return nanl ("");
 
-  mean = arithmetic_mean_value (values, n);
-
-  for (size_t i = 0; i < n; i++)
-    {
-      const long double t = (values[i] - mean);
-      moment2 += t*t;
-      moment4 += t*t*t*t;
-    }
-  moment2 /= n;
-  moment4 /= n;
+  moment2 = m->m2 / n;
+  moment4 = m->m4 / n;
 
   excess_kurtosis = moment4 / (moment2*moment2) - 3;
 
@@ -340,10 +363,10 @@ SEK_value (size_t n)
 
 /* Kurtosis Test statistics Z = ( sample kurtosis / SEK ) */
 long double
-kurtosisZ_value (const long double * const values, size_t n)
+kurtosisZ_value (const struct moments *m)
 {
-  const long double kurt = excess_kurtosis_value (values,n,DF_SAMPLE);
-  const long double SEK = SEK_value (n);
+  const long double kurt = excess_kurtosis_value (m,DF_SAMPLE);
+  const long double SEK = SEK_value (m->n);
   if (isnan (kurt) || isnan (SEK) )
     return nanl ("");
   return kurt/SEK;
@@ -361,16 +384,17 @@ pchisq_df2 (long double x)
 }
 
 /*
- Given an array of doubles, return the p-Value
+ Given the moments of a series, return the p-Value
  Of the Jarque-Bera Test for normality
    http://en.wikipedia.org/wiki/Jarque%E2%80%93Bera_test
  Equivalent to R's "jarque.test ()" function in the "moments" library.
  */
 long double
-jarque_bera_pvalue (const long double * const values, size_t n )
+jarque_bera_pvalue (const struct moments *m)
 {
-  const long double k = excess_kurtosis_value (values,n,DF_POPULATION);
-  const long double s = skewness_value (values,n,DF_POPULATION);
+  const size_t n = m->n;
+  const long double k = excess_kurtosis_value (m,DF_POPULATION);
+  const long double s = skewness_value (m,DF_POPULATION);
   const long double jb = (long double)(n*(s*s + k*k/4))/6.0 ;
   const long double pval = 1.0 - pchisq_df2 (jb);
   if (n<=1 || isnan (k) || isnan (s))
@@ -384,10 +408,10 @@ jarque_bera_pvalue (const long double * const values, size_t n )
  where the null-hypothesis is normal distribution.
 */
 long double
-dagostino_pearson_omnibus_pvalue (const long double * const values, size_t n)
+dagostino_pearson_omnibus_pvalue (const struct moments *m)
 {
-  const long double z_skew = skewnessZ_value (values, n);
-  const long double z_kurt = kurtosisZ_value (values, n);
+  const long double z_skew = skewnessZ_value (m);
+  const long double z_kurt = kurtosisZ_value (m);
   const long double DP = z_skew*z_skew + z_kurt*z_kurt;
   const long double pval = 1.0 - pchisq_df2 (DP);
 
@@ -438,8 +462,8 @@ mode_value ( const long double * const values, size_t n, enum MODETYPE type)
   return best_value;
 }
 
-long double  _GL_ATTRIBUTE_PURE
-trimmed_mean_value ( const long double * const values, size_t n,
+long double
+trimmed_mean_value ( long double *values, size_t n,
                      const long double trimmed_mean_percent)
 {
   assert (trimmed_mean_percent >= 0); /* LCOV_EXCL_LINE */
@@ -448,11 +472,23 @@ trimmed_mean_value ( const long double * const values, size_t n,
   /* For R compatability:
      mean (x,trim=0.5) in R is equivalent to median (x).  */
   if (trimmed_mean_percent >= 0.5)
-    return median_value (values, n);
+    {
+      static const double median_quantile = 0.5;
+      select_quantiles (values, n, &median_quantile, 1);
+      return median_value (values, n);
+    }
 
   /* number of element to skip from each end */
   size_t c = pos_zero (floorl (trimmed_mean_percent * n));
 
+  /* The values between the c-th smallest and the c-th largest
+     (in any order) */
+  if (c > 0)
+    {
+      const size_t ranks[2] = { c - 1, n - c };
+      select_ranks (values, n, ranks, 2);
+    }
+
   long double v = 0;
   for (size_t i=c; i< (n-c); i++)
     v += values[i];
@@ -485,6 +521,175 @@ void qsortfl (long double *values, size_t n)
   qsort (values, n, sizeof (long double), cmp_long_double);
 }
 
+/* Ranges of up to this many values are sorted by insertion */
+#define SELECT_INSERTION_SIZE 16
+
+static void
+insertion_sortfl (long double *values, size_t n)
+{
+  for (size_t i = 1; i < n; ++i)
+    {
+      const long double v = values[i];
+      size_t j = i;
+      for (; j > 0 && v < values[j-1]; --j)
+        values[j] = values[j-1];
+      values[j] = v;
+    }
+}
+
+/* Returns the median of A, B and C */
+static long double _GL_ATTRIBUTE_CONST
+median3 (long double a, long double b, long double c)
+{
+  if (a < b)
+    return (b < c) ? b : (a < c) ? c : a;
+  return (a < c) ? a : (b < c) ? c : b;
+}
+
+/* Partitions VALUES[LO..HI] (at least 3 values) around the median of
+   its first, middle and last values (Hoare's scheme), and returns J
+   (LO <= J < HI) such that VALUES[LO..J] <= VALUES[J+1..HI]. */
+static size_t
+partitionfl (long double *values, size_t lo, size_t hi)
+{
+  const long double pivot = median3 (values[lo], values[lo + (hi-lo)/2],
+                                     values[hi]);
+  size_t i = lo;
+  size_t j = hi;
+  for (;;)
+    {
+      /* The pivot value (or a swapped value) stops both scans */
+      while (values[i] < pivot)
+        ++i;
+      while (pivot < values[j])
+        --j;
+      if (i >= j)
+        return j;
+      const long double t = values[i];
+      values[i++] = values[j];
+      values[j--] = t;
+    }
+}
+
+/* Selects the ranks RANKS[0..N_RANKS-1] (sorted, within LO..HI) of
+   VALUES[LO..HI], partitioning at most DEPTH times before sorting */
+static void
+select_ranks_range (long double *values, size_t lo, size_t hi,
+                    const size_t *ranks, size_t n_ranks, unsigned int depth)
+{
+  while (n_ranks > 0)
+    {
+      if (hi - lo < SELECT_INSERTION_SIZE)
+        {
+          insertion_sortfl (values + lo, hi - lo + 1);
+          return;
+        }
+      if (depth-- == 0)
+        {
+          /* Too many unbalanced partitions (e.g. crafted input) */
+          qsortfl (values + lo, hi - lo + 1);
+          return;
+        }
+
+      const size_t j = partitionfl (values, lo, hi);
+      size_t k = 0;
+      while (k < n_ranks && ranks[k] <= j)
+        ++k;
+      select_ranks_range (values, lo, j, ranks, k, depth);
+      lo = j + 1;
+      ranks += k;
+      n_ranks -= k;
+    }
+}
+
+/* Returns the number of partitions allowed for N values, before
+   falling back to qsortfl () */
+static unsigned int _GL_ATTRIBUTE_CONST
+partition_depth (size_t n)
+{
+  unsigned int depth = 0;
+  for (size_t m = n; m > 1; m /= 2)
+    depth += 2;
+  return depth;
+}
+
+void
+select_ranks (long double *values, size_t n,
+              const size_t *ranks, size_t n_ranks)
+{
+  if (n > 0)
+    select_ranks_range (values, 0, n - 1, ranks, n_ranks,
+                        partition_depth (n));
+}
+
+/* Sorts VALUES[LO..HI], partitioning at most DEPTH times */
+static void
+sort_range (long double *values, size_t lo, size_t hi, unsigned int depth)
+{
+  while (hi - lo >= SELECT_INSERTION_SIZE)
+    {
+      if (depth-- == 0)
+        {
+          qsortfl (values + lo, hi - lo + 1);
+          return;
+        }
+
+      /* Recurse into the smaller part */
+      const size_t j = partitionfl (values, lo, hi);
+      if (j - lo < hi - j)
+        {
+          sort_range (values, lo, j, depth);
+          lo = j + 1;
+        }
+      else
+        {
+          sort_range (values, j + 1, hi, depth);
+          hi = j;
+        }
+    }
+  insertion_sortfl (values + lo, hi - lo + 1);
+}
+
+void
+sortfl (long double *values, size_t n)
+{
+  if (n > 0)
+    sort_range (values, 0, n - 1, partition_depth (n));
+}
+
+void
+select_quantiles (long double *values, size_t n,
+                  const double *quantiles, size_t n_quantiles)
+{
+  size_t ranks[2 * SELECT_MAX_QUANTILES];
+  size_t n_ranks = 0;
+
+  assert (n_quantiles <= SELECT_MAX_QUANTILES); /* LCOV_EXCL_LINE */
+  if (n <= 1)
+    return;
+
+  for (size_t i = 0; i < n_quantiles; ++i)
+    {
+      double h;
+      size_t r[2];
+      quantile_position (n, quantiles[i], &h, &r[0], &r[1]);
+      for (int k = 0; k < 2; ++k)
+        {
+          /* Insert in order, without duplicates */
+          size_t j = n_ranks;
+          while (j > 0 && ranks[j-1] > r[k])
+            --j;
+          if (j > 0 && ranks[j-1] == r[k])
+            continue;
+          memmove (ranks + j + 1, ranks + j, (n_ranks - j) * sizeof *ranks);
+          ranks[j] = r[k];
+          ++n_ranks;
+        }
+    }
+
+  select_ranks (values, n, ranks, n_ranks);
+}
+
 bool _GL_ATTRIBUTE_PURE
 hash_compare_strings (void const *x, void const *y)
 {
@@ -580,8 +785,11 @@ static struct EXTRACT_NUMBER_TYPE extract_number_types[] =
 long double
 extract_number (const char* s, size_t len, enum extract_number_type type)
 {
-  static char* buf, *endptr;
-  static size_t buf_alloc;
+  /* Computed group keys (e.g. 'getnum(1)') are extracted by the
+     --threads workers too */
+  static _Thread_local char *buf;
+  static _Thread_local size_t buf_alloc;
+  char *endptr;
 
   long double r = 0;
   const char *pattern;
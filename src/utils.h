@@ -48,7 +48,9 @@ long double
 arithmetic_mean_value (const long double * const values, const size_t n);
 
 /*
- Given a sorted array of doubles, return the value of 'quantile'.
+ Given an array of doubles, return the value of 'quantile'.
+ The array must be sorted, or at least have the values needed for
+ 'quantile' in their sorted positions (see select_quantiles ()).
  Example of valid 'quantile':
     0.10 = First decile
     0.25 = First quartile
@@ -61,7 +63,8 @@ quantile_value (const long double * const values,
                 const size_t n, const double quantile);
 
 /*
- Given a sorted array of doubles, return the value of 'percentile'.
+ Given an array of doubles, return the value of 'percentile'
+ (sorted as for quantile_value ()).
  Example of valid 'percentile':
     10.0 = First decile
     25.0 = First quartile
@@ -73,34 +76,62 @@ long double
 percentile_value (const long double * const values,
                   const size_t n, const double percentile);
 
-/* Given a sorted array of doubles, return the value of the median */
+/* Given an array of doubles (sorted as for quantile_value ()),
+   return the value of the median */
 long double
 median_value (const long double * const values, size_t n);
 
-/* Given a sorted array of doubles, return the value of 1st quartile */
+/* Given an array of doubles (sorted as for quantile_value ()),
+   return the value of 1st quartile */
 static inline long double
 quartile1_value (const long double * const values, size_t n)
 {
   return quantile_value (values, n, 1.0/4.0);
 }
 
-/* Given a sorted array of doubles, return the value of 3rd quartile */
+/* Given an array of doubles (sorted as for quantile_value ()),
+   return the value of 3rd quartile */
 static inline long double
 quartile3_value (const long double * const values, size_t n)
 {
   return quantile_value (values, n, 3.0/4.0);
 }
 
-/* Given a sorted array of doubles, return the MAD value
-   (median absolute deviation), with scale constant 'scale' */
+/* Given an array of doubles, return the MAD value
+   (median absolute deviation), with scale constant 'scale'.
+   The values are reordered. */
 long double
-mad_value (const long double * const values, size_t n, double scale) ;
+mad_value (long double *values, size_t n, double scale) ;
 
 
 /* Sorts (in-place) an array of long-doubles */
 void
 qsortfl (long double *values, size_t n);
 
+/* Sorts (in-place) an array of N long-doubles like qsortfl (),
+   with the partitioning of select_ranks () instead of calling
+   a comparison function for each pair of values */
+void
+sortfl (long double *values, size_t n);
+
+/* Reorders (in-place) an array of N long-doubles, so that the values
+   at the positions RANKS[0..N_RANKS-1] (in increasing order) are those
+   of the sorted array, with no larger values before them and no smaller
+   values after them.  Takes O(N) time (instead of sorting the array). */
+void
+select_ranks (long double *values, size_t n,
+              const size_t *ranks, size_t n_ranks);
+
+/* The largest number of quantiles selected at once */
+#define SELECT_MAX_QUANTILES 2
+
+/* Reorders (in-place) an array of N long-doubles with select_ranks (),
+   so that quantile_value () can be used for each of the quantiles
+   QUANTILES[0..N_QUANTILES-1] */
+void
+select_quantiles (long double *values, size_t n,
+                  const double *quantiles, size_t n_quantiles);
+
 
 enum degrees_of_freedom
 {
@@ -108,62 +139,89 @@ enum degrees_of_freedom
   DF_SAMPLE = 1
 };
 
-/*
- Given an array of doubles, return the variance value.
- 'df' is degrees-of-freedom. Use DF_POPULATION or DF_SAMPLE (see above).
- */
-long double
-variance_value ( const long double * const values, size_t n, int df );
+/* The central moments of a series of values, accumulated in a single
+   pass with the updates of Welford and Terriberry, and combined with
+   the formulas of Pebay (see moments_merge ()).
+   The values are shifted by the first one, so that the running mean
+   stays small and keeps its precision when the values are large
+   compared to their spread.
+   For a pair of series (A,B), 'mean' and 'm2' are those of A. */
+struct moments
+{
+  size_t n;          /* number of values */
+  long double shift; /* the first value */
+  long double mean;  /* mean of the shifted values */
+  long double m2;    /* sums of the 2nd, 3rd and 4th powers */
+  long double m3;    /* of the deviations from the mean */
+  long double m4;
+  long double shift_b;  /* shift, mean and 'm2' of the B series */
+  long double mean_b;
+  long double m2_b;
+  long double comoment; /* sum of the products of the deviations */
+};
+
+/* Adds the value X to the moments M.
+   Only the 2nd moment is updated if ORDER is 2, and
+   also the 3rd and 4th if ORDER is 4. */
+void
+moments_add (struct moments *m, long double x, int order);
+
+/* Adds the pair of values (A,B) to the moments M of a pair of series */
+void
+moments_add_pair (struct moments *m, long double a, long double b);
+
+/* Combines into M the moments OTHER of more values of the same series */
+void
+moments_merge (struct moments *m, const struct moments *other);
 
 /*
- Given an two array of doubles, return the covariance value.
+ Given the moments of a series, return the variance value.
  'df' is degrees-of-freedom. Use DF_POPULATION or DF_SAMPLE (see above).
  */
 long double
-covariance_value ( const long double * const valuesA,
-                   const long double * const valuesB, size_t n, int df );
+variance_value ( const struct moments *m, int df );
 
 /*
- Given an two array of doubles, return the Pearson correlation coefficient
+ Given the moments of a pair of series, return the covariance value.
+ 'df' is degrees-of-freedom. Use DF_POPULATION or DF_SAMPLE (see above).
  */
 long double
-pearson_corr_value ( const long double * const valuesA,
-                     const long double * const valuesB, size_t n, int df);
+covariance_value ( const struct moments *m, int df );
 
 /*
- Given two columns of doubles, return their scalar product value.
+ Given the moments of a pair of series,
+ return the Pearson correlation coefficient
  */
 long double
-dot_product_value ( const long double * const valuesA,
-                    const long double * const valuesB, size_t n );
+pearson_corr_value ( const struct moments *m, int df );
 
 /*
- Given an array of doubles, return the standard-deviation value.
+ Given the moments of a series, return the standard-deviation value.
  'df' is degrees-of-freedom. Use DF_POPULATION or DF_SAMPLE (see above).
  */
 long double
-stdev_value ( const long double * const values, size_t n, int df );
+stdev_value ( const struct moments *m, int df );
 
 /*
- Given an array of doubles, return the skewness
+ Given the moments of a series, return the skewness
  'df' is degrees-of-freedom. Use DF_POPULATION or DF_SAMPLE (see above).
  */
 long double
-skewness_value ( const long double * const values, size_t n, int df );
+skewness_value ( const struct moments *m, int df );
 
 /* Standard error of skewness (SES), given the sample size 'n' */
 long double
 SES_value ( size_t n );
 
 /* Skewness Test statistics Z = ( sample skewness / SES ) */
-long double skewnessZ_value ( const long double * const values, size_t n);
+long double skewnessZ_value ( const struct moments *m );
 
 /*
- Given an array of doubles, return the excess kurtosis
+ Given the moments of a series, return the excess kurtosis
  'df' is degrees-of-freedom. Use DF_POPULATION or DF_SAMPLE (see above).
  */
 long double
-excess_kurtosis_value ( const long double * const values, size_t n, int df );
+excess_kurtosis_value ( const struct moments *m, int df );
 
 /* Standard error of kurtisos (SEK), given the sample size 'n' */
 long double
@@ -171,7 +229,7 @@ SEK_value ( size_t n );
 
 /* Kurtosis Test statistics Z = ( sample kurtosis / SEK ) */
 long double
-kurtosisZ_value ( const long double * const values, size_t n);
+kurtosisZ_value ( const struct moments *m );
 
 /*
  Chi-Squared - Cumulative distribution function,
@@ -187,18 +245,18 @@ pchisq_df2 (long double x);
  where the null-hypothesis is normal distribution.
 */
 long double
-dagostino_pearson_omnibus_pvalue (const long double * const values, size_t n);
+dagostino_pearson_omnibus_pvalue (const struct moments *m);
 
 
 
 /*
- Given an array of doubles, return the p-Value
+ Given the moments of a series, return the p-Value
  Of the Jarque-Bera Test for normality
    http://en.wikipedia.org/wiki/Jarque%E2%80%93Bera_test
  Equivalent to R's "jarque.test ()" function in the "moments" library.
  */
 long double
-jarque_bera_pvalue (const long double * const values, size_t n);
+jarque_bera_pvalue (const struct moments *m);
 
 
 enum MODETYPE
@@ -215,9 +273,10 @@ mode_value ( const long double * const values, size_t n, enum MODETYPE type);
 
 /*
  Given an array of doubles, return the trimmed mean values.
+ The values are reordered.
  */
 long double
-trimmed_mean_value ( const long double * const values, size_t n,
+trimmed_mean_value ( long double *values, size_t n,
                      const long double trimmed_mean_percent);
 
 
@@ -0,0 +1,173 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "system.h"
+#include "die.h"
+#include "ignore-value.h"
+#include "xalloc.h"
+
+#include "text-options.h"
+#include "text-output.h"
+#include "workers.h"
+
+struct worker
+{
+  pid_t pid;
+  FILE *out;
+  FILE *err;
+  FILE *state;
+};
+
+static FILE *
+worker_tmpfile (void)
+{
+  FILE *f = tmpfile ();
+  if (f == NULL)
+    die (EXIT_FAILURE, errno, _("failed to create temporary file"));
+  return f;
+}
+
+static void
+start_worker (struct worker *w, size_t i,
+              void (*task) (size_t i, FILE *state))
+{
+  w->out = worker_tmpfile ();
+  w->err = worker_tmpfile ();
+  w->state = worker_tmpfile ();
+
+  /* Don't let the child inherit (and flush again) pending output */
+  output_flush ();
+  fflush (stderr);
+
+  w->pid = fork ();
+  if (w->pid < 0)
+    die (EXIT_FAILURE, errno, _("cannot fork"));
+
+  if (w->pid == 0)
+    {
+      if (dup2 (fileno (w->out), STDOUT_FILENO) < 0
+          || dup2 (fileno (w->err), STDERR_FILENO) < 0)
+        die (EXIT_FAILURE, errno, "dup2");
+      text_output_line_buffered = false;
+      task (i, w->state);
+      exit (EXIT_SUCCESS);
+    }
+}
+
+/* Copies LEN bytes (or everything, if LEN is negative) from FROM
+   to TO (or to the standard output, if TO is NULL) */
+static void
+copy_stream (FILE *from, FILE *to, off_t len)
+{
+  char buf[BUFSIZ];
+  size_t n;
+
+  while (len != 0)
+    {
+      size_t want = sizeof buf;
+      if (len > 0 && (uintmax_t) len < want)
+        want = len;
+      if ((n = fread (buf, 1, want, from)) == 0)
+        break;
+      if (to)
+        fwrite (buf, 1, n, to);
+      else
+        output_bytes (buf, n);
+      if (len > 0)
+        len -= n;
+    }
+  if (ferror (from))
+    die (EXIT_FAILURE, errno, _("read error"));
+}
+
+void
+copy_output (FILE *from, off_t len)
+{
+  copy_stream (from, NULL, len);
+}
+
+static void
+close_worker (struct worker *w)
+{
+  fclose (w->out);
+  fclose (w->err);
+  fclose (w->state);
+}
+
+void
+run_workers (size_t n, size_t max_jobs,
+             void (*task) (size_t i, FILE *state),
+             void (*collect) (size_t i, FILE *out, FILE *state))
+{
+  struct worker *workers = xnmalloc (n, sizeof *workers);
+  size_t started = 0;
+
+  for (size_t i = 0; i < n; ++i)
+    {
+      /* Keep up to MAX_JOBS tasks running, starting with task I */
+      while (started < n && started < i + max_jobs)
+        {
+          start_worker (&workers[started], started, task);
+          started++;
+        }
+
+      struct worker *w = &workers[i];
+      int status;
+      while (waitpid (w->pid, &status, 0) < 0)
+        if (errno != EINTR)
+          die (EXIT_FAILURE, errno, _("waitpid failed"));
+
+      rewind (w->out);
+      rewind (w->err);
+      rewind (w->state);
+      copy_stream (w->err, stderr, -1);
+
+      if (!WIFEXITED (status) || WEXITSTATUS (status) != EXIT_SUCCESS)
+        {
+          copy_output (w->out, -1);
+          for (size_t j = i + 1; j < started; ++j)
+            {
+              kill (workers[j].pid, SIGTERM);
+              ignore_value (waitpid (workers[j].pid, NULL, 0));
+            }
+          if (WIFSIGNALED (status))
+            die (EXIT_FAILURE, 0, _("worker process terminated by signal %d"),
+                 WTERMSIG (status));
+          exit (WEXITSTATUS (status));
+        }
+
+      collect (i, w->out, w->state);
+      close_worker (w);
+    }
+
+  free (workers);
+}
@@ -0,0 +1,47 @@
+/* GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Run independent tasks in child processes, collecting their results
+   in a deterministic order. */
+#ifndef __WORKERS_H__
+#define __WORKERS_H__
+
+/* Runs TASK (I, STATE) for each I in [0, N), in up to MAX_JOBS child
+   processes at a time. The standard output and standard error of each
+   child are saved in temporary files, and TASK can write additional
+   results to STATE.
+
+   In the order of I: once task I has completed, its standard error is
+   copied to stderr, and COLLECT (I, OUT, STATE) is called with its
+   standard output and its STATE file (both rewound).
+   If task I failed, its output is copied to stdout, the remaining
+   children are terminated, and the program exits with the
+   task's exit status. */
+void
+run_workers (size_t n, size_t max_jobs,
+             void (*task) (size_t i, FILE *state),
+             void (*collect) (size_t i, FILE *out, FILE *state));
+
+/* Copies LEN bytes (or everything, if LEN is negative) from FROM to
+   the standard output (see text-output.h) */
+void
+copy_output (FILE *from, off_t len);
+
+#endif
@@ -0,0 +1,136 @@
+#!/usr/bin/env perl
+=pod
+  Unit Tests for GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+=cut
+
+use strict;
+use warnings;
+
+use lib '.';
+# Until a better way comes along to auto-use Coreutils Perl modules
+# as in the coreutils' autotools system.
+use Coreutils;
+use CuSkip;
+use CuTmpdir qw(datamash);
+use MIME::Base64;
+
+(my $program_name = $0) =~ s|.*/||;
+my $prog_bin = 'datamash';
+
+## Cross-Compiling portability hack:
+##  under qemu/binfmt, argv[0] (which is used to report errors) will contain
+##  the full path of the binary, if the binary is on the $PATH.
+##  So we try to detect what is the actual returned value of the program
+##  in case of an error.
+my $prog = `$prog_bin ---print-progname`;
+$prog = $prog_bin unless $prog;
+
+# Turn off localization of executable's output.
+@ENV{qw(LANGUAGE LANG LC_ALL)} = ('C') x 3;
+
+## Which formats are supported by this build?
+sub supported($)
+{
+  my $format = shift;
+  my $err = `$prog_bin --decompress=$format count 1 < /dev/null 2>&1`;
+  return $err !~ /not supported/;
+}
+
+CuSkip::skip "datamash was built without gzip support\n"
+  unless supported ('gzip');
+my $have_zstd = supported ('zstd');
+
+## printf 'A\t1\nA\t2\nB\t3\n' | gzip -9n
+my $in_gz = decode_base64 ("H4sIAAAAAAACA3PkNORy5DTicuI05gIAXX6e4AwAAAA=");
+## printf 'B\t4\nC\t5\n' | gzip -9n
+my $in_gz2 = decode_base64 ("H4sIAAAAAAACA3PiNOFy5jTlAgDE5c2KCAAAAA==");
+## printf 'x\ty\nA\t1\nB\t2\n' | gzip -9n
+my $in_gz_hdr = decode_base64 ("H4sIAAAAAAACA6vgrORy5DTkcuI04gIAc3b8ewwAAAA=");
+## The first 20 bytes of $in_gz
+my $in_gz_trunc = decode_base64 ("H4sIAAAAAAACA3PkNORy5DTicuI=");
+## printf 'A\t1\nA\t2\nB\t3\n' | zstd
+my $in_zst = decode_base64 ("KLUv/SQMYQAAQQkxCkEJMgpCCTMKcREcQw==");
+## The first 15 bytes of $in_zst
+my $in_zst_trunc = decode_base64 ("KLUv/SQMYQAAQQkxCkEJ");
+
+my $in_plain = "A\t1\nA\t2\nB\t3\n";
+
+my @Tests =
+(
+  # Detected from the first bytes
+  ['gz1', '-g1 sum 2', {IN_PIPE=>$in_gz}, {OUT=>"A\t3\nB\t3\n"}],
+  ['gz2', '-g1 sum 2', '<', {IN=>$in_gz}, {OUT=>"A\t3\nB\t3\n"}],
+  ['gz3', 'count 1 -- ', {IN=>{'a.gz'=>$in_gz}}, {OUT=>"3\n"}],
+  ['gz4', 'transpose', {IN_PIPE=>$in_gz}, {OUT=>"A\tA\tB\n1\t2\t3\n"}],
+  # Concatenated gzip files are one input
+  ['gz5', '-g1 sum 2', {IN_PIPE=>$in_gz . $in_gz2},
+    {OUT=>"A\t3\nB\t7\nC\t5\n"}],
+  # Compressed and uncompressed files can be combined
+  ['gz6', '-g1 sum 2 -- ', {IN=>{'a.gz'=>$in_gz}}, {IN=>{'b.gz'=>$in_gz2}},
+    {IN=>{'c.txt'=>"C\t1\n"}}, {OUT=>"A\t3\nB\t7\nC\t6\n"}],
+  ['gz7', '--parallel=2 -g1 sum 2 -- ', {IN=>{'a.gz'=>$in_gz}},
+    {IN=>{'b.gz'=>$in_gz2}}, {OUT=>"A\t3\nB\t7\nC\t5\n"}],
+
+  # Sorting compressed input
+  ['gz8', '-s -g1 sum 2', {IN_PIPE=>$in_gz2 . $in_gz},
+    {OUT=>"A\t3\nB\t7\nC\t5\n"}],
+  ['gz9', '-s -g1 sum 2', '<', {IN=>$in_gz2 . $in_gz},
+    {OUT=>"A\t3\nB\t7\nC\t5\n"}],
+  ['gz10', '-s -H -g x sum y', {IN_PIPE=>$in_gz_hdr},
+    {OUT=>"GroupBy(x)\tsum(y)\nA\t1\nB\t2\n"}],
+  ['gz11', '-H -g x sum y', '<', {IN=>$in_gz_hdr},
+    {OUT=>"GroupBy(x)\tsum(y)\nA\t1\nB\t2\n"}],
+
+  # --decompress
+  ['dc1', '--decompress=gzip sum 2', {IN_PIPE=>$in_gz}, {OUT=>"6\n"}],
+  ['dc2', '--decompress=auto sum 2', {IN_PIPE=>$in_plain}, {OUT=>"6\n"}],
+  ['dc3', '--decompress=none count 1', {IN_PIPE=>$in_plain},
+    {OUT=>"3\n"}],
+  ['dc4', '--decompress=gzip sum 2', {IN_PIPE=>$in_plain}, {EXIT=>1},
+    {ERR=>"$prog: invalid gzip-compressed input: incorrect header check\n"}],
+  ['dc5', '--decompress=foo sum 2', {IN_PIPE=>$in_gz}, {EXIT=>1},
+    {ERR=>"$prog: invalid compression format: 'foo'\n"}],
+
+  # Truncated input
+  ['tr1', 'sum 2', {IN_PIPE=>$in_gz_trunc}, {EXIT=>1},
+    {ERR=>"$prog: invalid gzip-compressed input: unexpected end of input\n"}],
+  ['tr2', 'sum 2', '<', {IN=>$in_gz_trunc}, {EXIT=>1},
+    {ERR=>"$prog: invalid gzip-compressed input: unexpected end of input\n"}],
+);
+
+if ($have_zstd)
+  {
+    push @Tests,
+      ['zst1', '-g1 sum 2', {IN_PIPE=>$in_zst}, {OUT=>"A\t3\nB\t3\n"}],
+      ['zst2', '-g1 sum 2', '<', {IN=>$in_zst}, {OUT=>"A\t3\nB\t3\n"}],
+      ['zst3', 'sum 2', {IN_PIPE=>$in_zst . $in_zst}, {OUT=>"12\n"}],
+      ['zst4', '-s -g1 sum 2 -- ', {IN=>{'a.zst'=>$in_zst}},
+        {IN=>{'b.gz'=>$in_gz2}}, {OUT=>"A\t3\nB\t7\nC\t5\n"}],
+      ['zst5', '--decompress=zstd sum 2', {IN_PIPE=>$in_zst}, {OUT=>"6\n"}],
+      ['zst6', 'sum 2', {IN_PIPE=>$in_zst_trunc}, {EXIT=>1},
+        {ERR=>"$prog: invalid zstd-compressed input: " .
+              "unexpected end of input\n"}];
+  }
+
+my $save_temps = $ENV{SAVE_TEMPS};
+my $verbose = $ENV{VERBOSE};
+
+my $fail = run_tests ($program_name, $prog, \@Tests, $save_temps, $verbose);
+exit $fail;
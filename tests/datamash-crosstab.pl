@@ -167,6 +167,19 @@ my $out4_no_hdr=<<'EOF';
 4	N/A	N/A	N/A	1
 EOF
 
+# Row and column names longer than 512 bytes, which differ only
+# after their 512th byte
+my $long_a = ("a" x 600) . "1";
+my $long_b = ("a" x 600) . "2";
+my $long_x = ("x" x 1000) . "1";
+my $long_y = ("x" x 1000) . "2";
+my $in5 = "$long_a\t$long_x\t1\n"
+        . "$long_b\t$long_x\t2\n"
+        . "$long_b\t$long_y\t3\n";
+my $out5 = "\t$long_x\t$long_y\n"
+         . "$long_a\t1\tN/A\n"
+         . "$long_b\t2\t3\n";
+
 my @Tests =
 (
   ['c1','crosstab 1,2 first 3', {IN_PIPE=>$in1}, {OUT=>$out1_first}],
@@ -201,6 +214,11 @@ my @Tests =
   ['c31','--filler XX ct 1,2 first 3', {IN_PIPE=>$in3}, {OUT=>$out3_xx}],
   ['c32','-F XX ct 1,2 first 3',       {IN_PIPE=>$in3}, {OUT=>$out3_xx}],
 
+  # Test long row and column names
+  ['c40','ct 1,2 first 3',       {IN_PIPE=>$in5}, {OUT=>$out5}],
+  ['c41','-s ct 1,2 first 3',    {IN_PIPE=>$in5}, {OUT=>$out5}],
+  ['c42','--hash-group ct 1,2 first 3', {IN_PIPE=>$in5}, {OUT=>$out5}],
+
   # Test wrong usage
   ['e1',  'ct',  {IN_PIPE=>""}, {EXIT=>1},
     {ERR=>"$prog: missing field for operation 'crosstab'\n"}],
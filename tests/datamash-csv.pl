@@ -0,0 +1,134 @@
+#!/usr/bin/env perl
+=pod
+  Unit Tests for GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+=cut
+
+use strict;
+use warnings;
+
+use lib '.';
+# Until a better way comes along to auto-use Coreutils Perl modules
+# as in the coreutils' autotools system.
+use Coreutils;
+use CuSkip;
+use CuTmpdir qw(datamash);
+
+(my $program_name = $0) =~ s|.*/||;
+my $prog_bin = 'datamash';
+
+## Cross-Compiling portability hack:
+##  under qemu/binfmt, argv[0] (which is used to report errors) will contain
+##  the full path of the binary, if the binary is on the $PATH.
+##  So we try to detect what is the actual returned value of the program
+##  in case of an error.
+my $prog = `$prog_bin ---print-progname`;
+$prog = $prog_bin unless $prog;
+
+# Turn off localization of executable's output.
+@ENV{qw(LANGUAGE LANG LC_ALL)} = ('C') x 3;
+
+# A field longer than the 64-byte blocks of the tokenizer
+my $long = "x" x 100;
+
+my $in1 = qq{a,1\n"b,c",2\n"d""e",3\n"multi\nline",4\n,5\n"",6\n};
+my $in_crlf = qq{a,1\r\n"b\r\nc",2\r\n};
+my $in_hdr = qq{"id","value, total"\nx,1\ny,2\n};
+my $in_long = qq{"$long,$long",1\n"$long""",2\n$long,3\n};
+
+my @Tests =
+(
+  ['c1', '--csv --output-delimiter=: cut 1,2', {IN_PIPE=>$in1},
+    {OUT=>"a:1\nb,c:2\n\"d\"\"e\":3\n\"multi\nline\":4\n:5\n:6\n"}],
+  ['c2', '--csv sum 2', {IN_PIPE=>$in1}, {OUT=>"21\n"}],
+  ['c3', '--csv check', {IN_PIPE=>$in1}, {OUT=>"6 lines, 2 fields\n"}],
+  ['c4', '--csv -g1 count 1', {IN_PIPE=>$in1},
+    {OUT=>"a,1\n\"b,c\",1\n\"d\"\"e\",1\n\"multi\nline\",1\n,2\n"}],
+  ['c5', '--csv md5 1', {IN_PIPE=>qq{"a"\n"""a"""\n}},
+    {OUT=>"0cc175b9c0f1b6a831c399e269772661\n" .
+          "6067924ae1b1832abce3d12fe83755a9\n"}],
+
+  # The field delimiter and output delimiter
+  ['d1', '--csv -t";" cut 2,3', {IN_PIPE=>qq{a;"1;2";3\n}},
+    {OUT=>"\"1;2\";3\n"}],
+  ['d2', '-t";" --csv --output-delimiter=: cut 2,3',
+    {IN_PIPE=>qq{a;"1;2";3\n}}, {OUT=>"1;2:3\n"}],
+  ['d3', '--csv -t"|" sum 2', {IN_PIPE=>qq{"a|b"|5\n}}, {OUT=>"5\n"}],
+
+  # CR-LF line endings
+  ['r1', '--csv --output-delimiter=: cut 1,2', {IN_PIPE=>$in_crlf},
+    {OUT=>"a:1\n\"b\r\nc\":2\n"}],
+
+  # Quoted column names
+  ['h1', '--csv -H sum 2', {IN_PIPE=>$in_hdr},
+    {OUT=>"\"sum(value, total)\"\n3\n"}],
+  ['h2', '--csv --header-in --output-delimiter=: -g id sum 2',
+    {IN_PIPE=>$in_hdr}, {OUT=>"x:1\ny:2\n"}],
+
+  # Quoted fields spanning several blocks
+  ['l1', '--csv --output-delimiter=: cut 1,2', {IN_PIPE=>$in_long},
+    {OUT=>"$long,$long:1\n\"$long\"\"\":2\n$long:3\n"}],
+
+  # Output fields are quoted if needed, so that the output is valid CSV
+  ['q1', '--csv -g1 collapse 2', {IN_PIPE=>qq{"a,b",1\n"a,b",2\n}},
+    {OUT=>"\"a,b\",\"1,2\"\n"}],
+  ['q2', '--csv --full round 2', {IN_PIPE=>qq{"x ""y""",1.4\n}},
+    {OUT=>"\"x \"\"y\"\"\",1.4,1\n"}],
+  ['q3', '--csv -H --full round 2', {IN_PIPE=>$in_hdr},
+    {OUT=>"id,\"value, total\",\"round(value, total)\"\nx,1,1\ny,2,2\n"}],
+  ['q4', '--csv -s --header-in --header-out -g2 count 1',
+    {IN_PIPE=>$in_hdr},
+    {OUT=>"\"GroupBy(value, total)\",count(id)\n1,1\n2,1\n"}],
+  ['q5', '--csv crosstab 1,2 first 2', {IN_PIPE=>qq{a,"x,y"\nb,z\n}},
+    {OUT=>",\"x,y\",z\na,\"x,y\",N/A\nb,N/A,z\n"}],
+  ['q6', '--csv transpose', {IN_PIPE=>qq{a,"x,y"\nb,z\n}},
+    {OUT=>"a,b\n\"x,y\",z\n"}],
+  ['q7', '--csv --hash-group -g1 sum 2', {IN_PIPE=>qq{"a\nb",1\n"a\nb",2\n}},
+    {OUT=>"\"a\nb\",3\n"}],
+
+  # Without --csv, quotes have no special meaning
+  ['n1', '-t, --output-delimiter=: cut 1,2', {IN_PIPE=>qq{"a,b",1\n}},
+    {OUT=>"\"a:b\"\n"}],
+
+  # Input files, memory-mapped or read from a pipe
+  ['f1', '--csv sum 2 -- in1', {OUT=>"21\n"}],
+  ['f2', '--csv sum 2 -- - in1', {IN_PIPE=>$in1}, {OUT=>"42\n"}],
+
+  # Errors
+  ['e1', '--csv sum 2', {IN_PIPE=>qq{a,1\n"b,2\n}}, {EXIT=>1},
+    {ERR=>"$prog: invalid CSV input: unterminated quoted field\n"}],
+  ['e2', '--csv -W sum 1', {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: --csv and --whitespace cannot be combined\n"}],
+  ['e3', '--csv --vnlog sum 1', {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: --csv and --vnlog cannot be combined\n"}],
+  ['e4', '--csv --sort-cmd=sort -s -g1 sum 2', {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: --csv and --sort-cmd cannot be combined\n"}],
+  ['e5', '--csv -t\'"\' sum 1', {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: the delimiter cannot be a double-quote with --csv\n"}],
+);
+
+open my $fh, '>', 'in1' or die "$program_name: in1: $!\n";
+print $fh $in1;
+close $fh or die "$program_name: in1: $!\n";
+
+my $save_temps = $ENV{SAVE_TEMPS};
+my $verbose = $ENV{VERBOSE};
+
+my $fail = run_tests ($program_name, $prog, \@Tests, $save_temps, $verbose);
+exit $fail;
@@ -203,6 +203,28 @@ my @Tests =
   ['e98','perc:1:2  1',    {IN_PIPE=>""}, {EXIT=>1},
     {ERR=>"$prog: too many parameters for operation 'perc'\n"}],
 
+  # values for approximate percentile operations
+  ['e156','aperc:101  1',    {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: invalid percentile value 101\n"}],
+  ['e157','aperc:50:5  1',    {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: invalid compression value 5 " .
+          "(expected 10 <= X <= 100000)\n"}],
+  ['e158','amedian:200000  1',    {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: invalid compression value 200000 " .
+          "(expected 10 <= X <= 100000)\n"}],
+  ['e159','aperc:1:20:3  1',    {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: too many parameters for operation 'aperc'\n"}],
+  ['e160','amedian:20:3  1',    {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: too many parameters for operation 'amedian'\n"}],
+
+  # values for approximate count of unique values
+  ['e161','acountunique:3  1',    {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: invalid precision value 3 (expected 4 <= X <= 18)\n"}],
+  ['e162','acountunique:4.5  1',    {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: invalid precision value 4.5 (expected 4 <= X <= 18)\n"}],
+  ['e163','acountunique:12:3  1',    {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: too many parameters for operation 'acountunique'\n"}],
+
   # Invalid output delimiters
   ['e100', '--output-delimiter', {IN_PIPE=>""}, {EXIT=>1},
     {ERR_SUBST=>'s/requires an argument -- output-delimiter/' .
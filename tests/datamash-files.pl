@@ -0,0 +1,221 @@
+#!/usr/bin/env perl
+=pod
+  Unit Tests for GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+=cut
+
+use strict;
+use warnings;
+
+use lib '.';
+# Until a better way comes along to auto-use Coreutils Perl modules
+# as in the coreutils' autotools system.
+use Coreutils;
+use CuSkip;
+use CuTmpdir qw(datamash);
+
+(my $program_name = $0) =~ s|.*/||;
+my $prog_bin = 'datamash';
+
+## Cross-Compiling portability hack:
+##  under qemu/binfmt, argv[0] (which is used to report errors) will contain
+##  the full path of the binary, if the binary is on the $PATH.
+##  So we try to detect what is the actual returned value of the program
+##  in case of an error.
+my $prog = `$prog_bin ---print-progname`;
+$prog = $prog_bin unless $prog;
+
+# Turn off localization of executable's output.
+@ENV{qw(LANGUAGE LANG LC_ALL)} = ('C') x 3;
+
+## Input files, created in the test directory
+## (they are used by several tests, and by --files0-from lists).
+my %files = (
+  # Groups 'B' and 'C' span files f1/f2 and f2/f3.
+  'f1'  => "A\t1\nA\t2\nB\t3\n",
+  'f2'  => "B\t4\nC\t5\n",
+  'f3'  => "C\t6\nC\t7\nD\t8\n",
+  'e0'  => "",
+  # Same data, with header lines
+  'h1'  => "x\ty\nA\t1\nA\t2\nB\t3\n",
+  'h2'  => "x\ty\nB\t4\nC\t5\n",
+  'h3'  => "x\ty\n",
+  # Not sorted (for --sort)
+  'u1'  => "C\t1\nA\t2\n",
+  'u2'  => "B\t3\nA\t4\n",
+  # Keys differing in letter case (for -i)
+  'i1'  => "a\t1\n",
+  'i2'  => "A\t5\na\t2\nb\t1\n",
+  # Three fields instead of two
+  'w3'  => "A\t1\t1\n",
+  # An invalid value, and a line with three fields, in line 2
+  'x1'  => "A\t1\nA\tx\n",
+  'x2'  => "A\t1\nA\t1\t1\n",
+  'hx'  => "x\ty\nA\t1\nA\tx\n",
+  # Lists of file names
+  'l1'  => "f1\0f2\0f3\0",
+  'l2'  => "f1\0\0f2\0",
+  'l3'  => "",
+  'l4'  => "f1\0missing\0",
+);
+
+foreach my $name (keys %files)
+  {
+    open my $fh, '>', $name or die "$program_name: $name: $!\n";
+    print $fh $files{$name};
+    close $fh or die "$program_name: $name: $!\n";
+  }
+
+my $out_sum=<<'EOF';
+A	3
+B	7
+C	18
+D	8
+EOF
+
+my $out_collapse=<<'EOF';
+A	1,2
+B	3,4
+C	5,6,7
+D	8
+EOF
+
+my $out_hdr_sum=<<'EOF';
+GroupBy(x)	sum(y)
+A	3
+B	7
+C	5
+EOF
+
+my @Tests =
+(
+  # Files are read one after the other, as a single input
+  ['f1', '-g1 sum 2 -- f1 f2 f3', {OUT=>$out_sum}],
+  ['f2', '-g1 collapse 2 -- f1 e0 f2 e0 f3', {OUT=>$out_collapse}],
+  ['f3', 'sum 2 -- f1 f2', {OUT=>"15\n"}],
+  ['f4', 'count 1 -- f1 - f3', {IN_PIPE=>"Z\t1\n"}, {OUT=>"7\n"}],
+  ['f5', 'transpose -- f1 f2', {OUT=>"A\tA\tB\tB\tC\n1\t2\t3\t4\t5\n"}],
+  ['f6', '-s -g1 sum 2 -- u1 u2', {OUT=>"A\t6\nB\t3\nC\t1\n"}],
+  ['f7', 'check -- f1 f2 f3', {OUT=>"8 lines, 2 fields\n"}],
+  ['f8', '-- sum 1', {IN_PIPE=>"1\n2\n"}, {OUT=>"3\n"}],
+
+  # Only the first header line is used
+  ['h1', '-H -g1 sum 2 -- h1 h2', {OUT=>$out_hdr_sum}],
+  ['h2', '-H -g1 sum 2 -- h1 h3 h2', {OUT=>$out_hdr_sum}],
+  ['h3', '-s --header-in -g x sum y -- h2 h1',
+    {OUT=>"A\t3\nB\t7\nC\t5\n"}],
+  ['h4', '--header-in cut 2 -- h1 h2', {OUT=>"1\n2\n3\n4\n5\n"}],
+
+  # Lists of NUL-terminated file names
+  ['l1', '--files0-from=l1 -g1 sum 2', {OUT=>$out_sum}],
+  ['l2', '--files0-from=- -g1 sum 2', {IN_PIPE=>"f1\0f2\0f3\0"},
+    {OUT=>$out_sum}],
+
+  # Parallel workers give the same output
+  ['p1', '--parallel=2 -g1 sum 2 -- f1 f2 f3', {OUT=>$out_sum}],
+  ['p2', '--parallel=3 -g1 collapse 2 -- f1 e0 f2 e0 f3',
+    {OUT=>$out_collapse}],
+  ['p3', '--parallel=2 -g1 count 1 mean 2 -- f1 f2 f3',
+    {OUT=>"A\t2\t1.5\nB\t2\t3.5\nC\t3\t6\nD\t1\t8\n"}],
+  ['p4', '--parallel=4 -g1 min 2 max 2 range 2 -- f1 f2 f3',
+    {OUT=>"A\t1\t2\t1\nB\t3\t4\t1\nC\t5\t7\t2\nD\t8\t8\t0\n"}],
+  ['p5', '--parallel=2 -g1 first 2 last 2 -- f1 f2 f3',
+    {OUT=>"A\t1\t2\nB\t3\t4\nC\t5\t7\nD\t8\t8\n"}],
+  ['p6', '--parallel=2 -g1 median 2 countunique 2 -- f1 f2 f3',
+    {OUT=>"A\t1.5\t2\nB\t3.5\t2\nC\t6\t3\nD\t8\t1\n"}],
+  ['p7', '--parallel=2 sum 2 -- f1 f2 f3', {OUT=>"36\n"}],
+  ['p8', '--parallel=2 -H -g1 sum 2 -- h1 h3 h2', {OUT=>$out_hdr_sum}],
+  ['p9', '--parallel=2 --header-out -g1 sum 2 -- e0 f1',
+    {OUT=>"GroupBy(field-1)\tsum(field-2)\nA\t3\nB\t3\n"}],
+  ['p10', '--parallel=2 cut 2,1 -- f1 f2',
+    {OUT=>"1\tA\n2\tA\n3\tB\n4\tB\n5\tC\n"}],
+  ['p11', '--parallel=2 check -- f1 e0 f2 f3',
+    {OUT=>"8 lines, 2 fields\n"}],
+  ['p12', '--parallel=2 --files0-from=l1 -g1 sum 2', {OUT=>$out_sum}],
+  # Sequential fallback (--sort)
+  ['p13', '--parallel=2 -s -g1 sum 2 -- u1 u2',
+    {OUT=>"A\t6\nB\t3\nC\t1\n"}],
+
+  # With -i, the printed key is from the line kept by max/last
+  ['p14', '-i -g1 max 2 -- i1 i2', {OUT=>"A\t5\nb\t1\n"}],
+  ['p15', '-i --parallel=2 -g1 max 2 -- i1 i2', {OUT=>"A\t5\nb\t1\n"}],
+  ['p16', '-i -g1 last 2 -- i1 i2', {OUT=>"a\t2\nb\t1\n"}],
+  ['p17', '-i --parallel=2 -g1 last 2 -- i1 i2', {OUT=>"a\t2\nb\t1\n"}],
+
+  # Errors
+  ['e1', 'check -- f1 w3', {EXIT=>1},
+    {ERR=>"f1: line 3 (2 fields):\n  B\t3\n" .
+          "w3: line 1 (3 fields):\n  A\t1\t1\n" .
+          "$prog: w3: check failed: line 1 has 3 fields " .
+          "(previous line had 2)\n"}],
+  ['e2', '--parallel=2 check -- f1 w3', {EXIT=>1},
+    {ERR=>"f1: line 3 (2 fields):\n  B\t3\n" .
+          "w3: line 1 (3 fields):\n  A\t1\t1\n" .
+          "$prog: w3: check failed: line 1 has 3 fields " .
+          "(previous line had 2)\n"}],
+  # Errors about an input line name its file, and give the line number
+  # in that file (counting its header line), with or without --parallel
+  ['e12', 'sum 2 -- f1 x1', {EXIT=>1},
+    {ERR=>"$prog: x1: invalid numeric value in line 2 field 2: 'x'\n"}],
+  ['e13', '--parallel=2 sum 2 -- f1 x1', {EXIT=>1},
+    {ERR=>"$prog: x1: invalid numeric value in line 2 field 2: 'x'\n"}],
+  ['e14', 'check -- f1 x2', {EXIT=>1},
+    {ERR=>"x2: line 1 (2 fields):\n  A\t1\n" .
+          "x2: line 2 (3 fields):\n  A\t1\t1\n" .
+          "$prog: x2: check failed: line 2 has 3 fields " .
+          "(previous line had 2)\n"}],
+  ['e15', '--parallel=2 check -- f1 x2', {EXIT=>1},
+    {ERR=>"x2: line 1 (2 fields):\n  A\t1\n" .
+          "x2: line 2 (3 fields):\n  A\t1\t1\n" .
+          "$prog: x2: check failed: line 2 has 3 fields " .
+          "(previous line had 2)\n"}],
+  ['e16', '--hash-group --threads=2 -g1 sum 2 -- f1 x1', {EXIT=>1},
+    {ERR=>"$prog: x1: invalid numeric value in line 2 field 2: 'x'\n"}],
+  ['e17', '--header-in sum 2 -- h1 hx', {EXIT=>1},
+    {ERR=>"$prog: hx: invalid numeric value in line 3 field 2: 'x'\n"}],
+  ['e18', '--parallel=2 --header-in sum 2 -- h1 hx', {EXIT=>1},
+    {ERR=>"$prog: hx: invalid numeric value in line 3 field 2: 'x'\n"}],
+  ['e3', 'sum 1 -- missing', {EXIT=>1},
+    {ERR=>"$prog: missing: No such file or directory\n"}],
+  ['e4', '--parallel=2 sum 2 -- f1 missing', {EXIT=>1},
+    {ERR=>"$prog: missing: No such file or directory\n"}],
+  ['e5', '--files0-from=l1 sum 2 -- f1', {EXIT=>1},
+    {ERR=>"$prog: extra operand 'f1'\n" .
+          "file operands cannot be combined with --files0-from\n" .
+          "Try '$prog --help' for more information.\n"}],
+  ['e6', '--files0-from=l2 sum 2', {EXIT=>1},
+    {ERR=>"$prog: l2:2: invalid zero-length file name\n"}],
+  ['e7', '--files0-from=l3 sum 2', {EXIT=>1},
+    {ERR=>"$prog: no input from 'l3'\n"}],
+  ['e8', '--files0-from=l4 sum 2', {EXIT=>1},
+    {ERR=>"$prog: missing: No such file or directory\n"}],
+  ['e9', '--files0-from=nolist sum 2', {EXIT=>1},
+    {ERR=>"$prog: cannot open 'nolist' for reading: " .
+          "No such file or directory\n"}],
+  ['e10', '--parallel=0 sum 2 -- f1', {EXIT=>1},
+    {ERR=>"$prog: invalid number of parallel jobs: '0'\n"}],
+  ['e11', '--parallel=x sum 2 -- f1', {EXIT=>1},
+    {ERR=>"$prog: invalid number of parallel jobs: 'x'\n"}],
+);
+
+my $save_temps = $ENV{SAVE_TEMPS};
+my $verbose = $ENV{VERBOSE};
+
+my $fail = run_tests ($program_name, $prog, \@Tests, $save_temps, $verbose);
+exit $fail;
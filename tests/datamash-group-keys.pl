@@ -0,0 +1,140 @@
+#!/usr/bin/env perl
+=pod
+  Unit Tests for GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+=cut
+
+use strict;
+use warnings;
+
+use lib '.';
+# Until a better way comes along to auto-use Coreutils Perl modules
+# as in the coreutils' autotools system.
+use Coreutils;
+use CuSkip;
+use CuTmpdir qw(datamash);
+
+(my $program_name = $0) =~ s|.*/||;
+my $prog_bin = 'datamash';
+
+## Cross-Compiling portability hack:
+##  under qemu/binfmt, argv[0] (which is used to report errors) will contain
+##  the full path of the binary, if the binary is on the $PATH.
+##  So we try to detect what is the actual returned value of the program
+##  in case of an error.
+my $prog = `$prog_bin ---print-progname`;
+$prog = $prog_bin unless $prog;
+
+# Turn off localization of executable's output.
+@ENV{qw(LANGUAGE LANG LC_ALL)} = ('C') x 3;
+
+my $in1=<<'EOF';
+5	1
+12	2
+-3	4
+15	8
+-10	1
+7	16
+EOF
+
+my $in_hdr=<<'EOF';
+v	n
+1.5	1
+2.5	2
+EOF
+
+## Without -s, each run of a computed key is a group
+my $out_runs=<<'EOF';
+0	1
+10	2
+-10	4
+10	8
+-10	1
+0	16
+EOF
+
+my $out_sorted=<<'EOF';
+-10	5
+0	17
+10	10
+EOF
+
+my $out_hash=<<'EOF';
+0	17
+10	10
+-10	5
+EOF
+
+my $out_ct=<<'EOF';
+	0	10
+-10	2	N/A
+0	1	1
+10	2	N/A
+EOF
+
+## Many keys extracted with getnum, by several --threads workers
+my $in_getnum = join ('', map { "id" . ($_ % 1000) . ("x" x ($_ % 50))
+                                . "\t1\n" } 0 .. 99999);
+my $out_getnum = join ('', map { "$_\t100\n" } 0 .. 999);
+
+my @Tests =
+(
+  ['k1', q{-g 'bin:10(1)' sum 2}, {IN_PIPE=>$in1}, {OUT=>$out_runs}],
+  ['k2', q{-s -g 'bin:10(1)' sum 2}, {IN_PIPE=>$in1}, {OUT=>$out_sorted}],
+  ['k3', q{-s groupby 'bin:10(1)' sum 2}, {IN_PIPE=>$in1},
+    {OUT=>$out_sorted}],
+  ['k4', q{--hash-group -g 'bin:10(1)' sum 2}, {IN_PIPE=>$in1},
+    {OUT=>$out_hash}],
+  ['k5', q{--hash-group --hash-buffer-size=1b --threads 2 -s }
+         . q{-g 'bin:10(1)' sum 2}, {IN_PIPE=>$in1}, {OUT=>$out_sorted}],
+  ['k5a', q{--hash-group --threads 4 -s -g 'getnum(1)' count 1},
+    {IN_PIPE=>$in_getnum}, {OUT=>$out_getnum}],
+  # Computed keys are sorted by their values
+  ['k6', q{-s -g 'round(1)' count 1}, {IN_PIPE=>"100\n20\n3\n20.4\n"},
+    {OUT=>"3\t1\n20\t2\n100\t1\n"}],
+  ['k7', q{-s -g 'bin(1)',2 count 1}, {IN_PIPE=>"150\tb\n-1\ta\n120\ta\n"},
+    {OUT=>"-100\ta\t1\n100\ta\t1\n100\tb\t1\n"}],
+  ['k8', q{-s -i -g 'getnum(1)',2 collapse 1},
+    {IN_PIPE=>"a1\tx\nb01\tX\nc2\tx\n"}, {OUT=>"1\tx\ta1,b01\n2\tx\tc2\n"}],
+  ['k9', q{-s -g 'strbin:2(1)' collapse 1}, {IN_PIPE=>$in1},
+    {OUT=>"0\t12,-10\n1\t5,-3,15,7\n"}],
+  ['k10', q{-s crosstab 'bin:10(1)','bin:10(2)'}, {IN_PIPE=>$in1},
+    {OUT=>$out_ct}],
+  ['k11', q{-s --header-in --header-out -g 'floor(v)' sum n},
+    {IN_PIPE=>$in_hdr}, {OUT=>"GroupBy(floor(v))\tsum(n)\n1\t1\n2\t2\n"}],
+
+  ['e1', q{-g 'bin:10(1' count 1}, {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: missing ')' after the field of operation 'bin'\n"}],
+  ['e2', q{-g 'sum(1)' count 1}, {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: invalid group key operation 'sum'\n"}],
+  ['e3', q{-g 'bin:10 1' count 1}, {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: missing field for operation 'bin'\n"}],
+  ['e4', q{-g 'round()' count 1}, {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: invalid field ')' for operation 'round'\n"}],
+  ['e5', q{rmdup 'bin(1)'}, {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: operation 'dedup' cannot use a computed key\n"}],
+  ['e6', q{-g 'bin(1)' count 1}, {IN_PIPE=>"x\n"}, {EXIT=>1},
+    {ERR=>"$prog: invalid numeric value in line 1 field 1: 'x'\n"}],
+);
+
+my $save_temps = $ENV{SAVE_TEMPS};
+my $verbose = $ENV{VERBOSE};
+
+my $fail = run_tests ($program_name, $prog, \@Tests, $save_temps, $verbose);
+exit $fail;
@@ -0,0 +1,219 @@
+#!/usr/bin/env perl
+=pod
+  Unit Tests for GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+=cut
+
+use strict;
+use warnings;
+
+use lib '.';
+# Until a better way comes along to auto-use Coreutils Perl modules
+# as in the coreutils' autotools system.
+use Coreutils;
+use CuSkip;
+use CuTmpdir qw(datamash);
+
+(my $program_name = $0) =~ s|.*/||;
+my $prog_bin = 'datamash';
+
+## Cross-Compiling portability hack:
+##  under qemu/binfmt, argv[0] (which is used to report errors) will contain
+##  the full path of the binary, if the binary is on the $PATH.
+##  So we try to detect what is the actual returned value of the program
+##  in case of an error.
+my $prog = `$prog_bin ---print-progname`;
+$prog = $prog_bin unless $prog;
+
+# Turn off localization of executable's output.
+@ENV{qw(LANGUAGE LANG LC_ALL)} = ('C') x 3;
+
+
+## Unsorted input: groups 'b' and 'a' are interleaved
+my $in1=<<'EOF';
+b	1	x
+a	2	y
+B	3	z
+b	4	x
+c	5	y
+a	6	z
+EOF
+
+my $in_hdr = "key\tval\tname\n" . $in1;
+
+my $out_first_seen=<<'EOF';
+b	5
+a	8
+B	3
+c	5
+EOF
+
+my $out_sorted=<<'EOF';
+B	3
+a	8
+b	5
+c	5
+EOF
+
+# Many groups, in several levels of temporary files
+my @many = map { (($_ * 7919) % 1009) . "\t$_\n" } 1..3000;
+my $in_many = join ('', @many);
+my (%first, %last, %count, @keys);
+foreach my $i (1..3000)
+  {
+    my $k = ($i * 7919) % 1009;
+    push @keys, $k unless exists $first{$k};
+    $first{$k} = $i unless exists $first{$k};
+    $last{$k} = $i;
+    $count{$k}++;
+  }
+my $out_many = join ('', map { "$_\t$first{$_}\t$last{$_}\t$count{$_}\n" }
+                              @keys);
+my $out_many_sorted = join ('', map { "$_\t$first{$_}\t$last{$_}\t" .
+                                      "$count{$_}\n" }
+                                     sort { "$a" cmp "$b" } @keys);
+
+my @Tests =
+(
+  # Groups are printed in the order of their first line
+  ['h1', '--hash-group -g1 sum 2', {IN_PIPE=>$in1}, {OUT=>$out_first_seen}],
+  # With --sort, only the results are sorted
+  ['h2', '--hash-group -s -g1 sum 2', {IN_PIPE=>$in1}, {OUT=>$out_sorted}],
+  ['h3', '-s -g1 sum 2', {IN_PIPE=>$in1}, {OUT=>$out_sorted}],
+  ['h4', '--hash-group -s -g1 count 1 collapse 2 unique 3',
+    {IN_PIPE=>$in1},
+    {OUT=>"B\t1\t3\tz\na\t2\t2,6\ty,z\nb\t2\t1,4\tx\nc\t1\t5\ty\n"}],
+  # Operations with a subordinate field, and with value lists
+  ['h5', '--hash-group -g3 pcov 2:2 median 2 first 1 last 1',
+    {IN_PIPE=>$in1},
+    {OUT=>"x\t2.25\t2.5\tb\tb\ny\t2.25\t3.5\ta\tc\n" .
+          "z\t2.25\t4.5\tB\ta\n"}],
+  # Several keys
+  ['h6', '--hash-group -g3,1 sum 2', {IN_PIPE=>$in1},
+    {OUT=>"x\tb\t5\ny\ta\t2\nz\tB\t3\ny\tc\t5\nz\ta\t6\n"}],
+  # --ignore-case: the first line's key is printed
+  ['h7', '--hash-group -i -g1 sum 2', {IN_PIPE=>$in1},
+    {OUT=>"b\t8\na\t8\nc\t5\n"}],
+  ['h8', '--hash-group -i -s -g1 sum 2', {IN_PIPE=>$in1},
+    {OUT=>"a\t8\nb\t8\nc\t5\n"}],
+  # Headers
+  ['h9', '--hash-group -H -g key sum val', {IN_PIPE=>$in_hdr},
+    {OUT=>"GroupBy(key)\tsum(val)\n$out_first_seen"}],
+  ['h10', '--hash-group --header-out -g1 sum 2', {IN_PIPE=>$in1},
+    {OUT=>"GroupBy(field-1)\tsum(field-2)\n$out_first_seen"}],
+  # crosstab
+  ['h11', '--hash-group crosstab 1,3', {IN_PIPE=>$in1},
+    {OUT=>"\tx\ty\tz\nB\tN/A\tN/A\t1\na\tN/A\t1\t1\n" .
+          "b\t2\tN/A\tN/A\nc\tN/A\t1\tN/A\n"}],
+  # Without grouping, or with per-line operations, --hash-group is ignored
+  ['h12', '--hash-group sum 2', {IN_PIPE=>$in1}, {OUT=>"21\n"}],
+  ['h13', '--hash-group cut 1', {IN_PIPE=>$in1},
+    {OUT=>"b\na\nB\nb\nc\na\n"}],
+  # Empty input
+  ['h14', '--hash-group -s -g1 sum 2', {IN_PIPE=>""}, {OUT=>""}],
+  # --csv can be combined with -s (no input sorting)
+  ['h15', '--csv --hash-group -s -g1 sum 2',
+    {IN_PIPE=>"\"b,1\",1\na,2\n\"b,1\",3\n"}, {OUT=>"a,2\n\"b,1\",4\n"}],
+
+  # A small memory budget: the lines of the groups which do not fit
+  # are grouped later, from temporary files, with the same output
+  ['m1', '--hash-buffer-size=1b --hash-group -g1 sum 2', {IN_PIPE=>$in1},
+    {OUT=>$out_first_seen}],
+  ['m2', '--hash-buffer-size=1b --hash-group -s -g1 sum 2', {IN_PIPE=>$in1},
+    {OUT=>$out_sorted}],
+  ['m3', '--hash-buffer-size=1b --hash-group -g3 pcov 2:2 median 2 ' .
+         'first 1 last 1', {IN_PIPE=>$in1},
+    {OUT=>"x\t2.25\t2.5\tb\tb\ny\t2.25\t3.5\ta\tc\n" .
+          "z\t2.25\t4.5\tB\ta\n"}],
+  ['m4', '--hash-buffer-size=1b --hash-group -i -s -g1 sum 2',
+    {IN_PIPE=>$in1}, {OUT=>"a\t8\nb\t8\nc\t5\n"}],
+  ['m5', '--hash-buffer-size=1b --hash-group -H -g key sum val',
+    {IN_PIPE=>$in_hdr}, {OUT=>"GroupBy(key)\tsum(val)\n$out_first_seen"}],
+  ['m6', '--hash-buffer-size=1b --hash-group crosstab 1,3', {IN_PIPE=>$in1},
+    {OUT=>"\tx\ty\tz\nB\tN/A\tN/A\t1\na\tN/A\t1\t1\n" .
+          "b\t2\tN/A\tN/A\nc\tN/A\t1\tN/A\n"}],
+  ['m7', '--hash-buffer-size=1 --hash-group -g1 first 2 last 2 count 2',
+    {IN_PIPE=>$in_many}, {OUT=>$out_many}],
+  ['m8', '--hash-buffer-size=1 --hash-group -s -g1 first 2 last 2 count 2',
+    {IN_PIPE=>$in_many}, {OUT=>$out_many_sorted}],
+
+  # Other modes still sort the input
+  ['h16', '--hash-group -s rmdup 1', {IN_PIPE=>$in1},
+    {OUT=>"B\t3\tz\na\t2\ty\nb\t1\tx\nc\t5\ty\n"}],
+
+  # Several threads give the same output
+  ['t1', '--threads=4 --hash-group -g1 sum 2', {IN_PIPE=>$in1},
+    {OUT=>$out_first_seen}],
+  ['t2', '--threads=3 --hash-group -s -g1 sum 2', {IN_PIPE=>$in1},
+    {OUT=>$out_sorted}],
+  ['t3', '--threads=2 --hash-group -g3 pcov 2:2 median 2 first 1 last 1',
+    {IN_PIPE=>$in1},
+    {OUT=>"x\t2.25\t2.5\tb\tb\ny\t2.25\t3.5\ta\tc\n" .
+          "z\t2.25\t4.5\tB\ta\n"}],
+  ['t4', '--threads=4 --hash-group -i -g1 sum 2', {IN_PIPE=>$in1},
+    {OUT=>"b\t8\na\t8\nc\t5\n"}],
+  ['t5', '--threads=2 --hash-group -H -g key sum val', {IN_PIPE=>$in_hdr},
+    {OUT=>"GroupBy(key)\tsum(val)\n$out_first_seen"}],
+  ['t6', '--threads=3 --hash-group crosstab 1,3', {IN_PIPE=>$in1},
+    {OUT=>"\tx\ty\tz\nB\tN/A\tN/A\t1\na\tN/A\t1\t1\n" .
+          "b\t2\tN/A\tN/A\nc\tN/A\t1\tN/A\n"}],
+  ['t7', '--threads=4 --hash-group -g1 first 2 last 2 count 2',
+    {IN_PIPE=>$in_many}, {OUT=>$out_many}],
+  ['t8', '--threads=3 --hash-buffer-size=1 --hash-group -g1 first 2 ' .
+         'last 2 count 2', {IN_PIPE=>$in_many}, {OUT=>$out_many}],
+  ['t9', '--threads=3 --hash-buffer-size=1 --hash-group -s -g1 first 2 ' .
+         'last 2 count 2', {IN_PIPE=>$in_many}, {OUT=>$out_many_sorted}],
+  ['t10', '--threads=2 -s -g1 sum 2', {IN_PIPE=>$in1}, {OUT=>$out_sorted}],
+
+  # Errors
+  ['e1', '--hash-group -g1 sum 3', {IN_PIPE=>$in1}, {EXIT=>1},
+    {ERR=>"$prog: invalid numeric value in line 1 field 3: 'x'\n"}],
+  ['e2', '--hash-group -g4 sum 2', {IN_PIPE=>$in1}, {EXIT=>1},
+    {ERR=>"$prog: invalid input: field 4 requested, line 1 has only 3 " .
+          "fields\n"}],
+  # Spilled lines are reported with their input line number
+  ['e3', '--hash-buffer-size=1b --hash-group -g1 sum 2',
+    {IN_PIPE=>"a\t1\nb\t2\nb\tx\n"}, {EXIT=>1},
+    {ERR=>"$prog: invalid numeric value in line 3 field 2: 'x'\n"}],
+  ['e4', '--hash-buffer-size=0 --hash-group -g1 sum 2', {IN_PIPE=>""},
+    {EXIT=>1}, {ERR=>"$prog: invalid hash buffer size: '0'\n"}],
+  ['e5', '--hash-buffer-size=1b --hash-group -g1 sum 2',
+    {IN_PIPE=>"a\t1\nb\t2\n"}, {ENV=>"TMPDIR=/nonexistent-dir"}, {EXIT=>1},
+    {ERR=>"$prog: failed to create temporary file in '/nonexistent-dir': " .
+          "No such file or directory\n"}],
+  # With several threads, the first invalid line is reported
+  ['e6', '--threads=4 --hash-group -g1 sum 2',
+    {IN_PIPE=>"a\t1\nb\t2\nc\t3\nd\tx\nb\ty\na\tz\n"}, {EXIT=>1},
+    {ERR=>"$prog: invalid numeric value in line 4 field 2: 'x'\n"}],
+  ['e7', '--threads=4 --hash-group -g2 sum 1',
+    {IN_PIPE=>"1\ta\nx\tb\n3\n"}, {EXIT=>1},
+    {ERR=>"$prog: invalid numeric value in line 2 field 1: 'x'\n"}],
+  ['e8', '--threads=4 --hash-group -g2 sum 1',
+    {IN_PIPE=>"1\ta\n2\tb\n3\nx\tc\n"}, {EXIT=>1},
+    {ERR=>"$prog: invalid input: field 2 requested, line 3 has only 1 " .
+          "fields\n"}],
+  ['e9', '--threads=0 --hash-group -g1 sum 2', {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: invalid number of threads: '0'\n"}],
+);
+
+my $save_temps = $ENV{SAVE_TEMPS};
+my $verbose = $ENV{VERBOSE};
+
+my $fail = run_tests ($program_name, $prog, \@Tests, $save_temps, $verbose);
+exit $fail;
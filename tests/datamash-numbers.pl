@@ -0,0 +1,116 @@
+#!/usr/bin/env perl
+=pod
+  Unit Tests for GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+=cut
+
+use strict;
+use warnings;
+
+use lib '.';
+# Until a better way comes along to auto-use Coreutils Perl modules
+# as in the coreutils' autotools system.
+use Coreutils;
+use CuSkip;
+use CuTmpdir qw(datamash);
+
+(my $program_name = $0) =~ s|.*/||;
+my $prog_bin = 'datamash';
+
+## Cross-Compiling portability hack:
+##  under qemu/binfmt, argv[0] (which is used to report errors) will contain
+##  the full path of the binary, if the binary is on the $PATH.
+##  So we try to detect what is the actual returned value of the program
+##  in case of an error.
+my $prog = `$prog_bin ---print-progname`;
+$prog = $prog_bin unless $prog;
+
+# Turn off localization of executable's output.
+@ENV{qw(LANGUAGE LANG LC_ALL)} = ('C') x 3;
+
+my $in_plain = join ("", map { "$_\n" }
+                     qw(1 -2 +3 4.5 -.5 6. 1e3 1.5E-3 -2e+2 0.000125 007));
+
+my $in_mixed = join ("", map { "$_\n" }
+                     qw(0x10 1e30 12345678901234567890123 1e400 -1e400 1.e2));
+
+my @Tests =
+(
+  # Plain decimal numbers
+  ['n1', 'sum 1', {IN_PIPE=>$in_plain}, {OUT=>"819.001625\n"}],
+  ['n2', 'min 1 max 1', {IN_PIPE=>$in_plain}, {OUT=>"-200\t1000\n"}],
+  ['n3', 'sum 1', {IN_PIPE=>"0.1\n" x 10}, {OUT=>"1\n"}],
+  ['n4', 'sum 1', {IN_PIPE=>"-0\n"}, {OUT=>"0\n"}],
+  ['n5', 'sum 1', {IN_PIPE=>"0e999\n"}, {OUT=>"0\n"}],
+  ['n6', 'sum 1', {IN_PIPE=>"0.000000000000000000000000000000001\n"},
+    {OUT=>"1e-33\n"}],
+  ['n7', 'sum 1', {IN_PIPE=>"9999999999999999999\n"},
+    {OUT=>"1e+19\n"}],
+
+  # Other numbers accepted by strtold
+  ['n10', 'sum 1', {IN_PIPE=>"0x10\n 5\n"}, {OUT=>"21\n"}],
+  ['n11', 'cut 1', {IN_PIPE=>$in_mixed},
+    {OUT=>"0x10\n1e30\n12345678901234567890123\n1e400\n-1e400\n1.e2\n"}],
+  ['n12', 'max 1', {IN_PIPE=>$in_mixed}, {OUT=>"1e+400\n"}],
+  ['n13', 'min 1', {IN_PIPE=>$in_mixed}, {OUT=>"-1e+400\n"}],
+  ['n14', 'sum 1', {IN_PIPE=>"1e30\n"}, {OUT=>"1e+30\n"}],
+  ['n15', 'sum 1', {IN_PIPE=>"12345678901234567890123\n"},
+    {OUT=>"1.2345678901235e+22\n"}],
+  ['n16', 'sum 1', {IN_PIPE=>"inf\n"}, {OUT=>"inf\n"}],
+  ['n17', 'sum 1', {IN_PIPE=>"-inf\n"}, {OUT=>"-inf\n"}],
+  ['n18', 'sum 1', {IN_PIPE=>"NaN\n"}, {OUT=>"nan\n"}],
+
+  # N/A values
+  ['na1', '--narm sum 1', {IN_PIPE=>"1\nNA\n2\nN/A\nnan\n3\n"},
+    {OUT=>"6\n"}],
+  ['na2', '--narm count 1', {IN_PIPE=>"1\nNA\nnA\nN/a\nNaN\n"},
+    {OUT=>"1\n"}],
+  ['na3', '--narm unique 1', {IN_PIPE=>"x\nNA\nnan\n"}, {OUT=>"x\n"}],
+  ['na4', 'sum 1', {IN_PIPE=>"1\nNA\n"}, {EXIT=>1},
+    {ERR=>"$prog: invalid numeric value in line 2 field 1: 'NA'\n"}],
+  ['na5', 'sum 1', {IN_PIPE=>"N/A\n"}, {EXIT=>1},
+    {ERR=>"$prog: invalid numeric value in line 1 field 1: 'N/A'\n"}],
+
+  # Invalid numbers
+  ['e1', 'sum 1', {IN_PIPE=>".\n"}, {EXIT=>1},
+    {ERR=>"$prog: invalid numeric value in line 1 field 1: '.'\n"}],
+  ['e2', 'sum 1', {IN_PIPE=>"e5\n"}, {EXIT=>1},
+    {ERR=>"$prog: invalid numeric value in line 1 field 1: 'e5'\n"}],
+  ['e3', 'sum 1', {IN_PIPE=>"1e\n"}, {EXIT=>1},
+    {ERR=>"$prog: invalid numeric value in line 1 field 1: '1e'\n"}],
+  ['e4', 'sum 1', {IN_PIPE=>"1e+\n"}, {EXIT=>1},
+    {ERR=>"$prog: invalid numeric value in line 1 field 1: '1e+'\n"}],
+  ['e5', 'sum 1', {IN_PIPE=>"--5\n"}, {EXIT=>1},
+    {ERR=>"$prog: invalid numeric value in line 1 field 1: '--5'\n"}],
+  ['e6', 'sum 1', {IN_PIPE=>"5 \n"}, {EXIT=>1},
+    {ERR=>"$prog: invalid numeric value in line 1 field 1: '5 '\n"}],
+  ['e7', 'sum 1', {IN_PIPE=>"1.2.3\n"}, {EXIT=>1},
+    {ERR=>"$prog: invalid numeric value in line 1 field 1: '1.2.3'\n"}],
+  ['e8', '-W sum 2', {IN_PIPE=>"a 1\nb\n"}, {EXIT=>1},
+    {ERR=>"$prog: invalid input: field 2 requested, " .
+          "line 2 has only 1 fields\n"}],
+  ['e9', '-t, sum 2', {IN_PIPE=>"a,\n"}, {EXIT=>1},
+    {ERR=>"$prog: invalid numeric value in line 1 field 2: ''\n"}],
+);
+
+my $save_temps = $ENV{SAVE_TEMPS};
+my $verbose = $ENV{VERBOSE};
+
+my $fail = run_tests ($program_name, $prog, \@Tests, $save_temps, $verbose);
+exit $fail;
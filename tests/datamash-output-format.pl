@@ -96,6 +96,46 @@ my @Tests =
   # ['a1', '--format "%0.3a" sum 1', {IN_PIPE=>$in1}, {OUT=>"0x8.000p-3\n"}],
 
 
+  # Rounding ties are rounded to even, like printf
+  ['t1', '--format "%.0f" sum 1', {IN_PIPE=>"0.5\n"}, {OUT=>"0\n"}],
+  ['t2', '--format "%.0f" sum 1', {IN_PIPE=>"1.5\n"}, {OUT=>"2\n"}],
+  ['t3', '--format "%.0f" sum 1', {IN_PIPE=>"2.5\n"}, {OUT=>"2\n"}],
+  ['t4', '-R 2 sum 1', {IN_PIPE=>"0.125\n"}, {OUT=>"0.12\n"}],
+  ['t5', '-R 2 sum 1', {IN_PIPE=>"0.375\n"}, {OUT=>"0.38\n"}],
+  ['t6', '--format "%.1e" sum 1', {IN_PIPE=>"-2.25\n"}, {OUT=>"-2.2e+00\n"}],
+
+  # Carry into the next power of ten
+  ['t7', 'sum 1', {IN_PIPE=>"9.999999999999999\n"}, {OUT=>"10\n"}],
+  ['t8', '--format "%.2e" sum 1', {IN_PIPE=>"9.999\n"}, {OUT=>"1.00e+01\n"}],
+  ['t9', '-R 1 sum 1', {IN_PIPE=>"-99.96\n"}, {OUT=>"-100.0\n"}],
+
+  # Negative zero and zero
+  ['z1', '-R 1 sum 1', {IN_PIPE=>"-0.01\n"}, {OUT=>"-0.0\n"}],
+  ['z2', '--format "%e" sum 1', {IN_PIPE=>"0\n"}, {OUT=>"0.000000e+00\n"}],
+  ['z3', '-R 3 sum 1', {IN_PIPE=>"0\n"}, {OUT=>"0.000\n"}],
+
+  # %g switches to exponential notation
+  ['x1', 'sum 1', {IN_PIPE=>"123456789012345678\n"},
+    {OUT=>"1.2345678901235e+17\n"}],
+  ['x2', 'sum 1', {IN_PIPE=>"0.0001234\n"}, {OUT=>"0.0001234\n"}],
+  ['x3', 'sum 1', {IN_PIPE=>"0.00001234\n"}, {OUT=>"1.234e-05\n"}],
+  ['x4', '--format "%G" sum 1', {IN_PIPE=>"0.00001234\n"},
+    {OUT=>"1.234E-05\n"}],
+  ['x5', 'sum 1', {IN_PIPE=>"1e-300\n"}, {OUT=>"1e-300\n"}],
+  ['x6', 'sum 1', {IN_PIPE=>"1e300\n"}, {OUT=>"1e+300\n"}],
+
+  # Text around the directive, flags
+  ['p1', '--format "v=%%%+09.2f%%" sum 1', {IN_PIPE=>"-3.75\n"},
+    {OUT=>"v=%-00003.75%\n"}],
+  ['p2', '--format "[% .3g]" sum 1', {IN_PIPE=>"3.75\n"},
+    {OUT=>"[ 3.75]\n"}],
+  ['p3', '--format "[%-8.1e]" sum 1', {IN_PIPE=>"375\n"},
+    {OUT=>"[3.8e+02 ]\n"}],
+
+  # Non-finite values
+  ['n1', '-R 2 sum 1', {IN_PIPE=>"-inf\n"}, {OUT=>"-inf\n"}],
+  ['n2', '--format "%08.2f" sum 1', {IN_PIPE=>"nan\n"}, {OUT=>"     nan\n"}],
+
   # Custom formats can use lots of memory
   ['m1', '--format "%04000.0f"   sum 1',  {IN_PIPE=>$in1},
     {OUT => "0" x 3999 . "1\n"}],
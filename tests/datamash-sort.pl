@@ -0,0 +1,186 @@
+#!/usr/bin/env perl
+=pod
+  Unit Tests for GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+=cut
+
+use strict;
+use warnings;
+
+use lib '.';
+# Until a better way comes along to auto-use Coreutils Perl modules
+# as in the coreutils' autotools system.
+use Coreutils;
+use CuSkip;
+use CuTmpdir qw(datamash);
+
+(my $program_name = $0) =~ s|.*/||;
+my $prog_bin = 'datamash';
+
+## Cross-Compiling portability hack:
+##  under qemu/binfmt, argv[0] (which is used to report errors) will contain
+##  the full path of the binary, if the binary is on the $PATH.
+##  So we try to detect what is the actual returned value of the program
+##  in case of an error.
+my $prog = `$prog_bin ---print-progname`;
+$prog = $prog_bin unless $prog;
+
+# Turn off localization of executable's output.
+@ENV{qw(LANGUAGE LANG LC_ALL)} = ('C') x 3;
+
+
+# Unsorted input; the second column is the input order
+my $in1=<<'EOF';
+b	1
+a	2
+B	3
+c	4
+a	5
+b	6
+A	7
+EOF
+
+my $in_hdr = "k\tv\n" . $in1;
+
+# Multiple keys
+my $in2=<<'EOF';
+x	2	1
+y	1	2
+x	1	3
+y	0	4
+x	2	5
+EOF
+
+my $out_first_last=<<'EOF';
+A	7	7
+B	3	3
+a	2	5
+b	1	6
+c	4	4
+EOF
+
+my $out_fold=<<'EOF';
+b	1,3,6
+a	2,5,7
+c	4
+EOF
+
+my $out_keys=<<'EOF';
+0	y	4
+1	x	3
+1	y	2
+2	x	1,5
+EOF
+
+# Already sorted, and sorted up to the last two lines
+my $in_sorted = "a\t1\na\t2\nb\t3\nb\t4\nc\t5\n";
+my $in_prefix = $in_sorted . "a\t6\nb\t7\n";
+my $out_sorted = "a\t1,2\nb\t3,4\nc\t5\n";
+my $out_prefix = "a\t1,2,6\nb\t3,4,7\nc\t5\n";
+
+# A larger input, sorted in several temporary files
+my $in_big = join ('', map { ($_ * 7919 % 101) . "\t$_\n" } 1..2000);
+my $out_big = join ('', map {
+                      my $k = $_;
+                      my @v = grep { $_ * 7919 % 101 == $k } 1..2000;
+                      "$k\t$v[0]\t$v[-1]\t" . scalar (@v) . "\n"
+                    } sort { "$a" cmp "$b" } 0..100);
+
+my @Tests =
+(
+  # The built-in sort is stable: first/last keep the input order
+  ['s1', '-s -g1 first 2 last 2', {IN_PIPE=>$in1}, {OUT=>$out_first_last}],
+  ['s2', '-s -i -g1 collapse 2', {IN_PIPE=>$in1},
+    {OUT=>"a\t2,5,7\nb\t1,3,6\nc\t4\n"}],
+  ['s3', '-s -g3,1 count 1', {IN_PIPE=>"1\t2\tz\n1\t2\ty\n2\t2\tz\n"},
+    {OUT=>"y\t1\t1\nz\t1\t1\nz\t2\t1\n"}],
+  ['s4', '-s -g2,1 collapse 3', {IN_PIPE=>$in2}, {OUT=>$out_keys}],
+  ['s5', '-s -g1 count 1', {IN_PIPE=>""}, {OUT=>""}],
+  ['s6', '-s -g1 count 1', {IN_PIPE=>"b\ta"}, {OUT=>"b\t1\n"}],
+  ['s7', '-s -z -g1 count 1', {IN_PIPE=>"b\0a\0b\0"}, {OUT=>"a\t1\0b\t2\0"}],
+  ['s8', '-s -W -g2 sum 1', {IN_PIPE=>"1  b\n2 a\n 3 b\n"},
+    {OUT=>"a\t2\nb\t4\n"}],
+  ['s9', '-s -t, -g1 sum 2', {IN_PIPE=>"b,1\na,2\nb,3\n"},
+    {OUT=>"a,2\nb,4\n"}],
+
+  # Header lines are not sorted
+  ['h1', '-s -H -g1 sum 2', {IN_PIPE=>$in_hdr},
+    {OUT=>"GroupBy(k)\tsum(v)\nA\t7\nB\t3\na\t7\nb\t7\nc\t4\n"}],
+  ['h2', '-s --header-in -g k last v', {IN_PIPE=>$in_hdr},
+    {OUT=>"A\t7\nB\t3\na\t5\nb\t6\nc\t4\n"}],
+  ['h3', '-s --header-in rmdup 1', {IN_PIPE=>$in_hdr},
+    {OUT=>"A\t7\nB\t3\na\t2\nb\t1\nc\t4\n"}],
+
+  # rmdup keeps the first line of each key, in sorted order
+  ['r1', '-s rmdup 1', {IN_PIPE=>$in1},
+    {OUT=>"A\t7\nB\t3\na\t2\nb\t1\nc\t4\n"}],
+  ['r2', '-s -i rmdup 1', {IN_PIPE=>$in1},
+    {OUT=>"a\t2\nA\t7\nb\t1\nB\t3\nc\t4\n"}],
+
+  # CSV records can contain delimiters and newlines
+  ['c1', '--csv -s -g1 sum 2', {IN_PIPE=>qq{"b\nx",1\na,2\n"b\nx",3\n}},
+    {OUT=>"a,2\n\"b\nx\",4\n"}],
+
+  # Small buffers: the input is sorted in temporary files
+  ['b1', '--sort-buffer-size=1b -s -g1 first 2 last 2', {IN_PIPE=>$in1},
+    {OUT=>$out_first_last}],
+  ['b2', '--sort-buffer-size=1 -s -g1 first 2 last 2 count 2',
+    {IN_PIPE=>$in_big}, {OUT=>$out_big}],
+  ['b3', '--sort-buffer-size=1b -s -i -g1 collapse 2', {IN_PIPE=>$in1},
+    {OUT=>"a\t2,5,7\nb\t1,3,6\nc\t4\n"}],
+  ['b4', '--sort-buffer-size=1b -s -g2,1 collapse 3', {IN_PIPE=>$in2},
+    {OUT=>$out_keys}],
+  ['b5', '--sort-buffer-size=1b -s -H -g1 sum 2', {IN_PIPE=>$in_hdr},
+    {OUT=>"GroupBy(k)\tsum(v)\nA\t7\nB\t3\na\t7\nb\t7\nc\t4\n"}],
+  ['b6', '--sort-buffer-size=1b -s rmdup 1', {IN_PIPE=>$in1},
+    {OUT=>"A\t7\nB\t3\na\t2\nb\t1\nc\t4\n"}],
+  ['b7', '--sort-buffer-size=1G -s -g1 first 2', {IN_PIPE=>$in1},
+    {OUT=>"A\t7\nB\t3\na\t2\nb\t1\nc\t4\n"}],
+
+  # Lines read in order are not sorted again (input files are
+  # memory-mapped, and their lines are not copied)
+  ['p1', '-s -g1 collapse 2', {IN_PIPE=>$in_sorted}, {OUT=>$out_sorted}],
+  ['p2', '-s -g1 collapse 2', '<', {IN=>$in_sorted}, {OUT=>$out_sorted}],
+  ['p3', '-s -g1 collapse 2', {IN_PIPE=>$in_prefix}, {OUT=>$out_prefix}],
+  ['p4', '-s -g1 collapse 2', '<', {IN=>$in_prefix}, {OUT=>$out_prefix}],
+  ['p5', '--sort-buffer-size=1b -s -g1 collapse 2', '<', {IN=>$in_prefix},
+    {OUT=>$out_prefix}],
+  ['p6', '--sort-buffer-size=200b -s -g1 collapse 2', {IN_PIPE=>$in_prefix},
+    {OUT=>$out_prefix}],
+  ['p7', '--sort-buffer-size=200b -s -g1 collapse 2', '<', {IN=>$in_prefix},
+    {OUT=>$out_prefix}],
+
+  # Errors
+  ['e1', '--sort-buffer-size=0 -s -g1 count 1', {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: invalid sort buffer size: '0'\n"}],
+  ['e2', '--sort-buffer-size=1x -s -g1 count 1', {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: invalid sort buffer size: '1x'\n"}],
+  ['e3', '--sort-buffer-size=b -s -g1 count 1', {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: invalid sort buffer size: 'b'\n"}],
+  ['e4', '--sort-buffer-size=1b -s -g1 count 1', {IN_PIPE=>"b\na\n"},
+    {ENV=>"TMPDIR=/nonexistent-dir"}, {EXIT=>1},
+    {ERR=>"$prog: failed to create temporary file in '/nonexistent-dir': " .
+          "No such file or directory\n"}],
+);
+
+my $save_temps = $ENV{SAVE_TEMPS};
+my $verbose = $ENV{VERBOSE};
+
+my $fail = run_tests ($program_name, $prog, \@Tests, $save_temps, $verbose);
+exit $fail;
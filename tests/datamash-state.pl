@@ -0,0 +1,214 @@
+#!/usr/bin/env perl
+=pod
+  Unit Tests for GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+=cut
+
+
+use strict;
+use warnings;
+
+use lib '.';
+# Until a better way comes along to auto-use Coreutils Perl modules
+# as in the coreutils' autotools system.
+use Coreutils;
+use CuSkip;
+use CuTmpdir qw(datamash);
+
+(my $program_name = $0) =~ s|.*/||;
+my $prog_bin = 'datamash';
+
+## Cross-Compiling portability hack:
+##  under qemu/binfmt, argv[0] (which is used to report errors) will contain
+##  the full path of the binary, if the binary is on the $PATH.
+##  So we try to detect what is the actual returned value of the program
+##  in case of an error.
+my $prog = `$prog_bin ---print-progname`;
+$prog = $prog_bin unless $prog;
+
+# Turn off localization of executable's output.
+@ENV{qw(LANGUAGE LANG LC_ALL)} = ('C') x 3;
+
+## Input files, created in the test directory.
+## The state files are written by datamash itself (their format
+## depends on the system).
+my %files = (
+  # Groups 'B' and 'C' are in both files, not sorted
+  'f1'  => "C\t1\nA\t2\nB\t3\nA\t4\n",
+  'f2'  => "B\t5\nC\t6\nD\t7\n",
+  'e0'  => "",
+  # Same data, with header lines
+  'h1'  => "k\tv\nC\t1\nA\t2\nB\t3\nA\t4\n",
+  'h2'  => "k\tv\nB\t5\nC\t6\nD\t7\n",
+  # Mixed letter case
+  'i1'  => "a\t1\nB\t2\n",
+  'i2'  => "A\t3\nb\t4\n",
+  'x1'  => "not a state file\n",
+  # Values of the same group, for the moments (variance, skewness...)
+  'w1'  => "A\t1\t2\nA\t2\t1\nA\t6\t7\n",
+  'w2'  => "A\t10\t8\nA\t3\t5\n",
+);
+
+foreach my $name (keys %files)
+  {
+    open my $fh, '>', $name or die "$program_name: $name: $!\n";
+    print $fh $files{$name};
+    close $fh or die "$program_name: $name: $!\n";
+  }
+
+my @states = (
+  ['s1', '-g1 sum 2 collapse 2 median 2 < f1'],
+  ['s2', '-g1 sum 2 collapse 2 median 2 < f2'],
+  ['se', '-g1 sum 2 collapse 2 median 2 < e0'],
+  ['c1', '-g1 count 2 < f1'],
+  ['n1', 'sum 2 countunique 1 < f1'],
+  ['n2', 'sum 2 countunique 1 < f2'],
+  ['k1', '-H -g k sum v < h1'],
+  ['k2', '-H -g k sum v < h2'],
+  ['j1', '-i -g1 sum 2 < i1'],
+  ['j2', '-i -g1 sum 2 < i2'],
+  ['j3', '-i -g1 max 2 < i1'],
+  ['j4', '-i -g1 max 2 < i2'],
+  ['v1', '-g1 pvar 2 pskew 2 skurt 2 ppearson 2:3 < w1'],
+  ['v2', '-g1 pvar 2 pskew 2 skurt 2 ppearson 2:3 < w2'],
+  ['a1', '-g1 aperc:90 2 amedian 2 < w1'],
+  ['a2', '-g1 aperc:90 2 amedian 2 < w2'],
+  ['u1', '-i acountunique 1 acountunique:4 1 < i1'],
+  ['q1', '-i unique 1 countunique 1 < i1'],
+  ['q2', '-i unique 1 countunique 1 < i2'],
+  ['u2', '-i acountunique 1 acountunique:4 1 < i2'],
+  # Merged states can be merged again
+  ['r1', 'merge-state -- s1 se'],
+);
+
+foreach my $s (@states)
+  {
+    my ($name, $args) = @$s;
+    system ("$prog_bin --emit-state $args > $name") == 0
+      or die "$program_name: cannot create state file $name\n";
+  }
+
+## The contents of s1, and its first 30 bytes
+open my $fh, '<', 's1' or die "$program_name: s1: $!\n";
+binmode $fh;
+my $state1 = do { local $/; <$fh> };
+close $fh;
+my $trunc = substr ($state1, 0, 30);
+open $fh, '>', 't1' or die "$program_name: t1: $!\n";
+binmode $fh;
+print $fh $trunc;
+close $fh or die "$program_name: t1: $!\n";
+
+my $out_merged=<<'EOF';
+C	7	1,6	3.5
+A	6	2,4	3
+B	8	3,5	4
+D	7	7	7
+EOF
+
+my $out_merged_sorted=<<'EOF';
+A	6	2,4	3
+B	8	3,5	4
+C	7	1,6	3.5
+D	7	7	7
+EOF
+
+my @Tests =
+(
+  # Same as --hash-group on the concatenated input
+  ['m1', 'merge-state -- s1 s2', {OUT=>$out_merged}],
+  ['m2', '-s merge-state -- s1 s2', {OUT=>$out_merged_sorted}],
+  ['m3', 'merge-state -- s1 se s2', {OUT=>$out_merged}],
+  ['m4', 'merge-state -- s2 s1',
+    {OUT=>"B\t8\t5,3\t4\nC\t7\t6,1\t3.5\nD\t7\t7\t7\nA\t6\t2,4\t3\n"}],
+  ['m5', 'merge-state -- se', {OUT=>""}],
+  ['m6', 'merge-state', {IN_PIPE=>$state1},
+    {OUT=>"C\t1\t1\t1\nA\t6\t2,4\t3\nB\t3\t3\t3\n"}],
+  ['m7', 'merge-state -- - s2', {IN_PIPE=>$state1}, {OUT=>$out_merged}],
+  # Without grouping
+  ['m8', 'merge-state -- n1 n2', {OUT=>"28\t4\n"}],
+  ['m9', 'merge-state -- r1 s2', {OUT=>$out_merged}],
+
+  # Header lines
+  ['h1', '--header-out merge-state -- s1 s2',
+    {OUT=>"GroupBy(field-1)\tsum(field-2)\tcollapse(field-2)\t" .
+          "median(field-2)\n$out_merged"}],
+  ['h2', 'merge-state -- k1 k2', {OUT=>"C\t7\nA\t6\nB\t8\nD\t7\n"}],
+  ['h3', '--header-out merge-state -- k1 k2',
+    {OUT=>"GroupBy(k)\tsum(v)\nC\t7\nA\t6\nB\t8\nD\t7\n"}],
+
+  # --ignore-case is read from the state files
+  ['i1', 'merge-state -- j1 j2', {OUT=>"a\t4\nB\t6\n"}],
+  # The printed key is from the line kept by max, as with --hash-group
+  ['i2', 'merge-state -- j3 j4', {OUT=>"A\t3\nb\t4\n"}],
+  ['i3', '-i --hash-group -g1 max 2 -- i1 i2', {OUT=>"A\t3\nb\t4\n"}],
+
+  # The moments of the values are combined
+  ['v1', 'merge-state -- v1 v2',
+    {OUT=>"A\t10.64\t0.71363887031784\t0.2018203403245\t0.89465539665361\n"}],
+
+  # The digests of approximate percentiles are combined
+  ['a1', 'merge-state -- a1 a2', {OUT=>"A\t8.4\t3\n"}],
+
+  # The sketches of approximate unique counts are combined
+  ['u1', 'merge-state -- u1 u2', {OUT=>"2\t2\n"}],
+
+  # The strings of unique and countunique are added once
+  ['q1', 'merge-state -- q1 q2', {OUT=>"a,B\t2\n"}],
+
+  # Errors
+  ['e1', '--emit-state -g1 rand 2 -- f1', {EXIT=>1},
+    {ERR=>"$prog: operation 'rand' cannot be used with --emit-state\n"}],
+  ['e2', '--emit-state transpose -- f1', {EXIT=>1},
+    {ERR=>"$prog: --emit-state can only be used with grouping operations\n"}],
+  ['e3', '--emit-state --full -g1 sum 2 -- f1', {EXIT=>1},
+    {ERR=>"$prog: --full cannot be used with --emit-state\n"}],
+  ['e4', 'merge-state -- x1', {EXIT=>1},
+    {ERR=>"$prog: x1: not a datamash state file\n"}],
+  ['e5', 'merge-state -- e0', {EXIT=>1},
+    {ERR=>"$prog: e0: not a datamash state file\n"}],
+  ['e6', 'merge-state -- t1', {EXIT=>1},
+    {ERR=>"$prog: t1: invalid state file\n"}],
+  ['e7', 'merge-state -- s1 c1', {EXIT=>1},
+    {ERR=>"$prog: c1: the state file has different operations\n"}],
+  ['e8', 'merge-state -- s1 k1', {EXIT=>1},
+    {ERR=>"$prog: k1: the state file has different operations\n"}],
+  ['e9', '-g1 merge-state -- s1', {EXIT=>1},
+    {ERR=>"$prog: merge-state reads the grouping from the state files\n"}],
+  ['e10', 'merge-state s1', {EXIT=>1},
+    {ERR=>"$prog: extra operand 's1'\n" .
+          "state files are given after '--'\n" .
+          "Try '$prog --help' for more information.\n"}],
+  ['e11', 'merge-state -- s1 missing', {EXIT=>1},
+    {ERR=>"$prog: missing: No such file or directory\n"}],
+  # The values of pair operations are paired across the lines with --narm
+  ['e12', '--emit-state --narm pcov 1:2 -- f1', {EXIT=>1},
+    {ERR=>"$prog: operation 'pcov' cannot be used with --emit-state " .
+          "and --narm\n"}],
+  # Concatenated state files: the second header is read as a group,
+  # with an invalid length
+  ['e13', 'merge-state', {IN_PIPE=>$state1 . $state1}, {EXIT=>1},
+    {ERR=>"$prog: -: invalid state file\n"}],
+);
+
+my $save_temps = $ENV{SAVE_TEMPS};
+my $verbose = $ENV{VERBOSE};
+
+my $fail = run_tests ($program_name, $prog, \@Tests, $save_temps, $verbose);
+exit $fail;
@@ -128,6 +128,35 @@ my $seq22 = c(61,61,61,61,61,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,
 # "Example 2: Size of Rat Litters"
 my $seq23 =  c(rep(1,7),rep(2,33),rep(3,58),rep(4,116),rep(5,125),rep(6,126),
                rep(7,121),rep(8,107),rep(9,56),rep(10,37),rep(11,25),rep(12,4));
+# The same values as seq21, far from zero: the moments
+# should not lose precision
+my $seq24 = join "", map { ($_ + 100000000000000) . "\n" } split /\n/, $seq21;
+# Pairs of values with N/A values: with --narm, the N/A values are removed
+# from each field, and the n-th values of the fields are paired
+# (1,10), (3,20), (4,40)
+my $pair_na = "1\t10\nNA\t20\n3\tNA\n4\t40\n";
+# 0..999, shuffled: the quantiles are found without sorting all the values
+my $seq25 = join "", map { ($_ * 367 % 1000) . "\n" } (0..999);
+# 0..199999, randomly shuffled (with a fixed LCG): the value at rank R is R
+my @seq26 = (0..199999);
+{
+  my $r = 1;
+  for (my $i = $#seq26; $i > 0; --$i)
+    {
+      $r = ($r * 1103515245 + 12345) % 2147483648;
+      my $j = $r % ($i + 1);
+      @seq26[$i, $j] = @seq26[$j, $i];
+    }
+}
+my $seq26 = join "", map { "$_\n" } @seq26;
+# Replaces each estimate of the field N, at rank PERC% of $seq26, by 'ok'
+# when its rank is within MAX% of the number of values
+sub check_rank ($$$)
+{
+  my ($n, $perc, $max) = @_;
+  return "s{^((?:\\S+\\t){$n})(\\S+)}{\$1 . (abs (\$2 - 199999 * $perc / 100)"
+         . " <= 200000 * $max / 100 ? 'ok' : \$2)}e";
+}
 
 =pod
 The datamash tests below should return the same results are thes R commands:
@@ -384,6 +413,7 @@ my @Tests =
   ['med11','median 1' ,  {IN_PIPE=>$seq21}, {OUT => "37\n"},],
   ['med12','median 1' ,  {IN_PIPE=>$seq22}, {OUT => "67\n"},],
   ['med13','median 1' ,  {IN_PIPE=>$seq23}, {OUT => "6\n"},],
+  ['med14','median 1' ,  {IN_PIPE=>$seq25}, {OUT => "499.5\n"},],
 
   # Test Q1
   ['q1_1', 'q1 1' ,  {IN_PIPE=>$seq1},   {OUT => "1.75\n"}],
@@ -400,6 +430,7 @@ my @Tests =
   ['q1_11','q1 1' ,  {IN_PIPE=>$seq21},  {OUT => "23\n"},],
   ['q1_12','q1 1' ,  {IN_PIPE=>$seq22},  {OUT => "67\n"},],
   ['q1_13','q1 1' ,  {IN_PIPE=>$seq23},  {OUT => "4\n"},],
+  ['q1_14','q1 1' ,  {IN_PIPE=>$seq25},  {OUT => "249.75\n"},],
 
   # Test Q3
   ['q3_1', 'q3 1' ,  {IN_PIPE=>$seq1},   {OUT => "3.25\n"}],
@@ -416,6 +447,7 @@ my @Tests =
   ['q3_11','q3 1' ,  {IN_PIPE=>$seq21},  {OUT => "61.5\n"},],
   ['q3_12','q3 1' ,  {IN_PIPE=>$seq22},  {OUT => "70\n"},],
   ['q3_13','q3 1' ,  {IN_PIPE=>$seq23},  {OUT => "8\n"},],
+  ['q3_14','q3 1' ,  {IN_PIPE=>$seq25},  {OUT => "749.25\n"},],
 
   # Test range
   ['range_1', 'range 1' ,  {IN_PIPE=>$seq1},   {OUT => "3\n"}],
@@ -449,6 +481,7 @@ my @Tests =
   ['perc90_11','perc:90 1' ,  {IN_PIPE=>$seq21},  {OUT => "84.2\n"},],
   ['perc90_12','perc:90 1' ,  {IN_PIPE=>$seq22},  {OUT => "70\n"},],
   ['perc90_13','perc:90 1' ,  {IN_PIPE=>$seq23},  {OUT => "9\n"},],
+  ['perc90_14','perc:90 1' ,  {IN_PIPE=>$seq25},  {OUT => "899.1\n"},],
 
   # Test perc:95
   ['perc95_1', 'perc:95 1' ,  {IN_PIPE=>$seq1},   {OUT => "3.85\n"}],
@@ -507,6 +540,31 @@ my @Tests =
   ['perc75_13','perc:75 1' ,  {IN_PIPE=>$seq23},  {OUT => "8\n"},],
 
 
+  # Approximate percentiles: exact while each value is kept
+  # (up to twice the compression values)
+  ['aperc90_1', 'aperc:90 1' ,  {IN_PIPE=>$seq1},   {OUT => "3.7\n"}],
+  ['aperc90_2', 'aperc:90 1' ,  {IN_PIPE=>$seq12_unsorted},
+    {OUT => "30.8\n"}],
+  ['aperc90_3', 'aperc:90 1' ,  {IN_PIPE=>$seq21},  {OUT => "84.2\n"},],
+  ['aperc90_4', 'aperc:90:500 1' ,  {IN_PIPE=>$seq25},  {OUT => "899.1\n"},],
+  ['aperc95_1', 'aperc 1' ,  {IN_PIPE=>$seq20},  {OUT => "114.15\n"},],
+  ['aperc1_1',  'aperc:1 1',    {IN_PIPE=>$seq20},  {OUT => "78\n"},],
+  ['aperc100_1','aperc:100 1',  {IN_PIPE=>$seq20},  {OUT => "120\n"},],
+  ['amed1', 'amedian 1' ,  {IN_PIPE=>$seq21}, {OUT => "37\n"},],
+  ['amed2', 'amedian 1' ,  {IN_PIPE=>$seq23}, {OUT => "6\n"},],
+  ['amed3', 'amedian:500 1' ,  {IN_PIPE=>$seq25}, {OUT => "499.5\n"},],
+  # Estimated from about 250 centroids, with the exact extreme values
+  ['amed4', '--format %.0f amedian 1 aperc:99 1 aperc:0 1 aperc:100 1',
+    {IN_PIPE=>$seq25}, {OUT => "501\t989\t0\t999\n"},],
+  ['amed5', 'amedian 1' ,  {IN_PIPE=>""}, {OUT => ""},],
+  ['amed6', '--narm amedian 1' ,  {IN_PIPE=>"NA\n"}, {OUT => "nan\n"},],
+  # The documented bounds of the rank error: 0.5% of the values for the
+  # median, and 0.1% for the 1st and 99th percentiles
+  ['amed7', 'amedian 1 aperc:1 1 aperc:99 1', {IN_PIPE=>$seq26},
+    {OUT_SUBST => check_rank (0, 50, 0.5) . ";" . check_rank (1, 1, 0.1)
+                  . ";" . check_rank (2, 99, 0.1)},
+    {OUT => "ok\tok\tok\n"},],
+
   # Trimmed Mean:0
   ['tmean0_1', 'trimmean:0 1' ,  {IN_PIPE=>$seq1},   {OUT => "2.5\n"}],
   ['tmean0_2', 'trimmean:0 1' ,  {IN_PIPE=>$seq2},   {OUT => "2\n"}],
@@ -532,6 +590,7 @@ my @Tests =
   ['tmean1_9', 'trimmean:0.1 1' ,  {IN_PIPE=>$seq21},  {OUT => "42\n"},],
   ['tmean1_10','trimmean:0.1 1' ,  {IN_PIPE=>$seq22},  {OUT => "67.45\n"},],
   ['tmean1_11','trimmean:0.1 1' ,  {IN_PIPE=>$seq23},  {OUT => "6.076\n"},],
+  ['tmean1_12', 'trimmean:0.1 1' ,  {IN_PIPE=>$seq25},  {OUT => "499.5\n"}],
 
   # Trimmed Mean:0.2
   ['tmean2_1', 'trimmean:0.2 1' ,  {IN_PIPE=>$seq1},   {OUT => "2.5\n"}],
@@ -585,6 +644,7 @@ my @Tests =
   ['iqr_9', 'iqr 1' ,  {IN_PIPE=>$seq21},  {OUT => "38.5\n"},],
   ['iqr_10','iqr 1' ,  {IN_PIPE=>$seq22},  {OUT => "3\n"},],
   ['iqr_11','iqr 1' ,  {IN_PIPE=>$seq23},  {OUT => "4\n"},],
+  ['iqr_12','iqr 1' ,  {IN_PIPE=>$seq25},  {OUT => "499.5\n"},],
 
   # Test sample standard deviation
   ['sstdev_1', 'sstdev 1' ,  {IN_PIPE=>$seq1},   {OUT => "1.290\n"}],
@@ -598,6 +658,7 @@ my @Tests =
   ['sstdev_9', 'sstdev 1' ,  {IN_PIPE=>$seq21},  {OUT => "30.448\n"},],
   ['sstdev_10','sstdev 1' ,  {IN_PIPE=>$seq22},  {OUT => "2.934\n"},],
   ['sstdev_11','sstdev 1' ,  {IN_PIPE=>$seq23},  {OUT => "2.275\n"},],
+  ['sstdev_12','sstdev 1' ,  {IN_PIPE=>$seq24},  {OUT => "30.448\n"},],
 
   # Test population standard deviation
   ['pstdev_1', 'pstdev 1' ,  {IN_PIPE=>$seq1},   {OUT => "1.118\n"}],
@@ -637,6 +698,7 @@ my @Tests =
   ['pvar_9', 'pvar 1' ,  {IN_PIPE=>$seq21},  {OUT => "917.857\n"},],
   ['pvar_10','pvar 1' ,  {IN_PIPE=>$seq22},  {OUT => "8.527\n"},],
   ['pvar_11','pvar 1' ,  {IN_PIPE=>$seq23},  {OUT => "5.172\n"},],
+  ['pvar_12','pvar 1' ,  {IN_PIPE=>$seq24},  {OUT => "917.857\n"},],
 
   # Test MAD (Median Absolute Deviation), with default
   # scaling factor of 1.486 for normal distributions
@@ -655,6 +717,7 @@ my @Tests =
   ['mad_9', 'mad 1' ,  {IN_PIPE=>$seq21},  {OUT => "27.428\n"},],
   ['mad_10','mad 1' ,  {IN_PIPE=>$seq22},  {OUT => "4.447\n"},],
   ['mad_11','mad 1' ,  {IN_PIPE=>$seq23},  {OUT => "2.965\n"},],
+  ['mad_12','mad 1' ,  {IN_PIPE=>$seq25},  {OUT => "370.65\n"},],
 
   # Test MAD-Raw (Median Absolute Deviation), with scaling factor of 1
   ['madraw_1', 'madraw 1' ,  {IN_PIPE=>$seq1},   {OUT => "1\n"}],
@@ -672,6 +735,7 @@ my @Tests =
   ['madraw_9', 'madraw 1' ,  {IN_PIPE=>$seq21},  {OUT => "18.5\n"},],
   ['madraw_10','madraw 1' ,  {IN_PIPE=>$seq22},  {OUT => "3\n"},],
   ['madraw_11','madraw 1' ,  {IN_PIPE=>$seq23},  {OUT => "2\n"},],
+  ['madraw_12','madraw 1' ,  {IN_PIPE=>$seq25},  {OUT => "250\n"},],
 
   # Test Skewness for a population
   ['pskew_1', 'pskew 1' ,  {IN_PIPE=>$seq1},   {OUT => "0\n"}],
@@ -685,6 +749,7 @@ my @Tests =
   ['pskew_9', 'pskew 1' ,  {IN_PIPE=>$seq21},  {OUT => "1.193\n"},],
   ['pskew_10','pskew 1' ,  {IN_PIPE=>$seq22},  {OUT => "-0.108\n"},],
   ['pskew_11','pskew 1' ,  {IN_PIPE=>$seq23},  {OUT => "0.172\n"},],
+  ['pskew_12','pskew 1' ,  {IN_PIPE=>$seq24},  {OUT => "1.193\n"},],
 
   # Test Skewness for a sample
   ['sskew_1', 'sskew 1' ,  {IN_PIPE=>$seq1},   {OUT => "0\n"}],
@@ -725,6 +790,7 @@ my @Tests =
   ['skurt_9', 'skurt 1' ,  {IN_PIPE=>$seq21},  {OUT => "1.958\n"},],
   ['skurt_10','skurt 1' ,  {IN_PIPE=>$seq22},  {OUT => "-0.209\n"},],
   ['skurt_11','skurt 1' ,  {IN_PIPE=>$seq23},  {OUT => "-0.476\n"},],
+  ['skurt_12','skurt 1' ,  {IN_PIPE=>$seq24},  {OUT => "1.958\n"},],
 
   # Test Jarque-Bera normality pVale
   ['jarque_1', 'jarque 1' ,  {IN_PIPE=>$seq1},   {OUT => "0.857\n"}],
@@ -738,6 +804,7 @@ my @Tests =
   ['jarque_9', 'jarque 1' ,  {IN_PIPE=>$seq21},  {OUT => "8.011e-09\n"},],
   ['jarque_10','jarque 1' ,  {IN_PIPE=>$seq22},  {OUT => "0.789\n"},],
   ['jarque_11','jarque 1' ,  {IN_PIPE=>$seq23},  {OUT => "0.002\n"},],
+  ['jarque_12','jarque 1' ,  {IN_PIPE=>$seq24},  {OUT => "8.011e-09\n"},],
 
   # Test D'Agostino-Pearson omnibus test for normality
   ['dpo_1', 'dpo 1' ,  {IN_PIPE=>$seq1},   {OUT => "0.900\n"}],
@@ -751,13 +818,25 @@ my @Tests =
   ['dpo_9', 'dpo 1' ,  {IN_PIPE=>$seq21},  {OUT => "7.689e-10\n"},],
   ['dpo_10','dpo 1' ,  {IN_PIPE=>$seq22},  {OUT => "0.819\n"},],
   ['dpo_11','dpo 1' ,  {IN_PIPE=>$seq23},  {OUT => "0.002\n"},],
+  ['dpo_12','dpo 1' ,  {IN_PIPE=>$seq24},  {OUT => "7.689e-10\n"},],
+
+  # Pair operations with --narm
+  ['narm_pair_1', '--narm dotprod 1:2', {IN_PIPE=>$pair_na}, {OUT => "230\n"}],
+  ['narm_pair_2', '--narm dotprod 2:1', {IN_PIPE=>$pair_na}, {OUT => "230\n"}],
+  ['narm_pair_3', '--narm pcov 1:2',    {IN_PIPE=>$pair_na},
+    {OUT => "14.444\n"}],
+  ['narm_pair_4', '--narm scov 2:1',    {IN_PIPE=>$pair_na},
+    {OUT => "21.666\n"}],
+  ['narm_pair_5', '--narm ppearson 1:2', {IN_PIPE=>$pair_na},
+    {OUT => "0.928\n"}],
 );
 
 ##
 ## For each test, trim the resulting value to maximum three digits
-## after the decimal point.
+## after the decimal point (unless the test has its own OUT_SUBST).
 ##
 for my $t (@Tests) {
+ next if grep { ref $_ eq 'HASH' && exists $_->{OUT_SUBST} } @{$t};
  push @{$t}, {OUT_SUBST=>'s/^(-?\d+\.\d{1,3})\d*/\1/'};
 }
 
@@ -238,6 +238,16 @@ A x 5
 B Y 6
 EOF
 
+# Long keys which differ only at their end, in two columns
+my $in_case_long=<<'EOF';
+customer-0000001 region-00000001 1
+CUSTOMER-0000001 REGION-00000001 2
+customer-0000001 region-00000001 3
+customer-0000001 region-00000002 4
+customer-0000002 region-00000002 5
+Customer-0000002 Region-00000002 6
+EOF
+
 my $in_sort_quote1=<<"EOF";
 A'1
 B'2
@@ -444,6 +454,14 @@ sub single_line_base64($)
 my $out_g1_base64 = transform_column ($in_g1, 2, \&single_line_base64);
 my $out_g1_debase64 = transform_column ($out_g1_base64, 1, \&decode_base64);
 
+# More than 128KiB of input, and a line longer than 128KiB
+my $in_blocks1 = ("A 1\n" x 30000) . ("B 2\n" x 30000) . "C 3\n";
+my $in_blocks2 = "A 1\n" . "B " . ("x" x 300000) . "\nC 3";
+
+# Lines with 100 fields
+my $in_scan1 = join(",", 0..99) . "\n" . join(",", 0..99) . "\n";
+my $in_scan2 = join(" \t ", 0..99) . "  \n" . join("\t", 0..99) . "\n";
+
 my @Tests =
 (
   # Basic tests, single field, single group, default everything
@@ -750,6 +768,8 @@ my @Tests =
     {OUT=>"perc:95(y)\n8.45\n"},],
   ['hdr26', '-W -H perc:50 2', {IN_PIPE=>$in_hdr1},
     {OUT=>"perc:50(y)\n4\n"}],
+  ['hdr27', '-W -H aperc 2 aperc:50:200 2 amedian:200 2', {IN_PIPE=>$in_hdr1},
+    {OUT=>"aperc:95(y)\taperc:50(y)\tamedian(y)\n8.45\t4\t4\n"}],
 
   # Test single line per group
   ['sl1', '-t" " -g 1 mean 2', {IN_PIPE=>$in_g4},
@@ -767,6 +787,23 @@ my @Tests =
     {OUT=>"a 1\nA 3\n"}],
   ['cuq5', '-i -t" " -g 1 countunique 2', {IN_PIPE=>$in_cnt_uniq2},
     {OUT=>"a 2\n"}],
+  # unique, case-insensitive: the first of the equal values is printed
+  ['cuq6', '-i -t" " unique 2', {IN_PIPE=>$in_cnt_uniq2}, {OUT=>"B,C\n"}],
+  # many repeated values
+  ['cuq7', 'countunique 1 unique 1', {IN_PIPE=>("x\ny\n" x 1000) . "z\n"},
+    {OUT=>"3\tx,y,z\n"}],
+
+  # Test acountunique operation (exact while the values are few)
+  ['acuq1', '-t" " -g 1 acountunique 3', {IN_PIPE=>$in_g3},
+    {OUT=>"A 2\nB 2\nC 1\n"}],
+  ['acuq2', '-t" " --header-in -g 1 acountunique 2',
+    {IN_PIPE=>$in_cnt_uniq1},
+    {OUT=>"A 2\nB 2\n"}],
+  ['acuq3', '-t" " -g 1 acountunique 2', {IN_PIPE=>$in_cnt_uniq2},
+    {OUT=>"a 1\nA 3\n"}],
+  ['acuq4', '-i -t" " -g 1 acountunique:4 2', {IN_PIPE=>$in_cnt_uniq2},
+    {OUT=>"a 2\n"}],
+  ['acuq5', 'acountunique 1', {IN_PIPE=>""}, {OUT=>""}],
 
   # Test Tab vs White-space field separator
   ['tab1', "sum 2", {IN_PIPE=>$in_tab1}, {OUT=>"60\n"}],
@@ -807,6 +844,19 @@ my @Tests =
     {OUT=>"A 7\nB 6\na 4\nb 4\n"}],
   ['case6', '-t" " -s -g 1 unique 2', {IN_PIPE=>$in_case_unsorted},
     {OUT=>"A X,x\nB Y\na X,x\nb Y\n"}],
+  ['case10', '-t" " -g 1,2 sum 3', {IN_PIPE=>$in_case_long},
+    {OUT=>"customer-0000001 region-00000001 1\n" .
+          "CUSTOMER-0000001 REGION-00000001 2\n" .
+          "customer-0000001 region-00000001 3\n" .
+          "customer-0000001 region-00000002 4\n" .
+          "customer-0000002 region-00000002 5\n" .
+          "Customer-0000002 Region-00000002 6\n"}],
+  ['case11', '-t" " -i -g 1,2 sum 3', {IN_PIPE=>$in_case_long},
+    {OUT=>"customer-0000001 region-00000001 6\n" .
+          "customer-0000001 region-00000002 4\n" .
+          "customer-0000002 region-00000002 11\n"}],
+  ['case12', '-t" " -i -g 2 collapse 3', {IN_PIPE=>$in_case_long},
+    {OUT=>"region-00000001 1,2,3\nregion-00000002 4,5,6\n"}],
 
   ## Test nul-terminated lines
   ['nul1', '-t" " -z -g 1 sum 2', {IN_PIPE=>$in_nul1},
@@ -973,6 +1023,58 @@ my @Tests =
   ## group by name + sorting
   ['ng11',   '-s -t" " -H -g x sum 2', {IN_PIPE=>$in_hdr1},
     {OUT=>"GroupBy(x) sum(y)\nA 14\nB 18\nC 20\n"}],
+
+  ## Input redirected from a regular file (memory-mapped, not a pipe)
+  ['mmap1', '-W -g1 sum 2', '<', {IN=>"A 1\nA 2\nB 3"},
+    {OUT=>"A\t3\nB\t3\n"}],
+  ['mmap2', '-s -t" " -H -g x sum 2', '<', {IN=>$in_hdr1},
+    {OUT=>"GroupBy(x) sum(y)\nA 14\nB 18\nC 20\n"}],
+  ['mmap3', '-z -W -g1 sum 2', '<', {IN=>$in_nul1},
+    {OUT=>"A\t3\x00B\t7\x00"}],
+  ['mmap4', '-C -W -g1 count 1', '<', {IN=>"#A 1\nA 1\n  ;B 2\nB 2\n"},
+    {OUT=>"A\t1\nB\t1\n"}],
+  ['mmap5', '-W --full round 2', '<', {IN=>"A 1.2\n"},
+    {OUT=>"A\t1.2\t1\n"}],
+
+  ## Field splitting of lines longer than one scanning block (64 bytes),
+  ## with the vector kernels and with the portable kernel
+  ['scan1', '-t, count 100 sum 100 last 70', {IN_PIPE=>$in_scan1},
+    {OUT=>"2,198,69\n"}],
+  ['scan2', '---no-simd -t, count 100 sum 100 last 70', {IN_PIPE=>$in_scan1},
+    {OUT=>"2,198,69\n"}],
+  ['scan3', '-W count 100 sum 100 last 70', {IN_PIPE=>$in_scan2},
+    {OUT=>"2\t198\t69\n"}],
+  ['scan4', '---no-simd -W count 100 sum 100 last 70', {IN_PIPE=>$in_scan2},
+    {OUT=>"2\t198\t69\n"}],
+
+  ## Lines are split only up to the highest used column,
+  ## unless the entire line is needed.
+  ['proj1', '-t, -g2 count 2 last 1', {IN_PIPE=>"1,A,x,y\n2,A,z\n3,B\n"},
+    {OUT=>"A,2,2\nB,1,3\n"}],
+  ['proj2', '-t, --output-delimiter=: rmdup 2',
+    {IN_PIPE=>"1,A,x,y\n2,A,z\n3,B\n"}, {OUT=>"1:A:x:y\n3:B\n"}],
+  ['proj3', '-t, --header-out --full round 1',
+    {IN_PIPE=>"1,A,x,y\n2,A,z\n"},
+    {OUT=>"field-1,field-2,field-3,field-4,round(field-1)\n" .
+          "1,A,x,y,1\n2,A,z,2\n"}],
+  ['proj4', '-t, --full -g2 count 2', {IN_PIPE=>"1,A,x,y\n2,A,z\n"},
+    {OUT=>"1,A,x,y,2\n"},
+    {ERR=>"datamash: Using -f/--full with non-linewise operations " .
+          "is deprecated and will be disabled in a future release.\n"}],
+  ['proj5', '-t, sum 3', {IN_PIPE=>"1,2,3,4,5\n1,2\n"}, {EXIT=>1},
+    {ERR=>"$prog: invalid input: field 3 requested, " .
+          "line 2 has only 2 fields\n"}],
+
+  ## Input larger than one read buffer, with lines spanning buffers
+  ['blk1', '-W -g1 count 1 sum 2', {IN_PIPE=>$in_blocks1},
+    {OUT=>"A\t30000\t30000\nB\t30000\t60000\nC\t1\t3\n"}],
+  ['blk2', '-W check', {IN_PIPE=>$in_blocks2},
+    {OUT=>"3 lines, 2 fields\n"}],
+  ['blk3', '-W check', {IN_PIPE=>$in_blocks1 . "D E F\n"}, {EXIT=>1},
+    {ERR=>"line 60001 (2 fields):\n  C 3\n" .
+          "line 60002 (3 fields):\n  D E F\n" .
+          "$prog: check failed: line 60002 has 3 fields " .
+          "(previous line had 2)\n"}],
 );
 
 if ($have_stable_sort) {
@@ -0,0 +1,138 @@
+#!/usr/bin/env perl
+=pod
+  Unit Tests for GNU Datamash - perform simple calculation on input data
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of GNU Datamash.
+
+   GNU Datamash is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   GNU Datamash is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Datamash.  If not, see <https://www.gnu.org/licenses/>.
+=cut
+
+use strict;
+use warnings;
+
+use lib '.';
+# Until a better way comes along to auto-use Coreutils Perl modules
+# as in the coreutils' autotools system.
+use Coreutils;
+use CuSkip;
+use CuTmpdir qw(datamash);
+
+(my $program_name = $0) =~ s|.*/||;
+my $prog_bin = 'datamash';
+
+## Cross-Compiling portability hack:
+##  under qemu/binfmt, argv[0] (which is used to report errors) will contain
+##  the full path of the binary, if the binary is on the $PATH.
+##  So we try to detect what is the actual returned value of the program
+##  in case of an error.
+my $prog = `$prog_bin ---print-progname`;
+$prog = $prog_bin unless $prog;
+
+# Turn off localization of executable's output.
+@ENV{qw(LANGUAGE LANG LC_ALL)} = ('C') x 3;
+
+## Unsorted input: the groups of 'b' are not consecutive
+my $in1=<<'EOF';
+a	1	9
+b	5	1
+c	3	1
+b	2	1
+d	7	2
+e	7	3
+EOF
+
+my $in2 = $in1 . "f\tNA\t1\n";
+
+my $in_hdr = "key\tval\tn\n" . $in1;
+
+## Largest sums first; equal sums in the usual order of the groups
+my $out_top3=<<'EOF';
+b	7
+d	7
+e	7
+EOF
+
+my $out_hdr=<<'EOF';
+GroupBy(key)	sum(val)
+b	7
+d	7
+EOF
+
+my @Tests =
+(
+  ['t1', '--hash-group --top 3 -g1 sum 2', {IN_PIPE=>$in1},
+    {OUT=>$out_top3}],
+  ['t2', '--hash-group --top=3 --by=1 -g1 sum 2', {IN_PIPE=>$in1},
+    {OUT=>$out_top3}],
+  ['t3', '-s --top 3 -g1 sum 2', {IN_PIPE=>$in1}, {OUT=>$out_top3}],
+  ['t4', '--hash-group -s --top 3 -g1 sum 2', {IN_PIPE=>$in1},
+    {OUT=>$out_top3}],
+  # With sorted input, each run of a key is a group
+  ['t5', '--top 2 -g1 sum 2', {IN_PIPE=>$in1}, {OUT=>"d\t7\ne\t7\n"}],
+  # Fewer groups than N
+  ['t6', '-s --top 100 -g1 count 1', {IN_PIPE=>"x\ny\nx\n"},
+    {OUT=>"x\t2\ny\t1\n"}],
+  ['t7', '--hash-group --top 2 --by 2 -g1 sum 3 sum 2', {IN_PIPE=>$in1},
+    {OUT=>"b\t2\t7\nd\t2\t7\n"}],
+  ['t8', '-s --top 2 --by 2 -g1 max 3 count 2', {IN_PIPE=>$in1},
+    {OUT=>"b\t1\t2\na\t9\t1\n"}],
+  # The operation can be any operation with a numeric result
+  ['t9', '--hash-group --top 1 -g1 max 3', {IN_PIPE=>$in1},
+    {OUT=>"a\t9\n"}],
+  ['t10', '--hash-group --top 2 --by 2 -g1 first 3 count 2',
+    {IN_PIPE=>$in1}, {OUT=>"b\t1\t2\na\t9\t1\n"}],
+  # NaN results are ranked last
+  ['t11', '--narm --hash-group --top 10 -g1 mean 2', {IN_PIPE=>$in2},
+    {OUT=>"d\t7\ne\t7\nb\t3.5\nc\t3\na\t1\nf\tnan\n"}],
+  # Operations on pairs of fields count as one operation
+  ['t12', '--narm --hash-group --top 2 --by 2 -g1 pcov 2:3 sum 2',
+    {IN_PIPE=>$in2}, {OUT=>"b\t0\t7\nd\t0\t7\n"}],
+  # Threads and spilled groups
+  ['t13', '--hash-group --threads 3 --top 3 -g1 sum 2', {IN_PIPE=>$in1},
+    {OUT=>$out_top3}],
+  ['t14', '--hash-group --hash-buffer-size=1b --top 3 -g1 sum 2',
+    {IN_PIPE=>$in1}, {OUT=>$out_top3}],
+  ['t15', '--hash-group --hash-buffer-size=1b -s --top 3 -g1 sum 2',
+    {IN_PIPE=>$in1}, {OUT=>$out_top3}],
+  ['t16', '--hash-group --hash-buffer-size=1b --threads 2 --top 3 '
+          . '-g1 sum 2', {IN_PIPE=>$in1}, {OUT=>$out_top3}],
+  # The header line is printed first
+  ['t17', '--header-in --header-out --hash-group --top 2 -g key sum val',
+    {IN_PIPE=>$in_hdr}, {OUT=>$out_hdr}],
+
+  ['e1', '--top 0 -g1 sum 2', {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: invalid number of groups: '0'\n"}],
+  ['e2', '--top 1 --by x -g1 sum 2', {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: invalid operation number: 'x'\n"}],
+  ['e3', '--by 1 -g1 sum 2', {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: --by requires --top\n"}],
+  ['e4', '--top 1 --by 2 -g1 sum 2', {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: invalid operation number for --by: 2\n"}],
+  ['e5', '--top 1 --by 2 -g1 sum 2 unique 2', {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: operation 'unique' cannot be used with --by\n"}],
+  ['e6', '--top 1 md5 1', {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: --top can only be used with grouping operations\n"}],
+  ['e7', '--top 1 ct 1,2', {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: --top can only be used with grouping operations\n"}],
+  ['e8', '--top 1 --emit-state -g1 sum 2', {IN_PIPE=>""}, {EXIT=>1},
+    {ERR=>"$prog: --top can only be used with grouping operations\n"}],
+);
+
+my $save_temps = $ENV{SAVE_TEMPS};
+my $verbose = $ENV{VERBOSE};
+
+my $fail = run_tests ($program_name, $prog, \@Tests, $save_temps, $verbose);
+exit $fail;